@@ -5,7 +5,9 @@
 #include <array>
 #include "lion/math/vector3d.h"
 #include "lion/io/Xml_document.h"
+#include "src/core/foundation/polyline_spatial_index.h"
 #include <memory>
+#include <chrono>
 
 
 class Circuit_preprocessor
@@ -33,9 +35,24 @@ class Circuit_preprocessor
         scalar maximum_dkappa = 2.0e-2;
         scalar maximum_dn     = 1.0;
         scalar maximum_distance_find = 50.0;
+        scalar maximum_window_find   = 100.0;       //! Maximum distance along a boundary between consecutive projections on it
 
         scalar adaption_aspect_ratio_max = 1.2;
 
+        size_t maximum_association_iterations = 10; //! Maximum number of NLP solves with updated node-segment associations
+
+        // Multilevel: the problem is solved first on meshes coarser by multilevel_coarsening^(multilevel_levels-1),...,multilevel_coarsening,
+        // each solution warm starting the next level, until the requested mesh. multilevel_levels = 1 solves the requested mesh only
+        size_t multilevel_levels     = 1;
+        scalar multilevel_coarsening = 2.0;
+        size_t multilevel_minimum_elements = 20;    //! Minimum number of elements of the coarse levels, if given by number of elements
+
+        // Parallel chunks (closed circuits only): if parallel_chunks > 1, the first level is solved as parallel_chunks overlapping
+        // open circuits, set up in parallel and solved by IPOPT one at a time. Their solutions are blended in the overlaps, and 
+        // warm start a closed circuit solve
+        size_t parallel_chunks = 1;
+        scalar chunk_overlap   = 100.0;     //! Length of the overlap between adjacent chunks [m]
+
         int print_level = 0;
     };
 
@@ -59,6 +76,20 @@ class Circuit_preprocessor
         *this = Circuit_preprocessor(coord_left, coord_right, opts, std::forward<Args>(args)...);
     }
 
+    //! Any constructor from KML/KMZ files, read without building the XML tree
+    template<typename ... Args>
+    Circuit_preprocessor(const std::string& coord_left_file, 
+                         const std::string& coord_right_file,
+                         Options opts,
+                         Args&&... args)
+    {
+        // (1) Stream the KML/KMZ files into vectors of coordinates
+        auto [coord_left, coord_right] = read_kml(coord_left_file,coord_right_file);
+
+        // (2) Call the proper implementation from vector of coordinates 
+        *this = Circuit_preprocessor(coord_left, coord_right, opts, std::forward<Args>(args)...);
+    }
+
     //! Constructor for closed circuits, from number of elements
     Circuit_preprocessor(const std::vector<Coordinates>& coord_left, 
                          const std::vector<Coordinates>& coord_right, 
@@ -69,11 +100,12 @@ class Circuit_preprocessor
         // (1) Compute the centerline and preprocess inputs
         transform_coordinates<true>(coord_left, coord_right);
 
-        // (3) Compute the centerline estimate
-        const auto [s_center,r_center,track_length_estimate] = compute_averaged_centerline<true>(r_left_measured,r_right_measured,n_elements,n_points,options);
-
-        // (3) Perform the optimization
-        compute<true>(s_center, r_center, track_length_estimate);
+        // (2) Compute the centerline estimate and perform the optimization, for each level
+        compute_multilevel<true>([&](const scalar coarsening)
+        {
+            const size_t n_el_level = get_level_number_of_elements(n_el, coarsening);
+            return compute_averaged_centerline<true>(r_left_measured,r_right_measured,n_el_level,n_el_level,options);
+        });
     }
 
     //! Constructor for closed circuits, from mesh size given as breakpoints along the circuit
@@ -97,14 +129,15 @@ class Circuit_preprocessor
             ds_breakpoints_v3d[i].second = ds_breakpoints[i].second;
         }
 
-        // (3) Compute the centerline estimate
-        const auto [s_center,r_center,track_length_estimate] = compute_averaged_centerline<true>(r_left_measured,r_right_measured,ds_breakpoints_v3d,options);
-
-        n_points   = s_center.size();
-        n_elements = n_points;
+        // (2) Compute the centerline estimate and perform the optimization, for each level
+        compute_multilevel<true>([&](const scalar coarsening)
+        {
+            auto ds_breakpoints_level = ds_breakpoints_v3d;
+            for (auto& breakpoint : ds_breakpoints_level)
+                breakpoint.second *= coarsening;
 
-        // (3) Perform the optimization
-        compute<true>(s_center, r_center, track_length_estimate);
+            return compute_averaged_centerline<true>(r_left_measured,r_right_measured,ds_breakpoints_level,options);
+        });
     }
 
     //! Constructor for closed circuits, from mesh size given as breakpoints along the circuit
@@ -118,14 +151,15 @@ class Circuit_preprocessor
         // (1) Compute the centerline and preprocess inputs
         transform_coordinates<true>(coord_left, coord_right);
 
-        // (2) Compute the centerline estimate
-        const auto [s_center,r_center,track_length_estimate] = compute_averaged_centerline<true>(r_left_measured,r_right_measured,s_distribution,ds_distribution,options);
-
-        n_points   = s_center.size();
-        n_elements = n_points;
+        // (2) Compute the centerline estimate and perform the optimization, for each level
+        compute_multilevel<true>([&](const scalar coarsening)
+        {
+            std::vector<scalar> ds_distribution_level(ds_distribution);
+            for (auto& ds : ds_distribution_level)
+                ds *= coarsening;
 
-        // (3) Perform the optimization
-        compute<true>(s_center, r_center, track_length_estimate);
+            return compute_averaged_centerline<true>(r_left_measured,r_right_measured,s_distribution,ds_distribution_level,options);
+        });
     }
 
 
@@ -145,11 +179,12 @@ class Circuit_preprocessor
         // (2) Compute the centerline and preprocess inputs
         transform_coordinates<false>(coord_left_trim, coord_right_trim);
 
-        // (3) Compute the centerline estimate
-        const auto [s_center,r_center,track_length_estimate] = compute_averaged_centerline<false>(r_left_measured,r_right_measured,n_elements,n_points,options);
-
-        // (4) Perform the optimization
-        compute<false>(s_center, r_center, track_length_estimate);
+        // (3) Compute the centerline estimate and perform the optimization, for each level
+        compute_multilevel<false>([&](const scalar coarsening)
+        {
+            const size_t n_el_level = get_level_number_of_elements(n_el, coarsening);
+            return compute_averaged_centerline<false>(r_left_measured,r_right_measured,n_el_level,n_el_level+1,options);
+        });
     }
 
     // Inputs ------------------------------------:-
@@ -157,11 +192,11 @@ class Circuit_preprocessor
     size_t      n_elements;
     size_t      n_points;
     bool        is_closed;
-    int         direction;      
+    int         direction = 0;      
 
     // Outputs -----------------------------------:-
-    scalar x0;      
-    scalar y0;      
+    scalar x0 = 0.0;      
+    scalar y0 = 0.0;      
     scalar phi0;    
     scalar theta0;  
     scalar phi_ref; 
@@ -188,6 +223,20 @@ class Circuit_preprocessor
     scalar left_boundary_L2_error;
     scalar right_boundary_L2_error;
 
+    size_t n_association_iterations = 0;    //! Number of NLP solves until the node-segment associations converged
+    bool associations_converged = false;    //! If the associations converged before maximum_association_iterations
+
+    //! Statistics of each level of the multilevel solution, from the coarsest
+    struct Level_statistics
+    {
+        size_t n_elements;                  //! Number of elements of the level
+        size_t n_association_iterations;    //! Number of NLP solves of the level
+        bool associations_converged;        //! If the associations of the level converged
+        scalar elapsed_time;                //! Wall time of the level, including the centerline estimate [s]
+    };
+
+    std::vector<Level_statistics> level_statistics;
+
     std::unique_ptr<Xml_document> xml() const;
 
  private:
@@ -195,8 +244,32 @@ class Circuit_preprocessor
     template<bool closed>
     void transform_coordinates(const std::vector<Coordinates>& coord_left, const std::vector<Coordinates>& coord_right);
 
+    //! Solve the problem from a centerline estimate
+    //! @param[in] warm_start: if true, the initial guess is interpolated from the current solution (that of a coarser mesh)
+    template<bool closed>
+    void compute(const std::vector<scalar>& s_center, const std::vector<sVector3d>& r_center, const scalar track_length_estimate,
+                 const bool warm_start = false);
+
+    //! Solve the problem as overlapping open chunks in parallel, and store their blended solution in the outputs
+    void compute_chunks(const std::vector<scalar>& s_center, const std::vector<sVector3d>& r_center, const scalar track_length_estimate);
+
+    //! Solve the problem for each level, from the coarsest
+    //! @param[in] centerline: returns the centerline estimate (s, r, track length estimate) of the mesh coarsened by a given factor
+    template<bool closed, typename Centerline_function>
+    void compute_multilevel(Centerline_function&& centerline);
+
+    //! Number of elements of a level, coarser by a given factor
+    size_t get_level_number_of_elements(const size_t n_el, const scalar coarsening) const
+        { return (coarsening == 1.0 ? n_el : std::min(n_el, std::max(options.multilevel_minimum_elements, static_cast<size_t>(std::round(n_el/coarsening))))); }
+
+    //! Compute the segments of the measured boundaries and the centerline estimate closest to each node of the variables x. 
+    //! Each node is searched within a window from the segments of the previous node, as find_closest_point_in_window()
+    //! @param[in] r_center: the centerline estimate
+    //! @return the indexes of the first point of the segments for the left boundary, right boundary, and centerline
     template<bool closed>
-    void compute(const std::vector<scalar>& s_center, const std::vector<sVector3d>& r_center, const scalar track_length_estimate);
+    std::array<std::vector<size_t>,3> compute_associations(const std::vector<scalar>& x, const Polyline_spatial_index& left_index,
+                                                           const Polyline_spatial_index& right_index, const Polyline_spatial_index& center_index,
+                                                           const std::vector<sVector3d>& r_center) const;
 
     template<bool closed>
     class FG
@@ -221,6 +294,17 @@ class Circuit_preprocessor
 
         void operator()(ADvector& fg, const ADvector& x);
 
+        //! Set the segments of the left and right boundaries and the centerline used for the distances of each node
+        void set_associations(const std::vector<size_t>& segment_left, const std::vector<size_t>& segment_right, const std::vector<size_t>& segment_center)
+        {
+            _segment_left   = segment_left;
+            _segment_right  = segment_right;
+            _segment_center = segment_center;
+        }
+
+        //! Squared distance from p to the segment [r_curve[i_segment], r_curve[i_segment+1]]
+        static CppAD::AD<scalar> segment_distance2(const std::vector<sVector3d>& r_curve, const size_t i_segment, const Vector3d<CppAD::AD<scalar>>& p);
+
         std::array<CppAD::AD<scalar>,NSTATE> equations(const std::array<CppAD::AD<scalar>,NSTATE>& q, const std::array<CppAD::AD<scalar>,NCONTROLS>& u) const
         {
             return { cos(q[ITHETA]), sin(q[ITHETA]), q[IKAPPA], u[IDKAPPA], u[IDNL], u[IDNR] };
@@ -245,6 +329,10 @@ class Circuit_preprocessor
         std::vector<sVector3d> _r_right;
         std::vector<sVector3d> _r_center;
 
+        std::vector<size_t> _segment_left;      //! Segment of the left boundary associated to each node
+        std::vector<size_t> _segment_right;     //! Segment of the right boundary associated to each node
+        std::vector<size_t> _segment_center;    //! Segment of the centerline estimate associated to each node
+
         std::vector<std::array<CppAD::AD<scalar>,NSTATE>> _q;
         std::vector<std::array<CppAD::AD<scalar>,NCONTROLS>> _u;
         std::vector<std::array<CppAD::AD<scalar>,NSTATE>> _dqds;
@@ -256,6 +344,9 @@ class Circuit_preprocessor
 
     std::pair<std::vector<Coordinates>,std::vector<Coordinates>> read_kml(Xml_document& coord_left_kml, Xml_document& coord_right_kml);
 
+    //! Read the coordinates of KML/KMZ files with Kml_reader
+    std::pair<std::vector<Coordinates>,std::vector<Coordinates>> read_kml(const std::string& coord_left_file, const std::string& coord_right_file);
+
     //! Compute the averaged centerline between r_left and r_right with given number of elements
     template<bool closed>
     static std::tuple<std::vector<scalar>, std::vector<sVector3d>, scalar> compute_averaged_centerline(std::vector<sVector3d> r_left, 
@@ -285,8 +376,22 @@ class Circuit_preprocessor
                                                                                           const std::vector<Coordinates>& coord_right,
                                                                                           Coordinates start, Coordinates finish);
 
-    template<bool closed>
-    static scalar compute_ds_for_coordinates(const sVector3d point, const std::vector<sVector3d>& r_curve, const std::vector<std::pair<sVector3d,scalar>>& ds_breakpoints);
+    //! Get the mesh size of the closest breakpoint behind point
+    //! @param[in] curve_index: spatial index of the curve where the breakpoints are located
+    //! @param[in] ds_breakpoints_projection: closest points of the curve to each breakpoint, from project_ds_breakpoints
+    static scalar compute_ds_for_coordinates(const sVector3d point, const Polyline_spatial_index& curve_index, 
+                                             const std::vector<Polyline_spatial_index::Result>& ds_breakpoints_projection,
+                                             const std::vector<std::pair<sVector3d,scalar>>& ds_breakpoints);
+
+    //! Project the breakpoints on the curve once, rather than for each mesh point
+    static std::vector<Polyline_spatial_index::Result> project_ds_breakpoints(const Polyline_spatial_index& curve_index,
+                                                                              const std::vector<std::pair<sVector3d,scalar>>& ds_breakpoints);
+
+    //! Closest point of the curve within maximum_distance, among the segments within window_length along the curve from 
+    //! the segment i_start, from its spatial index. If there is none, searches along r_curve from i_start, as find_closest_point()
+    static Polyline_spatial_index::Result find_closest_point_in_window(const Polyline_spatial_index& curve_index, const std::vector<sVector3d>& r_curve,
+                                                                       const sVector3d& point, const bool closed, const size_t i_start,
+                                                                       const scalar maximum_distance, const scalar window_length);
 
     static size_t who_is_ahead(std::array<size_t,2>& i_p1, std::array<size_t,2>& i_p2, const sVector3d& p1, const sVector3d& p2, const sVector3d& p_ref);
 };
@@ -5,6 +5,11 @@
 #include "lion/math/polynomial.h"
 #include "lion/math/matrix_extensions.h"
 #include "lion/math/ipopt_cppad_handler.hpp"
+#include "lion/thirdparty/include/logger.hpp"
+#include "src/core/foundation/polyline_spatial_index.h"
+#include "src/core/foundation/kml_reader.h"
+#include "src/core/foundation/thread_pool.h"
+#include "src/core/foundation/ipopt_solver_lock.h"
 
 inline std::pair<std::vector<Circuit_preprocessor::Coordinates>,std::vector<Circuit_preprocessor::Coordinates>>
     Circuit_preprocessor::read_kml(Xml_document& coord_left_kml, Xml_document& coord_right_kml)
@@ -35,6 +40,27 @@ inline std::pair<std::vector<Circuit_preprocessor::Coordinates>,std::vector<Circ
 }
 
 
+inline std::pair<std::vector<Circuit_preprocessor::Coordinates>,std::vector<Circuit_preprocessor::Coordinates>>
+    Circuit_preprocessor::read_kml(const std::string& coord_left_file, const std::string& coord_right_file)
+{
+    auto read_coordinates = [](const std::string& filename)
+    {
+        std::vector<Coordinates> coordinates;
+        coordinates.reserve(Kml_reader::estimate_number_of_points(filename));
+
+        Kml_reader::read(filename, [&](const Kml_reader::Point* points, const size_t n_points)
+        {
+            for (size_t i = 0; i < n_points; ++i)
+                coordinates.push_back({points[i].longitude, points[i].latitude});
+        });
+
+        return coordinates;
+    };
+
+    return {read_coordinates(coord_left_file), read_coordinates(coord_right_file)};
+}
+
+
 inline Circuit_preprocessor::Circuit_preprocessor(Xml_document& doc)
 {
     Xml_element root = doc.get_root_element();
@@ -173,9 +199,10 @@ inline void Circuit_preprocessor::transform_coordinates(const std::vector<Coordi
 
 
 template<bool closed>
-inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, const std::vector<sVector3d>& r_center, const scalar track_length_estimate)
+inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, const std::vector<sVector3d>& r_center, const scalar track_length_estimate,
+    const bool warm_start)
 {
-    // (1) Compute the initial condition via finite differences
+    // (1) Compute the initial condition via finite differences, or from the solution of the previous level
     std::vector<scalar> x_init(n_points,0.0);
     std::vector<scalar> y_init(n_points,0.0);
     std::vector<scalar> theta_init(n_points,0.0);
@@ -186,68 +213,124 @@ inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, c
     std::vector<scalar> dnl_init(n_points,0.0);
     std::vector<scalar> dnr_init(n_points,0.0);
 
-    // x and y
-    for (size_t i = 0; i < n_points; ++i)
+    // The spatial indexes of the measured boundaries are also used for the associations and the errors
+    const Polyline_spatial_index left_index(r_left_measured, closed);
+    const Polyline_spatial_index right_index(r_right_measured, closed);
+
+    if ( !warm_start )
     {
-        x_init[i] = r_center[i][0];
-        y_init[i] = r_center[i][1];
-    }
+        // x and y
+        for (size_t i = 0; i < n_points; ++i)
+        {
+            x_init[i] = r_center[i][0];
+            y_init[i] = r_center[i][1];
+        }
 
-    // theta
-    theta_init[0] = atan2(y_init[1]-y_init[0],x_init[1]-x_init[0]);
-    for (size_t i = 1; i < n_points-1; ++i)
-        theta_init[i] = theta_init[i-1] + wrap_to_pi(atan2(y_init[i+1]-y_init[i],x_init[i+1]-x_init[i])-theta_init[i-1]);
+        // theta
+        theta_init[0] = atan2(y_init[1]-y_init[0],x_init[1]-x_init[0]);
+        for (size_t i = 1; i < n_points-1; ++i)
+            theta_init[i] = theta_init[i-1] + wrap_to_pi(atan2(y_init[i+1]-y_init[i],x_init[i+1]-x_init[i])-theta_init[i-1]);
     
-    if (closed)
-    {
-        theta_init[n_elements-1] = theta_init[n_elements-2] + wrap_to_pi(atan2(y_init[0]-y_init[n_elements-1],x_init[0]-x_init[n_elements-1])-theta_init[n_elements-2]);
+        if (closed)
+        {
+            theta_init[n_elements-1] = theta_init[n_elements-2] + wrap_to_pi(atan2(y_init[0]-y_init[n_elements-1],x_init[0]-x_init[n_elements-1])-theta_init[n_elements-2]);
     
-        // compute the circuit direction (clockwise/counter clockwise)
-        direction = ( theta_init[n_elements-1] > theta_init[0] ? COUNTERCLOCKWISE : CLOCKWISE );
-    }
-    else
-        theta_init[n_elements] = theta_init[n_elements-1];
+            // compute the circuit direction (clockwise/counter clockwise)
+            direction = ( theta_init[n_elements-1] > theta_init[0] ? COUNTERCLOCKWISE : CLOCKWISE );
+        }
+        else
+            theta_init[n_elements] = theta_init[n_elements-1];
 
 
-    // kappa
-    for (size_t i = 0; i < n_points-1; ++i)
-        kappa_init[i] = (theta_init[i+1]-theta_init[i])/(s_center[i+1]-s_center[i]);
+        // kappa
+        for (size_t i = 0; i < n_points-1; ++i)
+            kappa_init[i] = (theta_init[i+1]-theta_init[i])/(s_center[i+1]-s_center[i]);
 
-    if (closed)
-        kappa_init[n_elements-1] = (theta_init[0] + 2.0*pi*direction - theta_init[n_elements-1])/norm(r_center.front() - r_center.back());
-    else
-        kappa_init[n_elements] = kappa_init[n_elements-1];
+        if (closed)
+            kappa_init[n_elements-1] = (theta_init[0] + 2.0*pi*direction - theta_init[n_elements-1])/norm(r_center.front() - r_center.back());
+        else
+            kappa_init[n_elements] = kappa_init[n_elements-1];
 
-    // nl and nr
-    std::array<size_t,2> i_l = {0,0};
-    std::array<size_t,2> i_r = {0,0};
-    for (size_t i = 0; i < n_points; ++i)
-    {
-        std::tie(std::ignore,nl_init[i],i_l) = find_closest_point<scalar>(r_left_measured, r_center[i], closed, min(i_l[0],i_l[1]), options.maximum_distance_find);
-        std::tie(std::ignore,nr_init[i],i_r) = find_closest_point<scalar>(r_right_measured, r_center[i], closed, min(i_r[0],i_r[1]), options.maximum_distance_find);
-        nl_init[i] = sqrt(nl_init[i]);
-        nr_init[i] = sqrt(nr_init[i]);
-    }
+        // nl and nr
+        std::array<size_t,2> i_l = {0,0};
+        std::array<size_t,2> i_r = {0,0};
+        for (size_t i = 0; i < n_points; ++i)
+        {
+            std::tie(std::ignore,nl_init[i],i_l) = find_closest_point_in_window(left_index, r_left_measured, r_center[i], closed, i_l[0], options.maximum_distance_find, options.maximum_window_find);
+            std::tie(std::ignore,nr_init[i],i_r) = find_closest_point_in_window(right_index, r_right_measured, r_center[i], closed, i_r[0], options.maximum_distance_find, options.maximum_window_find);
+            nl_init[i] = sqrt(nl_init[i]);
+            nr_init[i] = sqrt(nr_init[i]);
+        }
 
-    // dkappa, dnl, and dnr
-    for (size_t i = 0; i < n_points-1; ++i)
-    {
-        dkappa_init[i] = (kappa_init[i+1]-kappa_init[i])/(s_center[i+1]-s_center[i]);
-        dnl_init[i] = (nl_init[i+1]-nl_init[i])/(s_center[i+1]-s_center[i]);
-        dnr_init[i] = (nr_init[i+1]-nr_init[i])/(s_center[i+1]-s_center[i]);
-    }
+        // dkappa, dnl, and dnr
+        for (size_t i = 0; i < n_points-1; ++i)
+        {
+            dkappa_init[i] = (kappa_init[i+1]-kappa_init[i])/(s_center[i+1]-s_center[i]);
+            dnl_init[i] = (nl_init[i+1]-nl_init[i])/(s_center[i+1]-s_center[i]);
+            dnr_init[i] = (nr_init[i+1]-nr_init[i])/(s_center[i+1]-s_center[i]);
+        }
 
-    if (closed)
-    {
-        dkappa_init[n_elements-1] = (kappa_init[0] - kappa_init[n_elements-1])/norm(r_center.front()-r_center.back());
-        dnl_init[n_elements-1] = (nl_init[0] - nl_init[n_elements-1])/norm(r_center.front()-r_center.back());
-        dnr_init[n_elements-1] = (nr_init[0] - nr_init[n_elements-1])/norm(r_center.front()-r_center.back());
+        if (closed)
+        {
+            dkappa_init[n_elements-1] = (kappa_init[0] - kappa_init[n_elements-1])/norm(r_center.front()-r_center.back());
+            dnl_init[n_elements-1] = (nl_init[0] - nl_init[n_elements-1])/norm(r_center.front()-r_center.back());
+            dnr_init[n_elements-1] = (nr_init[0] - nr_init[n_elements-1])/norm(r_center.front()-r_center.back());
+        }
+        else
+        {
+            dkappa_init[n_elements] = dkappa_init[n_elements-1];
+            dnl_init[n_elements] = dnl_init[n_elements-1];
+            dnr_init[n_elements] = dnr_init[n_elements-1];
+        }
     }
     else
     {
-        dkappa_init[n_elements] = dkappa_init[n_elements-1];
-        dnl_init[n_elements] = dnl_init[n_elements-1];
-        dnr_init[n_elements] = dnr_init[n_elements-1];
+        // Interpolate the solution of the previous level (still stored in the outputs) at the same fraction of the track length
+        const size_t n_previous = s.size();
+        const scalar length_previous = (closed ? track_length : s.back());
+
+        auto interpolate = [&](const std::vector<scalar>& values, const scalar sigma, const scalar offset_at_end)
+        {
+            const size_t i = std::min<size_t>(std::upper_bound(s.cbegin(), s.cend(), sigma) - s.cbegin(), n_previous) - 1;
+
+            if ( i + 1 < n_previous )
+            {
+                const scalar xi = (sigma - s[i])/(s[i+1] - s[i]);
+                return (1.0-xi)*values[i] + xi*values[i+1];
+            }
+            else if ( closed )
+            {
+                // Periodic element
+                const scalar xi = (sigma - s[i])/(length_previous - s[i]);
+                return (1.0-xi)*values[i] + xi*(values.front() + offset_at_end);
+            }
+            else
+                return values.back();
+        };
+
+        std::vector<scalar> x_previous(n_previous), y_previous(n_previous);
+        for (size_t i = 0; i < n_previous; ++i)
+        {
+            x_previous[i] = r_centerline[i].x();
+            y_previous[i] = r_centerline[i].y();
+        }
+
+        const scalar length_estimate = (closed ? track_length_estimate : s_center.back());
+
+        for (size_t i = 0; i < n_points; ++i)
+        {
+            const scalar sigma = s_center[i]/length_estimate*length_previous;
+
+            x_init[i]      = interpolate(x_previous, sigma, 0.0);
+            y_init[i]      = interpolate(y_previous, sigma, 0.0);
+            theta_init[i]  = interpolate(theta, sigma, 2.0*pi*direction);
+            kappa_init[i]  = interpolate(kappa, sigma, 0.0);
+            nl_init[i]     = interpolate(nl, sigma, 0.0);
+            nr_init[i]     = interpolate(nr, sigma, 0.0);
+            dkappa_init[i] = interpolate(dkappa, sigma, 0.0);
+            dnl_init[i]    = interpolate(dnl, sigma, 0.0);
+            dnr_init[i]    = interpolate(dnr, sigma, 0.0);
+        }
     }
 
     // compute the ds candidate
@@ -261,6 +344,7 @@ inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, c
 
     // (2) Create the FG object
     FG<closed> fg(n_elements, n_points, element_ds, r_left_measured, r_right_measured, r_center, direction, options);
+    const Polyline_spatial_index center_index(r_center, closed);
 
     // load them into an x vector
     std::vector<scalar> x(fg.get_n_variables());
@@ -316,7 +400,7 @@ inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, c
     ipoptoptions += "\n";
     ipoptoptions += "String  sb           yes\n";
     ipoptoptions += "Sparse true forward\n";
-    ipoptoptions += "Retape true\n";
+    ipoptoptions += "Retape false\n";
     ipoptoptions += "Numeric tol          1e-10\n";
     ipoptoptions += "Numeric constr_viol_tol  1e-10\n";
     ipoptoptions += "Numeric acceptable_tol  1e-8\n";
@@ -324,12 +408,42 @@ inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, c
     // place to return solution
     CppAD::ipopt_cppad_result<std::vector<scalar>> result;
 
-    // solve the problem
-    CppAD::ipopt_cppad_solve(ipoptoptions, x, x_lb, x_ub, std::vector<scalar>(fg.get_n_constraints(),0.0), std::vector<scalar>(fg.get_n_constraints(),0.0), fg, result);
+    // (7.1) Outer loop: freeze the segments of the boundaries and centerline closest to each node, solve the problem with a 
+    //       fixed tape, and update the segments from the solution until they do not change
+    std::array<std::vector<size_t>,3> segments = compute_associations<closed>(x, left_index, right_index, center_index, r_center);
 
-    if ( result.status != CppAD::ipopt_cppad_result<std::vector<scalar>>::success )
+    for (n_association_iterations = 1; ; ++n_association_iterations)
     {
-        throw std::runtime_error("Optimization did not succeed");
+        fg.set_associations(segments[0], segments[1], segments[2]);
+
+        // solve the problem. The solves of parallel chunks are run one at a time
+        {
+            Ipopt_solver_lock lock;
+            CppAD::ipopt_cppad_solve(ipoptoptions, x, x_lb, x_ub, std::vector<scalar>(fg.get_n_constraints(),0.0), std::vector<scalar>(fg.get_n_constraints(),0.0), fg, result);
+        }
+
+        if ( result.status != CppAD::ipopt_cppad_result<std::vector<scalar>>::success )
+        {
+            throw std::runtime_error("Optimization did not succeed");
+        }
+
+        const auto new_segments = compute_associations<closed>(result.x, left_index, right_index, center_index, r_center);
+
+        associations_converged = (new_segments == segments);
+
+        if ( associations_converged )
+            break;
+
+        if ( n_association_iterations >= options.maximum_association_iterations )
+        {
+            out(2) << "[Circuit_preprocessor] warning: the node-segment associations did not converge after " << n_association_iterations 
+                   << " solves. The solution uses the associations of the last solve" << std::endl;
+            break;
+        }
+
+        // Warm start from the current solution
+        segments = new_segments;
+        x = result.x;
     }
 
     // Load the solution
@@ -394,8 +508,8 @@ inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, c
 
 
     // Compute the errors
-    left_boundary_max_error   = sqrt(std::get<1>(find_closest_point<scalar>(r_left_measured,r_left.front(), closed, 0, 1.0e18)));
-    right_boundary_max_error  = sqrt(std::get<1>(find_closest_point<scalar>(r_right_measured,r_right.front(), closed, 0, 1.0e18)));
+    left_boundary_max_error   = sqrt(std::get<1>(left_index.find_closest_point(r_left.front())));
+    right_boundary_max_error  = sqrt(std::get<1>(right_index.find_closest_point(r_right.front())));
     left_boundary_L2_error   = 0.0;
     right_boundary_L2_error  = 0.0;
 
@@ -405,8 +519,8 @@ inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, c
     {
         const scalar ds = s[i]-s[i-1];
         // Compute current error
-        scalar current_left_error = sqrt(std::get<1>(find_closest_point<scalar>(r_left_measured,r_left[i], closed, 0, 1.0e18))); 
-        scalar current_right_error = sqrt(std::get<1>(find_closest_point<scalar>(r_right_measured,r_right[i], closed, 0, 1.0e18))); 
+        scalar current_left_error = sqrt(std::get<1>(left_index.find_closest_point(r_left[i]))); 
+        scalar current_right_error = sqrt(std::get<1>(right_index.find_closest_point(r_right[i]))); 
 
         // Compute maximum error
         left_boundary_max_error = max(current_left_error, left_boundary_max_error);
@@ -424,8 +538,8 @@ inline void Circuit_preprocessor::compute(const std::vector<scalar>& s_center, c
     if (closed)
     {
         const scalar ds = track_length - s.back();
-        scalar current_left_error = sqrt(std::get<1>(find_closest_point<scalar>(r_left_measured,r_left.front(), closed, 0, 1.0e18)));
-        scalar current_right_error = sqrt(std::get<1>(find_closest_point<scalar>(r_right_measured,r_right.front(), closed, 0, 1.0e18)));
+        scalar current_left_error = sqrt(std::get<1>(left_index.find_closest_point(r_left.front())));
+        scalar current_right_error = sqrt(std::get<1>(right_index.find_closest_point(r_right.front())));
 
         // Compute L2 error
         left_boundary_L2_error  += 0.5*ds*(prev_left_error*prev_left_error + current_left_error*current_left_error);
@@ -691,11 +805,12 @@ inline std::tuple<std::vector<scalar>, std::vector<sVector3d>, scalar> Circuit_p
         r_right_equispaced[i] = track_right(s_right_equispaced[i]);
 
     // (5) Get the closest point in the left boundary to each point of the right boundary
+    const Polyline_spatial_index left_index(r_left, closed);
     std::vector<sVector3d> r_left_equispaced(n_points);
     std::array<size_t,2> i_left = {0, 0};
     for (size_t i = 0; i < n_points; ++i)
         std::tie(r_left_equispaced[i],std::ignore,i_left) 
-            = find_closest_point<scalar>(r_left,r_right_equispaced[i], closed, min(i_left[0],i_left[1]), options.maximum_distance_find);
+            = find_closest_point_in_window(left_index, r_left, r_right_equispaced[i], closed, i_left[0], options.maximum_distance_find, options.maximum_window_find);
 
     // (6) Compute the centerline estimation, and close it
     std::vector<sVector3d> r_center = 0.5*(r_left_equispaced + r_right_equispaced);
@@ -745,10 +860,13 @@ std::tuple<std::vector<scalar>, std::vector<sVector3d>, scalar> Circuit_preproce
     std::vector<scalar> s_right_mesh = {0.0, ds_breakpoints.front().second};
     std::vector<sVector3d> r_right_mesh = { track_right(s_right_mesh[0]), track_right(s_right_mesh[1]) };
 
+    const Polyline_spatial_index right_index(r_right, closed);
+    const auto ds_breakpoints_right = project_ds_breakpoints(right_index, ds_breakpoints);
+
     scalar ds_prev = ds_breakpoints.front().second;
     while ( s_right_mesh.back() < s_right.back() )
     {
-        scalar ds = compute_ds_for_coordinates<closed>(r_right_mesh.back(), r_right, ds_breakpoints);
+        scalar ds = compute_ds_for_coordinates(r_right_mesh.back(), right_index, ds_breakpoints_right, ds_breakpoints);
 
         // Restrict the maximum aspect ratio of adjacent cells
         if ( ds > options.adaption_aspect_ratio_max*ds_prev )
@@ -781,11 +899,12 @@ std::tuple<std::vector<scalar>, std::vector<sVector3d>, scalar> Circuit_preproce
     const size_t n_elements = (closed ? n_points : n_points - 1);
 
     // (5) Get the closest point in the left boundary to each point of the right boundary
+    const Polyline_spatial_index left_index(r_left, closed);
     std::vector<sVector3d> r_left_mesh(n_points);
     std::array<size_t,2> i_left = {0,0};
     for (size_t i = 0; i < n_points; ++i)
         std::tie(r_left_mesh[i],std::ignore,i_left) 
-            = find_closest_point<scalar>(r_left,r_right_mesh[i], closed, min(i_left[0],i_left[1]), options.maximum_distance_find);
+            = find_closest_point_in_window(left_index, r_left, r_right_mesh[i], closed, i_left[0], options.maximum_distance_find, options.maximum_window_find);
 
     // (6) Compute the centerline estimation, and close it
     std::vector<sVector3d> r_center = 0.5*(r_left_mesh + r_right_mesh);
@@ -802,10 +921,13 @@ std::tuple<std::vector<scalar>, std::vector<sVector3d>, scalar> Circuit_preproce
     std::vector<scalar> s_center_mesh = {0.0, ds_breakpoints.front().second};
     std::vector<sVector3d> r_center_mesh = { track_center(s_center_mesh[0]), track_center(s_center_mesh[1]) };
 
+    const Polyline_spatial_index center_index(r_center, closed);
+    const auto ds_breakpoints_center = project_ds_breakpoints(center_index, ds_breakpoints);
+
     ds_prev = ds_breakpoints.front().second;
     while ( s_center_mesh.back() < s_center.back() )
     {
-        scalar ds = compute_ds_for_coordinates<closed>(r_center_mesh.back(), r_center, ds_breakpoints);
+        scalar ds = compute_ds_for_coordinates(r_center_mesh.back(), center_index, ds_breakpoints_center, ds_breakpoints);
 
         // Restrict the maximum aspect ratio of adjacent cells
         if ( ds > options.adaption_aspect_ratio_max*ds_prev )
@@ -900,11 +1022,12 @@ std::tuple<std::vector<scalar>, std::vector<sVector3d>, scalar> Circuit_preproce
     const size_t n_elements = (closed ? n_points : n_points - 1);
 
     // (5) Get the closest point in the left boundary to each point of the right boundary
+    const Polyline_spatial_index left_index(r_left, closed);
     std::vector<sVector3d> r_left_mesh(n_points);
     std::array<size_t,2> i_left = {0,0};
     for (size_t i = 0; i < n_points; ++i)
         std::tie(r_left_mesh[i],std::ignore,i_left) 
-            = find_closest_point<scalar>(r_left,r_right_mesh[i], closed, min(i_left[0],i_left[1]), options.maximum_distance_find);
+            = find_closest_point_in_window(left_index, r_left, r_right_mesh[i], closed, i_left[0], options.maximum_distance_find, options.maximum_window_find);
 
     // (6) Compute the centerline estimation, and close it
     std::vector<sVector3d> r_center = 0.5*(r_left_mesh + r_right_mesh);
@@ -1055,28 +1178,26 @@ void Circuit_preprocessor::FG<closed>::operator()(ADvector& fg, const ADvector&
     // (3) Initialize fitness function
     fg[0] = 0.0;
 
-    // (4) Compute the equations for the first node
-    _dqds[0] = equations(_q[0],_u[0]);
-    std::array<size_t,2> i_left = {0,0}, i_right = {0,0}, i_center = {0,0};
+    // (4) Compute the equations and the distances to the associated segments for every node. The segments are frozen, 
+    //     so that the operation sequence does not depend on x
+    if ( (_segment_left.size() != _n_points) || (_segment_right.size() != _n_points) || (_segment_center.size() != _n_points) )
+        throw std::runtime_error("Circuit_preprocessor::FG: the boundary segments associated to the nodes were not set");
 
-    std::tie(std::ignore,_dist2_left[0],i_left) = find_closest_point<CppAD::AD<scalar>>(_r_left, Vector3d<CppAD::AD<scalar>>  (_q[0][IX] - sin(_q[0][ITHETA])*_q[0][INL], _q[0][IY] + cos(_q[0][ITHETA])*_q[0][INL], 0.0), true, 0, options.maximum_distance_find);
-    std::tie(std::ignore,_dist2_right[0],i_right)  = find_closest_point<CppAD::AD<scalar>>(_r_right, Vector3d<CppAD::AD<scalar>> (_q[0][IX] + sin(_q[0][ITHETA])*_q[0][INR], _q[0][IY] - cos(_q[0][ITHETA])*_q[0][INR], 0.0), true, 0, options.maximum_distance_find);
-    std::tie(std::ignore,_dist2_center[0],i_center) = find_closest_point<CppAD::AD<scalar>>(_r_center, Vector3d<CppAD::AD<scalar>>(_q[0][IX], _q[0][IY], 0.0), true, 0, options.maximum_distance_find);
+    for (size_t i = 0; i < _n_points; ++i)
+    {
+        _dqds[i] = equations(_q[i],_u[i]);
 
-    // (5) Compute the equations for the i-th node, and append the scheme equations for the i-th element
+        _dist2_left[i]   = segment_distance2(_r_left, _segment_left[i], 
+            Vector3d<CppAD::AD<scalar>>(_q[i][IX] - sin(_q[i][ITHETA])*_q[i][INL], _q[i][IY] + cos(_q[i][ITHETA])*_q[i][INL], 0.0));
+        _dist2_right[i]  = segment_distance2(_r_right, _segment_right[i], 
+            Vector3d<CppAD::AD<scalar>>(_q[i][IX] + sin(_q[i][ITHETA])*_q[i][INR], _q[i][IY] - cos(_q[i][ITHETA])*_q[i][INR], 0.0));
+        _dist2_center[i] = segment_distance2(_r_center, _segment_center[i], Vector3d<CppAD::AD<scalar>>(_q[i][IX], _q[i][IY], 0.0));
+    }
+
+    // (5) Append the scheme equations for the i-th element
     k = 1;  // Reset the counter
     for (size_t i = 1; i < _n_points; ++i)
     {
-        _dqds[i] = equations(_q[i],_u[i]);
-        std::tie(std::ignore,_dist2_left[i],i_left) = find_closest_point<CppAD::AD<scalar>>(_r_left, 
-            Vector3d<CppAD::AD<scalar>>  (_q[i][IX] - sin(_q[i][ITHETA])*_q[i][INL], _q[i][IY] + cos(_q[i][ITHETA])*_q[i][INL], 0.0), 
-            true, min(i_left[0],i_left[1]), options.maximum_distance_find);
-        std::tie(std::ignore,_dist2_right[i],i_right) = find_closest_point<CppAD::AD<scalar>>(_r_right, 
-            Vector3d<CppAD::AD<scalar>> (_q[i][IX] + sin(_q[i][ITHETA])*_q[i][INR], _q[i][IY] - cos(_q[i][ITHETA])*_q[i][INR], 0.0), 
-            true, min(i_right[0],i_right[1]), options.maximum_distance_find);
-        std::tie(std::ignore,_dist2_center[i],i_center) = find_closest_point<CppAD::AD<scalar>>(_r_center, 
-            Vector3d<CppAD::AD<scalar>>(_q[i][IX], _q[i][IY], 0.0), 
-            true, min(i_center[0],i_center[1]), options.maximum_distance_find);
 
         // Fitness function: minimize the square of the distance to the boundaries and centerline, and control powers
         const auto ds = ds_factor*_ds[i-1];
@@ -1127,14 +1248,264 @@ void Circuit_preprocessor::FG<closed>::operator()(ADvector& fg, const ADvector&
 }
 
 
+template<bool closed, typename Centerline_function>
+inline void Circuit_preprocessor::compute_multilevel(Centerline_function&& centerline)
+{
+    const size_t n_levels = std::max<size_t>(options.multilevel_levels, 1);
+
+    if ( (n_levels > 1) && (options.multilevel_coarsening <= 1.0) )
+        throw std::runtime_error("Circuit_preprocessor: multilevel_coarsening shall be greater than 1");
+
+    if ( (options.parallel_chunks > 1) && !closed )
+        throw std::runtime_error("Circuit_preprocessor: parallel chunks are only available for closed circuits");
+
+    level_statistics.clear();
+
+    for (size_t level = 0; level < n_levels; ++level)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        // (1) Centerline estimate of this level
+        const scalar coarsening = std::pow(options.multilevel_coarsening, static_cast<scalar>(n_levels - 1 - level));
+        const auto [s_center,r_center,track_length_estimate] = centerline(coarsening);
+
+        n_points   = s_center.size();
+        n_elements = (closed ? n_points : n_points - 1);
+
+        // (2) Solve, warm started from the previous level. The first level can be warm started from parallel chunks
+        const bool solve_chunks = (level == 0) && (options.parallel_chunks > 1);
+
+        if ( solve_chunks )
+            compute_chunks(s_center, r_center, track_length_estimate);
+
+        compute<closed>(s_center, r_center, track_length_estimate, (level > 0) || solve_chunks);
+
+        const std::chrono::duration<scalar> elapsed = std::chrono::steady_clock::now() - start;
+        level_statistics.push_back({n_elements, n_association_iterations, associations_converged, elapsed.count()});
+
+        if ( options.print_level > 0 )
+            out(2) << "[Circuit_preprocessor] level " << level << ": " << n_elements << " elements, " << n_association_iterations 
+                   << " solves, " << elapsed.count() << "s" << std::endl;
+    }
+}
+
+
+inline void Circuit_preprocessor::compute_chunks(const std::vector<scalar>& s_center, const std::vector<sVector3d>& r_center, 
+    const scalar track_length_estimate)
+{
+    const size_t n = s_center.size();
+    const size_t n_chunks = options.parallel_chunks;
+
+    // (1) Nodes of the overlaps, from the average element length
+    const size_t n_overlap = std::max<size_t>(1, static_cast<size_t>(std::ceil(options.chunk_overlap/(track_length_estimate/n))));
+
+    if ( n < n_chunks*(2*n_overlap + 2) )
+        throw std::runtime_error("Circuit_preprocessor: too many chunks or too much overlap for the number of elements");
+
+    // (2) Tangent angle of the centerline estimate, unwrapped, to bring the chunk angles to the same turn
+    std::vector<scalar> theta_reference(n);
+    theta_reference[0] = atan2(r_center[1].y()-r_center[0].y(), r_center[1].x()-r_center[0].x());
+    for (size_t i = 1; i < n; ++i)
+    {
+        const sVector3d& r_next = r_center[(i+1) % n];
+        theta_reference[i] = theta_reference[i-1] + wrap_to_pi(atan2(r_next.y()-r_center[i].y(), r_next.x()-r_center[i].x()) - theta_reference[i-1]);
+    }
+
+    direction = ( theta_reference.back() > theta_reference.front() ? COUNTERCLOCKWISE : CLOCKWISE );
+
+    // (3) Solve the chunks in parallel, as open circuits. Chunk k covers the nodes [k.n/K - n_overlap, (k+1).n/K + n_overlap).
+    //     The setup of the chunks runs in parallel, and their IPOPT solves one at a time (see Ipopt_solver_lock)
+    const Polyline_spatial_index left_index(r_left_measured, true);
+    const Polyline_spatial_index right_index(r_right_measured, true);
+
+    // Part of the measured boundary between the projections of two points, following the boundary direction
+    auto trim_boundary = [](const std::vector<sVector3d>& r_boundary, const Polyline_spatial_index& index, const sVector3d& p_start, const sVector3d& p_end)
+    {
+        const auto [r_start, d2_start, i_start] = index.find_closest_point(p_start);
+        const auto [r_end, d2_end, i_end] = index.find_closest_point(p_end);
+
+        const size_t n_boundary = r_boundary.size();
+        std::vector<sVector3d> result = {r_start};
+
+        for (size_t i = i_start[1]; i != i_end[1]; i = (i + 1) % n_boundary)
+            result.push_back(r_boundary[i]);
+
+        result.push_back(r_end);
+        return result;
+    };
+
+    auto get_chunk_begin = [&](const size_t k) { return (k*n/n_chunks + n - n_overlap) % n; };
+    auto get_chunk_size  = [&](const size_t k) { return (k+1)*n/n_chunks - k*n/n_chunks + 2*n_overlap; };
+
+    std::vector<Circuit_preprocessor> chunks(n_chunks);
+
+    Thread_pool::get().parallel_for(n_chunks, [&](const size_t k)
+    {
+        const size_t i_begin = get_chunk_begin(k);
+        const size_t n_chunk = get_chunk_size(k);
+
+        std::vector<scalar> s_chunk(n_chunk, 0.0);
+        std::vector<sVector3d> r_chunk(n_chunk);
+
+        for (size_t j = 0; j < n_chunk; ++j)
+        {
+            r_chunk[j] = r_center[(i_begin + j) % n];
+
+            if ( j > 0 )
+                s_chunk[j] = s_chunk[j-1] + norm(r_chunk[j] - r_chunk[j-1]);
+        }
+
+        Circuit_preprocessor& chunk = chunks[k];
+        chunk.options                      = options;
+        chunk.options.multilevel_levels    = 1;
+        chunk.options.parallel_chunks      = 1;
+        chunk.is_closed                    = false;
+        chunk.direction                    = 0;
+        chunk.n_points                     = n_chunk;
+        chunk.n_elements                   = n_chunk - 1;
+        chunk.r_left_measured              = trim_boundary(r_left_measured, left_index, r_chunk.front(), r_chunk.back());
+        chunk.r_right_measured             = trim_boundary(r_right_measured, right_index, r_chunk.front(), r_chunk.back());
+
+        chunk.compute<false>(s_chunk, r_chunk, s_chunk.back());
+    });
+
+    // (4) Blend the chunks on the nodes of the centerline estimate. The weights ramp linearly across the overlaps
+    r_centerline = std::vector<sVector3d>(n, sVector3d(0.0, 0.0, 0.0));
+    theta  = std::vector<scalar>(n, 0.0);
+    kappa  = std::vector<scalar>(n, 0.0);
+    nl     = std::vector<scalar>(n, 0.0);
+    nr     = std::vector<scalar>(n, 0.0);
+    dkappa = std::vector<scalar>(n, 0.0);
+    dnl    = std::vector<scalar>(n, 0.0);
+    dnr    = std::vector<scalar>(n, 0.0);
+    std::vector<scalar> weights(n, 0.0);
+
+    for (size_t k = 0; k < n_chunks; ++k)
+    {
+        const Circuit_preprocessor& chunk = chunks[k];
+        const size_t i_begin = get_chunk_begin(k);
+        const size_t n_chunk = chunk.n_points;
+
+        for (size_t j = 0; j < n_chunk; ++j)
+        {
+            const size_t i = (i_begin + j) % n;
+            const scalar w = std::min(1.0, (std::min(j, n_chunk - 1 - j) + 0.5)/(2.0*n_overlap));
+
+            const scalar theta_chunk = chunk.theta[j] + 2.0*pi*std::round((theta_reference[i] - chunk.theta[j])/(2.0*pi));
+
+            r_centerline[i] = r_centerline[i] + w*chunk.r_centerline[j];
+            theta[i]  += w*theta_chunk;
+            kappa[i]  += w*chunk.kappa[j];
+            nl[i]     += w*chunk.nl[j];
+            nr[i]     += w*chunk.nr[j];
+            dkappa[i] += w*chunk.dkappa[j];
+            dnl[i]    += w*chunk.dnl[j];
+            dnr[i]    += w*chunk.dnr[j];
+            weights[i] += w;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        r_centerline[i] = r_centerline[i]/weights[i];
+        theta[i]  /= weights[i];
+        kappa[i]  /= weights[i];
+        nl[i]     /= weights[i];
+        nr[i]     /= weights[i];
+        dkappa[i] /= weights[i];
+        dnl[i]    /= weights[i];
+        dnr[i]    /= weights[i];
+    }
+
+    // (5) The blended solution is given at the nodes of the centerline estimate
+    s = s_center;
+    track_length = track_length_estimate;
+}
+
+
 template<bool closed>
-inline scalar Circuit_preprocessor::compute_ds_for_coordinates(const sVector3d point, const std::vector<sVector3d>& r_curve,
-    const std::vector<std::pair<sVector3d,scalar>>& ds_breakpoints)
+inline std::array<std::vector<size_t>,3> Circuit_preprocessor::compute_associations(const std::vector<scalar>& x, 
+    const Polyline_spatial_index& left_index, const Polyline_spatial_index& right_index, const Polyline_spatial_index& center_index,
+    const std::vector<sVector3d>& r_center) const
+{
+    constexpr size_t IX        = FG<closed>::IX;
+    constexpr size_t IY        = FG<closed>::IY;
+    constexpr size_t ITHETA    = FG<closed>::ITHETA;
+    constexpr size_t INL       = FG<closed>::INL;
+    constexpr size_t INR       = FG<closed>::INR;
+    constexpr size_t NVARIABLES = FG<closed>::NSTATE + FG<closed>::NCONTROLS;
+
+    std::array<std::vector<size_t>,3> segments = {std::vector<size_t>(n_points), std::vector<size_t>(n_points), std::vector<size_t>(n_points)};
+
+    for (size_t i = 0; i < n_points; ++i)
+    {
+        const scalar x_i     = x[1 + NVARIABLES*i + IX];
+        const scalar y_i     = x[1 + NVARIABLES*i + IY];
+        const scalar theta_i = x[1 + NVARIABLES*i + ITHETA];
+        const scalar nl_i    = x[1 + NVARIABLES*i + INL];
+        const scalar nr_i    = x[1 + NVARIABLES*i + INR];
+
+        const sVector3d p_left(x_i - sin(theta_i)*nl_i, y_i + cos(theta_i)*nl_i, 0.0);
+        const sVector3d p_right(x_i + sin(theta_i)*nr_i, y_i - cos(theta_i)*nr_i, 0.0);
+        const sVector3d p_center(x_i, y_i, 0.0);
+
+        if ( i == 0 )
+        {
+            // (1) First node: closest segments of the whole curves
+            segments[0][i] = std::get<2>(left_index.find_closest_point(p_left))[0];
+            segments[1][i] = std::get<2>(right_index.find_closest_point(p_right))[0];
+            segments[2][i] = std::get<2>(center_index.find_closest_point(p_center))[0];
+        }
+        else
+        {
+            // (2) Next nodes: continue from the segments of the previous node, so that the associations do not jump to a 
+            //     closer part of the curves further along them (e.g. the other side of a hairpin)
+            segments[0][i] = std::get<2>(find_closest_point_in_window(left_index, r_left_measured, p_left, closed, segments[0][i-1],
+                                                                      options.maximum_distance_find, options.maximum_window_find))[0];
+            segments[1][i] = std::get<2>(find_closest_point_in_window(right_index, r_right_measured, p_right, closed, segments[1][i-1],
+                                                                      options.maximum_distance_find, options.maximum_window_find))[0];
+            segments[2][i] = std::get<2>(find_closest_point_in_window(center_index, r_center, p_center, closed, segments[2][i-1],
+                                                                      options.maximum_distance_find, options.maximum_window_find))[0];
+        }
+    }
+
+    return segments;
+}
+
+
+template<bool closed>
+inline CppAD::AD<scalar> Circuit_preprocessor::FG<closed>::segment_distance2(const std::vector<sVector3d>& r_curve, const size_t i_segment, 
+    const Vector3d<CppAD::AD<scalar>>& p)
+{
+    const sVector3d& a = r_curve[i_segment];
+    const sVector3d& b = r_curve[(i_segment + 1) % r_curve.size()];
+
+    const scalar abx = b.x() - a.x();
+    const scalar aby = b.y() - a.y();
+    const scalar length2 = abx*abx + aby*aby;
+
+    if ( length2 == 0.0 )
+        return (p.x() - a.x())*(p.x() - a.x()) + (p.y() - a.y())*(p.y() - a.y());
+
+    // Projection parameter, clamped to the segment with conditional expressions, which do not change the tape
+    CppAD::AD<scalar> xi = ((p.x() - a.x())*abx + (p.y() - a.y())*aby)/length2;
+    xi = CppAD::CondExpLt(xi, CppAD::AD<scalar>(0.0), CppAD::AD<scalar>(0.0), xi);
+    xi = CppAD::CondExpGt(xi, CppAD::AD<scalar>(1.0), CppAD::AD<scalar>(1.0), xi);
+
+    const CppAD::AD<scalar> dx = p.x() - a.x() - xi*abx;
+    const CppAD::AD<scalar> dy = p.y() - a.y() - xi*aby;
+
+    return dx*dx + dy*dy;
+}
+
+
+inline scalar Circuit_preprocessor::compute_ds_for_coordinates(const sVector3d point, const Polyline_spatial_index& curve_index,
+    const std::vector<Polyline_spatial_index::Result>& ds_breakpoints_projection, const std::vector<std::pair<sVector3d,scalar>>& ds_breakpoints)
 {
     // (1) Find the closest point to the requested point in the curve
     std::array<size_t,2> i_point; 
     sVector3d v_closest_point;
-    std::tie(v_closest_point,std::ignore,i_point) = find_closest_point<scalar>(r_curve, point, closed, 0, 1.0e18);
+    std::tie(v_closest_point,std::ignore,i_point) = curve_index.find_closest_point(point);
 
     // (2) Loop on the ds breakpoints until we find a point ahead of the requested
     size_t i_closest_break = ds_breakpoints.size()-1;
@@ -1142,7 +1513,7 @@ inline scalar Circuit_preprocessor::compute_ds_for_coordinates(const sVector3d p
     {
         std::array<size_t,2> i_break; 
         sVector3d v_closest_break;
-        std::tie(v_closest_break,std::ignore,i_break) = find_closest_point<scalar>(r_curve, ds_breakpoints[i].first, closed, 0, 1.0e18);
+        std::tie(v_closest_break,std::ignore,i_break) = ds_breakpoints_projection[i];
 
         if ( who_is_ahead(i_break, i_point, v_closest_break, v_closest_point, ds_breakpoints[i].first) == 1 )
         {
@@ -1154,6 +1525,36 @@ inline scalar Circuit_preprocessor::compute_ds_for_coordinates(const sVector3d p
     return ds_breakpoints[i_closest_break].second;
 }
 
+inline std::vector<Polyline_spatial_index::Result> Circuit_preprocessor::project_ds_breakpoints(const Polyline_spatial_index& curve_index,
+    const std::vector<std::pair<sVector3d,scalar>>& ds_breakpoints)
+{
+    std::vector<Polyline_spatial_index::Result> projection(ds_breakpoints.size());
+
+    for (size_t i = 0; i < ds_breakpoints.size(); ++i)
+        projection[i] = curve_index.find_closest_point(ds_breakpoints[i].first);
+
+    return projection;
+}
+
+
+inline Polyline_spatial_index::Result Circuit_preprocessor::find_closest_point_in_window(const Polyline_spatial_index& curve_index,
+    const std::vector<sVector3d>& r_curve, const sVector3d& point, const bool closed, const size_t i_start, const scalar maximum_distance,
+    const scalar window_length)
+{
+    Polyline_spatial_index::Result result;
+
+    // Only the segments around i_start are candidates: a closer part of the curve further along it (e.g. the other side of
+    // a hairpin) shall not break the continuity of the projections
+    const size_t i_center = std::min(i_start, curve_index.get_number_of_segments() - 1);
+
+    if ( curve_index.find_closest_point(result, point, maximum_distance, i_center, window_length) )
+        return result;
+
+    // Nothing within the search window: use the search along the curve from i_start
+    return find_closest_point<scalar>(r_curve, point, closed, i_start, maximum_distance);
+}
+
+
 inline size_t Circuit_preprocessor::who_is_ahead(std::array<size_t,2>& i_p1, std::array<size_t,2>& i_p2, const sVector3d& p1, 
     const sVector3d& p2, const sVector3d& p_ref)
 {
@@ -0,0 +1,145 @@
+#ifndef __DRIVER_MODEL_H__
+#define __DRIVER_MODEL_H__
+
+#include <array>
+#include <vector>
+#include "lion/foundation/types.h"
+#include "lion/thirdparty/include/cppad/cppad.hpp"
+#include "src/core/propagators/simplified_newton_crank_nicolson.h"
+#include "src/core/applications/vehicle_channels.h"
+
+//!     Closed-loop driver model
+//!     ------------------------
+//!
+//! Drives a curvilinear vehicle along a reference line (lateral position n_ref(s)) and a reference speed
+//! profile u_ref(s), and simulates forward in arclength. The controls are held constant within each step.
+//!
+//! * Steering: single point preview. The vehicle is extrapolated along its velocity direction to the preview
+//!   distance, where its lateral offset is compared against the reference line. The path curvature that
+//!   closes that gap, kappa_cmd = kappa(s+L/2) + 2.(n_ref(s+L) - n - L.sin(alpha+beta))/L^2, is converted into a
+//!   steering angle with the kinematic relation delta = wheelbase.kappa_cmd
+//! * Longitudinal: proportional-integral tracking of the speed profile, acting on the throttle (limebeer2014f1)
+//!   or on the rear axle torque (lot2016kart), within the control bounds of the vehicle
+//!
+//! Intended as a cheap evaluator (stability after a setup change, controllability on a new track) rather than
+//! as a replacement of Optimal_laptime. Many vehicles can be run in parallel with simulate_batch(). Scalar vehicles
+//! are the cheapest to run (see Simplified_newton_crank_nicolson)
+//!
+template<typename Dynamic_model_t>
+class Driver_model
+{
+ public:
+    using Road_type    = typename Dynamic_model_t::Road_type;
+    using Chassis_type = typename Dynamic_model_t::Chassis_type;
+
+    constexpr static size_t NSTATE     = Dynamic_model_t::NSTATE;
+    constexpr static size_t NALGEBRAIC = Dynamic_model_t::NALGEBRAIC;
+    constexpr static size_t NCONTROL   = Dynamic_model_t::NCONTROL;
+
+    //! Index of the steering angle in the controls
+    constexpr static size_t ISTEERING = Chassis_type::Front_axle_type::ISTEERING;
+
+    //! Index of the longitudinal control: throttle if available, rear axle torque otherwise
+    constexpr static size_t ILONGITUDINAL = []() { if constexpr (vehicle_channels_detail::has_throttle<Chassis_type>::value)
+                                                       return size_t(Chassis_type::ITHROTTLE);
+                                                   else
+                                                       return size_t(Chassis_type::Rear_axle_type::ITORQUE); }();
+
+    using Propagator_type = Simplified_newton_crank_nicolson<Dynamic_model_t>;
+
+    struct Options
+    {
+        scalar ds                       = 2.0;      //! Arclength step [m]
+        scalar preview_time             = 0.6;      //! Preview distance, as time at the current speed [s]
+        scalar preview_distance_min     = 6.0;      //! Minimum preview distance [m]
+        scalar steering_gain            = 1.0;      //! Gain applied to the kinematic steering angle [-]
+        scalar steering_max             = 0.4;      //! Maximum steering angle magnitude [rad]
+        scalar wheelbase                = 0.0;      //! Wheelbase [m]. If 0, computed from the axle positions
+        scalar speed_proportional_gain  = 0.5;      //! Longitudinal command per speed error, relative to longitudinal_max [1/(m/s)]
+        scalar speed_integral_gain      = 0.05;     //! Longitudinal command per integrated speed error, relative to longitudinal_max [1/m]
+        scalar longitudinal_min         = 0.0;      //! Minimum longitudinal command (throttle [-] or torque [N.m]). If min = max = 0,
+        scalar longitudinal_max         = 0.0;      //! the bounds are the control bounds of the vehicle (optimal_laptime_control_bounds)
+        scalar minimum_speed            = 1.0;      //! The run is aborted below this speed [m/s]
+        typename Propagator_type::Options propagator;   //! Options of the implicit propagator
+    };
+
+    //! Reference line and speed profile, tabulated in arclength. Interpolated linearly, periodic with the track length
+    struct Reference
+    {
+        std::vector<scalar> s;      //! Arclength [m], increasing
+        std::vector<scalar> n;      //! Lateral position of the reference line [m], as n of the road: within [-wl, wr]
+        std::vector<scalar> u;      //! Reference speed [m/s]
+    };
+
+    struct Result
+    {
+        std::vector<scalar> s;                                  //! Arclength of each point
+        std::vector<std::array<scalar,NSTATE>> q;               //! States
+        std::vector<std::array<scalar,NALGEBRAIC>> qa;          //! Algebraic states
+        std::vector<std::array<scalar,NCONTROL>> u;             //! Controls applied from each point
+        bool success = false;                                   //! If s_final was reached within the track limits
+        std::string message;                                    //! Reason of the failure, if any
+        scalar laptime = 0.0;                                   //! Time at the last point
+        typename Propagator_type::Statistics statistics;        //! Evaluations of the vehicle made by the propagator
+    };
+
+    //! Properties of the vehicle used by the controls
+    struct Vehicle_properties
+    {
+        scalar wheelbase;           //! Wheelbase [m]
+        scalar longitudinal_min;    //! Minimum longitudinal command
+        scalar longitudinal_max;    //! Maximum longitudinal command
+    };
+
+    //! Constructor
+    //! @param[in] reference: the reference line and speed profile
+    //! @param[in] options: the driver options
+    Driver_model(const Reference& reference, const Options& options = Options());
+
+    //! Simulate from s_start to s_final
+    //! @param[in] car: the vehicle, which is evaluated by the propagator
+    //! @param[in] q0, qa0: initial states
+    //! @param[in] s_start, s_final: initial and final arclength. Throws if s_final is not greater than s_start
+    Result simulate(Dynamic_model_t& car, const std::array<scalar,NSTATE>& q0, const std::array<scalar,NALGEBRAIC>& qa0,
+                    const scalar s_start, const scalar s_final) const;
+
+    //! Simulate one copy of the run per vehicle (e.g. different setups), in parallel
+    std::vector<Result> simulate_batch(std::vector<Dynamic_model_t>& cars, const std::array<scalar,NSTATE>& q0,
+                                       const std::array<scalar,NALGEBRAIC>& qa0, const scalar s_start, const scalar s_final) const;
+
+    //! Compute the controls from the states
+    //! @param[in] road: the road of the vehicle, to get the track curvature
+    //! @param[in] vehicle: the properties of the vehicle, from get_vehicle_properties()
+    //! @param[in,out] speed_error_integral: integral of the speed error in arclength
+    std::array<scalar,NCONTROL> controls(const Road_type& road, const Vehicle_properties& vehicle, const std::array<scalar,NSTATE>& q, 
+                                         const scalar s, const scalar ds, scalar& speed_error_integral) const;
+
+    //! Wheelbase and longitudinal command bounds, from the options or from the vehicle
+    Vehicle_properties get_vehicle_properties(const Dynamic_model_t& car) const;
+
+    //! Quasi steady-state speed profile along the track: limited by the lateral acceleration in corners, and
+    //! by the longitudinal accelerations before and after them
+    //! @param[in] road: the road, to get the curvature
+    //! @param[in] s: arclength where the profile is computed
+    //! @param[in] ay_max: maximum lateral acceleration [m/s2]
+    //! @param[in] ax_max: maximum longitudinal acceleration [m/s2]
+    //! @param[in] ax_min: maximum longitudinal deceleration, positive [m/s2]
+    //! @param[in] u_max: maximum speed [m/s]
+    static std::vector<scalar> compute_speed_profile(const Road_type& road, const std::vector<scalar>& s, const scalar ay_max,
+                                                     const scalar ax_max, const scalar ax_min, const scalar u_max);
+
+    //! Get the options
+    const Options& get_options() const { return _options; }
+
+ private:
+
+    //! Interpolate one channel of the reference at s, periodic with the track length L
+    scalar interpolate(const std::vector<scalar>& values, const scalar s, const scalar L) const;
+
+    Reference _reference;   //! The reference line and speed profile
+    Options _options;       //! The options
+};
+
+#include "driver_model.hpp"
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef __DRIVER_MODEL_HPP__
+#define __DRIVER_MODEL_HPP__
+
+#include <cmath>
+#include <algorithm>
+#include "src/core/foundation/thread_pool.h"
+
+template<typename Dynamic_model_t>
+inline Driver_model<Dynamic_model_t>::Driver_model(const Reference& reference, const Options& options)
+: _reference(reference), _options(options)
+{
+    if ( _reference.s.size() < 2 )
+        throw std::runtime_error("Driver_model: the reference shall contain at least two points");
+
+    if ( _reference.n.size() != _reference.s.size() || _reference.u.size() != _reference.s.size() )
+        throw std::runtime_error("Driver_model: s, n, and u of the reference shall have the same size");
+
+    for (size_t i = 1; i < _reference.s.size(); ++i)
+        if ( _reference.s[i] <= _reference.s[i-1] )
+            throw std::runtime_error("Driver_model: the arclength of the reference shall be strictly increasing");
+
+    if ( _options.ds <= 0.0 )
+        throw std::runtime_error("Driver_model: ds shall be positive");
+
+    if ( _options.longitudinal_min > _options.longitudinal_max )
+        throw std::runtime_error("Driver_model: longitudinal_min shall not be greater than longitudinal_max");
+}
+
+
+template<typename Dynamic_model_t>
+inline typename Driver_model<Dynamic_model_t>::Result Driver_model<Dynamic_model_t>::simulate(Dynamic_model_t& car,
+    const std::array<scalar,NSTATE>& q0, const std::array<scalar,NALGEBRAIC>& qa0, const scalar s_start, const scalar s_final) const
+{
+    if ( s_final <= s_start )
+        throw std::runtime_error("Driver_model: s_final shall be greater than s_start");
+
+    const auto& road = car.get_road();
+    const auto vehicle = get_vehicle_properties(car);
+
+    // (1) Preallocate the result
+    const size_t n_steps = static_cast<size_t>(std::ceil((s_final - s_start)/_options.ds - 1.0e-10));
+
+    Result result;
+    result.s.reserve(n_steps+1);
+    result.q.reserve(n_steps+1);
+    result.qa.reserve(n_steps+1);
+    result.u.reserve(n_steps+1);
+
+    auto q  = q0;
+    auto qa = qa0;
+    scalar s = s_start;
+    scalar speed_error_integral = 0.0;
+
+    Propagator_type propagator(car, _options.propagator);
+
+    // (2) Run
+    for (size_t i = 0; i <= n_steps; ++i)
+    {
+        const scalar ds = std::min(_options.ds, s_final - s);
+        const auto u = controls(road, vehicle, q, s, ds, speed_error_integral);
+
+        result.s.push_back(s);
+        result.q.push_back(q);
+        result.qa.push_back(qa);
+        result.u.push_back(u);
+
+        // (2.1) Check the state
+        if ( q[Chassis_type::IU] < _options.minimum_speed )
+        {
+            result.message = "speed below minimum at s = " + std::to_string(s);
+            break;
+        }
+
+        if ( (q[Road_type::IN] < -road.get_left_track_limit(s)) || (q[Road_type::IN] > road.get_right_track_limit(s)) )
+        {
+            result.message = "vehicle left the track at s = " + std::to_string(s);
+            break;
+        }
+
+        if ( i == n_steps )
+        {
+            result.success = true;
+            break;
+        }
+
+        // (2.2) Propagate, holding the controls within the step
+        try
+        {
+            propagator.take_step(u, u, q, qa, s, ds);
+        }
+        catch (const std::exception& error)
+        {
+            result.message = "propagation failed at s = " + std::to_string(s) + ": " + error.what();
+            break;
+        }
+
+        s = (i + 1 == n_steps ? s_final : s + ds);
+    }
+
+    result.laptime = result.q.back()[Road_type::ITIME];
+    result.statistics = propagator.get_statistics();
+
+    return result;
+}
+
+
+template<typename Dynamic_model_t>
+inline std::vector<typename Driver_model<Dynamic_model_t>::Result> Driver_model<Dynamic_model_t>::simulate_batch(std::vector<Dynamic_model_t>& cars,
+    const std::array<scalar,NSTATE>& q0, const std::array<scalar,NALGEBRAIC>& qa0, const scalar s_start, const scalar s_final) const
+{
+    std::vector<Result> results(cars.size());
+
+    Thread_pool::get().parallel_for(cars.size(), [&](const size_t i)
+    {
+        results[i] = simulate(cars[i], q0, qa0, s_start, s_final);
+    });
+
+    return results;
+}
+
+
+template<typename Dynamic_model_t>
+inline std::array<scalar,Driver_model<Dynamic_model_t>::NCONTROL> Driver_model<Dynamic_model_t>::controls(const Road_type& road,
+    const Vehicle_properties& vehicle, const std::array<scalar,NSTATE>& q, const scalar s, const scalar ds, scalar& speed_error_integral) const
+{
+    const scalar L = road.track_length();
+
+    const scalar u     = q[Chassis_type::IU];
+    const scalar v     = q[Chassis_type::IV];
+    const scalar n     = q[Road_type::IN];
+    const scalar alpha = q[Road_type::IALPHA];
+
+    std::array<scalar,NCONTROL> controls;
+    controls.fill(0.0);
+
+    // (1) Steering: preview point along the velocity direction
+    const scalar preview_distance = std::max(_options.preview_distance_min, _options.preview_time*u);
+    const scalar n_preview = n + preview_distance*sin(alpha + atan2(v,u));
+    const scalar n_ref_preview = interpolate(_reference.n, s + preview_distance, L);
+
+    const scalar kappa_track = road.get_geometry(std::fmod(s + 0.5*preview_distance, L))[Road_type::IGEOM_KAPPA];
+    const scalar kappa_cmd = kappa_track + 2.0*(n_ref_preview - n_preview)/(preview_distance*preview_distance);
+
+    controls[ISTEERING] = std::clamp(_options.steering_gain*vehicle.wheelbase*kappa_cmd, -_options.steering_max, _options.steering_max);
+
+    // (2) Longitudinal: PI on the speed error, scaled by the maximum command. The integral is frozen while the command 
+    //     saturates (anti-windup)
+    const scalar speed_error = interpolate(_reference.u, s, L) - u;
+    const scalar command = vehicle.longitudinal_max*(_options.speed_proportional_gain*speed_error 
+                                                   + _options.speed_integral_gain*(speed_error_integral + speed_error*ds));
+
+    if ( command > vehicle.longitudinal_min && command < vehicle.longitudinal_max )
+        speed_error_integral += speed_error*ds;
+
+    controls[ILONGITUDINAL] = std::clamp(command, vehicle.longitudinal_min, vehicle.longitudinal_max);
+
+    return controls;
+}
+
+
+template<typename Dynamic_model_t>
+inline std::vector<scalar> Driver_model<Dynamic_model_t>::compute_speed_profile(const Road_type& road, const std::vector<scalar>& s,
+    const scalar ay_max, const scalar ax_max, const scalar ax_min, const scalar u_max)
+{
+    const size_t n = s.size();
+    std::vector<scalar> u(n);
+
+    // (1) Cornering limit
+    for (size_t i = 0; i < n; ++i)
+    {
+        const scalar kappa = std::abs(road.get_geometry(s[i])[Road_type::IGEOM_KAPPA]);
+        u[i] = (kappa > 0.0 ? std::min(u_max, std::sqrt(ay_max/kappa)) : u_max);
+    }
+
+    // (2) Acceleration out of the corners
+    for (size_t i = 1; i < n; ++i)
+        u[i] = std::min(u[i], std::sqrt(u[i-1]*u[i-1] + 2.0*ax_max*(s[i]-s[i-1])));
+
+    // (3) Braking into the corners
+    for (size_t i = n-1; i > 0; --i)
+        u[i-1] = std::min(u[i-1], std::sqrt(u[i]*u[i] + 2.0*ax_min*(s[i]-s[i-1])));
+
+    return u;
+}
+
+
+template<typename Dynamic_model_t>
+inline scalar Driver_model<Dynamic_model_t>::interpolate(const std::vector<scalar>& values, const scalar s, const scalar L) const
+{
+    const auto& s_ref = _reference.s;
+
+    // (1) Bring s to [s_ref[0], s_ref[0] + L)
+    scalar s_local = std::fmod(s - s_ref.front(), L);
+    if ( s_local < 0.0 ) s_local += L;
+    s_local += s_ref.front();
+
+    // (2) Beyond the last point: interpolate towards the first one, one lap later
+    if ( s_local >= s_ref.back() )
+    {
+        const scalar interval = s_ref.front() + L - s_ref.back();
+
+        if ( interval <= 0.0 )
+            return values.back();
+
+        const scalar xi = (s_local - s_ref.back())/interval;
+        return (1.0-xi)*values.back() + xi*values.front();
+    }
+
+    const size_t i = std::upper_bound(s_ref.cbegin(), s_ref.cend(), s_local) - s_ref.cbegin() - 1;
+    const scalar xi = (s_local - s_ref[i])/(s_ref[i+1] - s_ref[i]);
+
+    return (1.0-xi)*values[i] + xi*values[i+1];
+}
+
+
+template<typename Dynamic_model_t>
+inline typename Driver_model<Dynamic_model_t>::Vehicle_properties Driver_model<Dynamic_model_t>::get_vehicle_properties(const Dynamic_model_t& car) const
+{
+    Vehicle_properties vehicle;
+
+    // (1) Wheelbase from the options, or from the axle positions
+    if ( _options.wheelbase > 0.0 )
+    {
+        vehicle.wheelbase = _options.wheelbase;
+    }
+    else
+    {
+        const auto& chassis = car.get_chassis();
+        const auto wheelbase = chassis.get_front_axle().get_frame().get_origin().at(X) - chassis.get_rear_axle().get_frame().get_origin().at(X);
+
+        if constexpr (std::is_same<typename Dynamic_model_t::Timeseries_type,CppAD::AD<scalar>>::value)
+            vehicle.wheelbase = std::abs(Value(wheelbase));
+        else
+            vehicle.wheelbase = std::abs(wheelbase);
+    }
+
+    // (2) Longitudinal command bounds from the options, or from the control bounds of the vehicle
+    if ( _options.longitudinal_min != 0.0 || _options.longitudinal_max != 0.0 )
+    {
+        vehicle.longitudinal_min = _options.longitudinal_min;
+        vehicle.longitudinal_max = _options.longitudinal_max;
+    }
+    else
+    {
+        const auto [u_lb, u_ub, dudt_lb, dudt_ub] = car.optimal_laptime_control_bounds();
+        vehicle.longitudinal_min = u_lb.at(ILONGITUDINAL);
+        vehicle.longitudinal_max = u_ub.at(ILONGITUDINAL);
+    }
+
+    return vehicle;
+}
+
+#endif
@@ -1,23 +1,103 @@
 #ifndef __MINIMUM_CURVATURE_PATH_H__
 #define __MINIMUM_CURVATURE_PATH_H__
 
+#include <array>
+#include <vector>
+#include <type_traits>
 #include "lion/thirdparty/include/cppad/cppad.hpp"
+#include "src/core/vehicles/track_by_arcs.h"
 
+//!     Minimum curvature path of a track
+//!     ---------------------------------
+//!
+//! Computes the lateral offsets w(s_i), at equally spaced points of a track, that minimise the integral of the
+//! squared pseudo curvature, with the track limits as bounds. Closed tracks have N points, and periodic finite
+//! differences. Open tracks have N+1 points, including both ends, with one-sided differences at the ends.
+//!
+//! The pseudo curvature (t0 x d2rc)/|t0|^3, with t0 the centerline tangent, is linear in (w, dw, d2w). With
+//! finite differences, the residuals are J.w + a, with J (cyclic) tridiagonal, and the problem is the
+//! box-constrained least squares min |J.w + a|^2, whose normal equations are (cyclic) pentadiagonal. The default
+//! solver is a projected Newton method, where each Newton step on the free variables is a cyclic banded Cholesky
+//! solve, O(N). It is run on a sequence of grids, from coarse to fine, so that the active set of the fine grid
+//! is found in a few iterations.
+//!
+//! The track shall provide operator()(s) = (r, dr, d2r), and the track limits. The third derivative of the
+//! centerline is exact for Track_by_arcs, and a finite difference of d2r on the grid otherwise.
+//!
+//! The IPOPT solver of the same problem is kept as a reference, for closed Track_by_arcs.
+//!
 class Minimum_curvature_path
 {
  public:
-    Minimum_curvature_path(const Track_by_arcs& track, const size_t N) { compute(track,N); }
+    enum Solver { BANDED_QP, IPOPT };
 
-    std::vector<double> compute(const Track_by_arcs& track, const size_t N);
+    struct Options
+    {
+        Solver solver               = BANDED_QP;    //! The solver
+        size_t maximum_iterations   = 100;          //! Maximum number of projected Newton iterations per grid (BANDED_QP)
+        size_t coarsest_grid        = 50;           //! Points of the coarsest grid of the continuation (BANDED_QP)
+        scalar tolerance            = 1.0e-6;       //! Tolerance of the projected gradient step [m] (BANDED_QP)
+        scalar margin               = 0.0;          //! Distance kept to the track limits [m]
+    };
+
+    //! Finite differences at a point: w_i, dw_i, and d2w_i as combinations of w at three points
+    struct Stencil
+    {
+        std::array<size_t,3> index;     //! The three points
+        std::array<scalar,3> w;         //! Coefficients of w
+        std::array<scalar,3> dw;        //! Coefficients of dw/ds
+        std::array<scalar,3> d2w;       //! Coefficients of d2w/ds2
+    };
+
+    //! Constructor
+    //! @param[in] N: number of points for closed tracks, number of intervals for open tracks
+    //! @param[in] closed: if the track is closed
+    template<typename Track_t>
+    Minimum_curvature_path(const Track_t& track, const size_t N, const bool closed = true) { compute(track,N,closed); }
+
+    template<typename Track_t>
+    Minimum_curvature_path(const Track_t& track, const size_t N, const Options& options) : _options(options) { compute(track,N,true); }
+
+    template<typename Track_t>
+    Minimum_curvature_path(const Track_t& track, const size_t N, const bool closed, const Options& options) : _options(options) { compute(track,N,closed); }
+
+    template<typename Track_t>
+    std::vector<double> compute(const Track_t& track, const size_t N, const bool closed = true);
 
     const std::vector<double>& get_x() const { return _x; }
-    const bool& get_success() const { return _success; } 
+
+    //! Arclength of the points
+    const std::vector<scalar>& get_s() const { return _s; }
+
+    const bool& get_success() const { return _success; }
+
+    bool is_closed() const { return _closed; }
+
+    //! Number of projected Newton iterations of the last BANDED_QP solve, in all the grids
+    size_t get_iterations() const { return _iterations; }
+
+    //! Finite differences at the point i of a grid of n_points, with spacing ds
+    static Stencil get_stencil(const size_t i, const size_t n_points, const bool closed, const scalar ds);
+
+    //! Derivatives (dr, d2r, d3r) of the centerline at the points s: exact for Track_by_arcs
+    static std::vector<std::array<sVector3d,3>> compute_derivatives(const Track_by_arcs& track, const std::vector<scalar>& s, const bool closed);
+
+    //! Derivatives (dr, d2r, d3r) of the centerline at the points s: d3r by finite differences of d2r
+    template<typename Track_t>
+    static std::vector<std::array<sVector3d,3>> compute_derivatives(const Track_t& track, const std::vector<scalar>& s, const bool closed);
+
  private:
 
+    //! Bandwidth of the normal equations
+    constexpr static size_t P = 2;
+
+    //! Symmetric cyclic banded matrix: band[i][P+d] = M(i, (i+d) mod n), for |d| <= P
+    using Cyclic_band = std::vector<std::array<scalar,2*P+1>>;
+
     class Fitness_fcn
     {
      public:
-        using ADvector = std::vector<timeseries>;
+        using ADvector = std::vector<CppAD::AD<scalar>>;
 
         Fitness_fcn(const size_t N, const Track_by_arcs& track) : _n(N), _track(track) {}
 
@@ -28,8 +108,43 @@ class Minimum_curvature_path
         Track_by_arcs _track;
     };
 
+    std::vector<double> compute_ipopt(const Track_by_arcs& track, const size_t N);
+
+    //! Solve the QP on a sequence of grids, halving N, and use the solution of each grid as the first guess of the next
+    template<typename Track_t>
+    std::vector<double> compute_banded_qp(const Track_t& track, const size_t N, const bool closed);
+
+    //! Compute the normal equations and the bounds of the QP with N points (closed) or intervals (open)
+    template<typename Track_t>
+    void assemble_qp(const Track_t& track, const size_t N, const bool closed, Cyclic_band& H, std::vector<scalar>& g,
+                     std::vector<scalar>& lb, std::vector<scalar>& ub) const;
+
+    //! Bounds of w at s: the track limits, reduced by the margin. As n in Road_curvilinear, w is measured along 
+    //! (-dr.y, dr.x), where the right track limit is: w in [-wl, wr]
+    template<typename Track_t>
+    std::pair<scalar,scalar> get_bounds(const Track_t& track, const scalar s) const;
+
+    //! Offset from i to j in a cyclic grid of n points, in [-n/2, n/2]
+    static int get_offset(const size_t i, const size_t j, const size_t n);
+
+    //! Solve min 0.5.w'.H.w + g'.w, with lb <= w <= ub, by a projected Newton method
+    //! @param[in,out] w: the initial guess, and the solution
+    //! @return true if the projected gradient converged
+    bool solve_box_qp(const Cyclic_band& H, const std::vector<scalar>& g, const std::vector<scalar>& lb,
+                      const std::vector<scalar>& ub, std::vector<scalar>& w);
+
+    //! Solve M.x = b, with M symmetric positive definite and cyclic banded
+    static std::vector<scalar> solve_cyclic_banded(const Cyclic_band& M, const std::vector<scalar>& b);
+
+    //! Solve A.x = b, with A dense, by Gaussian elimination with partial pivoting
+    static std::vector<scalar> solve_dense(std::vector<std::vector<scalar>> A, std::vector<scalar> b);
+
+    Options _options;
     bool _success;
+    bool _closed;
     std::vector<double> _x;
+    std::vector<scalar> _s;
+    size_t _iterations = 0;
 };
 
 #include "minimum_curvature_path.hpp"
@@ -1,14 +1,48 @@
+#include <cmath>
+#include <tuple>
+#include <algorithm>
 #include "lion/thirdparty/include/cppad/ipopt/solve.hpp"
 
-inline std::vector<scalar> Minimum_curvature_path::compute(const Track_by_arcs& track, const size_t N) 
+template<typename Track_t>
+inline std::vector<scalar> Minimum_curvature_path::compute(const Track_t& track, const size_t N, const bool closed)
+{
+    _closed = closed;
+
+    // Arclength of the points
+    _s.resize(closed ? N : N+1);
+
+    for (size_t i = 0; i < _s.size(); ++i)
+        _s[i] = ((scalar)i)*track.get_total_length()/((scalar)N);
+
+    if ( _options.solver == IPOPT )
+    {
+        if constexpr (std::is_same_v<Track_t,Track_by_arcs>)
+        {
+            if ( !closed )
+                throw std::runtime_error("Minimum_curvature_path: the IPOPT solver only supports closed tracks");
+
+            return compute_ipopt(track, N);
+        }
+        else
+            throw std::runtime_error("Minimum_curvature_path: the IPOPT solver only supports Track_by_arcs");
+    }
+    else
+        return compute_banded_qp(track, N, closed);
+}
+
+
+inline std::vector<scalar> Minimum_curvature_path::compute_ipopt(const Track_by_arcs& track, const size_t N)
 {
     Fitness_fcn f(N,track);
 
     // initial value of the independent variables
     std::vector<scalar> xi(N,0.0);
 
-    // lower and upper limits for x
-    std::vector<scalar> xl(N,-10.0), xu(N,10.0);
+    // lower and upper limits for x: the track limits
+    std::vector<scalar> xl(N), xu(N);
+
+    for (size_t i = 0; i < N; ++i)
+        std::tie(xl[i], xu[i]) = get_bounds(track, _s[i]);
 
     // lower and upper limits for g
     std::vector<scalar> gl, gu;
@@ -23,11 +57,6 @@ inline std::vector<scalar> Minimum_curvature_path::compute(const Track_by_arcs&
     // see Mathematical Programming, Volume 106, Number 1,
     // Pages 25-57, Equation (6)
     options += "Numeric tol          1e-6\n";
-    // derivative testing
-    options += "String  derivative_test            second-order\n";
-    // maximum amount of random pertubation; e.g.,
-    // when evaluation finite diff
-    options += "Numeric point_perturbation_radius  0.\n";
 
     options += "Sparse true forward\n";
     options += "Retape false\n";
@@ -46,6 +75,531 @@ inline std::vector<scalar> Minimum_curvature_path::compute(const Track_by_arcs&
     return solution.x;
 }
 
+
+template<typename Track_t>
+inline std::vector<scalar> Minimum_curvature_path::compute_banded_qp(const Track_t& track, const size_t N, const bool closed)
+{
+    if ( N < 2*P+1 )
+        throw std::runtime_error("Minimum_curvature_path: at least " + std::to_string(2*P+1) + " points are required");
+
+    // (1) Sequence of grids, halving N down to the coarsest grid
+    std::vector<size_t> grids = {N};
+
+    while ( grids.back()/2 >= std::max(_options.coarsest_grid, 2*P+1) )
+        grids.push_back(grids.back()/2);
+
+    std::reverse(grids.begin(), grids.end());
+
+    // (2) Solve each grid, starting from the solution of the previous one
+    _iterations = 0;
+    _x.assign(closed ? grids.front() : grids.front()+1, 0.0);
+
+    for (size_t level = 0; level < grids.size(); ++level)
+    {
+        const size_t n = grids[level];
+
+        Cyclic_band H;
+        std::vector<scalar> g, lb, ub;
+        assemble_qp(track, n, closed, H, g, lb, ub);
+
+        if ( level > 0 )
+        {
+            // Linear interpolation of the previous solution, periodic for closed tracks
+            const size_t n_previous = grids[level-1];
+            const std::vector<scalar> x_previous = _x;
+            _x.resize(closed ? n : n+1);
+
+            for (size_t i = 0; i < _x.size(); ++i)
+            {
+                const scalar xi = ((scalar)(i*n_previous))/((scalar)n);
+                const size_t j = std::min(static_cast<size_t>(xi), n_previous-1);
+                const scalar t = xi - ((scalar)j);
+
+                _x[i] = (1.0 - t)*x_previous[j] + t*x_previous[(j+1) % x_previous.size()];
+            }
+        }
+
+        _success = solve_box_qp(H, g, lb, ub, _x);
+    }
+
+    return _x;
+}
+
+
+template<typename Track_t>
+inline void Minimum_curvature_path::assemble_qp(const Track_t& track, const size_t N, const bool closed, Cyclic_band& H, std::vector<scalar>& g,
+                                                std::vector<scalar>& lb, std::vector<scalar>& ub) const
+{
+    const size_t n_points = (closed ? N : N+1);
+    const scalar ds = track.get_total_length() / ((scalar)N);
+
+    std::vector<scalar> s(n_points);
+    for (size_t i = 0; i < n_points; ++i)
+        s[i] = ((scalar)i)*ds;
+
+    const auto derivatives = compute_derivatives(track, s, closed);
+
+    // (1) Residuals: pseudo_curvature_i = a_i + J_i[0].w_{k0} + J_i[1].w_{k1} + J_i[2].w_{k2}, with k the points of the stencil, and
+    //     pseudo_curvature = (cross(dr,d2r) + w.dot(dr,d3r) + 2.dw.dot(dr,d2r) + d2w.dot(dr,dr))/|dr|^3
+    //     The ends of open tracks are weighted by 1/2, as in the trapezoidal rule
+    std::vector<scalar> a(n_points);
+    std::vector<Stencil> stencils(n_points);
+    std::vector<std::array<scalar,3>> J(n_points);
+    lb.resize(n_points);
+    ub.resize(n_points);
+
+    for (size_t i = 0; i < n_points; ++i)
+    {
+        const auto& [dr,d2r,d3r] = derivatives[i];
+
+        const scalar dr2 = dot(dr,dr);
+        const scalar inv_dr3 = 1.0/(dr2*std::sqrt(dr2));
+        const scalar weight = ((!closed && (i == 0 || i == n_points-1)) ? std::sqrt(0.5) : 1.0);
+
+        const scalar c_w   = dot(dr,d3r)*inv_dr3;
+        const scalar c_dw  = 2.0*dot(dr,d2r)*inv_dr3;
+        const scalar c_d2w = dr2*inv_dr3;
+
+        stencils[i] = get_stencil(i, n_points, closed, ds);
+
+        a[i] = weight*(dr[0]*d2r[1] - dr[1]*d2r[0])*inv_dr3;
+
+        for (size_t k = 0; k < 3; ++k)
+            J[i][k] = weight*(c_w*stencils[i].w[k] + c_dw*stencils[i].dw[k] + c_d2w*stencils[i].d2w[k]);
+
+        std::tie(lb[i], ub[i]) = get_bounds(track, s[i]);
+    }
+
+    // (2) Normal equations: H = J'.J, g = J'.a
+    H.resize(n_points);
+    g.assign(n_points, 0.0);
+
+    for (auto& row : H)
+        row.fill(0.0);
+
+    for (size_t i = 0; i < n_points; ++i)
+    {
+        for (size_t k1 = 0; k1 < 3; ++k1)
+        {
+            const size_t j = stencils[i].index[k1];
+            g[j] += J[i][k1]*a[i];
+
+            for (size_t k2 = 0; k2 < 3; ++k2)
+                H[j][P + get_offset(j, stencils[i].index[k2], n_points)] += J[i][k1]*J[i][k2];
+        }
+    }
+
+    // (3) Open tracks: the offsets linear in s do not change the curvature of straights, regularize them
+    if ( !closed )
+    {
+        scalar maximum_diagonal = 0.0;
+
+        for (const auto& row : H)
+            maximum_diagonal = std::max(maximum_diagonal, row[P]);
+
+        for (auto& row : H)
+            row[P] += 1.0e-12*maximum_diagonal;
+    }
+}
+
+
+template<typename Track_t>
+inline std::pair<scalar,scalar> Minimum_curvature_path::get_bounds(const Track_t& track, const scalar s) const
+{
+    scalar lower = -track.get_left_track_limit(s) + _options.margin;
+    scalar upper = track.get_right_track_limit(s) - _options.margin;
+
+    // If the margin is larger than the track, use its middle
+    if ( lower > upper )
+        lower = upper = 0.5*(lower + upper);
+
+    return {lower, upper};
+}
+
+
+inline Minimum_curvature_path::Stencil Minimum_curvature_path::get_stencil(const size_t i, const size_t n_points, const bool closed, const scalar ds)
+{
+    const scalar inv_ds = 1.0/ds;
+    const scalar inv_ds2 = inv_ds*inv_ds;
+
+    // (1) First point of open tracks: second order forward differences
+    if ( !closed && i == 0 )
+        return { {0, 1, 2}, {1.0, 0.0, 0.0}, {-1.5*inv_ds, 2.0*inv_ds, -0.5*inv_ds}, {inv_ds2, -2.0*inv_ds2, inv_ds2} };
+
+    // (2) Last point of open tracks: second order backward differences
+    if ( !closed && i == n_points-1 )
+        return { {n_points-3, n_points-2, n_points-1}, {0.0, 0.0, 1.0}, {0.5*inv_ds, -2.0*inv_ds, 1.5*inv_ds}, {inv_ds2, -2.0*inv_ds2, inv_ds2} };
+
+    // (3) Central differences, periodic for closed tracks
+    return { {(i + n_points - 1) % n_points, i, (i + 1) % n_points}, {0.0, 1.0, 0.0}, {-0.5*inv_ds, 0.0, 0.5*inv_ds}, {inv_ds2, -2.0*inv_ds2, inv_ds2} };
+}
+
+
+inline std::vector<std::array<sVector3d,3>> Minimum_curvature_path::compute_derivatives(const Track_by_arcs& track, const std::vector<scalar>& s, const bool)
+{
+    std::vector<std::array<sVector3d,3>> result(s.size());
+
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        const auto [r,dr,d2r,d3r] = track.at(s[i]);
+        result[i] = {dr, d2r, d3r};
+    }
+
+    return result;
+}
+
+
+template<typename Track_t>
+inline std::vector<std::array<sVector3d,3>> Minimum_curvature_path::compute_derivatives(const Track_t& track, const std::vector<scalar>& s, const bool closed)
+{
+    const size_t n = s.size();
+    assert(n >= 2);
+
+    std::vector<std::array<sVector3d,3>> result(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const auto [r,dr,d2r] = track(s[i]);
+        result[i] = {dr, d2r, sVector3d(0.0,0.0,0.0)};
+    }
+
+    // Central differences of d2r on the grid, periodic for closed tracks, and one-sided at the ends of open tracks
+    const scalar ds = s[1] - s[0];
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        if ( !closed && i == 0 )
+            result[i][2] = (result[1][1] - result[0][1])/ds;
+        else if ( !closed && i == n-1 )
+            result[i][2] = (result[n-1][1] - result[n-2][1])/ds;
+        else
+            result[i][2] = (result[(i+1) % n][1] - result[(i+n-1) % n][1])/(2.0*ds);
+    }
+
+    return result;
+}
+
+
+inline int Minimum_curvature_path::get_offset(const size_t i, const size_t j, const size_t n)
+{
+    int offset = static_cast<int>((j + n - i) % n);
+
+    if ( offset > static_cast<int>(n/2) )
+        offset -= static_cast<int>(n);
+
+    return offset;
+}
+
+
+inline bool Minimum_curvature_path::solve_box_qp(const Cyclic_band& H, const std::vector<scalar>& g, const std::vector<scalar>& lb,
+                                                 const std::vector<scalar>& ub, std::vector<scalar>& w)
+{
+    const size_t n = g.size();
+    assert(w.size() == n);
+
+    // Product by H
+    auto multiply = [&](const std::vector<scalar>& x)
+    {
+        std::vector<scalar> result(n, 0.0);
+
+        for (size_t i = 0; i < n; ++i)
+            for (size_t d = 0; d < 2*P+1; ++d)
+                result[i] += H[i][d]*x[(i + n + d - P) % n];
+
+        return result;
+    };
+
+    // Entry of H between two variables, zero if they are not within the band
+    auto H_entry = [&](const size_t i, const size_t j)
+    {
+        const int offset = get_offset(i, j, n);
+
+        return (std::abs(offset) <= static_cast<int>(P) ? H[i][P + offset] : 0.0);
+    };
+
+    // (1) Start from the projection of the initial guess
+    for (size_t i = 0; i < n; ++i)
+        w[i] = std::clamp(w[i], lb[i], ub[i]);
+
+    std::vector<scalar> gradient_w = multiply(w);
+
+    for (size_t i = 0; i < n; ++i)
+        gradient_w[i] += g[i];
+
+    for (size_t iter = 0; iter < _options.maximum_iterations; ++iter)
+    {
+        ++_iterations;
+
+        // (2) Optimality: distance to the projection of a scaled gradient step
+        scalar error = 0.0;
+
+        for (size_t i = 0; i < n; ++i)
+            error = std::max(error, std::abs(w[i] - std::clamp(w[i] - gradient_w[i]/H[i][P], lb[i], ub[i])));
+
+        if ( error < _options.tolerance )
+            return true;
+
+        // (3) Binding set: the variables within error of a bound, that the gradient pushes outwards
+        std::vector<bool> binding(n);
+        std::vector<size_t> free_indexes;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            binding[i] = (w[i] <= lb[i] + error && gradient_w[i] > 0.0) || (w[i] >= ub[i] - error && gradient_w[i] < 0.0);
+
+            if ( !binding[i] )
+                free_indexes.push_back(i);
+        }
+
+        // (4) Direction: reduced Newton on the free variables, scaled gradient on the binding ones. The binding
+        //     variables stay at their bounds, so that the direction is the exact step once the active set is found
+        std::vector<scalar> direction(n);
+
+        for (size_t i = 0; i < n; ++i)
+            direction[i] = -gradient_w[i]/H[i][P];
+
+        const size_t m = free_indexes.size();
+
+        if ( m > 0 )
+        {
+            std::vector<scalar> rhs(m);
+            for (size_t k = 0; k < m; ++k)
+                rhs[k] = -gradient_w[free_indexes[k]];
+
+            // The free variables keep the cyclic order, then their matrix is also cyclic banded
+            std::vector<scalar> direction_free;
+
+            if ( m < 2*P+1 )
+            {
+                std::vector<std::vector<scalar>> A(m, std::vector<scalar>(m));
+                for (size_t k1 = 0; k1 < m; ++k1)
+                    for (size_t k2 = 0; k2 < m; ++k2)
+                        A[k1][k2] = H_entry(free_indexes[k1], free_indexes[k2]);
+
+                direction_free = solve_dense(A, rhs);
+            }
+            else
+            {
+                Cyclic_band H_free(m);
+                for (size_t k = 0; k < m; ++k)
+                    for (size_t d = 0; d < 2*P+1; ++d)
+                        H_free[k][d] = H_entry(free_indexes[k], free_indexes[(k + m + d - P) % m]);
+
+                direction_free = solve_cyclic_banded(H_free, rhs);
+            }
+
+            for (size_t k = 0; k < m; ++k)
+                direction[free_indexes[k]] = direction_free[k];
+        }
+
+        // (5) Projected line search, with the Armijo condition along the projection arc. The change of the
+        //     objective, gradient'.step + 0.5.step'.H.step, is computed from the step to avoid cancellation
+        constexpr const scalar sufficient_decrease = 1.0e-4;
+        bool accepted = false;
+
+        for (scalar alpha = 1.0; alpha > 1.0e-12; alpha *= 0.5)
+        {
+            std::vector<scalar> step(n);
+            scalar predicted_change = 0.0;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                step[i] = std::clamp(w[i] + alpha*direction[i], lb[i], ub[i]) - w[i];
+                predicted_change += gradient_w[i]*step[i];
+            }
+
+            const std::vector<scalar> H_step = multiply(step);
+            scalar change = predicted_change;
+
+            for (size_t i = 0; i < n; ++i)
+                change += 0.5*step[i]*H_step[i];
+
+            if ( change <= sufficient_decrease*predicted_change )
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    w[i] += step[i];
+                    gradient_w[i] += H_step[i];
+                }
+
+                accepted = true;
+                break;
+            }
+        }
+
+        if ( !accepted )
+            return false;
+    }
+
+    return false;
+}
+
+
+inline std::vector<scalar> Minimum_curvature_path::solve_cyclic_banded(const Cyclic_band& M, const std::vector<scalar>& b)
+{
+    const size_t m = b.size();
+    assert(M.size() == m);
+    assert(m >= 2*P+1);
+
+    // (1) Split the unknowns into the border S = {0,...,P-1} and the rest R = {P,...,m-1}. The block M_RR is
+    //     banded, and the corners of M only couple S and R
+    const size_t q = m - P;
+
+    // (2) Banded Cholesky factorization of M_RR: L(i,k) = L[i][P+k-i]
+    std::vector<std::array<scalar,P+1>> L(q);
+
+    for (size_t i = 0; i < q; ++i)
+    {
+        const size_t k_start = (i > P ? i - P : 0);
+
+        for (size_t j = k_start; j <= i; ++j)
+        {
+            scalar sum = M[P+i][P+j-i];
+
+            for (size_t k = k_start; k < j; ++k)
+                sum -= L[i][P+k-i]*L[j][P+k-j];
+
+            if ( i == j )
+            {
+                if ( sum <= 0.0 )
+                    throw std::runtime_error("Minimum_curvature_path: the normal equations are not positive definite");
+
+                L[i][P] = std::sqrt(sum);
+            }
+            else
+                L[i][P+j-i] = sum/L[j][P];
+        }
+    }
+
+    auto solve_RR = [&](std::vector<scalar>& x)
+    {
+        for (size_t i = 0; i < q; ++i)
+        {
+            for (size_t k = (i > P ? i - P : 0); k < i; ++k)
+                x[i] -= L[i][P+k-i]*x[k];
+
+            x[i] /= L[i][P];
+        }
+
+        for (size_t i = q; i-- > 0; )
+        {
+            for (size_t k = i+1; k < std::min(q, i+P+1); ++k)
+                x[i] -= L[k][P+i-k]*x[k];
+
+            x[i] /= L[i][P];
+        }
+    };
+
+    // (3) Coupling block M_RS, and its solutions Y = M_RR^{-1}.M_RS
+    std::array<std::vector<scalar>,P> C, Y;
+
+    for (size_t s = 0; s < P; ++s)
+    {
+        C[s].assign(q, 0.0);
+
+        for (size_t r = 0; r < q; ++r)
+        {
+            int offset = static_cast<int>(s) - static_cast<int>(P + r);
+
+            if ( offset < -static_cast<int>(P) )
+                offset += static_cast<int>(m);
+
+            if ( std::abs(offset) <= static_cast<int>(P) )
+                C[s][r] = M[P+r][P+offset];
+        }
+
+        Y[s] = C[s];
+        solve_RR(Y[s]);
+    }
+
+    std::vector<scalar> z(b.cbegin() + P, b.cend());
+    solve_RR(z);
+
+    // (4) Schur complement on the border: (M_SS - M_SR.Y).x_S = b_S - M_SR.z
+    std::vector<std::vector<scalar>> schur(P, std::vector<scalar>(P));
+    std::vector<scalar> rhs_S(P);
+
+    for (size_t s1 = 0; s1 < P; ++s1)
+    {
+        rhs_S[s1] = b[s1];
+
+        for (size_t r = 0; r < q; ++r)
+            rhs_S[s1] -= C[s1][r]*z[r];
+
+        for (size_t s2 = 0; s2 < P; ++s2)
+        {
+            schur[s1][s2] = M[s1][P+s2-s1];
+
+            for (size_t r = 0; r < q; ++r)
+                schur[s1][s2] -= C[s1][r]*Y[s2][r];
+        }
+    }
+
+    const std::vector<scalar> x_S = solve_dense(schur, rhs_S);
+
+    // (5) Back substitution: x_R = z - Y.x_S
+    std::vector<scalar> x(m);
+
+    for (size_t s = 0; s < P; ++s)
+        x[s] = x_S[s];
+
+    for (size_t r = 0; r < q; ++r)
+    {
+        x[P+r] = z[r];
+
+        for (size_t s = 0; s < P; ++s)
+            x[P+r] -= Y[s][r]*x_S[s];
+    }
+
+    return x;
+}
+
+
+inline std::vector<scalar> Minimum_curvature_path::solve_dense(std::vector<std::vector<scalar>> A, std::vector<scalar> b)
+{
+    const size_t n = b.size();
+
+    for (size_t k = 0; k < n; ++k)
+    {
+        // (1) Partial pivoting
+        size_t i_pivot = k;
+        for (size_t i = k+1; i < n; ++i)
+            if ( std::abs(A[i][k]) > std::abs(A[i_pivot][k]) )
+                i_pivot = i;
+
+        if ( A[i_pivot][k] == 0.0 )
+            throw std::runtime_error("Minimum_curvature_path: singular system");
+
+        std::swap(A[k], A[i_pivot]);
+        std::swap(b[k], b[i_pivot]);
+
+        // (2) Elimination
+        for (size_t i = k+1; i < n; ++i)
+        {
+            const scalar factor = A[i][k]/A[k][k];
+
+            for (size_t j = k; j < n; ++j)
+                A[i][j] -= factor*A[k][j];
+
+            b[i] -= factor*b[k];
+        }
+    }
+
+    // (3) Back substitution
+    std::vector<scalar> x(n);
+    for (size_t i = n; i-- > 0; )
+    {
+        x[i] = b[i];
+
+        for (size_t j = i+1; j < n; ++j)
+            x[i] -= A[i][j]*x[j];
+
+        x[i] /= A[i][i];
+    }
+
+    return x;
+}
+
 inline void Minimum_curvature_path::Fitness_fcn::operator()(Minimum_curvature_path::Fitness_fcn::ADvector& fg, const Minimum_curvature_path::Fitness_fcn::ADvector& x) const
 {
     assert(fg.size() == 1);
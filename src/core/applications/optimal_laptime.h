@@ -5,6 +5,8 @@
 #include "lion/foundation/types.h"
 #include "src/core/vehicles/track_by_arcs.h"
 #include "src/core/vehicles/road_curvilinear.h"
+#include "src/core/foundation/ipopt_progress.h"
+#include "src/core/foundation/columnar_file.h"
 
 template<typename Dynamic_model_t>
 class Optimal_laptime
@@ -29,6 +31,7 @@ class Optimal_laptime
         scalar sigma = 0.5;         // 0: explicit euler, 0.5: crank-nicolson, 1.0: implicit euler
         size_t maximum_iterations = 3000;
         bool   throw_if_fail = true;
+        Ipopt_progress* progress = nullptr;   //! If provided, the solver reports its progress and can be cancelled through it
     };
     
 
@@ -93,6 +96,9 @@ class Optimal_laptime
 
     Optimal_laptime(Xml_document& doc);
 
+    //! Constructor from a binary columnar file, written by save()
+    explicit Optimal_laptime(const Columnar_file& file);
+
     void compute(const Dynamic_model_t& car, const std::array<scalar,Dynamic_model_t::NCONTROL>& dissipations);
 
     template<bool isClosed>
@@ -106,13 +112,20 @@ class Optimal_laptime
     //! Export to XML
     std::unique_ptr<Xml_document> xml() const;
 
+    //! Export to a binary columnar file: one channel per variable, with the same names as xml()
+    Columnar_file::Writer columnar(const Columnar_file::Compression compression = Columnar_file::NONE) const;
+
+    //! Save to a binary columnar file, to be read with Optimal_laptime(Columnar_file(filename))
+    void save(const std::string& filename, const Columnar_file::Compression compression = Columnar_file::NONE) const 
+        { columnar(compression).save(filename); }
+
     Options options;
 
     // Outputs
-    bool success;
+    bool success = false;
     bool is_closed;
-    bool is_direct;
-    bool warm_start;
+    bool is_direct = false;
+    bool warm_start = false;
     size_t n_elements;
     size_t n_points;
     std::vector<scalar> s;                                           //! Arclengths
@@ -1,5 +1,6 @@
 #include "lion/thirdparty/include/cppad/ipopt/solve.hpp"
 #include "lion/math/ipopt_cppad_handler.hpp"
+#include "src/core/foundation/ipopt_solver_lock.h"
 
 template<typename Dynamic_model_t>
 inline Optimal_laptime<Dynamic_model_t>::Optimal_laptime(const size_t n, const bool is_closed_, const bool is_direct_, 
@@ -226,6 +227,80 @@ inline Optimal_laptime<Dynamic_model_t>::Optimal_laptime(Xml_document& doc)
 }
 
 
+template<typename Dynamic_model_t>
+inline Optimal_laptime<Dynamic_model_t>::Optimal_laptime(const Columnar_file& file)
+{
+    if ( !file.has_attribute("format") || file.get_attribute("format") != "optimal_laptime" )
+        throw std::runtime_error("Optimal_laptime: the file does not contain an optimal laptime");
+
+    if ( file.get_attribute("type") == "closed" )
+        is_closed = true;
+    else if ( file.get_attribute("type") == "open" )
+        is_closed = false;
+    else
+        throw std::runtime_error("Incorrect track type, should be \"open\" or \"closed\"");
+
+    const auto [key_name, q_names, qa_names, u_names] = Dynamic_model_t::get_state_and_control_names();
+
+    // Get the data
+    n_points   = std::stoul(file.get_attribute("n_points"));
+    n_elements = (is_closed ? n_points : n_points - 1);
+    success    = (file.get_attribute("success") == "true");
+    is_direct  = (file.get_attribute("is_direct") == "true");
+
+    auto get_channel = [&](const std::string& name)
+    {
+        std::vector<scalar> values = file.get_channel(name);
+
+        if ( values.size() != n_points )
+            throw std::runtime_error("Optimal_laptime: channel \"" + name + "\" shall have n_points values");
+
+        return values;
+    };
+
+    laptime = file.get_channel("laptime").at(0);
+
+    s = get_channel("arclength");
+
+    // Get state
+    q = std::vector<std::array<scalar,Dynamic_model_t::NSTATE>>(n_points);
+    for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
+    {
+        const std::vector<scalar> data_in = get_channel(q_names[i]);
+        for (size_t j = 0; j < n_points; ++j)
+            q[j][i] = data_in[j];
+    }
+
+    // Get algebraic states
+    qa = std::vector<std::array<scalar,Dynamic_model_t::NALGEBRAIC>>(n_points);
+    for (size_t i = 0; i < Dynamic_model_t::NALGEBRAIC; ++i)
+    {
+        const std::vector<scalar> data_in = get_channel(qa_names[i]);
+        for (size_t j = 0; j < n_points; ++j)
+            qa[j][i] = data_in[j];
+    }
+
+    // Get controls
+    u = std::vector<std::array<scalar,Dynamic_model_t::NCONTROL>>(n_points);
+    for (size_t i = 0; i < Dynamic_model_t::NCONTROL; ++i)
+    {
+        const std::vector<scalar> data_in = get_channel(u_names[i]);
+        for (size_t j = 0; j < n_points; ++j)
+            u[j][i] = data_in[j];
+    }
+
+    // Get x
+    x_coord = get_channel("x");
+    y_coord = get_channel("y");
+    psi     = get_channel("psi");
+
+    // Get optimization data
+    optimization_data.zl     = file.get_channel("optimization_data/zl");
+    optimization_data.zu     = file.get_channel("optimization_data/zu");
+    optimization_data.lambda = file.get_channel("optimization_data/lambda");
+}
+
+
 template<typename Dynamic_model_t>
 inline void Optimal_laptime<Dynamic_model_t>::compute(const Dynamic_model_t& car, const std::array<scalar,Dynamic_model_t::NCONTROL>& dissipations)
 {
@@ -447,12 +522,59 @@ inline void Optimal_laptime<Dynamic_model_t>::compute_direct(const Dynamic_model
     // place to return solution
     CppAD::ipopt_cppad_result<std::vector<scalar>> result;
 
-    // solve the problem
-    if ( !warm_start )
+    // solve the problem. The IPOPT solves of all the threads run one at a time
+    if ( options.progress != nullptr )
+    {
+        CppAD::ipopt::solve_result<std::vector<scalar>> progress_result;
+
+        {
+            Ipopt_solver_lock lock;
+
+            if ( !warm_start )
+                ipopt_solve_with_progress(ipoptoptions, x0, x_lb, x_ub, c_lb, c_ub, nullptr, nullptr, nullptr, fg, progress_result, *options.progress);
+            else
+                ipopt_solve_with_progress(ipoptoptions, x0, x_lb, x_ub, c_lb, c_ub, &optimization_data.lambda, &optimization_data.zl, 
+                    &optimization_data.zu, fg, progress_result, *options.progress);
+        }
+
+        // Both results enumerate the same IPOPT statuses, except too_few_degrees_of_freedom
+        using progress_status = CppAD::ipopt::solve_result<std::vector<scalar>>;
+        using result_status   = CppAD::ipopt_cppad_result<std::vector<scalar>>;
+
+        switch (progress_result.status)
+        {
+         case progress_status::not_defined:               result.status = result_status::not_defined;               break;
+         case progress_status::success:                   result.status = result_status::success;                   break;
+         case progress_status::maxiter_exceeded:          result.status = result_status::maxiter_exceeded;          break;
+         case progress_status::stop_at_tiny_step:         result.status = result_status::stop_at_tiny_step;         break;
+         case progress_status::stop_at_acceptable_point:  result.status = result_status::stop_at_acceptable_point;  break;
+         case progress_status::local_infeasibility:       result.status = result_status::local_infeasibility;       break;
+         case progress_status::user_requested_stop:       result.status = result_status::user_requested_stop;       break;
+         case progress_status::feasible_point_found:      result.status = result_status::feasible_point_found;      break;
+         case progress_status::diverging_iterates:        result.status = result_status::diverging_iterates;        break;
+         case progress_status::restoration_failure:       result.status = result_status::restoration_failure;       break;
+         case progress_status::error_in_step_computation: result.status = result_status::error_in_step_computation; break;
+         case progress_status::invalid_number_detected:   result.status = result_status::invalid_number_detected;   break;
+         case progress_status::internal_error:            result.status = result_status::internal_error;            break;
+         default:                                         result.status = result_status::unknown;                   break;
+        }
+
+        result.x      = progress_result.x;
+        result.zl     = progress_result.zl;
+        result.zu     = progress_result.zu;
+        result.lambda = progress_result.lambda;
+    }
+    else if ( !warm_start )
+    {
+        Ipopt_solver_lock lock;
         CppAD::ipopt_cppad_solve<std::vector<scalar>, FG_direct<isClosed>>(ipoptoptions, x0, x_lb, x_ub, c_lb, c_ub, fg, result);
+    }
     else
+    {
+        Ipopt_solver_lock lock;
         CppAD::ipopt_cppad_solve<std::vector<scalar>, FG_direct<isClosed>>(ipoptoptions, x0, x_lb, x_ub, c_lb, c_ub, 
             optimization_data.lambda, optimization_data.zl, optimization_data.zu, fg, result);
+    }
     
 
     success = result.status == CppAD::ipopt_cppad_result<std::vector<scalar>>::success; 
@@ -714,8 +836,15 @@ inline void Optimal_laptime<Dynamic_model_t>::compute_derivative(const Dynamic_m
     // place to return solution
     CppAD::ipopt::solve_result<std::vector<scalar>> result;
 
-    // solve the problem
-    CppAD::ipopt::solve<std::vector<scalar>, FG_derivative<isClosed>>(ipoptoptions, x0, x_lb, x_ub, c_lb, c_ub, fg, result);
+    // solve the problem. The IPOPT solves of all the threads run one at a time
+    {
+        Ipopt_solver_lock lock;
+
+        if ( options.progress != nullptr )
+            ipopt_solve_with_progress(ipoptoptions, x0, x_lb, x_ub, c_lb, c_ub, nullptr, nullptr, nullptr, fg, result, *options.progress);
+        else
+            CppAD::ipopt::solve<std::vector<scalar>, FG_derivative<isClosed>>(ipoptoptions, x0, x_lb, x_ub, c_lb, c_ub, fg, result);
+    }
 
     if ( result.status != CppAD::ipopt::solve_result<std::vector<scalar>>::success )
     {
@@ -924,6 +1053,54 @@ std::unique_ptr<Xml_document> Optimal_laptime<Dynamic_model_t>::xml() const
 }
 
 
+template<typename Dynamic_model_t>
+Columnar_file::Writer Optimal_laptime<Dynamic_model_t>::columnar(const Columnar_file::Compression compression) const 
+{
+    const auto [key_name, q_names, qa_names, u_names] = Dynamic_model_t::get_state_and_control_names();
+
+    Columnar_file::Writer writer(compression);
+
+    writer.add_attribute("format", "optimal_laptime");
+    writer.add_attribute("type", is_closed ? "closed" : "open");
+    writer.add_attribute("n_points", std::to_string(n_points));
+    writer.add_attribute("success", success ? "true" : "false");
+    writer.add_attribute("is_direct", is_direct ? "true" : "false");
+
+    writer.add_channel("laptime", {laptime});
+    writer.add_channel("arclength", s);
+
+    // Save state, algebraic state, and controls
+    auto column = [](const auto& data, const size_t i)
+    {
+        std::vector<scalar> values(data.size());
+        for (size_t j = 0; j < data.size(); ++j)
+            values[j] = data[j][i];
+
+        return values;
+    };
+
+    for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
+        writer.add_channel(q_names[i], column(q,i));
+
+    for (size_t i = 0; i < Dynamic_model_t::NALGEBRAIC; ++i)
+        writer.add_channel(qa_names[i], column(qa,i));
+
+    for (size_t i = 0; i < Dynamic_model_t::NCONTROL; ++i)
+        writer.add_channel(u_names[i], column(u,i));
+
+    writer.add_channel("x", x_coord);
+    writer.add_channel("y", y_coord);
+    writer.add_channel("psi", psi);
+
+    // Save optimization data
+    writer.add_channel("optimization_data/zl", optimization_data.zl);
+    writer.add_channel("optimization_data/zu", optimization_data.zu);
+    writer.add_channel("optimization_data/lambda", optimization_data.lambda);
+
+    return writer;
+}
+
+
 template<typename Dynamic_model_t>
 template<bool isClosed>
 inline void Optimal_laptime<Dynamic_model_t>::FG_direct<isClosed>::operator()(FG_direct<isClosed>::ADvector& fg, const Optimal_laptime<Dynamic_model_t>::FG_direct<isClosed>::ADvector& x)
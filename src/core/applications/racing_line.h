@@ -0,0 +1,59 @@
+#ifndef __RACING_LINE_H__
+#define __RACING_LINE_H__
+
+#include <vector>
+#include "src/core/vehicles/track_by_polynomial.h"
+#include "src/core/applications/minimum_curvature_path.h"
+
+//!     Racing line reference track
+//!     ---------------------------
+//!
+//! Computes the minimum curvature path of a track, and a Track_by_polynomial along it, with its own track limits,
+//! to be used as the curvilinear reference of Optimal_laptime (through Road_curvilinear::change_track). The optimal
+//! trajectory stays close to the minimum curvature path, so that its lateral displacement n and relative heading
+//! alpha are smaller than around the centerline, and the NLP is better conditioned.
+//!
+//! The new track is constructed from a Circuit_preprocessor, kept in the track, so that it can be exported to xml
+//! and used as any other preprocessed circuit. Its track limits are the distances to the original track limits
+//! along the normal of the racing line, assuming that the original track limits are locally parallel to the
+//! centerline.
+//!
+class Racing_line
+{
+ public:
+
+    //! Constructor for a Track_by_polynomial: closed if its preprocessor says so, or if the ends of the centerline coincide
+    //! @param[in] n_elements: number of elements of the racing line
+    Racing_line(const Track_by_polynomial& track, const size_t n_elements, const Minimum_curvature_path::Options& options = {})
+        : Racing_line(track, n_elements, is_closed(track), options) {}
+
+    //! Constructor for any track supported by Minimum_curvature_path
+    //! @param[in] n_elements: number of elements of the racing line
+    //! @param[in] closed: if the track is closed
+    template<typename Track_t>
+    Racing_line(const Track_t& track, const size_t n_elements, const bool closed, const Minimum_curvature_path::Options& options = {});
+
+    //! The reference track along the racing line
+    const Track_by_polynomial& get_track() const { return _track; }
+
+    //! The minimum curvature path, as offsets from the centerline of the original track
+    const Minimum_curvature_path& get_minimum_curvature_path() const { return _path; }
+
+    //! Arclength of the nodes of the racing line along the original track
+    const std::vector<scalar>& get_original_arclength() const { return _path.get_s(); }
+
+    //! If a Track_by_polynomial is closed
+    static bool is_closed(const Track_by_polynomial& track);
+
+ private:
+    Minimum_curvature_path _path;       //! The minimum curvature path
+    Track_by_polynomial _track;         //! The reference track along the racing line
+
+    //! Compute the preprocessed circuit along the minimum curvature path
+    template<typename Track_t>
+    static Circuit_preprocessor compute_preprocessor(const Track_t& track, const Minimum_curvature_path& path);
+};
+
+#include "racing_line.hpp"
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef __RACING_LINE_HPP__
+#define __RACING_LINE_HPP__
+
+#include <cmath>
+#include <type_traits>
+
+template<typename Track_t>
+inline Racing_line::Racing_line(const Track_t& track, const size_t n_elements, const bool closed, const Minimum_curvature_path::Options& options)
+: _path(track, n_elements, closed, options), _track(compute_preprocessor(track, _path))
+{
+    if ( !_path.get_success() )
+        throw std::runtime_error("Racing_line: the minimum curvature path did not converge");
+}
+
+
+inline bool Racing_line::is_closed(const Track_by_polynomial& track)
+{
+    if ( track.has_preprocessor() )
+        return track.get_preprocessor().is_closed;
+
+    return norm(std::get<0>(track(0.0)) - std::get<0>(track(track.get_total_length()))) < 1.0e-6*track.get_total_length();
+}
+
+
+template<typename Track_t>
+inline Circuit_preprocessor Racing_line::compute_preprocessor(const Track_t& track, const Minimum_curvature_path& path)
+{
+    const bool closed = path.is_closed();
+    const std::vector<scalar>& s_original = path.get_s();
+    const std::vector<scalar>& w = path.get_x();
+    const size_t n_points = s_original.size();
+    const size_t n_elements = (closed ? n_points : n_points - 1);
+    const scalar ds = track.get_total_length()/((scalar)n_elements);
+
+    const auto derivatives = Minimum_curvature_path::compute_derivatives(track, s_original, closed);
+
+    Circuit_preprocessor circuit;
+    circuit.is_closed = closed;
+    circuit.n_elements = n_elements;
+    circuit.n_points = n_points;
+
+    circuit.r_centerline.resize(n_points);
+    circuit.r_left.resize(n_points);
+    circuit.r_right.resize(n_points);
+    circuit.s.resize(n_points);
+    circuit.theta.resize(n_points);
+    circuit.kappa.resize(n_points);
+    circuit.nl.resize(n_points);
+    circuit.nr.resize(n_points);
+
+    // Normal to the left of a tangent vector, and rotation 180 around +X to the frame of the preprocessor
+    auto normal = [](const sVector3d& v) { return sVector3d(-v.y(), v.x(), 0.0); };
+    auto flip_y = [](const sVector3d& v) { return sVector3d(v.x(), -v.y(), v.z()); };
+
+    // (1) Position, tangent and curvature of the racing line, with the finite differences of the minimum curvature path
+    std::vector<scalar> speed(n_points);
+
+    for (size_t i = 0; i < n_points; ++i)
+    {
+        const auto stencil = Minimum_curvature_path::get_stencil(i, n_points, closed, ds);
+
+        scalar dw = 0.0;
+        scalar d2w = 0.0;
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            dw += stencil.dw[k]*w[stencil.index[k]];
+            d2w += stencil.d2w[k]*w[stencil.index[k]];
+        }
+
+        const sVector3d r = std::get<0>(track(s_original[i]));
+        const auto& [dr, d2r, d3r] = derivatives[i];
+
+        const sVector3d rc   = r + w[i]*normal(dr);
+        const sVector3d drc  = dr + w[i]*normal(d2r) + dw*normal(dr);
+        const sVector3d d2rc = d2r + w[i]*normal(d3r) + 2.0*dw*normal(d2r) + d2w*normal(dr);
+
+        speed[i] = norm(drc);
+
+        // Track limits along the normal of the racing line. As n, w is positive towards the right track limit
+        const scalar cos_angle = dot(drc,dr)/(speed[i]*norm(dr));
+        const scalar wl = (track.get_left_track_limit(s_original[i]) + w[i])/cos_angle;
+        const scalar wr = (track.get_right_track_limit(s_original[i]) - w[i])/cos_angle;
+
+        const sVector3d n_c = normal(drc)/speed[i];
+        const scalar theta = std::atan2(drc.y(), drc.x());
+        const scalar kappa = (drc.x()*d2rc.y() - drc.y()*d2rc.x())/(speed[i]*speed[i]*speed[i]);
+
+        // Store in the frame of the preprocessor, which Track_by_polynomial flips back
+        circuit.r_centerline[i] = flip_y(rc);
+        circuit.r_left[i]       = flip_y(rc - wl*n_c);
+        circuit.r_right[i]      = flip_y(rc + wr*n_c);
+        circuit.theta[i]        = -theta;
+        circuit.kappa[i]        = -kappa;
+        circuit.nl[i]           = wl;
+        circuit.nr[i]           = wr;
+
+        // Continuous heading
+        if ( i > 0 )
+            circuit.theta[i] += 2.0*pi*std::round((circuit.theta[i-1] - circuit.theta[i])/(2.0*pi));
+    }
+
+    // (2) Arclength of the racing line, with the trapezoidal rule
+    circuit.s[0] = 0.0;
+
+    for (size_t i = 1; i < n_points; ++i)
+        circuit.s[i] = circuit.s[i-1] + 0.5*(speed[i-1] + speed[i])*ds;
+
+    circuit.track_length = circuit.s.back() + (closed ? 0.5*(speed.back() + speed.front())*ds : 0.0);
+
+    // (3) Derivatives with respect to the arclength of the racing line
+    auto derivative = [&](const std::vector<scalar>& f)
+    {
+        std::vector<scalar> result(n_points);
+
+        for (size_t i = 0; i < n_points; ++i)
+        {
+            if ( !closed && i == 0 )
+                result[i] = (f[1] - f[0])/(circuit.s[1] - circuit.s[0]);
+            else if ( !closed && i == n_points-1 )
+                result[i] = (f[i] - f[i-1])/(circuit.s[i] - circuit.s[i-1]);
+            else
+            {
+                const size_t i_prev = (i + n_points - 1) % n_points;
+                const size_t i_next = (i + 1) % n_points;
+                const scalar s_prev = circuit.s[i_prev] - (i == 0 ? circuit.track_length : 0.0);
+                const scalar s_next = circuit.s[i_next] + (i == n_points-1 ? circuit.track_length : 0.0);
+
+                result[i] = (f[i_next] - f[i_prev])/(s_next - s_prev);
+            }
+        }
+
+        return result;
+    };
+
+    circuit.dkappa = derivative(circuit.kappa);
+    circuit.dnl = derivative(circuit.nl);
+    circuit.dnr = derivative(circuit.nr);
+
+    // (4) Reference and measured data of the original circuit
+    if constexpr (std::is_same_v<Track_t,Track_by_polynomial>)
+    {
+        if ( track.has_preprocessor() )
+        {
+            const auto& original = track.get_preprocessor();
+
+            circuit.options                  = original.options;
+            circuit.direction                = original.direction;
+            circuit.x0                       = original.x0;
+            circuit.y0                       = original.y0;
+            circuit.phi0                     = original.phi0;
+            circuit.theta0                   = original.theta0;
+            circuit.phi_ref                  = original.phi_ref;
+            circuit.R_earth                  = original.R_earth;
+            circuit.r_left_measured          = original.r_left_measured;
+            circuit.r_right_measured         = original.r_right_measured;
+            circuit.left_boundary_max_error  = original.left_boundary_max_error;
+            circuit.right_boundary_max_error = original.right_boundary_max_error;
+            circuit.left_boundary_L2_error   = original.left_boundary_L2_error;
+            circuit.right_boundary_L2_error  = original.right_boundary_L2_error;
+
+            return circuit;
+        }
+    }
+
+    circuit.phi0 = 0.0;
+    circuit.theta0 = 0.0;
+    circuit.phi_ref = 0.0;
+    circuit.r_left_measured = circuit.r_left;
+    circuit.r_right_measured = circuit.r_right;
+    circuit.left_boundary_max_error = 0.0;
+    circuit.right_boundary_max_error = 0.0;
+    circuit.left_boundary_L2_error = 0.0;
+    circuit.right_boundary_L2_error = 0.0;
+
+    return circuit;
+}
+
+#endif
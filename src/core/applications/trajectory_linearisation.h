@@ -0,0 +1,128 @@
+#ifndef __TRAJECTORY_LINEARISATION_H__
+#define __TRAJECTORY_LINEARISATION_H__
+
+#include "lion/foundation/types.h"
+#include "lion/thirdparty/include/cppad/cppad.hpp"
+#include "src/core/foundation/thread_pool.h"
+#include "src/core/applications/optimal_laptime.h"
+
+//!     Linearisation of the vehicle equations along a trajectory
+//!     ---------------------------------------------------------
+//!
+//! Computes the equations and their Jacobians at all the points of a trajectory (e.g. an Optimal_laptime
+//! solution), to be used for MPC or stability analysis.
+//!
+//! The equations are recorded once. For curvilinear roads the track geometry is recorded as CppAD dynamic
+//! parameters, so that the same tape is valid at every arclength. The points are computed in parallel using
+//! the sparsity pattern of the Jacobian. Points where a comparison changes its result w.r.t. the recorded
+//! tape, and vehicles with variable parameters, are computed through Dynamic_model_car::equations
+//!
+//! The inputs are sorted as x = [q, qa, u] (NINPUTS), and the outputs as y = [dqdt, dqa] (NOUTPUTS).
+//! The Jacobians are stored as contiguous row-major blocks [NOUTPUTS x NINPUTS], one per point
+//!
+template<typename Dynamic_model_t>
+class Trajectory_linearisation
+{
+ public:
+    using Timeseries_t = typename Dynamic_model_t::Timeseries_type;
+
+    //! This class will only support vehicles with automatic differentiation
+    static_assert(std::is_same<Timeseries_t,CppAD::AD<scalar>>::value == true);
+
+    constexpr static size_t NSTATE     = Dynamic_model_t::NSTATE;
+    constexpr static size_t NALGEBRAIC = Dynamic_model_t::NALGEBRAIC;
+    constexpr static size_t NCONTROL   = Dynamic_model_t::NCONTROL;
+    constexpr static size_t NINPUTS    = Dynamic_model_t::NINPUTS;
+    constexpr static size_t NOUTPUTS   = Dynamic_model_t::NOUTPUTS;
+
+    //! Number of track geometry parameters recorded as dynamic parameters
+    constexpr static size_t NGEOMETRY  = Dynamic_model_t::Road_type::NGEOMETRY;
+
+    //! Constructor from a trajectory
+    //! @param[in] car: vehicle
+    //! @param[in] s: vector of arclengths (or times, for cartesian roads)
+    //! @param[in] q: vector of states
+    //! @param[in] qa: vector of algebraic states
+    //! @param[in] u: vector of controls
+    Trajectory_linearisation(const Dynamic_model_t& car,
+                             const std::vector<scalar>& s,
+                             const std::vector<std::array<scalar,NSTATE>>& q,
+                             const std::vector<std::array<scalar,NALGEBRAIC>>& qa,
+                             const std::vector<std::array<scalar,NCONTROL>>& u);
+
+    //! Constructor from an optimal laptime solution
+    //! @param[in] car: vehicle
+    //! @param[in] opt_laptime: the optimal laptime solution
+    Trajectory_linearisation(const Dynamic_model_t& car, const Optimal_laptime<Dynamic_model_t>& opt_laptime)
+        : Trajectory_linearisation(car, opt_laptime.s, opt_laptime.q, opt_laptime.qa, opt_laptime.u) {}
+
+    //! Number of points
+    size_t size() const { return _s.size(); }
+
+    //! Arclengths
+    const std::vector<scalar>& get_arclength() const { return _s; }
+
+    //! Time derivative of the states at the i-th point [NSTATE]
+    const scalar* get_dqdt(const size_t i) const { return _dqdt.data() + i*NSTATE; }
+
+    //! Algebraic equations at the i-th point [NALGEBRAIC]
+    const scalar* get_dqa(const size_t i) const { return _dqa.data() + i*NALGEBRAIC; }
+
+    //! Jacobian at the i-th point, row-major [NOUTPUTS x NINPUTS]
+    const scalar* get_jacobian(const size_t i) const { return _jacobians.data() + i*NOUTPUTS*NINPUTS; }
+
+    //! All the Jacobians, as contiguous blocks [size() x NOUTPUTS x NINPUTS]
+    const std::vector<scalar>& get_jacobians() const { return _jacobians; }
+
+    //! Derivative of the output row w.r.t. the input col at the i-th point
+    scalar jacobian(const size_t i, const size_t row, const size_t col) const { return get_jacobian(i)[row*NINPUTS + col]; }
+
+    //! A matrix: d(dqdt)/dq [NSTATE x NSTATE]
+    scalar get_A(const size_t i, const size_t row, const size_t col) const { return jacobian(i, row, col); }
+
+    //! B matrix: d(dqdt)/du [NSTATE x NCONTROL]
+    scalar get_B(const size_t i, const size_t row, const size_t col) const { return jacobian(i, row, NSTATE + NALGEBRAIC + col); }
+
+    //! C matrix: d(dqdt)/dqa [NSTATE x NALGEBRAIC]
+    scalar get_C(const size_t i, const size_t row, const size_t col) const { return jacobian(i, row, NSTATE + col); }
+
+    //! Rows of the sparsity pattern of the Jacobian, common to all the points computed from the tape
+    const std::vector<size_t>& get_sparsity_rows() const { return _jac_pattern.row(); }
+
+    //! Columns of the sparsity pattern of the Jacobian, common to all the points computed from the tape
+    const std::vector<size_t>& get_sparsity_cols() const { return _jac_pattern.col(); }
+
+    //! Number of points that were not computed from the common tape
+    size_t get_number_of_fallback_points() const { return _n_fallback_points; }
+
+ private:
+
+    using sparse_pattern = CppAD::sparse_rc<std::vector<size_t>>;
+    using sparse_matrix  = CppAD::sparse_rcv<std::vector<size_t>,std::vector<scalar>>;
+
+    //! Record the equations at the first point, with the track geometry as dynamic parameters
+    void record_tape();
+
+    //! Compute all the points
+    void compute();
+
+    Dynamic_model_t _car;                   //! Vehicle
+
+    std::vector<scalar> _s;                 //! [in] Arclengths
+    std::vector<scalar> _x;                 //! [in] Inputs [q, qa, u] of all the points [size() x NINPUTS]
+    std::vector<scalar> _geometry;          //! [in] Track geometry of all the points [size() x NGEOMETRY]
+
+    std::vector<scalar> _dqdt;              //! [out] Time derivatives [size() x NSTATE]
+    std::vector<scalar> _dqa;               //! [out] Algebraic equations [size() x NALGEBRAIC]
+    std::vector<scalar> _jacobians;         //! [out] Jacobians [size() x NOUTPUTS x NINPUTS]
+
+    bool _use_tape;                         //! If the common tape is used
+    CppAD::ADFun<scalar> _f;                //! The common tape, y = f(x;geometry)
+    sparse_pattern _jac_pattern;            //! Sparsity pattern of the Jacobian
+
+    size_t _n_fallback_points = 0;          //! Number of points computed through Dynamic_model_car::equations
+};
+
+#include "trajectory_linearisation.hpp"
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __TRAJECTORY_LINEARISATION_HPP__
+#define __TRAJECTORY_LINEARISATION_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+template<typename Dynamic_model_t>
+inline Trajectory_linearisation<Dynamic_model_t>::Trajectory_linearisation(const Dynamic_model_t& car,
+    const std::vector<scalar>& s, const std::vector<std::array<scalar,NSTATE>>& q,
+    const std::vector<std::array<scalar,NALGEBRAIC>>& qa, const std::vector<std::array<scalar,NCONTROL>>& u)
+: _car(car), _s(s), _x(s.size()*NINPUTS), _geometry(s.size()*NGEOMETRY), _dqdt(s.size()*NSTATE),
+  _dqa(s.size()*NALGEBRAIC), _jacobians(s.size()*NOUTPUTS*NINPUTS, 0.0), _use_tape(!car.has_variable_parameters())
+{
+    if ( q.size() != s.size() || qa.size() != s.size() || u.size() != s.size() )
+        throw std::runtime_error("Trajectory_linearisation: s, q, qa, and u shall have the same size");
+
+    if ( s.size() == 0 )
+        return;
+
+    // (1) Put the inputs and the track geometry of all the points into flat vectors
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        std::copy(q[i].cbegin(), q[i].cend(), _x.begin() + i*NINPUTS);
+        std::copy(qa[i].cbegin(), qa[i].cend(), _x.begin() + i*NINPUTS + NSTATE);
+        std::copy(u[i].cbegin(), u[i].cend(), _x.begin() + i*NINPUTS + NSTATE + NALGEBRAIC);
+
+        if constexpr (NGEOMETRY > 0)
+        {
+            const auto geometry = _car.get_road().get_geometry(s[i]);
+            std::copy(geometry.cbegin(), geometry.cend(), _geometry.begin() + i*NGEOMETRY);
+        }
+    }
+
+    // (2) Set up the thread pool before any recording, since it configures CppAD for multithreading
+    Thread_pool::get();
+
+    // (3) Record the common tape, and compute
+    if ( _use_tape )
+        record_tape();
+
+    compute();
+}
+
+
+template<typename Dynamic_model_t>
+inline void Trajectory_linearisation<Dynamic_model_t>::record_tape()
+{
+    // (1) Declare the inputs of the first point as independent variables, and its geometry as dynamic parameters
+    std::vector<CppAD::AD<scalar>> x_ad(_x.cbegin(), _x.cbegin() + NINPUTS);
+    std::vector<CppAD::AD<scalar>> geometry_ad(_geometry.cbegin(), _geometry.cbegin() + NGEOMETRY);
+
+    if constexpr (NGEOMETRY > 0)
+        CppAD::Independent(x_ad, 0, true, geometry_ad);
+    else
+        CppAD::Independent(x_ad);
+
+    // (2) Call the vehicle with the geometry overriden by the dynamic parameters
+    std::array<CppAD::AD<scalar>,NSTATE>     q;
+    std::array<CppAD::AD<scalar>,NALGEBRAIC> qa;
+    std::array<CppAD::AD<scalar>,NCONTROL>   u;
+
+    std::copy_n(x_ad.cbegin(), NSTATE, q.begin());
+    std::copy_n(x_ad.cbegin() + NSTATE, NALGEBRAIC, qa.begin());
+    std::copy_n(x_ad.cbegin() + NSTATE + NALGEBRAIC, NCONTROL, u.begin());
+
+    if constexpr (NGEOMETRY > 0)
+    {
+        std::array<CppAD::AD<scalar>,NGEOMETRY> geometry;
+        std::copy(geometry_ad.cbegin(), geometry_ad.cend(), geometry.begin());
+        _car.get_road().set_geometry_override(geometry);
+    }
+
+    auto [dqdt,dqa] = _car(q,qa,u,_s.front());
+
+    if constexpr (NGEOMETRY > 0)
+        _car.get_road().clear_geometry_override();
+
+    std::vector<CppAD::AD<scalar>> y(dqdt.cbegin(), dqdt.cend());
+    y.insert(y.end(), dqa.cbegin(), dqa.cend());
+
+    // (3) Stop the recording and optimize the tape
+    _f.Dependent(x_ad, y);
+    _f.optimize();
+
+    // (4) Compute the sparsity pattern of the Jacobian
+    sparse_pattern identity(NINPUTS, NINPUTS, NINPUTS);
+
+    for (size_t k = 0; k < NINPUTS; ++k)
+        identity.set(k, k, k);
+
+    _f.for_jac_sparsity(identity, false, false, false, _jac_pattern);
+}
+
+
+template<typename Dynamic_model_t>
+inline void Trajectory_linearisation<Dynamic_model_t>::compute()
+{
+    std::atomic<size_t> n_fallback_points = 0;
+
+    Thread_pool::get().parallel_for_chunks(size(), [&](const size_t begin, const size_t end)
+    {
+        // (1) Each chunk works with its own copy of the tape, and of the vehicle if needed
+        CppAD::ADFun<scalar> f;
+        sparse_matrix jac_subset;
+        CppAD::sparse_jac_work jac_work;
+        std::unique_ptr<Dynamic_model_t> car;
+
+        if ( _use_tape )
+        {
+            f = _f;
+            jac_subset = sparse_matrix(_jac_pattern);
+        }
+
+        std::vector<scalar> x(NINPUTS);
+        std::vector<scalar> geometry(NGEOMETRY);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            scalar* dqdt     = _dqdt.data() + i*NSTATE;
+            scalar* dqa      = _dqa.data() + i*NALGEBRAIC;
+            scalar* jacobian = _jacobians.data() + i*NOUTPUTS*NINPUTS;
+
+            std::copy_n(_x.cbegin() + i*NINPUTS, NINPUTS, x.begin());
+
+            // (2) Evaluate the common tape. It is only valid if no comparison changed its result
+            if ( _use_tape )
+            {
+                if constexpr (NGEOMETRY > 0)
+                {
+                    std::copy_n(_geometry.cbegin() + i*NGEOMETRY, NGEOMETRY, geometry.begin());
+                    f.new_dynamic(geometry);
+                }
+
+                const auto y = f.Forward(0, x);
+
+                if ( f.compare_change_number() == 0 )
+                {
+                    std::copy_n(y.cbegin(), NSTATE, dqdt);
+                    std::copy_n(y.cbegin() + NSTATE, NALGEBRAIC, dqa);
+
+                    f.sparse_jac_for(1, x, jac_subset, _jac_pattern, "cppad", jac_work);
+
+                    const auto& row = jac_subset.row();
+                    const auto& col = jac_subset.col();
+                    const auto& val = jac_subset.val();
+
+                    for (size_t k = 0; k < jac_subset.nnz(); ++k)
+                        jacobian[row[k]*NINPUTS + col[k]] = val[k];
+
+                    continue;
+                }
+            }
+
+            // (3) Fallback: compute the point through the vehicle, which records the equations at this point
+            if ( !car )
+                car = std::make_unique<Dynamic_model_t>(_car);
+
+            std::array<scalar,NSTATE>     q;
+            std::array<scalar,NALGEBRAIC> qa;
+            std::array<scalar,NCONTROL>   u;
+
+            std::copy_n(x.cbegin(), NSTATE, q.begin());
+            std::copy_n(x.cbegin() + NSTATE, NALGEBRAIC, qa.begin());
+            std::copy_n(x.cbegin() + NSTATE + NALGEBRAIC, NCONTROL, u.begin());
+
+            std::fill_n(jacobian, NOUTPUTS*NINPUTS, 0.0);
+            car->equations(dqdt, dqa, jacobian, (NALGEBRAIC > 0 ? jacobian + NSTATE*NINPUTS : nullptr), nullptr, nullptr, q, qa, u, _s[i]);
+
+            ++n_fallback_points;
+        }
+    });
+
+    _n_fallback_points = n_fallback_points;
+}
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef __VEHICLE_CHANNELS_H__
+#define __VEHICLE_CHANNELS_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "lion/foundation/types.h"
+#include "src/core/foundation/thread_pool.h"
+
+namespace vehicle_channels_detail
+{
+    //! If the chassis has a throttle control (limebeer2014f1)
+    template<typename Chassis_t, typename = void>
+    struct has_throttle : std::false_type {};
+
+    template<typename Chassis_t>
+    struct has_throttle<Chassis_t, std::void_t<decltype(Chassis_t::ITHROTTLE)>> : std::true_type {};
+
+    //! If the chassis has the tire normal forces as algebraic variables (limebeer2014f1)
+    template<typename Chassis_t, typename = void>
+    struct has_tire_loads : std::false_type {};
+
+    template<typename Chassis_t>
+    struct has_tire_loads<Chassis_t, std::void_t<decltype(Chassis_t::IFZFL)>> : std::true_type {};
+}
+
+//!     Output channels of a vehicle
+//!     ----------------------------
+//!
+//! Registry of the channels that can be extracted from a curvilinear vehicle (e.g. "u", "x", "Fz_fl",
+//! "front_axle.left_tire.kappa"). The channel names are resolved once to getters, so that a single
+//! evaluation of the vehicle per point fills all the requested channels
+//!
+template<typename Dynamic_model_t>
+class Vehicle_channels
+{
+ public:
+    //! This class will only support scalar vehicles
+    static_assert(std::is_same<typename Dynamic_model_t::Timeseries_type,scalar>::value == true);
+
+    using Road_type    = typename Dynamic_model_t::Road_type;
+    using Chassis_type = typename Dynamic_model_t::Chassis_type;
+
+    constexpr static size_t NSTATE     = Dynamic_model_t::NSTATE;
+    constexpr static size_t NALGEBRAIC = Dynamic_model_t::NALGEBRAIC;
+    constexpr static size_t NCONTROL   = Dynamic_model_t::NCONTROL;
+
+    //! Reads a channel from a vehicle already evaluated at (q,qa,u,s)
+    using Getter = scalar(*)(const Dynamic_model_t& car, const std::array<scalar,NSTATE>& q, const std::array<scalar,NALGEBRAIC>& qa,
+                             const std::array<scalar,NCONTROL>& u, const scalar s);
+
+    //! All the channels defined for this vehicle
+    static const std::map<std::string,Getter>& get_registry() { static const auto registry = construct_registry(); return registry; }
+
+    //! Constructor
+    //! @param[in] names: the requested channels. Throws if one of them is not defined
+    Vehicle_channels(const std::vector<std::string>& names);
+
+    //! Number of requested channels
+    size_t size() const { return _names.size(); }
+
+    //! Names of the requested channels
+    const std::vector<std::string>& get_names() const { return _names; }
+
+    //! Evaluate the vehicle at one point, and compute all the requested channels
+    //! @param[in] car: the vehicle, which is evaluated at (q,qa,u,s)
+    //! @param[out] values: the channels [size()]
+    void evaluate(Dynamic_model_t& car, const std::array<scalar,NSTATE>& q, const std::array<scalar,NALGEBRAIC>& qa,
+                  const std::array<scalar,NCONTROL>& u, const scalar s, scalar* values) const;
+
+    //! Compute the requested channels along a trajectory, with one evaluation of the vehicle per point.
+    //! The points are computed in parallel, each chunk with its own copy of the vehicle
+    //! @return one contiguous column per channel [size()][s.size()]
+    std::vector<std::vector<scalar>> compute(const Dynamic_model_t& car, const std::vector<scalar>& s,
+                                             const std::vector<std::array<scalar,NSTATE>>& q,
+                                             const std::vector<std::array<scalar,NALGEBRAIC>>& qa,
+                                             const std::vector<std::array<scalar,NCONTROL>>& u) const;
+
+ private:
+
+    std::vector<std::string> _names;    //! Requested channels
+    std::vector<Getter> _getters;       //! Getters of the requested channels
+
+    //! Construct the registry of channels
+    static std::map<std::string,Getter> construct_registry();
+
+    //! Get a tire: AXLE is 0 for the front axle, 1 for the rear axle. TIRE is 0 for the left tire, 1 for the right tire
+    template<size_t AXLE, size_t TIRE>
+    static const auto& get_tire(const Dynamic_model_t& car)
+    {
+        if constexpr (AXLE == 0)
+            return car.get_chassis().get_front_axle().template get_tire<TIRE>();
+        else
+            return car.get_chassis().get_rear_axle().template get_tire<TIRE>();
+    }
+
+    //! Add the channels of a tire, named as <prefix>.<channel>
+    template<size_t AXLE, size_t TIRE>
+    static void add_tire_channels(std::map<std::string,Getter>& registry, const std::string& prefix);
+};
+
+
+template<typename Dynamic_model_t>
+inline Vehicle_channels<Dynamic_model_t>::Vehicle_channels(const std::vector<std::string>& names)
+: _names(names)
+{
+    const auto& registry = get_registry();
+
+    for (const auto& name : _names)
+    {
+        const auto it = registry.find(name);
+
+        if ( it == registry.cend() )
+            throw std::runtime_error("Variable \"" + name + "\" is not defined for this vehicle");
+
+        _getters.push_back(it->second);
+    }
+}
+
+
+template<typename Dynamic_model_t>
+inline void Vehicle_channels<Dynamic_model_t>::evaluate(Dynamic_model_t& car, const std::array<scalar,NSTATE>& q,
+    const std::array<scalar,NALGEBRAIC>& qa, const std::array<scalar,NCONTROL>& u, const scalar s, scalar* values) const
+{
+    car(q, qa, u, s);
+
+    for (size_t j = 0; j < _getters.size(); ++j)
+        values[j] = _getters[j](car, q, qa, u, s);
+}
+
+
+template<typename Dynamic_model_t>
+inline std::vector<std::vector<scalar>> Vehicle_channels<Dynamic_model_t>::compute(const Dynamic_model_t& car, const std::vector<scalar>& s,
+    const std::vector<std::array<scalar,NSTATE>>& q, const std::vector<std::array<scalar,NALGEBRAIC>>& qa,
+    const std::vector<std::array<scalar,NCONTROL>>& u) const
+{
+    if ( q.size() != s.size() || qa.size() != s.size() || u.size() != s.size() )
+        throw std::runtime_error("Vehicle_channels: s, q, qa, and u shall have the same size");
+
+    std::vector<std::vector<scalar>> columns(size(), std::vector<scalar>(s.size()));
+
+    Thread_pool::get().parallel_for_chunks(s.size(), [&](const size_t begin, const size_t end)
+    {
+        Dynamic_model_t car_chunk(car);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            car_chunk(q[i], qa[i], u[i], s[i]);
+
+            for (size_t j = 0; j < _getters.size(); ++j)
+                columns[j][i] = _getters[j](car_chunk, q[i], qa[i], u[i], s[i]);
+        }
+    });
+
+    return columns;
+}
+
+
+template<typename Dynamic_model_t>
+template<size_t AXLE, size_t TIRE>
+inline void Vehicle_channels<Dynamic_model_t>::add_tire_channels(std::map<std::string,Getter>& registry, const std::string& prefix)
+{
+    registry[prefix + ".x"]      = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar)
+        { return get_tire<AXLE,TIRE>(car).get_position().at(0); };
+
+    registry[prefix + ".y"]      = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar)
+        { return get_tire<AXLE,TIRE>(car).get_position().at(1); };
+
+    registry[prefix + ".kappa"]  = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar)
+        { return get_tire<AXLE,TIRE>(car).get_kappa(); };
+
+    registry[prefix + ".lambda"] = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar)
+        { return get_tire<AXLE,TIRE>(car).get_lambda(); };
+
+    registry[prefix + ".Fx"]     = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar)
+        { return get_tire<AXLE,TIRE>(car).get_force().at(0); };
+
+    registry[prefix + ".Fy"]     = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar)
+        { return get_tire<AXLE,TIRE>(car).get_force().at(1); };
+
+    registry[prefix + ".Fz"]     = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar)
+        { return get_tire<AXLE,TIRE>(car).get_force().at(2); };
+}
+
+
+template<typename Dynamic_model_t>
+inline std::map<std::string,typename Vehicle_channels<Dynamic_model_t>::Getter> Vehicle_channels<Dynamic_model_t>::construct_registry()
+{
+    std::map<std::string,Getter> registry;
+
+    // (1) Road
+    registry["x"]     = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar) { return car.get_road().get_x(); };
+    registry["y"]     = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar) { return car.get_road().get_y(); };
+    registry["psi"]   = [](const Dynamic_model_t& car, const auto&, const auto&, const auto&, const scalar) { return car.get_road().get_psi(); };
+    registry["s"]     = [](const Dynamic_model_t&, const auto&, const auto&, const auto&, const scalar s) { return s; };
+    registry["n"]     = [](const Dynamic_model_t&, const auto& q, const auto&, const auto&, const scalar) { return q[Road_type::IN]; };
+    registry["alpha"] = [](const Dynamic_model_t&, const auto& q, const auto&, const auto&, const scalar) { return q[Road_type::IALPHA]; };
+    registry["time"]  = [](const Dynamic_model_t&, const auto& q, const auto&, const auto&, const scalar) { return q[Road_type::ITIME]; };
+
+    // (2) Chassis
+    registry["u"]     = [](const Dynamic_model_t&, const auto& q, const auto&, const auto&, const scalar) { return q[Chassis_type::IU]; };
+    registry["v"]     = [](const Dynamic_model_t&, const auto& q, const auto&, const auto&, const scalar) { return q[Chassis_type::IV]; };
+    registry["omega"] = [](const Dynamic_model_t&, const auto& q, const auto&, const auto&, const scalar) { return q[Chassis_type::IOMEGA]; };
+    registry["delta"] = [](const Dynamic_model_t&, const auto&, const auto&, const auto& u, const scalar)
+        { return u[Chassis_type::Front_axle_type::ISTEERING]; };
+
+    if constexpr (vehicle_channels_detail::has_throttle<Chassis_type>::value)
+        registry["throttle"] = [](const Dynamic_model_t&, const auto&, const auto&, const auto& u, const scalar) { return u[Chassis_type::ITHROTTLE]; };
+    else
+        registry["throttle"] = [](const Dynamic_model_t&, const auto&, const auto&, const auto& u, const scalar)
+            { return u[Chassis_type::Rear_axle_type::ITORQUE]; };
+
+    if constexpr (vehicle_channels_detail::has_tire_loads<Chassis_type>::value)
+    {
+        registry["Fz_fl"] = [](const Dynamic_model_t&, const auto&, const auto& qa, const auto&, const scalar) { return qa[Chassis_type::IFZFL]; };
+        registry["Fz_fr"] = [](const Dynamic_model_t&, const auto&, const auto& qa, const auto&, const scalar) { return qa[Chassis_type::IFZFR]; };
+        registry["Fz_rl"] = [](const Dynamic_model_t&, const auto&, const auto& qa, const auto&, const scalar) { return qa[Chassis_type::IFZRL]; };
+        registry["Fz_rr"] = [](const Dynamic_model_t&, const auto&, const auto& qa, const auto&, const scalar) { return qa[Chassis_type::IFZRR]; };
+    }
+
+    // (3) Tires
+    add_tire_channels<0,0>(registry, "front_axle.left_tire");
+    add_tire_channels<0,1>(registry, "front_axle.right_tire");
+    add_tire_channels<1,0>(registry, "rear_axle.left_tire");
+    add_tire_channels<1,1>(registry, "rear_axle.right_tire");
+
+    return registry;
+}
+
+#endif
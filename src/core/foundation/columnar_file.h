@@ -0,0 +1,560 @@
+#ifndef __COLUMNAR_FILE_H__
+#define __COLUMNAR_FILE_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <stdexcept>
+#include <filesystem>
+#include <unordered_map>
+#include "lion/foundation/types.h"
+#include "src/core/foundation/mapped_file.h"
+
+//!     Binary columnar file
+//!     --------------------
+//!
+//! Stores named channels of scalars, and string attributes, in a binary file. Reading maps the file, parses the
+//! directory, and only decodes the channels requested.
+//!
+//! Binary format (native endianness, checked on load):
+//!     header: "FLCOLS" magic [8], format version [u32], endianness mark [u32], directory size [u64], directory hash [u64], file size [u64]
+//!     directory: number of attributes [u64], each as name and value
+//!                number of channels [u64], each as name, compression [u32], number of values [u64], offset [u64], size [u64], hash [u64]
+//!     data: the channels, aligned to 8 bytes
+//!
+//! Strings are written as their size [u64] followed by their characters. Hashes are 64-bit FNV-1a, and the hash
+//! of a channel is checked when it is read.
+//!
+//! Compression XOR_RLE: each value is XOR-ed with the previous one, the bytes of the result are transposed into 8
+//! planes, and the planes are run-length encoded. Smooth channels share sign, exponent, and leading mantissa bits
+//! with their neighbours, and constant channels (e.g. inactive bound multipliers) reduce to a few bytes.
+//!
+class Columnar_file
+{
+ public:
+    //! Version of the binary format
+    constexpr static uint32_t FORMAT_VERSION = 1;
+
+    enum Compression : uint32_t { NONE = 0, XOR_RLE = 1 };
+
+    //!     Writer of a columnar file
+    //!     -------------------------
+    class Writer
+    {
+     public:
+        //! Constructor
+        //! @param[in] compression: compression of all the channels
+        explicit Writer(const Compression compression = NONE) : _compression(compression) {}
+
+        //! Add a string attribute. Throws if it already exists
+        Writer& add_attribute(const std::string& name, const std::string& value);
+
+        //! Add a channel. Throws if it already exists
+        Writer& add_channel(const std::string& name, std::vector<scalar> values);
+
+        //! Write the file in memory
+        std::vector<char> serialize() const;
+
+        //! Write the file to a temporary file, and rename it. Throws if it cannot be written
+        void save(const std::string& filename) const;
+
+     private:
+        Compression _compression;
+        std::vector<std::pair<std::string,std::string>> _attributes;
+        std::vector<std::pair<std::string,std::vector<scalar>>> _channels;
+    };
+
+    //! Constructor: map a file. Throws if it cannot be opened, or is not a valid columnar file
+    explicit Columnar_file(const std::string& filename);
+
+    //! Constructor: from a file in memory. Throws if it is not a valid columnar file
+    explicit Columnar_file(std::vector<char> data);
+
+    //! Names of the channels, in the order they were written
+    const std::vector<std::string>& get_channel_names() const { return _channel_names; }
+
+    bool has_channel(const std::string& name) const { return _channels.count(name) != 0; }
+
+    //! Number of values of a channel
+    size_t get_channel_size(const std::string& name) const { return get_channel_entry(name).n_values; }
+
+    //! Decode a channel. Throws if it does not exist, or its data is corrupted
+    std::vector<scalar> get_channel(const std::string& name) const;
+
+    bool has_attribute(const std::string& name) const { return _attributes.count(name) != 0; }
+
+    //! Get an attribute. Throws if it does not exist
+    const std::string& get_attribute(const std::string& name) const;
+
+    //! 64-bit FNV-1a hash
+    static uint64_t hash(const char* data, const size_t size);
+
+    //! Encode values with XOR_RLE
+    static std::vector<char> compress(const std::vector<scalar>& values);
+
+    //! Decode n_values with XOR_RLE. Throws if the data is corrupted
+    static std::vector<scalar> decompress(const char* data, const size_t size, const size_t n_values);
+
+ private:
+    struct Channel
+    {
+        Compression compression;
+        uint64_t n_values;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t hash;
+    };
+
+    std::unique_ptr<Mapped_file> _file;     //! The mapped file, if read from a file
+    std::vector<char> _buffer;              //! The file, if read from memory
+    const char* _data = nullptr;
+    size_t _size = 0;
+
+    std::vector<std::string> _channel_names;
+    std::unordered_map<std::string,Channel> _channels;
+    std::unordered_map<std::string,std::string> _attributes;
+
+    constexpr static size_t HEADER_SIZE = 40;
+    constexpr static uint32_t ENDIANNESS_MARK = 0x01020304;
+    constexpr static char MAGIC[8] = {'F','L','C','O','L','S','\0','\0'};
+
+    //! Parse the header and the directory
+    void read_directory();
+
+    const Channel& get_channel_entry(const std::string& name) const;
+};
+
+
+inline Columnar_file::Writer& Columnar_file::Writer::add_attribute(const std::string& name, const std::string& value)
+{
+    for (const auto& attribute : _attributes)
+        if ( attribute.first == name )
+            throw std::runtime_error("Columnar_file: attribute \"" + name + "\" already exists");
+
+    _attributes.emplace_back(name, value);
+    return *this;
+}
+
+
+inline Columnar_file::Writer& Columnar_file::Writer::add_channel(const std::string& name, std::vector<scalar> values)
+{
+    for (const auto& channel : _channels)
+        if ( channel.first == name )
+            throw std::runtime_error("Columnar_file: channel \"" + name + "\" already exists");
+
+    _channels.emplace_back(name, std::move(values));
+    return *this;
+}
+
+
+inline std::vector<char> Columnar_file::Writer::serialize() const
+{
+    auto write = [](std::vector<char>& data, const auto value)
+    {
+        const size_t position = data.size();
+        data.resize(position + sizeof(value));
+        std::memcpy(data.data() + position, &value, sizeof(value));
+    };
+
+    auto write_string = [&](std::vector<char>& data, const std::string& value)
+    {
+        write(data, static_cast<uint64_t>(value.size()));
+        data.insert(data.end(), value.cbegin(), value.cend());
+    };
+
+    // (1) Encode the channels
+    std::vector<std::vector<char>> encoded(_channels.size());
+
+    for (size_t i = 0; i < _channels.size(); ++i)
+    {
+        const auto& values = _channels[i].second;
+
+        if ( _compression == XOR_RLE )
+            encoded[i] = compress(values);
+        else
+        {
+            encoded[i].resize(values.size()*sizeof(double));
+            std::memcpy(encoded[i].data(), values.data(), encoded[i].size());
+        }
+    }
+
+    // (2) Size of the directory, to compute the offsets of the channels
+    size_t directory_size = sizeof(uint64_t);
+
+    for (const auto& [name, value] : _attributes)
+        directory_size += 2*sizeof(uint64_t) + name.size() + value.size();
+
+    directory_size += sizeof(uint64_t);
+
+    for (const auto& channel : _channels)
+        directory_size += sizeof(uint64_t) + channel.first.size() + sizeof(uint32_t) + 4*sizeof(uint64_t);
+
+    auto align = [](const size_t position) { return (position + 7) & ~static_cast<size_t>(7); };
+
+    // (3) Directory
+    std::vector<char> directory;
+    directory.reserve(directory_size);
+
+    write(directory, static_cast<uint64_t>(_attributes.size()));
+
+    for (const auto& [name, value] : _attributes)
+    {
+        write_string(directory, name);
+        write_string(directory, value);
+    }
+
+    write(directory, static_cast<uint64_t>(_channels.size()));
+
+    size_t offset = align(HEADER_SIZE + directory_size);
+
+    for (size_t i = 0; i < _channels.size(); ++i)
+    {
+        write_string(directory, _channels[i].first);
+        write(directory, static_cast<uint32_t>(_compression));
+        write(directory, static_cast<uint64_t>(_channels[i].second.size()));
+        write(directory, static_cast<uint64_t>(offset));
+        write(directory, static_cast<uint64_t>(encoded[i].size()));
+        write(directory, hash(encoded[i].data(), encoded[i].size()));
+
+        offset = align(offset + encoded[i].size());
+    }
+
+    // (4) Header, directory, and data
+    std::vector<char> data;
+    data.reserve(offset);
+    data.insert(data.end(), MAGIC, MAGIC + 8);
+    write(data, FORMAT_VERSION);
+    write(data, ENDIANNESS_MARK);
+    write(data, static_cast<uint64_t>(directory.size()));
+    write(data, hash(directory.data(), directory.size()));
+    write(data, static_cast<uint64_t>(offset));
+    data.insert(data.end(), directory.cbegin(), directory.cend());
+
+    for (const auto& channel_data : encoded)
+    {
+        data.resize(align(data.size()), 0);
+        data.insert(data.end(), channel_data.cbegin(), channel_data.cend());
+    }
+
+    data.resize(offset, 0);
+
+    return data;
+}
+
+
+inline void Columnar_file::Writer::save(const std::string& filename) const
+{
+    const std::vector<char> data = serialize();
+
+    // Write to a file unique to this thread, and rename it, so that readers never see partial files
+    const std::string temporary_filename = filename + ".tmp"
+        + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^ std::chrono::steady_clock::now().time_since_epoch().count());
+
+    {
+        std::ofstream file(temporary_filename, std::ios::binary);
+
+        if ( !file )
+            throw std::runtime_error("Columnar_file: unable to open \"" + temporary_filename + "\"");
+
+        file.write(data.data(), data.size());
+
+        if ( !file )
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temporary_filename, error);
+            throw std::runtime_error("Columnar_file: unable to write \"" + temporary_filename + "\"");
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_filename, filename, error);
+
+    if ( error )
+    {
+        std::filesystem::remove(temporary_filename, error);
+        throw std::runtime_error("Columnar_file: unable to write \"" + filename + "\"");
+    }
+}
+
+
+inline Columnar_file::Columnar_file(const std::string& filename)
+: _file(std::make_unique<Mapped_file>(filename)), _data(_file->data()), _size(_file->size())
+{
+    read_directory();
+}
+
+
+inline Columnar_file::Columnar_file(std::vector<char> data)
+: _buffer(std::move(data)), _data(_buffer.data()), _size(_buffer.size())
+{
+    read_directory();
+}
+
+
+inline void Columnar_file::read_directory()
+{
+    size_t position = 0;
+
+    auto read = [&](auto& value)
+    {
+        if ( position + sizeof(value) > _size )
+            throw std::runtime_error("Columnar_file: the file is truncated");
+
+        std::memcpy(&value, _data + position, sizeof(value));
+        position += sizeof(value);
+    };
+
+    auto read_string = [&]()
+    {
+        uint64_t size;
+        read(size);
+
+        if ( size > _size - position )
+            throw std::runtime_error("Columnar_file: the file is truncated");
+
+        std::string value(_data + position, size);
+        position += size;
+        return value;
+    };
+
+    // (1) Header
+    if ( _size < HEADER_SIZE || std::memcmp(_data, MAGIC, 8) != 0 )
+        throw std::runtime_error("Columnar_file: not a columnar file");
+
+    position = 8;
+
+    uint32_t version, endianness;
+    uint64_t directory_size, directory_hash, file_size;
+    read(version);
+    read(endianness);
+    read(directory_size);
+    read(directory_hash);
+    read(file_size);
+
+    if ( version != FORMAT_VERSION )
+        throw std::runtime_error("Columnar_file: format version " + std::to_string(version) + " is not supported");
+
+    if ( endianness != ENDIANNESS_MARK )
+        throw std::runtime_error("Columnar_file: the file was written with another endianness");
+
+    if ( file_size != _size || directory_size > _size - HEADER_SIZE )
+        throw std::runtime_error("Columnar_file: the file is truncated");
+
+    if ( hash(_data + HEADER_SIZE, directory_size) != directory_hash )
+        throw std::runtime_error("Columnar_file: the directory is corrupted");
+
+    // (2) Attributes
+    uint64_t n_attributes;
+    read(n_attributes);
+
+    for (uint64_t i = 0; i < n_attributes; ++i)
+    {
+        std::string name = read_string();
+        _attributes[name] = read_string();
+    }
+
+    // (3) Channels
+    uint64_t n_channels;
+    read(n_channels);
+
+    for (uint64_t i = 0; i < n_channels; ++i)
+    {
+        std::string name = read_string();
+        uint32_t compression;
+        Channel channel;
+
+        read(compression);
+        read(channel.n_values);
+        read(channel.offset);
+        read(channel.size);
+        read(channel.hash);
+
+        if ( compression != NONE && compression != XOR_RLE )
+            throw std::runtime_error("Columnar_file: unknown compression of channel \"" + name + "\"");
+
+        channel.compression = static_cast<Compression>(compression);
+
+        if ( channel.offset > _size || channel.size > _size - channel.offset )
+            throw std::runtime_error("Columnar_file: channel \"" + name + "\" is out of the file");
+
+        if ( channel.compression == NONE && channel.size != channel.n_values*sizeof(double) )
+            throw std::runtime_error("Columnar_file: channel \"" + name + "\" has an incorrect size");
+
+        _channel_names.push_back(name);
+        _channels[name] = channel;
+    }
+}
+
+
+inline const Columnar_file::Channel& Columnar_file::get_channel_entry(const std::string& name) const
+{
+    const auto it = _channels.find(name);
+
+    if ( it == _channels.cend() )
+        throw std::runtime_error("Columnar_file: channel \"" + name + "\" does not exist");
+
+    return it->second;
+}
+
+
+inline std::vector<scalar> Columnar_file::get_channel(const std::string& name) const
+{
+    const Channel& channel = get_channel_entry(name);
+    const char* data = _data + channel.offset;
+
+    if ( hash(data, channel.size) != channel.hash )
+        throw std::runtime_error("Columnar_file: channel \"" + name + "\" is corrupted");
+
+    if ( channel.compression == XOR_RLE )
+        return decompress(data, channel.size, channel.n_values);
+
+    std::vector<scalar> values(channel.n_values);
+    std::memcpy(values.data(), data, channel.size);
+    return values;
+}
+
+
+inline const std::string& Columnar_file::get_attribute(const std::string& name) const
+{
+    const auto it = _attributes.find(name);
+
+    if ( it == _attributes.cend() )
+        throw std::runtime_error("Columnar_file: attribute \"" + name + "\" does not exist");
+
+    return it->second;
+}
+
+
+inline uint64_t Columnar_file::hash(const char* data, const size_t size)
+{
+    uint64_t result = 14695981039346656037ull;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        result ^= static_cast<unsigned char>(data[i]);
+        result *= 1099511628211ull;
+    }
+
+    return result;
+}
+
+
+inline std::vector<char> Columnar_file::compress(const std::vector<scalar>& values)
+{
+    const size_t n = values.size();
+
+    // (1) XOR with the previous value, and transpose the bytes into planes
+    std::vector<unsigned char> planes(8*n);
+    uint64_t previous = 0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const double value = values[i];
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(double));
+
+        const uint64_t delta = bits ^ previous;
+        previous = bits;
+
+        for (size_t b = 0; b < 8; ++b)
+            planes[b*n + i] = static_cast<unsigned char>(delta >> (8*b));
+    }
+
+    // (2) Run-length encoding: a control byte c < 128 is followed by c+1 literals, and c >= 128 by one byte repeated c-126 times
+    std::vector<char> result;
+    size_t i = 0;
+
+    while ( i < planes.size() )
+    {
+        size_t run = 1;
+        while ( i + run < planes.size() && run < 129 && planes[i + run] == planes[i] )
+            ++run;
+
+        if ( run >= 2 )
+        {
+            result.push_back(static_cast<char>(run + 126));
+            result.push_back(static_cast<char>(planes[i]));
+            i += run;
+        }
+        else
+        {
+            // Literals, until the next run of at least 2
+            size_t n_literals = 1;
+            while ( i + n_literals < planes.size() && n_literals < 128
+                    && !(i + n_literals + 1 < planes.size() && planes[i + n_literals] == planes[i + n_literals + 1]) )
+                ++n_literals;
+
+            result.push_back(static_cast<char>(n_literals - 1));
+            result.insert(result.end(), planes.cbegin() + i, planes.cbegin() + i + n_literals);
+            i += n_literals;
+        }
+    }
+
+    return result;
+}
+
+
+inline std::vector<scalar> Columnar_file::decompress(const char* data, const size_t size, const size_t n_values)
+{
+    // (1) Run-length decoding
+    std::vector<unsigned char> planes;
+    planes.reserve(8*n_values);
+    size_t position = 0;
+
+    while ( position < size )
+    {
+        const unsigned char control = static_cast<unsigned char>(data[position++]);
+
+        if ( control < 128 )
+        {
+            const size_t n_literals = control + 1;
+
+            if ( n_literals > size - position )
+                throw std::runtime_error("Columnar_file: compressed data is corrupted");
+
+            planes.insert(planes.end(), data + position, data + position + n_literals);
+            position += n_literals;
+        }
+        else
+        {
+            if ( position >= size )
+                throw std::runtime_error("Columnar_file: compressed data is corrupted");
+
+            planes.insert(planes.end(), control - 126, static_cast<unsigned char>(data[position++]));
+        }
+
+        if ( planes.size() > 8*n_values )
+            throw std::runtime_error("Columnar_file: compressed data is corrupted");
+    }
+
+    if ( planes.size() != 8*n_values )
+        throw std::runtime_error("Columnar_file: compressed data is corrupted");
+
+    // (2) Transpose the planes back, and undo the XOR
+    std::vector<scalar> values(n_values);
+    uint64_t previous = 0;
+
+    for (size_t i = 0; i < n_values; ++i)
+    {
+        uint64_t delta = 0;
+
+        for (size_t b = 0; b < 8; ++b)
+            delta |= static_cast<uint64_t>(planes[b*n_values + i]) << (8*b);
+
+        previous ^= delta;
+
+        double value;
+        std::memcpy(&value, &previous, sizeof(double));
+        values[i] = value;
+    }
+
+    return values;
+}
+
+#endif
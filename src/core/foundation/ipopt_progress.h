@@ -0,0 +1,167 @@
+#ifndef __IPOPT_PROGRESS_H__
+#define __IPOPT_PROGRESS_H__
+
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <sstream>
+#include "lion/foundation/types.h"
+#include "lion/thirdparty/include/cppad/ipopt/solve.hpp"
+
+//!     Progress of an IPOPT solve
+//!     --------------------------
+//!
+//! Written by the solver at each iteration, and read by any other thread. A cancellation request
+//! stops the solver at the next iteration, which then returns with status user_requested_stop
+//!
+struct Ipopt_progress
+{
+    std::atomic<int>    iteration            = -1;      //! Current iteration, -1 if not started
+    std::atomic<scalar> objective            = 0.0;     //! Current objective function value
+    std::atomic<scalar> primal_infeasibility = 0.0;     //! Current constraint violation
+    std::atomic<scalar> dual_infeasibility   = 0.0;     //! Current dual infeasibility
+    std::atomic<bool>   cancel_requested     = false;   //! If true, the solver stops at the next iteration
+    std::atomic<int>    status               = -1;      //! Final CppAD::ipopt::solve_result status, -1 until the solver returns
+};
+
+
+//! IPOPT problem of CppAD::ipopt::solve that reports its progress, and supports warm start
+template<class Dvector, class ADvector, class FG_eval>
+class Ipopt_progress_callback : public CppAD::ipopt::solve_callback<Dvector,ADvector,FG_eval>
+{
+ public:
+    using base_type = CppAD::ipopt::solve_callback<Dvector,ADvector,FG_eval>;
+
+    //! Constructor
+    //! @param[in] lambda, zl, zu: warm start multipliers. Not used if nullptr
+    //! @param[in] progress: the progress to report
+    //! The rest of arguments are those of CppAD::ipopt::solve_callback
+    Ipopt_progress_callback(size_t nf, size_t nx, size_t ng, const Dvector& xi, const Dvector& xl, const Dvector& xu,
+                            const Dvector& gl, const Dvector& gu, const Dvector* lambda, const Dvector* zl, const Dvector* zu,
+                            FG_eval& fg_eval, bool retape, bool sparse_forward, bool sparse_reverse,
+                            CppAD::ipopt::solve_result<Dvector>& solution, Ipopt_progress& progress)
+    : base_type(nf, nx, ng, xi, xl, xu, gl, gu, fg_eval, retape, sparse_forward, sparse_reverse, solution),
+      _xi(xi), _lambda(lambda), _zl(zl), _zu(zu), _progress(progress) {}
+
+    //! Set the initial point, and the multipliers if warm started
+    virtual bool get_starting_point(Ipopt::Index n, bool init_x, Ipopt::Number* x, bool init_z, Ipopt::Number* z_L, Ipopt::Number* z_U,
+                                    Ipopt::Index m, bool init_lambda, Ipopt::Number* lambda) override
+    {
+        if ( init_x )
+            for (Ipopt::Index i = 0; i < n; ++i) x[i] = _xi[i];
+
+        if ( init_z )
+        {
+            if ( _zl == nullptr || _zu == nullptr )
+                return false;
+
+            for (Ipopt::Index i = 0; i < n; ++i) { z_L[i] = (*_zl)[i]; z_U[i] = (*_zu)[i]; }
+        }
+
+        if ( init_lambda )
+        {
+            if ( _lambda == nullptr )
+                return false;
+
+            for (Ipopt::Index i = 0; i < m; ++i) lambda[i] = (*_lambda)[i];
+        }
+
+        return true;
+    }
+
+    //! Report the progress, and stop if cancelled
+    virtual bool intermediate_callback(Ipopt::AlgorithmMode mode, Ipopt::Index iter, Ipopt::Number obj_value, Ipopt::Number inf_pr,
+                                       Ipopt::Number inf_du, Ipopt::Number mu, Ipopt::Number d_norm, Ipopt::Number regularization_size,
+                                       Ipopt::Number alpha_du, Ipopt::Number alpha_pr, Ipopt::Index ls_trials, const Ipopt::IpoptData* ip_data,
+                                       Ipopt::IpoptCalculatedQuantities* ip_cq) override
+    {
+        _progress.objective            = obj_value;
+        _progress.primal_infeasibility = inf_pr;
+        _progress.dual_infeasibility   = inf_du;
+        _progress.iteration            = iter;
+
+        return !_progress.cancel_requested;
+    }
+
+ private:
+    const Dvector& _xi;
+    const Dvector* _lambda;
+    const Dvector* _zl;
+    const Dvector* _zu;
+    Ipopt_progress& _progress;
+};
+
+
+//! Same as CppAD::ipopt::solve, reporting the progress at every iteration. If lambda, zl, and zu
+//! are provided, the solver is warm started
+template<class Dvector, class FG_eval>
+void ipopt_solve_with_progress(const std::string& options, const Dvector& xi, const Dvector& xl, const Dvector& xu, const Dvector& gl,
+                               const Dvector& gu, const Dvector* lambda, const Dvector* zl, const Dvector* zu, FG_eval& fg_eval,
+                               CppAD::ipopt::solve_result<Dvector>& solution, Ipopt_progress& progress)
+{
+    using ADvector = typename FG_eval::ADvector;
+
+    const size_t nx = xi.size();
+    const size_t ng = gl.size();
+
+    Ipopt::SmartPtr<Ipopt::IpoptApplication> app = new Ipopt::IpoptApplication();
+
+    // (1) Process the options: each line is "<type> <name> <value>", as in CppAD::ipopt::solve
+    bool retape         = false;
+    bool sparse_forward = false;
+    bool sparse_reverse = false;
+
+    size_t begin = 0;
+    while ( begin < options.size() )
+    {
+        const size_t end = options.find('\n', begin);
+        std::istringstream line(options.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        begin = (end == std::string::npos ? options.size() : end + 1);
+
+        std::string type, name, value;
+        line >> type >> name >> value;
+
+        if ( type.empty() )
+            continue;
+        else if ( type == "Retape" )
+            retape = (name == "true");
+        else if ( type == "Sparse" )
+        {
+            sparse_forward = (name == "true" && value == "forward");
+            sparse_reverse = (name == "true" && value == "reverse");
+        }
+        else if ( type == "String" )
+            app->Options()->SetStringValue(name.c_str(), value.c_str());
+        else if ( type == "Numeric" )
+            app->Options()->SetNumericValue(name.c_str(), std::atof(value.c_str()));
+        else if ( type == "Integer" )
+            app->Options()->SetIntegerValue(name.c_str(), std::atoi(value.c_str()));
+        else
+            throw std::runtime_error("ipopt_solve_with_progress: option type \"" + type + "\" is not recognized");
+    }
+
+    if ( lambda != nullptr )
+    {
+        app->Options()->SetStringValue("warm_start_init_point", "yes");
+        app->Options()->SetNumericValue("warm_start_bound_push", 1.0e-9);
+        app->Options()->SetNumericValue("warm_start_mult_bound_push", 1.0e-9);
+    }
+
+    // (2) Initialize the application
+    if ( app->Initialize() != Ipopt::Solve_Succeeded )
+    {
+        solution.status = CppAD::ipopt::solve_result<Dvector>::unknown;
+        progress.status = solution.status;
+        return;
+    }
+
+    // (3) Solve
+    Ipopt::SmartPtr<Ipopt::TNLP> nlp = new Ipopt_progress_callback<Dvector,ADvector,FG_eval>(1, nx, ng, xi, xl, xu, gl, gu, lambda, zl, zu,
+                                                                                              fg_eval, retape, sparse_forward, sparse_reverse,
+                                                                                              solution, progress);
+    app->OptimizeTNLP(nlp);
+
+    progress.status = solution.status;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __IPOPT_SOLVER_LOCK_H__
+#define __IPOPT_SOLVER_LOCK_H__
+
+#include <mutex>
+
+//!     Process-wide lock of the IPOPT solves
+//!     -------------------------------------
+//!
+//! IPOPT and its linear solver (MUMPS, with the static state of its sequential MPI stub) are not guaranteed to be
+//! thread-safe. Solves started from several threads wait here, one at a time, while the rest of their work (setup,
+//! initial guess, post-processing) runs in parallel. The lock shall be taken around each call to an IPOPT solve:
+//!
+//!     {
+//!         Ipopt_solver_lock lock;
+//!         CppAD::ipopt::solve(...);
+//!     }
+//!
+class Ipopt_solver_lock
+{
+ public:
+    Ipopt_solver_lock() : _lock(get_mutex()) {}
+
+    Ipopt_solver_lock(const Ipopt_solver_lock&) = delete;
+    Ipopt_solver_lock& operator=(const Ipopt_solver_lock&) = delete;
+
+ private:
+
+    //! The mutex shared by all the solves
+    static std::mutex& get_mutex() { static std::mutex mutex; return mutex; }
+
+    std::lock_guard<std::mutex> _lock;  //! Held while alive
+};
+
+#endif
@@ -0,0 +1,757 @@
+#ifndef __KML_READER_H__
+#define __KML_READER_H__
+
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "lion/foundation/types.h"
+
+//!     Streaming reader of KML/KMZ coordinates
+//!     ---------------------------------------
+//!
+//! Reads the <coordinates> of the first <LineString> of a KML file without building the XML tree: the text is
+//! tokenised as it is read, and the points are delivered in chunks to a callback, or stored in a preallocated vector.
+//!
+//! KMZ files (zip archives, detected by their signature) are decoded in memory: the first .kml entry of the
+//! archive (doc.kml if present) is inflated and tokenised. Stored and deflated entries are supported, and the
+//! CRC-32 of the entry is checked.
+//!
+class Kml_reader
+{
+ public:
+    //! A point of the LineString: longitude, latitude, and altitude (0 if not given)
+    struct Point
+    {
+        scalar longitude;
+        scalar latitude;
+        scalar altitude;
+    };
+
+    //! Receives a chunk of consecutive points
+    using Callback = std::function<void(const Point* points, const size_t n_points)>;
+
+    //! Default number of points per chunk
+    constexpr static size_t DEFAULT_CHUNK_SIZE = 4096;
+
+    //! Read all the points of a KML/KMZ file
+    static std::vector<Point> read(const std::string& filename);
+
+    //! Read the points of a KML/KMZ file, in chunks of at most chunk_size points
+    static void read(const std::string& filename, const Callback& callback, const size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    //! Estimate of the number of points of a KML/KMZ file from its size, to preallocate the results
+    static size_t estimate_number_of_points(const std::string& filename);
+
+    //! Read the points of KML text held in memory
+    static void read_kml_text(const char* text, const size_t size, const Callback& callback, const size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    //! Extract the KML entry of a KMZ archive held in memory
+    static std::vector<char> extract_kml(const std::vector<uint8_t>& kmz);
+
+    //! Decompress a raw deflate stream (RFC 1951)
+    //! @param[in] expected_size: size of the result, if known, used to preallocate it
+    static std::vector<char> inflate(const uint8_t* data, const size_t size, const size_t expected_size = 0);
+
+    //! CRC-32 of a buffer, as used by zip archives
+    static uint32_t crc32(const char* data, const size_t size);
+
+ private:
+
+    //! Incremental tokeniser: consumes the text in pieces of any size
+    class Tokeniser
+    {
+     public:
+        Tokeniser(const Callback& callback, const size_t chunk_size);
+
+        //! Consume the next piece of text
+        void feed(const char* text, const size_t size);
+
+        //! Deliver the remaining points. Throws if the text ended within the coordinates
+        void finish();
+
+     private:
+        enum class State { TEXT, TAG, COORDINATES, DONE };
+
+        void end_tag();
+        void end_number();
+        void end_point();
+
+        const Callback& _callback;
+        size_t _chunk_size;
+        std::vector<Point> _points;        //! Points not yet delivered
+
+        State _state = State::TEXT;
+        std::string _tag_name;             //! Name of the tag being read
+        bool _tag_name_complete = false;   //! If the name of the tag was already read
+        char _tag_last[2] = {0,0};         //! Last two characters of the tag, to find the end of the comments
+        bool _tag_self_closing = false;
+        bool _is_comment = false;
+        size_t _linestring_depth = 0;
+
+        char _number[64];                  //! Digits of the number being read
+        size_t _number_size = 0;
+        std::array<scalar,3> _components;  //! Components of the point being read
+        size_t _component = 0;             //! Index of the component being read
+        size_t _n_values = 0;              //! Number of components read
+        bool _after_comma = false;
+    };
+
+    //! Decoding of the Huffman codes of a deflate stream
+    struct Huffman
+    {
+        std::array<uint16_t,16> count;     //! Number of codes of each length
+        std::vector<uint16_t> symbol;      //! Symbols, ordered by code
+
+        //! Build the table from the code lengths. Returns false if the lengths are oversubscribed
+        bool build(const uint8_t* lengths, const size_t n);
+    };
+
+    //! Reader of the bits of a deflate stream
+    struct Bit_reader
+    {
+        const uint8_t* data;
+        size_t size;
+        size_t position = 0;
+        uint32_t buffer = 0;
+        size_t n_bits = 0;
+
+        uint32_t bits(const size_t n);
+        int decode(const Huffman& huffman);
+    };
+
+    static uint16_t read_u16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+    static uint32_t read_u32(const uint8_t* p) { return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+};
+
+
+inline std::vector<Kml_reader::Point> Kml_reader::read(const std::string& filename)
+{
+    // (1) Preallocate
+    std::vector<Point> points;
+    points.reserve(estimate_number_of_points(filename));
+
+    // (2) Read
+    read(filename, [&](const Point* chunk, const size_t n) { points.insert(points.end(), chunk, chunk + n); });
+
+    return points;
+}
+
+
+inline size_t Kml_reader::estimate_number_of_points(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+
+    if ( !file )
+        throw std::runtime_error("Kml_reader: unable to open file \"" + filename + "\"");
+
+    // A KML point takes about 30 characters, which deflate compresses to about 10 bytes
+    const size_t file_size = static_cast<size_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+
+    char signature[2] = {0,0};
+    file.read(signature, 2);
+    const bool is_kmz = (signature[0] == 'P' && signature[1] == 'K');
+
+    return file_size/(is_kmz ? 10 : 30) + 1;
+}
+
+
+inline void Kml_reader::read(const std::string& filename, const Callback& callback, const size_t chunk_size)
+{
+    std::ifstream file(filename, std::ios::binary);
+
+    if ( !file )
+        throw std::runtime_error("Kml_reader: unable to open file \"" + filename + "\"");
+
+    // (1) Check for the zip signature
+    char signature[4] = {0,0,0,0};
+    file.read(signature, 4);
+    const size_t n_signature = static_cast<size_t>(file.gcount());
+
+    if ( n_signature == 4 && signature[0] == 'P' && signature[1] == 'K' && signature[2] == 3 && signature[3] == 4 )
+    {
+        // (2) KMZ: read the archive, and tokenise its KML entry
+        file.seekg(0, std::ios::end);
+        std::vector<uint8_t> kmz(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(reinterpret_cast<char*>(kmz.data()), kmz.size());
+
+        const std::vector<char> kml = extract_kml(kmz);
+        read_kml_text(kml.data(), kml.size(), callback, chunk_size);
+        return;
+    }
+
+    // (3) KML: tokenise the file as it is read
+    Tokeniser tokeniser(callback, chunk_size);
+    tokeniser.feed(signature, n_signature);
+
+    std::vector<char> buffer(1 << 16);
+
+    while ( file )
+    {
+        file.read(buffer.data(), buffer.size());
+        tokeniser.feed(buffer.data(), static_cast<size_t>(file.gcount()));
+    }
+
+    tokeniser.finish();
+}
+
+
+inline void Kml_reader::read_kml_text(const char* text, const size_t size, const Callback& callback, const size_t chunk_size)
+{
+    Tokeniser tokeniser(callback, chunk_size);
+    tokeniser.feed(text, size);
+    tokeniser.finish();
+}
+
+
+inline std::vector<char> Kml_reader::extract_kml(const std::vector<uint8_t>& kmz)
+{
+    const size_t n = kmz.size();
+    const uint8_t* data = kmz.data();
+
+    // (1) Find the end of central directory record, searching backwards over its comment
+    constexpr size_t EOCD_SIZE = 22;
+
+    if ( n < EOCD_SIZE )
+        throw std::runtime_error("Kml_reader: KMZ archive is too short");
+
+    size_t eocd = n;
+    for (size_t i = n - EOCD_SIZE + 1; (i-- > 0) && (n - i <= EOCD_SIZE + 0xFFFF); )
+    {
+        if ( read_u32(data + i) == 0x06054b50 )
+        {
+            eocd = i;
+            break;
+        }
+    }
+
+    if ( eocd == n )
+        throw std::runtime_error("Kml_reader: end of central directory not found in KMZ archive");
+
+    const size_t n_entries = read_u16(data + eocd + 10);
+    const size_t directory_offset = read_u32(data + eocd + 16);
+
+    if ( directory_offset == 0xFFFFFFFF )
+        throw std::runtime_error("Kml_reader: zip64 archives are not supported");
+
+    // (2) Look for the KML entry in the central directory: doc.kml, or the first .kml
+    struct Entry { size_t method, compressed_size, uncompressed_size, local_offset; uint32_t crc; };
+    Entry entry_found = {};
+    bool found = false;
+    bool found_doc = false;
+
+    size_t p = directory_offset;
+    for (size_t i = 0; i < n_entries; ++i)
+    {
+        if ( p + 46 > n || read_u32(data + p) != 0x02014b50 )
+            throw std::runtime_error("Kml_reader: corrupted central directory in KMZ archive");
+
+        const size_t name_length    = read_u16(data + p + 28);
+        const size_t extra_length   = read_u16(data + p + 30);
+        const size_t comment_length = read_u16(data + p + 32);
+
+        if ( p + 46 + name_length > n )
+            throw std::runtime_error("Kml_reader: corrupted central directory in KMZ archive");
+
+        const std::string name(reinterpret_cast<const char*>(data + p + 46), name_length);
+        const bool is_kml = (name.size() >= 4) && (name.compare(name.size()-4, 4, ".kml") == 0);
+        const bool is_doc = (name == "doc.kml");
+
+        if ( is_kml && (!found || (is_doc && !found_doc)) )
+        {
+            entry_found = {read_u16(data + p + 10), read_u32(data + p + 20), read_u32(data + p + 24), read_u32(data + p + 42), read_u32(data + p + 16)};
+            found = true;
+            found_doc = is_doc;
+        }
+
+        p += 46 + name_length + extra_length + comment_length;
+    }
+
+    if ( !found )
+        throw std::runtime_error("Kml_reader: no KML entry found in KMZ archive");
+
+    // (3) Skip the local header
+    const size_t local = entry_found.local_offset;
+
+    if ( local + 30 > n || read_u32(data + local) != 0x04034b50 )
+        throw std::runtime_error("Kml_reader: corrupted local header in KMZ archive");
+
+    const size_t begin = local + 30 + read_u16(data + local + 26) + read_u16(data + local + 28);
+
+    if ( begin + entry_found.compressed_size > n )
+        throw std::runtime_error("Kml_reader: KMZ archive entry exceeds the archive size");
+
+    // (4) Decode
+    std::vector<char> kml;
+
+    if ( entry_found.method == 0 )
+        kml.assign(data + begin, data + begin + entry_found.compressed_size);
+    else if ( entry_found.method == 8 )
+        kml = inflate(data + begin, entry_found.compressed_size, entry_found.uncompressed_size);
+    else
+        throw std::runtime_error("Kml_reader: unsupported compression method " + std::to_string(entry_found.method) + " in KMZ archive");
+
+    if ( kml.size() != entry_found.uncompressed_size )
+        throw std::runtime_error("Kml_reader: KMZ archive entry size mismatch");
+
+    if ( crc32(kml.data(), kml.size()) != entry_found.crc )
+        throw std::runtime_error("Kml_reader: KMZ archive entry CRC mismatch");
+
+    return kml;
+}
+
+
+inline uint32_t Kml_reader::crc32(const char* data, const size_t size)
+{
+    static const std::array<uint32_t,256> table = []()
+    {
+        std::array<uint32_t,256> result;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (size_t k = 0; k < 8; ++k)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+
+            result[i] = c;
+        }
+        return result;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+inline bool Kml_reader::Huffman::build(const uint8_t* lengths, const size_t n)
+{
+    // (1) Count the codes of each length
+    count.fill(0);
+    for (size_t i = 0; i < n; ++i)
+        ++count[lengths[i]];
+
+    if ( count[0] == n )
+    {
+        symbol.clear();
+        return true;
+    }
+
+    // (2) Check that the code is not oversubscribed
+    int left = 1;
+    for (size_t length = 1; length < 16; ++length)
+    {
+        left = 2*left - count[length];
+
+        if ( left < 0 )
+            return false;
+    }
+
+    // (3) Sort the symbols by length, then by value
+    std::array<uint16_t,16> offsets;
+    offsets[1] = 0;
+    for (size_t length = 1; length < 15; ++length)
+        offsets[length+1] = offsets[length] + count[length];
+
+    symbol.assign(n, 0);
+    for (size_t i = 0; i < n; ++i)
+        if ( lengths[i] != 0 )
+            symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+
+    return true;
+}
+
+
+inline uint32_t Kml_reader::Bit_reader::bits(const size_t n)
+{
+    while ( n_bits < n )
+    {
+        if ( position == size )
+            throw std::runtime_error("Kml_reader: unexpected end of deflate stream");
+
+        buffer |= static_cast<uint32_t>(data[position++]) << n_bits;
+        n_bits += 8;
+    }
+
+    const uint32_t result = buffer & ((1u << n) - 1u);
+    buffer >>= n;
+    n_bits -= n;
+    return result;
+}
+
+
+inline int Kml_reader::Bit_reader::decode(const Huffman& huffman)
+{
+    // Canonical codes: read one bit at a time, and compare with the first code of each length
+    int code = 0;
+    int first = 0;
+    int index = 0;
+
+    for (size_t length = 1; length < 16; ++length)
+    {
+        code |= static_cast<int>(bits(1));
+        const int count = huffman.count[length];
+
+        if ( code - count < first )
+            return huffman.symbol[index + (code - first)];
+
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+
+    throw std::runtime_error("Kml_reader: invalid Huffman code in deflate stream");
+}
+
+
+inline std::vector<char> Kml_reader::inflate(const uint8_t* data, const size_t size, const size_t expected_size)
+{
+    static const uint16_t length_base[29]  = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+    static const uint16_t length_extra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+    static const uint16_t distance_base[30]  = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+    static const uint16_t distance_extra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+    static const uint8_t code_length_order[19] = {16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15};
+
+    std::vector<char> output;
+    output.reserve(expected_size);
+
+    Bit_reader reader{data, size};
+    Huffman literals, distances;
+    bool is_last = false;
+
+    while ( !is_last )
+    {
+        is_last = reader.bits(1);
+        const uint32_t type = reader.bits(2);
+
+        if ( type == 0 )
+        {
+            // (1) Stored block: discard the remaining bits of the byte, and copy
+            reader.buffer = 0;
+            reader.n_bits = 0;
+
+            if ( reader.position + 4 > size )
+                throw std::runtime_error("Kml_reader: unexpected end of deflate stream");
+
+            const size_t length = read_u16(data + reader.position);
+
+            if ( (length ^ 0xFFFF) != read_u16(data + reader.position + 2) )
+                throw std::runtime_error("Kml_reader: corrupted stored block in deflate stream");
+
+            reader.position += 4;
+
+            if ( reader.position + length > size )
+                throw std::runtime_error("Kml_reader: unexpected end of deflate stream");
+
+            output.insert(output.end(), data + reader.position, data + reader.position + length);
+            reader.position += length;
+            continue;
+        }
+        else if ( type == 1 )
+        {
+            // (2) Fixed codes
+            std::array<uint8_t,288> lengths;
+            std::fill(lengths.begin()      , lengths.begin() + 144, 8);
+            std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+            std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+            std::fill(lengths.begin() + 280, lengths.end()        , 8);
+            literals.build(lengths.data(), 288);
+
+            std::array<uint8_t,30> distance_lengths;
+            distance_lengths.fill(5);
+            distances.build(distance_lengths.data(), 30);
+        }
+        else if ( type == 2 )
+        {
+            // (3) Dynamic codes: the code lengths are themselves Huffman coded
+            const size_t n_literals  = reader.bits(5) + 257;
+            const size_t n_distances = reader.bits(5) + 1;
+            const size_t n_code_lengths = reader.bits(4) + 4;
+
+            if ( n_literals > 286 || n_distances > 30 )
+                throw std::runtime_error("Kml_reader: invalid dynamic block in deflate stream");
+
+            std::array<uint8_t,19> code_lengths;
+            code_lengths.fill(0);
+            for (size_t i = 0; i < n_code_lengths; ++i)
+                code_lengths[code_length_order[i]] = static_cast<uint8_t>(reader.bits(3));
+
+            Huffman code_length_huffman;
+            if ( !code_length_huffman.build(code_lengths.data(), 19) )
+                throw std::runtime_error("Kml_reader: invalid dynamic block in deflate stream");
+
+            std::array<uint8_t,316> lengths;
+            size_t i = 0;
+            while ( i < n_literals + n_distances )
+            {
+                const int symbol = reader.decode(code_length_huffman);
+
+                if ( symbol < 16 )
+                {
+                    lengths[i++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+
+                uint8_t value = 0;
+                size_t repeat;
+
+                if ( symbol == 16 )
+                {
+                    if ( i == 0 )
+                        throw std::runtime_error("Kml_reader: invalid dynamic block in deflate stream");
+
+                    value = lengths[i-1];
+                    repeat = 3 + reader.bits(2);
+                }
+                else if ( symbol == 17 )
+                    repeat = 3 + reader.bits(3);
+                else
+                    repeat = 11 + reader.bits(7);
+
+                if ( i + repeat > n_literals + n_distances )
+                    throw std::runtime_error("Kml_reader: invalid dynamic block in deflate stream");
+
+                std::fill(lengths.begin() + i, lengths.begin() + i + repeat, value);
+                i += repeat;
+            }
+
+            if ( lengths[256] == 0 || !literals.build(lengths.data(), n_literals) || !distances.build(lengths.data() + n_literals, n_distances) )
+                throw std::runtime_error("Kml_reader: invalid dynamic block in deflate stream");
+        }
+        else
+            throw std::runtime_error("Kml_reader: invalid block type in deflate stream");
+
+        // (4) Decode the literals and the (length,distance) pairs of the block
+        while ( true )
+        {
+            const int symbol = reader.decode(literals);
+
+            if ( symbol < 256 )
+                output.push_back(static_cast<char>(symbol));
+            else if ( symbol == 256 )
+                break;
+            else
+            {
+                const size_t length_symbol = symbol - 257;
+
+                if ( length_symbol >= 29 )
+                    throw std::runtime_error("Kml_reader: invalid length in deflate stream");
+
+                const size_t length = length_base[length_symbol] + reader.bits(length_extra[length_symbol]);
+                const int distance_symbol = reader.decode(distances);
+
+                if ( distance_symbol >= 30 )
+                    throw std::runtime_error("Kml_reader: invalid distance in deflate stream");
+
+                const size_t distance = distance_base[distance_symbol] + reader.bits(distance_extra[distance_symbol]);
+
+                if ( distance > output.size() )
+                    throw std::runtime_error("Kml_reader: distance too far back in deflate stream");
+
+                const size_t start = output.size() - distance;
+                for (size_t k = 0; k < length; ++k)
+                    output.push_back(output[start + k]);
+            }
+        }
+    }
+
+    return output;
+}
+
+
+inline Kml_reader::Tokeniser::Tokeniser(const Callback& callback, const size_t chunk_size)
+: _callback(callback), _chunk_size(std::max<size_t>(chunk_size,1))
+{
+    _points.reserve(_chunk_size);
+}
+
+
+inline void Kml_reader::Tokeniser::feed(const char* text, const size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        const char c = text[i];
+
+        switch (_state)
+        {
+         case State::TEXT:
+            if ( c == '<' )
+            {
+                _state = State::TAG;
+                _tag_name.clear();
+                _tag_name_complete = false;
+                _tag_last[0] = _tag_last[1] = 0;
+                _tag_self_closing = false;
+                _is_comment = false;
+            }
+            break;
+
+         case State::TAG:
+            if ( c == '>' && (!_is_comment || (_tag_last[0] == '-' && _tag_last[1] == '-')) )
+            {
+                _tag_self_closing = (_tag_last[1] == '/');
+                end_tag();
+                break;
+            }
+
+            if ( !_tag_name_complete )
+            {
+                if ( c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '>' || (c == '/' && !_tag_name.empty()) )
+                    _tag_name_complete = true;
+                else
+                    _tag_name.push_back(c);
+
+                if ( _tag_name == "!--" )
+                {
+                    _is_comment = true;
+                    _tag_name_complete = true;
+                    _tag_last[0] = _tag_last[1] = 0;
+                    break;
+                }
+            }
+
+            _tag_last[0] = _tag_last[1];
+            _tag_last[1] = c;
+            break;
+
+         case State::COORDINATES:
+            if ( c == '<' )
+            {
+                end_number();
+                end_point();
+
+                if ( !_points.empty() )
+                    _callback(_points.data(), _points.size());
+
+                _points.clear();
+                _state = State::DONE;
+            }
+            else if ( c == ',' )
+            {
+                end_number();
+
+                if ( _component == 2 )
+                    throw std::runtime_error("Kml_reader: points shall have at most three components");
+
+                _after_comma = true;
+                ++_component;
+            }
+            else if ( c == ' ' || c == '\t' || c == '\n' || c == '\r' )
+            {
+                end_number();
+
+                if ( !_after_comma )
+                    end_point();
+            }
+            else
+            {
+                if ( _number_size + 1 >= sizeof(_number) )
+                    throw std::runtime_error("Kml_reader: number too long in coordinates");
+
+                _number[_number_size++] = c;
+                _after_comma = false;
+            }
+            break;
+
+         case State::DONE:
+            return;
+        }
+    }
+}
+
+
+inline void Kml_reader::Tokeniser::finish()
+{
+    if ( _state == State::COORDINATES )
+        throw std::runtime_error("Kml_reader: unexpected end of file within <coordinates>");
+
+    if ( _state != State::DONE )
+        throw std::runtime_error("Kml_reader: no <coordinates> of a <LineString> found");
+}
+
+
+inline void Kml_reader::Tokeniser::end_tag()
+{
+    _state = State::TEXT;
+
+    if ( _is_comment )
+        return;
+
+    // Remove the namespace prefix, if any
+    const bool is_closing = (!_tag_name.empty() && _tag_name.front() == '/');
+    std::string name = (is_closing ? _tag_name.substr(1) : _tag_name);
+
+    const size_t colon = name.find(':');
+    if ( colon != std::string::npos )
+        name = name.substr(colon + 1);
+
+    if ( name == "LineString" && !_tag_self_closing )
+    {
+        if ( !is_closing )
+            ++_linestring_depth;
+        else if ( _linestring_depth > 0 )
+            --_linestring_depth;
+    }
+    else if ( name == "coordinates" && !is_closing && !_tag_self_closing && _linestring_depth > 0 )
+    {
+        _state = State::COORDINATES;
+        _number_size = 0;
+        _component = 0;
+        _n_values = 0;
+        _after_comma = false;
+    }
+}
+
+
+inline void Kml_reader::Tokeniser::end_number()
+{
+    if ( _number_size == 0 )
+        return;
+
+    _number[_number_size] = '\0';
+    char* end;
+    const scalar value = std::strtod(_number, &end);
+
+    if ( end != _number + _number_size )
+        throw std::runtime_error("Kml_reader: invalid number \"" + std::string(_number) + "\" in coordinates");
+
+    _components[_component] = value;
+    _n_values = _component + 1;
+    _number_size = 0;
+}
+
+
+inline void Kml_reader::Tokeniser::end_point()
+{
+    if ( _n_values == 0 && _component == 0 )
+        return;
+
+    if ( _n_values != _component + 1 )
+        throw std::runtime_error("Kml_reader: empty component in coordinates");
+
+    if ( _n_values < 2 )
+        throw std::runtime_error("Kml_reader: points shall have at least two components");
+
+    _points.push_back({_components[0], _components[1], (_n_values == 3 ? _components[2] : 0.0)});
+    _component = 0;
+    _n_values = 0;
+    _after_comma = false;
+
+    if ( _points.size() == _chunk_size )
+    {
+        _callback(_points.data(), _points.size());
+        _points.clear();
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+//!     Read-only view of a file
+//!     ------------------------
+//!
+//! The file is memory mapped, so that only the pages that are accessed are read. On Windows, the file is
+//! read into a buffer instead.
+//!
+class Mapped_file
+{
+ public:
+
+    //! Constructor
+    //! @param[in] filename: the file to map. Throws if it cannot be opened
+    explicit Mapped_file(const std::string& filename);
+
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+
+    ~Mapped_file();
+
+    //! The contents of the file
+    const char* data() const { return _data; }
+
+    //! The size of the file
+    size_t size() const { return _size; }
+
+ private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+
+#if defined(_WIN32)
+    std::vector<char> _buffer;
+#endif
+};
+
+
+#if defined(_WIN32)
+
+inline Mapped_file::Mapped_file(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+
+    if ( !file )
+        throw std::runtime_error("Mapped_file: unable to open file \"" + filename + "\"");
+
+    _buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    file.read(_buffer.data(), _buffer.size());
+
+    _data = _buffer.data();
+    _size = _buffer.size();
+}
+
+
+inline Mapped_file::~Mapped_file() {}
+
+#else
+
+inline Mapped_file::Mapped_file(const std::string& filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+
+    if ( fd < 0 )
+        throw std::runtime_error("Mapped_file: unable to open file \"" + filename + "\"");
+
+    struct stat file_stat;
+
+    if ( fstat(fd, &file_stat) != 0 )
+    {
+        close(fd);
+        throw std::runtime_error("Mapped_file: unable to get the size of \"" + filename + "\"");
+    }
+
+    _size = static_cast<size_t>(file_stat.st_size);
+
+    // Empty files cannot be mapped
+    if ( _size > 0 )
+    {
+        void* mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if ( mapping == MAP_FAILED )
+        {
+            close(fd);
+            throw std::runtime_error("Mapped_file: unable to map \"" + filename + "\"");
+        }
+
+        _data = static_cast<const char*>(mapping);
+    }
+
+    // The mapping remains valid after closing the file
+    close(fd);
+}
+
+
+inline Mapped_file::~Mapped_file()
+{
+    if ( _data != nullptr )
+        munmap(const_cast<char*>(_data), _size);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef __POLYLINE_SPATIAL_INDEX_H__
+#define __POLYLINE_SPATIAL_INDEX_H__
+
+#include <array>
+#include <vector>
+#include <tuple>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "lion/foundation/types.h"
+#include "lion/math/vector3d.h"
+
+//!     Spatial index of the segments of a polyline
+//!     --------------------------------------------
+//!
+//! Uniform grid in the (x,y) plane. Each cell lists the segments whose bounding box overlaps it. The cell size is
+//! of the order of the average segment length, so that a closest point query visits a few cells around the point,
+//! instead of every segment of the polyline.
+//!
+//! The results follow the convention of find_closest_point(): the closest point, the squared distance, and the
+//! indexes of the two points of the segment ({n-1,0} for the closing segment of a closed polyline).
+//! Ties are resolved in favour of the segment with the lowest index, independently of the traversal order.
+//!
+//! Queries can be restricted to a window in arclength around a given segment, so that consecutive projections
+//! of a curve follow the polyline continuously, instead of jumping to another part of it that is closer.
+//!
+class Polyline_spatial_index
+{
+ public:
+    using Result = std::tuple<sVector3d,scalar,std::array<size_t,2>>;
+
+    //! Default constructor
+    Polyline_spatial_index() = default;
+
+    //! Constructor
+    //! @param[in] points: the points of the polyline
+    //! @param[in] closed: if true, the last point is joined to the first one
+    Polyline_spatial_index(const std::vector<sVector3d>& points, const bool closed);
+
+    //! Closest point of the polyline to p
+    Result find_closest_point(const sVector3d& p) const;
+
+    //! Closest point of the polyline to p, only among the segments closer than maximum_distance
+    //! @param[out] result: the closest point, if found
+    //! @return false if no segment is closer than maximum_distance
+    bool find_closest_point(Result& result, const sVector3d& p, const scalar maximum_distance) const;
+
+    //! Closest point of the polyline to p, only among the segments closer than maximum_distance, and whose distance
+    //! along the polyline from the start of the segment i_center is below window_length (periodic if the polyline is closed)
+    //! @param[out] result: the closest point, if found
+    //! @return false if no segment of the window is closer than maximum_distance
+    bool find_closest_point(Result& result, const sVector3d& p, const scalar maximum_distance, const size_t i_center, 
+                            const scalar window_length) const;
+
+    //! Number of segments
+    size_t get_number_of_segments() const { return _n_segments; }
+
+ private:
+
+    //! Closest point to p in the segment i
+    void closest_point_in_segment(const size_t i, const sVector3d& p, sVector3d& closest, scalar& dist2) const;
+
+    //! Distance along the polyline between the start of segment i_center and the segment i
+    scalar distance_along(const size_t i_center, const size_t i) const;
+
+    //! Search the grid in rings around p, for segments closer than sqrt(dist2_max) that satisfy is_candidate(i)
+    template<typename Predicate_t>
+    bool search(Result& result, const sVector3d& p, const scalar dist2_max, const Predicate_t& is_candidate) const;
+
+    std::vector<sVector3d> _points; //! Points of the polyline
+    bool _closed = false;           //! If the last point is joined to the first one
+    size_t _n_segments = 0;         //! Number of segments
+    std::vector<scalar> _s;         //! Arclength at the start of each segment, and at the end of the last one
+
+    scalar _x_min = 0.0;            //! Origin of the grid
+    scalar _y_min = 0.0;
+    scalar _cell_size = 1.0;        //! Size of the cells
+    size_t _nx = 0;                 //! Number of cells in x
+    size_t _ny = 0;                 //! Number of cells in y
+
+    std::vector<size_t> _cell_begin; //! Segments of cell c are _segments[_cell_begin[c]..._cell_begin[c+1]), c = ix + _nx.iy
+    std::vector<size_t> _segments;
+};
+
+
+inline Polyline_spatial_index::Polyline_spatial_index(const std::vector<sVector3d>& points, const bool closed)
+: _points(points), _closed(closed)
+{
+    if ( _points.size() == 0 )
+        throw std::runtime_error("Polyline_spatial_index: the polyline is empty");
+
+    // (1) Segments. A single point is seen as a degenerate segment
+    const size_t n = _points.size();
+    _n_segments = (n == 1 ? 1 : (closed ? n : n - 1));
+
+    auto end_point = [&](const size_t i) -> const sVector3d& { return _points[(i + 1) % n]; };
+
+    // (2) Grid: the cells are of the order of the average segment length, bounded to about 4 cells per segment
+    scalar x_max = _points.front().x();
+    scalar y_max = _points.front().y();
+    _x_min = x_max;
+    _y_min = y_max;
+    scalar total_length = 0.0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        _x_min = std::min(_x_min, _points[i].x());
+        _y_min = std::min(_y_min, _points[i].y());
+        x_max  = std::max(x_max, _points[i].x());
+        y_max  = std::max(y_max, _points[i].y());
+    }
+
+    _s.assign(_n_segments + 1, 0.0);
+
+    for (size_t i = 0; i < _n_segments; ++i)
+    {
+        total_length += std::hypot(end_point(i).x() - _points[i].x(), end_point(i).y() - _points[i].y());
+        _s[i+1] = total_length;
+    }
+
+    const scalar width  = x_max - _x_min;
+    const scalar height = y_max - _y_min;
+
+    _cell_size = std::max(total_length/_n_segments, std::sqrt(width*height/(4.0*_n_segments)));
+
+    if ( _cell_size <= 0.0 )
+        _cell_size = std::max({width, height, 1.0});
+
+    _nx = static_cast<size_t>(std::floor(width/_cell_size)) + 1;
+    _ny = static_cast<size_t>(std::floor(height/_cell_size)) + 1;
+
+    auto cell_x = [&](const scalar x) { return std::min(static_cast<size_t>(std::max(0.0, std::floor((x - _x_min)/_cell_size))), _nx - 1); };
+    auto cell_y = [&](const scalar y) { return std::min(static_cast<size_t>(std::max(0.0, std::floor((y - _y_min)/_cell_size))), _ny - 1); };
+
+    // (3) Fill the cells with the segments that overlap their bounding box: count, then place
+    _cell_begin.assign(_nx*_ny + 1, 0);
+
+    auto for_each_cell = [&](const size_t i, auto&& f)
+    {
+        const size_t ix_begin = cell_x(std::min(_points[i].x(), end_point(i).x()));
+        const size_t ix_end   = cell_x(std::max(_points[i].x(), end_point(i).x()));
+        const size_t iy_begin = cell_y(std::min(_points[i].y(), end_point(i).y()));
+        const size_t iy_end   = cell_y(std::max(_points[i].y(), end_point(i).y()));
+
+        for (size_t iy = iy_begin; iy <= iy_end; ++iy)
+            for (size_t ix = ix_begin; ix <= ix_end; ++ix)
+                f(ix + _nx*iy);
+    };
+
+    for (size_t i = 0; i < _n_segments; ++i)
+        for_each_cell(i, [&](const size_t c) { ++_cell_begin[c+1]; });
+
+    for (size_t c = 0; c < _nx*_ny; ++c)
+        _cell_begin[c+1] += _cell_begin[c];
+
+    _segments.resize(_cell_begin.back());
+    std::vector<size_t> cell_position(_cell_begin.cbegin(), _cell_begin.cend() - 1);
+
+    for (size_t i = 0; i < _n_segments; ++i)
+        for_each_cell(i, [&](const size_t c) { _segments[cell_position[c]++] = i; });
+}
+
+
+inline Polyline_spatial_index::Result Polyline_spatial_index::find_closest_point(const sVector3d& p) const
+{
+    Result result;
+    search(result, p, std::numeric_limits<scalar>::infinity(), [](const size_t) { return true; });
+    return result;
+}
+
+
+inline bool Polyline_spatial_index::find_closest_point(Result& result, const sVector3d& p, const scalar maximum_distance) const
+{
+    return search(result, p, maximum_distance*maximum_distance, [](const size_t) { return true; });
+}
+
+
+inline bool Polyline_spatial_index::find_closest_point(Result& result, const sVector3d& p, const scalar maximum_distance, 
+    const size_t i_center, const scalar window_length) const
+{
+    if ( i_center >= _n_segments )
+        throw std::runtime_error("Polyline_spatial_index: the center of the window is not a segment");
+
+    return search(result, p, maximum_distance*maximum_distance, 
+                  [this,i_center,window_length](const size_t i) { return distance_along(i_center, i) <= window_length; });
+}
+
+
+inline scalar Polyline_spatial_index::distance_along(const size_t i_center, const size_t i) const
+{
+    const scalar s_center = _s[i_center];
+    const scalar s_begin  = _s[i];
+    const scalar s_end    = _s[i+1];
+
+    if ( s_center >= s_begin && s_center <= s_end )
+        return 0.0;
+
+    const scalar ahead  = s_begin - s_center;
+    const scalar behind = s_center - s_end;
+
+    if ( !_closed )
+        return (ahead > 0.0 ? ahead : behind);
+
+    // Closed polylines: the segment can be reached in both directions
+    const scalar L = _s.back();
+    return std::min(ahead < 0.0 ? ahead + L : ahead, behind < 0.0 ? behind + L : behind);
+}
+
+
+inline void Polyline_spatial_index::closest_point_in_segment(const size_t i, const sVector3d& p, sVector3d& closest, scalar& dist2) const
+{
+    const sVector3d& a = _points[i];
+    const sVector3d& b = _points[(i + 1) % _points.size()];
+
+    const scalar abx = b.x() - a.x();
+    const scalar aby = b.y() - a.y();
+    const scalar length2 = abx*abx + aby*aby;
+
+    const scalar xi = (length2 > 0.0 ? std::clamp(((p.x() - a.x())*abx + (p.y() - a.y())*aby)/length2, 0.0, 1.0) : 0.0);
+
+    closest = sVector3d(a.x() + xi*abx, a.y() + xi*aby, 0.0);
+    dist2 = (p.x() - closest.x())*(p.x() - closest.x()) + (p.y() - closest.y())*(p.y() - closest.y());
+}
+
+
+template<typename Predicate_t>
+inline bool Polyline_spatial_index::search(Result& result, const sVector3d& p, const scalar dist2_max, const Predicate_t& is_candidate) const
+{
+    if ( _n_segments == 0 )
+        throw std::runtime_error("Polyline_spatial_index: the index is empty");
+
+    // (1) Cell of p, clamped to the grid
+    const scalar fx = std::floor((p.x() - _x_min)/_cell_size);
+    const scalar fy = std::floor((p.y() - _y_min)/_cell_size);
+    const long cx = static_cast<long>(std::clamp(fx, 0.0, static_cast<scalar>(_nx - 1)));
+    const long cy = static_cast<long>(std::clamp(fy, 0.0, static_cast<scalar>(_ny - 1)));
+
+    const long nx = static_cast<long>(_nx);
+    const long ny = static_cast<long>(_ny);
+
+    scalar dist2_best = dist2_max;
+    size_t i_best = _n_segments;
+    sVector3d closest_best;
+
+    auto visit_cell = [&](const long ix, const long iy)
+    {
+        if ( ix < 0 || iy < 0 || ix >= nx || iy >= ny ) return;
+
+        const size_t c = static_cast<size_t>(ix + nx*iy);
+
+        for (size_t k = _cell_begin[c]; k < _cell_begin[c+1]; ++k)
+        {
+            const size_t i = _segments[k];
+
+            if ( !is_candidate(i) ) continue;
+
+            sVector3d closest;
+            scalar dist2;
+            closest_point_in_segment(i, p, closest, dist2);
+
+            if ( (dist2 < dist2_best) || (dist2 == dist2_best && i < i_best) )
+            {
+                dist2_best = dist2;
+                i_best = i;
+                closest_best = closest;
+            }
+        }
+    };
+
+    // (2) Visit rings of cells at Chebyshev distance k from (cx,cy), until no unvisited cell can improve the result
+    for (long k = 0; ; ++k)
+    {
+        if ( k == 0 )
+            visit_cell(cx, cy);
+        else
+        {
+            for (long ix = cx - k; ix <= cx + k; ++ix)
+            {
+                visit_cell(ix, cy - k);
+                visit_cell(ix, cy + k);
+            }
+
+            for (long iy = cy - k + 1; iy <= cy + k - 1; ++iy)
+            {
+                visit_cell(cx - k, iy);
+                visit_cell(cx + k, iy);
+            }
+        }
+
+        // (2.1) All the grid was visited
+        if ( cx - k <= 0 && cy - k <= 0 && cx + k >= nx - 1 && cy + k >= ny - 1 )
+            break;
+
+        // (2.2) Distance from p to the cells outside of the visited block
+        const scalar x_lower = _x_min + (cx - k)*_cell_size;
+        const scalar x_upper = _x_min + (cx + k + 1)*_cell_size;
+        const scalar y_lower = _y_min + (cy - k)*_cell_size;
+        const scalar y_upper = _y_min + (cy + k + 1)*_cell_size;
+
+        const bool is_inside = (p.x() >= x_lower) && (p.x() <= x_upper) && (p.y() >= y_lower) && (p.y() <= y_upper);
+
+        if ( is_inside )
+        {
+            const scalar bound = std::min({p.x() - x_lower, x_upper - p.x(), p.y() - y_lower, y_upper - p.y()});
+
+            if ( bound*bound > dist2_best )
+                break;
+        }
+    }
+
+    if ( i_best == _n_segments )
+        return false;
+
+    const size_t n = _points.size();
+    result = {closest_best, dist2_best, {i_best, (i_best + 1) % n}};
+    return true;
+}
+
+#endif
@@ -0,0 +1,377 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include "lion/foundation/types.h"
+#include "lion/thirdparty/include/cppad/cppad.hpp"
+
+//!     Pool of worker threads
+//!     ----------------------
+//!
+//! Process-wide pool of threads whose tasks can use CppAD: the workers are registered in
+//! CppAD::thread_alloc through thread_number() and in_parallel(), and CppAD::parallel_ad<scalar>()
+//! is called on construction.
+//!
+//! * The pool is constructed on the first call to get(), which shall be done outside any CppAD recording
+//! * Tasks shall release the CppAD objects they create (tapes, AD vectors) before they return
+//! * parallel_for calls can be nested: the calling thread computes the chunks that no worker has taken,
+//!   so that it never waits for a chunk that has not started
+//! * Threads that are not workers use CppAD within the lifetime of a Caller_registration, which
+//!   lends them a free CppAD thread number, so that they do not need to hand their work to the pool
+//! * CppAD memory shall be returned under the thread number it was allocated with. Objects that keep CppAD
+//!   objects between calls from different threads own a Reserved_thread_number, and register the calling
+//!   thread with it during each call
+//!
+class Thread_pool
+{
+ public:
+
+    //! A CppAD thread number taken from the ones of the callers while alive
+    class Reserved_thread_number
+    {
+     public:
+        //! Take a free number. Throws if there is none, since they are only returned when their owners are destroyed
+        Reserved_thread_number();
+        ~Reserved_thread_number();
+
+        Reserved_thread_number(const Reserved_thread_number&) = delete;
+        Reserved_thread_number& operator=(const Reserved_thread_number&) = delete;
+
+        size_t get() const { return _thread_number; }
+
+     private:
+        size_t _thread_number;  //! The reserved number
+    };
+
+    //! Registers the calling thread in CppAD while alive, with a thread number different to the ones of the
+    //! workers and the other registered callers
+    class Caller_registration
+    {
+     public:
+        //! Borrow a free thread number. Nothing is done if the calling thread already has a number
+        Caller_registration();
+
+        //! Use a reserved thread number, even if the calling thread already has a number, which is restored on
+        //! destruction. The caller shall ensure that no other thread uses the reserved number at the same time
+        explicit Caller_registration(const Reserved_thread_number& thread_number);
+
+        ~Caller_registration();
+
+        Caller_registration(const Caller_registration&) = delete;
+        Caller_registration& operator=(const Caller_registration&) = delete;
+
+     private:
+        bool _is_registered = false;        //! If this object set the thread number
+        bool _is_borrowed = false;          //! If the thread number was borrowed from the free ones
+        size_t _previous_thread_number = 0; //! Thread number of the calling thread before the registration
+    };
+
+    //! Get the process-wide pool
+    static Thread_pool& get() { static Thread_pool pool; return pool; }
+
+    //! Number of worker threads
+    size_t size() const { return _workers.size(); }
+
+    //! Submit a task to the pool
+    //! @param[in] f: task, called as f()
+    //! @return a future with the result of the task
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& f);
+
+    //! Call f(begin,end) on contiguous chunks of [0,n) in parallel, and wait for all of them
+    //! The calling thread computes chunks too, and can be a worker
+    //! @param[in] n: number of items
+    //! @param[in] f: function called as f(begin,end)
+    //! @param[in] n_chunks_max: maximum number of chunks. If 0, one chunk per worker + the calling thread
+    template<typename F>
+    void parallel_for_chunks(const size_t n, F&& f, size_t n_chunks_max = 0);
+
+    //! Call f(i) for i in [0,n) in parallel, and wait for all of them
+    template<typename F>
+    void parallel_for(const size_t n, F&& f)
+        { parallel_for_chunks(n, [&f](const size_t begin, const size_t end) { for (size_t i = begin; i < end; ++i) f(i); }); }
+
+    //! Index of the calling thread: 1..size() for the workers, size()+1.. for the registered callers, 0 otherwise
+    static size_t thread_number() { return _thread_number; }
+
+    //! If the pool is executing tasks
+    static bool in_parallel() { return _n_running_tasks.load() > 0; }
+
+ private:
+
+    //! Construct the pool with one worker per hardware thread, and set up CppAD
+    Thread_pool();
+
+    //! Join all the workers
+    ~Thread_pool();
+
+    //! Worker loop
+    void work(const size_t thread_number);
+
+    std::vector<std::thread> _workers;             //! Worker threads
+    std::deque<std::function<void()>> _tasks;      //! Queue of pending tasks
+    std::mutex _mutex;                             //! Protects _tasks and _stop
+    std::condition_variable _condition;            //! Signals new tasks or stop
+    bool _stop = false;                            //! Set by the destructor
+
+    std::vector<size_t> _free_caller_numbers;      //! Thread numbers available for Caller_registration and Reserved_thread_number
+    std::mutex _callers_mutex;                     //! Protects _free_caller_numbers
+    std::condition_variable _caller_released;      //! Signals a thread number returned by a caller
+
+    inline static thread_local size_t _thread_number = 0;   //! Index of the current thread
+    inline static std::atomic<size_t> _n_running_tasks = 0; //! Number of tasks being executed
+};
+
+
+inline Thread_pool::Thread_pool()
+{
+    // (1) Number of workers: one per hardware thread, limited by CppAD. The CppAD threads left are lent to 
+    //     the callers that are not workers
+    size_t n_workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    n_workers = std::min<size_t>(n_workers, (CPPAD_MAX_NUM_THREADS - 1)/2);
+
+    const size_t n_callers = CPPAD_MAX_NUM_THREADS - 1 - n_workers;
+
+    for (size_t i = n_callers; i > 0; --i)
+        _free_caller_numbers.push_back(n_workers + i);
+
+    // (2) Set up CppAD for multithreading, before any worker starts
+    CppAD::thread_alloc::parallel_setup(n_workers + n_callers + 1, in_parallel, thread_number);
+    CppAD::parallel_ad<scalar>();
+
+    // (3) Start the workers
+    for (size_t i = 0; i < n_workers; ++i)
+        _workers.emplace_back(&Thread_pool::work, this, i+1);
+}
+
+
+inline Thread_pool::~Thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+
+    _condition.notify_all();
+
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+
+inline Thread_pool::Reserved_thread_number::Reserved_thread_number()
+{
+    auto& pool = get();
+
+    std::lock_guard<std::mutex> lock(pool._callers_mutex);
+
+    if ( pool._free_caller_numbers.empty() )
+        throw std::runtime_error("Thread_pool: there are no CppAD thread numbers left to reserve");
+
+    _thread_number = pool._free_caller_numbers.back();
+    pool._free_caller_numbers.pop_back();
+}
+
+
+inline Thread_pool::Reserved_thread_number::~Reserved_thread_number()
+{
+    auto& pool = get();
+
+    {
+        std::lock_guard<std::mutex> lock(pool._callers_mutex);
+        pool._free_caller_numbers.push_back(_thread_number);
+    }
+
+    pool._caller_released.notify_one();
+}
+
+
+inline Thread_pool::Caller_registration::Caller_registration()
+{
+    if ( _thread_number != 0 )
+        return;
+
+    auto& pool = get();
+
+    std::unique_lock<std::mutex> lock(pool._callers_mutex);
+    pool._caller_released.wait(lock, [&pool]() { return !pool._free_caller_numbers.empty(); });
+
+    // CppAD is in parallel mode while a caller is registered
+    ++_n_running_tasks;
+    _thread_number = pool._free_caller_numbers.back();
+    pool._free_caller_numbers.pop_back();
+    _is_registered = true;
+    _is_borrowed = true;
+}
+
+
+inline Thread_pool::Caller_registration::Caller_registration(const Reserved_thread_number& thread_number)
+{
+    // CppAD is in parallel mode while a caller is registered
+    ++_n_running_tasks;
+    _previous_thread_number = _thread_number;
+    _thread_number = thread_number.get();
+    _is_registered = true;
+}
+
+
+inline Thread_pool::Caller_registration::~Caller_registration()
+{
+    if ( !_is_registered )
+        return;
+
+    if ( !_is_borrowed )
+    {
+        _thread_number = _previous_thread_number;
+        --_n_running_tasks;
+        return;
+    }
+
+    auto& pool = get();
+
+    {
+        std::lock_guard<std::mutex> lock(pool._callers_mutex);
+        pool._free_caller_numbers.push_back(_thread_number);
+        _thread_number = 0;
+        --_n_running_tasks;
+    }
+
+    pool._caller_released.notify_one();
+}
+
+
+inline void Thread_pool::work(const size_t thread_number)
+{
+    _thread_number = thread_number;
+
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+
+            if ( _stop && _tasks.empty() )
+                return;
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+
+template<typename F>
+inline std::future<std::invoke_result_t<F>> Thread_pool::submit(F&& f)
+{
+    using result_type = std::invoke_result_t<F>;
+
+    auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(f));
+    auto result = task->get_future();
+
+    // The task counts as running since it is submitted, so that CppAD is in parallel mode before it starts
+    ++_n_running_tasks;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if ( _stop )
+        {
+            --_n_running_tasks;
+            throw std::runtime_error("Thread_pool: tasks cannot be submitted to a stopped pool");
+        }
+
+        _tasks.emplace_back([task]() { (*task)(); --_n_running_tasks; });
+    }
+
+    _condition.notify_one();
+
+    return result;
+}
+
+
+template<typename F>
+inline void Thread_pool::parallel_for_chunks(const size_t n, F&& f, size_t n_chunks_max)
+{
+    if ( n == 0 )
+        return;
+
+    // (1) Compute the chunks
+    if ( n_chunks_max == 0 )
+        n_chunks_max = size() + 1;
+
+    const size_t chunk_size = (n + std::min(n, n_chunks_max) - 1)/std::min(n, n_chunks_max);
+    const size_t n_chunks = (n + chunk_size - 1)/chunk_size;
+
+    if ( n_chunks == 1 || size() == 0 )
+    {
+        f(size_t(0),n);
+        return;
+    }
+
+    // (2) Chunks are taken in order by whoever is free: the workers that pick a helper task, and this thread.
+    //     Helper tasks that start after all the chunks are taken return without calling f
+    struct Loop_state
+    {
+        std::atomic<size_t> next_chunk = 0;
+        size_t n_finished_chunks = 0;
+        std::exception_ptr first_exception;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto state = std::make_shared<Loop_state>();
+
+    auto run_chunks = [state, &f, n, chunk_size, n_chunks]()
+    {
+        for (size_t chunk = state->next_chunk++; chunk < n_chunks; chunk = state->next_chunk++)
+        {
+            std::exception_ptr exception;
+
+            try
+            {
+                f(chunk*chunk_size, std::min((chunk+1)*chunk_size, n));
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            if ( exception && !state->first_exception ) 
+                state->first_exception = exception;
+
+            if ( ++state->n_finished_chunks == n_chunks )
+                state->finished.notify_all();
+        }
+    };
+
+    // (3) Submit the helper tasks, and compute chunks in this thread, which is in parallel mode meanwhile
+    for (size_t i = 1; i < n_chunks; ++i)
+        submit(run_chunks);
+
+    ++_n_running_tasks;
+    run_chunks();
+    --_n_running_tasks;
+
+    // (4) Wait for the chunks taken by the workers, and rethrow the first exception found
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state, n_chunks]() { return state->n_finished_chunks == n_chunks; });
+
+    if ( state->first_exception )
+        std::rethrow_exception(state->first_exception);
+}
+
+#endif
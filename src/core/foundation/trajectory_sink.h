@@ -0,0 +1,323 @@
+#ifndef __TRAJECTORY_SINK_H__
+#define __TRAJECTORY_SINK_H__
+
+#include <array>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+#include "lion/foundation/types.h"
+
+//!     Destination of the points of a trajectory
+//!     ------------------------------------------
+//!
+//! Receives the points (t,q) of a simulation, in increasing t, as they are computed
+//!
+template<size_t NSTATE>
+class Trajectory_sink
+{
+ public:
+    virtual ~Trajectory_sink() = default;
+
+    //! Receive one point of the trajectory
+    virtual void write(const scalar t, const std::array<scalar,NSTATE>& q) = 0;
+
+    //! Called at the end of a simulation: all the points received shall be processed on return
+    virtual void flush() {}
+};
+
+
+//!     Bounded ring buffer of trajectory points
+//!     -----------------------------------------
+//!
+//! Keeps the last capacity() points received. Its memory does not grow with the length of the simulation
+//!
+template<size_t NSTATE>
+class Trajectory_ring_buffer : public Trajectory_sink<NSTATE>
+{
+ public:
+    //! Constructor
+    //! @param[in] capacity: maximum number of points stored
+    Trajectory_ring_buffer(const size_t capacity) : _t(capacity), _q(capacity)
+        { if ( capacity == 0 ) throw std::runtime_error("Trajectory_ring_buffer: capacity shall be greater than 0"); }
+
+    void write(const scalar t, const std::array<scalar,NSTATE>& q) override
+    {
+        _t[_head] = t;
+        _q[_head] = q;
+        _head = (_head + 1) % capacity();
+        _size = std::min(_size + 1, capacity());
+        ++_n_received;
+    }
+
+    //! Maximum number of points stored
+    size_t capacity() const { return _t.size(); }
+
+    //! Number of points stored
+    size_t size() const { return _size; }
+
+    //! Number of points received since construction or clear()
+    size_t n_received() const { return _n_received; }
+
+    //! Time of the i-th stored point, from the oldest (i = 0) to the newest (i = size()-1)
+    scalar get_t(const size_t i) const { return _t[index(i)]; }
+
+    //! States of the i-th stored point, from the oldest (i = 0) to the newest (i = size()-1)
+    const std::array<scalar,NSTATE>& get_q(const size_t i) const { return _q[index(i)]; }
+
+    //! Discard all the points
+    void clear() { _head = 0; _size = 0; _n_received = 0; }
+
+ private:
+
+    //! Position in storage of the i-th stored point
+    size_t index(const size_t i) const
+    {
+        if ( i >= _size )
+            throw std::out_of_range("Trajectory_ring_buffer: index " + std::to_string(i) + " out of range, size = " + std::to_string(_size));
+
+        return (_head + capacity() - _size + i) % capacity();
+    }
+
+    std::vector<scalar> _t;                         //! Times, circular storage
+    std::vector<std::array<scalar,NSTATE>> _q;      //! States, circular storage
+    size_t _head = 0;                               //! Position of the next point
+    size_t _size = 0;                               //! Number of points stored
+    size_t _n_received = 0;                         //! Number of points received
+};
+
+
+//!     Streaming writer of trajectory points
+//!     -------------------------------------
+//!
+//! Writes the points to a file from a background thread. The points are packed in blocks: the simulation
+//! only copies them into the current block, and hands it to the writer thread when full. At most
+//! max_pending_blocks blocks wait to be written, which bounds the memory used if the disk is slower than
+//! the simulation.
+//!
+//! Formats:
+//!  - CSV: one line per point "t,q[0],...,q[NSTATE-1]", after a header line with the column names
+//!  - BINARY: the magic "FLTRAJ01", the number of columns (NSTATE+1) as uint64, and then the points as
+//!    rows of native doubles [t,q[0],...,q[NSTATE-1]]
+//!
+template<size_t NSTATE>
+class Trajectory_file_writer : public Trajectory_sink<NSTATE>
+{
+ public:
+    enum Format { CSV, BINARY };
+
+    //! Constructor: opens the file and starts the writer thread
+    //! @param[in] file_name: the output file, overwritten
+    //! @param[in] format: CSV or BINARY
+    //! @param[in] column_names: names of the states for the CSV header. If empty, q[0],...,q[NSTATE-1]
+    //! @param[in] block_size: number of points per block
+    //! @param[in] max_pending_blocks: maximum number of full blocks waiting to be written
+    Trajectory_file_writer(const std::string& file_name, const Format format, const std::vector<std::string>& column_names = {},
+                           const size_t block_size = 4096, const size_t max_pending_blocks = 4);
+
+    //! Destructor: writes the remaining points and joins the writer thread
+    ~Trajectory_file_writer();
+
+    Trajectory_file_writer(const Trajectory_file_writer&) = delete;
+    Trajectory_file_writer& operator=(const Trajectory_file_writer&) = delete;
+
+    void write(const scalar t, const std::array<scalar,NSTATE>& q) override;
+
+    //! Write all the points received, and flush the file. Throws if a write failed
+    void flush() override;
+
+ private:
+
+    //! Hand the current block to the writer thread, waiting if too many blocks are pending
+    void submit_block();
+
+    //! Writer thread loop
+    void work();
+
+    //! Write one block to the file
+    void write_block(const std::vector<scalar>& block);
+
+    std::ofstream _file;                            //! The output file
+    Format _format;                                 //! Its format
+    size_t _block_size;                             //! Number of points per block
+    size_t _max_pending_blocks;                     //! Maximum number of pending blocks
+
+    std::vector<scalar> _current_block;             //! Block being filled by the simulation
+    std::deque<std::vector<scalar>> _pending;       //! Full blocks waiting to be written
+    std::vector<std::vector<scalar>> _free_blocks;  //! Written blocks, reused to avoid reallocations
+    bool _is_writing = false;                       //! If the writer thread is writing a block
+    bool _stop = false;                             //! Set by the destructor
+    bool _failed = false;                           //! Set if a write failed
+
+    std::mutex _mutex;                              //! Protects the shared state
+    std::condition_variable _condition;             //! Signals changes of the shared state
+    std::thread _writer;                            //! Writer thread
+};
+
+
+template<size_t NSTATE>
+inline Trajectory_file_writer<NSTATE>::Trajectory_file_writer(const std::string& file_name, const Format format,
+    const std::vector<std::string>& column_names, const size_t block_size, const size_t max_pending_blocks)
+: _file(file_name, (format == BINARY ? std::ios::out | std::ios::binary : std::ios::out)),
+  _format(format),
+  _block_size(std::max<size_t>(block_size,1)),
+  _max_pending_blocks(std::max<size_t>(max_pending_blocks,1))
+{
+    if ( !_file )
+        throw std::runtime_error("Trajectory_file_writer: could not open file \"" + file_name + "\"");
+
+    if ( !column_names.empty() && column_names.size() != NSTATE )
+        throw std::runtime_error("Trajectory_file_writer: " + std::to_string(column_names.size()) + " column names were provided, "
+            + std::to_string(NSTATE) + " were expected");
+
+    // (1) Write the header
+    if ( _format == CSV )
+    {
+        _file << "t";
+        for (size_t i = 0; i < NSTATE; ++i)
+            _file << "," << (column_names.empty() ? "q[" + std::to_string(i) + "]" : column_names[i]);
+        _file << std::endl;
+
+        _file.precision(17);
+    }
+    else
+    {
+        const uint64_t n_columns = NSTATE + 1;
+        _file.write("FLTRAJ01", 8);
+        _file.write(reinterpret_cast<const char*>(&n_columns), sizeof(uint64_t));
+    }
+
+    // (2) Start the writer thread
+    _current_block.reserve(_block_size*(NSTATE+1));
+    _writer = std::thread([this]() { work(); });
+}
+
+
+template<size_t NSTATE>
+inline Trajectory_file_writer<NSTATE>::~Trajectory_file_writer()
+{
+    if ( !_current_block.empty() )
+        submit_block();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+
+    _condition.notify_all();
+    _writer.join();
+}
+
+
+template<size_t NSTATE>
+inline void Trajectory_file_writer<NSTATE>::write(const scalar t, const std::array<scalar,NSTATE>& q)
+{
+    _current_block.push_back(t);
+    _current_block.insert(_current_block.end(), q.cbegin(), q.cend());
+
+    if ( _current_block.size() == _block_size*(NSTATE+1) )
+        submit_block();
+}
+
+
+template<size_t NSTATE>
+inline void Trajectory_file_writer<NSTATE>::flush()
+{
+    if ( !_current_block.empty() )
+        submit_block();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() { return _pending.empty() && !_is_writing; });
+
+    _file.flush();
+
+    if ( _failed || !_file )
+        throw std::runtime_error("Trajectory_file_writer: failed to write the trajectory");
+}
+
+
+template<size_t NSTATE>
+inline void Trajectory_file_writer<NSTATE>::submit_block()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() { return _pending.size() < _max_pending_blocks; });
+
+    _pending.push_back(std::move(_current_block));
+
+    // Reuse the storage of a written block if available
+    if ( _free_blocks.empty() )
+        _current_block = std::vector<scalar>();
+    else
+    {
+        _current_block = std::move(_free_blocks.back());
+        _free_blocks.pop_back();
+    }
+
+    _current_block.clear();
+    _current_block.reserve(_block_size*(NSTATE+1));
+
+    lock.unlock();
+    _condition.notify_all();
+}
+
+
+template<size_t NSTATE>
+inline void Trajectory_file_writer<NSTATE>::work()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _condition.wait(lock, [this]() { return _stop || !_pending.empty(); });
+
+        if ( _pending.empty() )
+            return;
+
+        // (1) Take the oldest block, and write it without holding the lock
+        auto block = std::move(_pending.front());
+        _pending.pop_front();
+        _is_writing = true;
+
+        lock.unlock();
+        _condition.notify_all();
+
+        write_block(block);
+
+        lock.lock();
+        _is_writing = false;
+
+        if ( !_file ) _failed = true;
+
+        // (2) Keep its storage for the next blocks
+        _free_blocks.push_back(std::move(block));
+
+        _condition.notify_all();
+    }
+}
+
+
+template<size_t NSTATE>
+inline void Trajectory_file_writer<NSTATE>::write_block(const std::vector<scalar>& block)
+{
+    if ( _format == BINARY )
+    {
+        _file.write(reinterpret_cast<const char*>(block.data()), block.size()*sizeof(scalar));
+        return;
+    }
+
+    for (size_t i = 0; i < block.size(); i += NSTATE+1)
+    {
+        _file << block[i];
+        for (size_t j = 1; j <= NSTATE; ++j)
+            _file << "," << block[i+j];
+        _file << "\n";
+    }
+}
+
+#endif
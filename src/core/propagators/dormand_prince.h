@@ -0,0 +1,98 @@
+#ifndef __DORMAND_PRINCE_H__
+#define __DORMAND_PRINCE_H__
+
+#include <array>
+#include "lion/foundation/types.h"
+
+//!     Dormand-Prince 5(4) explicit propagator
+//!     ---------------------------------------
+//!
+//! Adaptive explicit Runge-Kutta scheme for dqdt = vehicle(q,control(q,t),t). The fifth order solution is
+//! propagated, and the embedded fourth order solution is used to estimate the local error.
+//!
+//! Contrary to lion's ODE45, whose settings are process-wide, the options are owned by each instance. Hence
+//! different instances can be used concurrently from different threads. The last stage of an accepted step
+//! is reused as the first stage of the next one (FSAL) if the next step starts where the previous ended.
+//!
+//! If dense output is enabled, the solution can be interpolated within the last accepted step with
+//! Dormand and Prince's fourth order continuous extension, at no extra evaluation of the vehicle
+//!
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+class Dormand_prince
+{
+ public:
+    using Timeseries_t = typename Dynamic_model_t::Timeseries_type;
+
+    struct Options
+    {
+        scalar max_h          = 0.01;       //! Maximum step size
+        scalar relative_error = 1.0e-8;     //! Relative tolerance of the local error
+        scalar absolute_error = 1.0e-6;     //! Absolute tolerance of the local error
+        scalar min_h          = 1.0e-12;    //! Steps smaller than this throw an exception
+        scalar safety_factor  = 0.9;        //! Safety factor of the step size controller
+        scalar maximum_growth = 5.0;        //! Maximum ratio between consecutive step sizes
+        scalar minimum_shrink = 0.2;        //! Minimum ratio between consecutive step sizes
+        bool dense_output     = false;      //! Store the interpolation coefficients of each accepted step
+    };
+
+    struct Statistics
+    {
+        size_t n_steps                = 0;  //! Number of accepted steps
+        size_t n_rejected_steps       = 0;  //! Number of rejected steps
+        size_t n_function_evaluations = 0;  //! Number of evaluations of the vehicle
+    };
+
+    //! Constructor
+    //! @param[in] options: the integrator options
+    Dormand_prince(const Options& options = Options()) : _options(options) {}
+
+    //! Take one accepted step, same interface as lion's ODE45::take_step
+    //! @param[in] vehicle: the vehicle, evaluated as dqdt = vehicle(q,u,t)
+    //! @param[in] control: the controls, evaluated as u = control(q,t)
+    //! @param[in,out] q: states at t on input, at t + h on output
+    //! @param[in,out] t: time at the start of the step on input, at the end on output
+    //! @param[in,out] dt: proposed step size on input, proposed size of the next step on output
+    //! @param[in] t_final: final time, which the step will not overshoot
+    //! @param[out] t_end_reached: true if t == t_final on output
+    void take_step(Dynamic_model_t& vehicle, const Control_t& control, std::array<Timeseries_t,NSTATE>& q, scalar& t, scalar& dt,
+                   const scalar t_final, bool& t_end_reached);
+
+    //! Interpolate the solution within the last accepted step. Requires dense_output
+    //! @param[in] t: time in [t_start,t_end] of the last accepted step
+    std::array<Timeseries_t,NSTATE> interpolate(const scalar t) const;
+
+    //! Get the options
+    const Options& get_options() const { return _options; }
+
+    //! Set the options
+    void set_options(const Options& options) { _options = options; }
+
+    //! Get the statistics
+    const Statistics& get_statistics() const { return _statistics; }
+
+    //! Discard the stored last stage. To be called if the vehicle or the controls are modified
+    void reset() { _is_last_stage_valid = false; }
+
+ private:
+
+    //! Evaluate dqdt = vehicle(q,control(q,t),t)
+    std::array<Timeseries_t,NSTATE> evaluate(Dynamic_model_t& vehicle, const Control_t& control, const std::array<Timeseries_t,NSTATE>& q,
+                                             const scalar t);
+
+    Options _options;                                   //! The options
+    Statistics _statistics;                             //! The statistics
+
+    std::array<Timeseries_t,NSTATE> _last_stage;        //! Time derivative at the end of the last accepted step
+    std::array<Timeseries_t,NSTATE> _q_last;            //! States at the end of the last accepted step
+    scalar _t_last = 0.0;                               //! Time at the end of the last accepted step
+    bool _is_last_stage_valid = false;                  //! If _last_stage can be reused
+
+    std::array<std::array<Timeseries_t,NSTATE>,5> _dense; //! Interpolation coefficients of the last accepted step
+    scalar _t_dense = 0.0;                              //! Time at the start of the last accepted step
+    scalar _h_dense = 0.0;                              //! Size of the last accepted step
+    bool _is_dense_valid = false;                       //! If _dense was computed
+};
+
+#include "dormand_prince.hpp"
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef __DORMAND_PRINCE_HPP__
+#define __DORMAND_PRINCE_HPP__
+
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline void Dormand_prince<Dynamic_model_t,Control_t,NSTATE>::take_step(Dynamic_model_t& vehicle, const Control_t& control,
+    std::array<Timeseries_t,NSTATE>& q, scalar& t, scalar& dt, const scalar t_final, bool& t_end_reached)
+{
+    // Butcher tableau
+    constexpr scalar c2 = 1.0/5.0, c3 = 3.0/10.0, c4 = 4.0/5.0, c5 = 8.0/9.0;
+
+    constexpr scalar a21 = 1.0/5.0;
+    constexpr scalar a31 = 3.0/40.0, a32 = 9.0/40.0;
+    constexpr scalar a41 = 44.0/45.0, a42 = -56.0/15.0, a43 = 32.0/9.0;
+    constexpr scalar a51 = 19372.0/6561.0, a52 = -25360.0/2187.0, a53 = 64448.0/6561.0, a54 = -212.0/729.0;
+    constexpr scalar a61 = 9017.0/3168.0, a62 = -355.0/33.0, a63 = 46732.0/5247.0, a64 = 49.0/176.0, a65 = -5103.0/18656.0;
+    constexpr scalar a71 = 35.0/384.0, a73 = 500.0/1113.0, a74 = 125.0/192.0, a75 = -2187.0/6784.0, a76 = 11.0/84.0;
+
+    // Difference between the fifth and fourth order weights
+    constexpr scalar e1 = 71.0/57600.0, e3 = -71.0/16695.0, e4 = 71.0/1920.0, e5 = -17253.0/339200.0, e6 = 22.0/525.0, e7 = -1.0/40.0;
+
+    // (1) Get the first stage: reuse the last stage of the previous step if it ended here
+    std::array<Timeseries_t,NSTATE> k1;
+
+    if ( _is_last_stage_valid && (t == _t_last) && (q == _q_last) )
+        k1 = _last_stage;
+    else
+        k1 = evaluate(vehicle, control, q, t);
+
+    t_end_reached = false;
+
+    std::array<Timeseries_t,NSTATE> k2, k3, k4, k5, k6, k7, q_stage, q_new;
+
+    while (true)
+    {
+        // (2) Compute the step size: bounded by max_h, and do not overshoot t_final
+        const scalar h_proposed = std::min(dt, _options.max_h);
+        scalar h = h_proposed;
+        const bool is_last_step = (t + h >= t_final - 1.0e-12*std::max(1.0,std::abs(t_final)));
+
+        if ( is_last_step )
+            h = t_final - t;
+
+        if ( h < _options.min_h )
+            throw std::runtime_error("Dormand_prince: step size " + std::to_string(h) + " is below the minimum at t = " + std::to_string(t));
+
+        // (3) Compute the stages
+        for (size_t i = 0; i < NSTATE; ++i) q_stage[i] = q[i] + h*a21*k1[i];
+        k2 = evaluate(vehicle, control, q_stage, t + c2*h);
+
+        for (size_t i = 0; i < NSTATE; ++i) q_stage[i] = q[i] + h*(a31*k1[i] + a32*k2[i]);
+        k3 = evaluate(vehicle, control, q_stage, t + c3*h);
+
+        for (size_t i = 0; i < NSTATE; ++i) q_stage[i] = q[i] + h*(a41*k1[i] + a42*k2[i] + a43*k3[i]);
+        k4 = evaluate(vehicle, control, q_stage, t + c4*h);
+
+        for (size_t i = 0; i < NSTATE; ++i) q_stage[i] = q[i] + h*(a51*k1[i] + a52*k2[i] + a53*k3[i] + a54*k4[i]);
+        k5 = evaluate(vehicle, control, q_stage, t + c5*h);
+
+        for (size_t i = 0; i < NSTATE; ++i) q_stage[i] = q[i] + h*(a61*k1[i] + a62*k2[i] + a63*k3[i] + a64*k4[i] + a65*k5[i]);
+        k6 = evaluate(vehicle, control, q_stage, t + h);
+
+        for (size_t i = 0; i < NSTATE; ++i) q_new[i] = q[i] + h*(a71*k1[i] + a73*k3[i] + a74*k4[i] + a75*k5[i] + a76*k6[i]);
+        k7 = evaluate(vehicle, control, q_new, t + h);
+
+        // (4) Estimate the local error, scaled by the tolerances
+        scalar error = 0.0;
+        for (size_t i = 0; i < NSTATE; ++i)
+        {
+            const scalar error_i = Value(h*(e1*k1[i] + e3*k3[i] + e4*k4[i] + e5*k5[i] + e6*k6[i] + e7*k7[i]));
+            const scalar tolerance_i = _options.absolute_error
+                                     + _options.relative_error*std::max(std::abs(Value(q[i])), std::abs(Value(q_new[i])));
+
+            error += (error_i/tolerance_i)*(error_i/tolerance_i);
+        }
+        error = std::sqrt(error/NSTATE);
+
+        // (5) Propose the next step size
+        const scalar factor = (error > 0.0 ? _options.safety_factor*std::pow(error,-0.2) : _options.maximum_growth);
+
+        if ( error <= 1.0 )
+        {
+            // (5.1) Accept the step
+            if ( _options.dense_output )
+            {
+                constexpr scalar d1 = -12715105075.0/11282082432.0, d3 = 87487479700.0/32700410799.0, d4 = -10690763975.0/1880347072.0,
+                                 d5 = 701980252875.0/199316789632.0, d6 = -1453857185.0/822651844.0, d7 = 69997945.0/29380423.0;
+
+                for (size_t i = 0; i < NSTATE; ++i)
+                {
+                    const Timeseries_t dq = q_new[i] - q[i];
+                    const Timeseries_t b = h*k1[i] - dq;
+
+                    _dense[0][i] = q[i];
+                    _dense[1][i] = dq;
+                    _dense[2][i] = b;
+                    _dense[3][i] = dq - h*k7[i] - b;
+                    _dense[4][i] = h*(d1*k1[i] + d3*k3[i] + d4*k4[i] + d5*k5[i] + d6*k6[i] + d7*k7[i]);
+                }
+
+                _t_dense = t;
+                _h_dense = h;
+                _is_dense_valid = true;
+            }
+
+            q = q_new;
+            t = (is_last_step ? t_final : t + h);
+            t_end_reached = is_last_step;
+
+            // The next step is not limited by the truncation to t_final
+            dt = h_proposed*std::min(factor, _options.maximum_growth);
+
+            _last_stage = k7;
+            _q_last = q;
+            _t_last = t;
+            _is_last_stage_valid = true;
+
+            ++_statistics.n_steps;
+            return;
+        }
+
+        // (5.2) Reject the step, and try again with a smaller one
+        dt = h*std::max(factor, _options.minimum_shrink);
+        ++_statistics.n_rejected_steps;
+    }
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline std::array<typename Dynamic_model_t::Timeseries_type,NSTATE> Dormand_prince<Dynamic_model_t,Control_t,NSTATE>::interpolate(const scalar t) const
+{
+    if ( !_is_dense_valid )
+        throw std::runtime_error("Dormand_prince: interpolate requires dense_output and an accepted step");
+
+    const scalar theta = (t - _t_dense)/_h_dense;
+    const scalar theta1 = 1.0 - theta;
+
+    std::array<Timeseries_t,NSTATE> q;
+
+    for (size_t i = 0; i < NSTATE; ++i)
+        q[i] = _dense[0][i] + theta*(_dense[1][i] + theta1*(_dense[2][i] + theta*(_dense[3][i] + theta1*_dense[4][i])));
+
+    return q;
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline std::array<typename Dynamic_model_t::Timeseries_type,NSTATE> Dormand_prince<Dynamic_model_t,Control_t,NSTATE>::evaluate(Dynamic_model_t& vehicle,
+    const Control_t& control, const std::array<Timeseries_t,NSTATE>& q, const scalar t)
+{
+    ++_statistics.n_function_evaluations;
+
+    return vehicle(q, control(q,t), t);
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef __DORMAND_PRINCE_SENSITIVITY_H__
+#define __DORMAND_PRINCE_SENSITIVITY_H__
+
+#include <array>
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include "lion/foundation/types.h"
+#include "lion/thirdparty/include/cppad/cppad.hpp"
+
+//!     Sensitivities of the Dormand-Prince propagator
+//!     ----------------------------------------------
+//!
+//! Derivatives of the solution of dqdt = vehicle(q,control(t),t) with respect to the parameters x of the
+//! controls, and to a set of parameters of the vehicle, along the steps t_0,...,t_N of a nominal solution 
+//! computed with Dormand_prince. The derivatives are sorted as [controls, vehicle parameters].
+//!
+//! The steps of the scheme are differentiated exactly (discrete sensitivities), so that the gradients are
+//! those of the computed solution up to the accuracy of the Jacobians of the vehicle. The step sizes are kept 
+//! fixed, as accepted by the nominal solution.
+//!
+//! * forward(): propagates dq/dx along with q. Cost proportional to the number of parameters
+//! * adjoint(): propagates the gradient of a function of the final states backwards. The forward states are
+//!   stored every checkpoint_interval steps, and recomputed within each interval during the backward sweep.
+//!   Memory is O(N/checkpoint_interval + checkpoint_interval) states
+//!
+//! The Jacobians of the vehicle w.r.t. the states and controls are:
+//! * AD vehicles (Timeseries_t = CppAD::AD<scalar>): exact, from CppAD. Vehicles with a recorded equations tape
+//!   (Dynamic_model_car without algebraic equations) reuse it, the others are recorded at each evaluation
+//! * scalar vehicles: central differences, with steps cbrt(eps).max(1,|x|). The gradients are then only accurate to
+//!   about 1e-5 (relative) for the vehicles of this repository, since the round-off error is amplified by the
+//!   scaling of the states and by the tire models. Use the AD vehicle for exact gradients
+//!
+//! The vehicle parameters are scalar constants of the models, so their Jacobian is always computed by central 
+//! differences, with vehicle.set_parameter(name,value). A copy of the vehicle is perturbed, such that its recorded 
+//! tapes are not invalidated.
+//!
+//! The controls shall only depend on time, and provide control.jacobian(t,dudx), with dudx row-major [NCONTROL x n_parameters]
+//!
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+class Dormand_prince_sensitivity
+{
+    //! If the vehicle provides the equations() tape, and has no algebraic equations
+    template<typename T, typename = void>
+    struct has_equations_tape : std::false_type {};
+
+    template<typename T>
+    struct has_equations_tape<T,std::void_t<decltype(&T::reset_equations_tape),decltype(T::NALGEBRAIC)>> 
+        : std::bool_constant<T::NALGEBRAIC == 0> {};
+
+ public:
+    using Timeseries_t = typename Dynamic_model_t::Timeseries_type;
+
+    constexpr static size_t NCONTROL = Dynamic_model_t::NCONTROL;
+
+    //! Number of inputs of the vehicle: [q,u]
+    constexpr static size_t NINPUTS = NSTATE + NCONTROL;
+
+    //! Number of stages that contribute to the solution (the seventh is only used by the error estimator)
+    constexpr static size_t NSTAGES = 6;
+
+    //! Constructor
+    //! @param[in] n_parameters: number of parameters of the controls
+    //! @param[in] checkpoint_interval: number of steps between stored states in adjoint()
+    //! @param[in] vehicle_parameters: names and nominal values of the vehicle parameters to differentiate
+    Dormand_prince_sensitivity(const size_t n_parameters, const size_t checkpoint_interval = 50,
+                               const std::vector<std::pair<std::string,scalar>>& vehicle_parameters = {})
+        : _n_parameters(n_parameters), _checkpoint_interval(std::max<size_t>(checkpoint_interval,1)),
+          _vehicle_parameters(vehicle_parameters) {}
+
+    //! Number of derivatives: parameters of the controls, and of the vehicle
+    size_t number_of_derivatives() const { return _n_parameters + _vehicle_parameters.size(); }
+
+    //! Propagate the states and their sensitivities
+    //! @param[in] times: t_0,...,t_N, the steps of the nominal solution
+    //! @param[in,out] q: states at t_0 on input, at t_N on output
+    //! @param[out] dqdx: sensitivities at t_N, row-major [NSTATE x number_of_derivatives()]. The initial states do not depend on x
+    void forward(Dynamic_model_t& vehicle, const Control_t& control, const std::vector<scalar>& times, std::array<scalar,NSTATE>& q,
+                 std::vector<scalar>& dqdx) const;
+
+    //! Compute the gradient of a function of the final states
+    //! @param[in] times: t_0,...,t_N, the steps of the nominal solution
+    //! @param[in] q0: states at t_0
+    //! @param[in] dJdq: gradient of the function w.r.t. the states at t_N
+    //! @param[out] dJdx: gradient w.r.t. the parameters [number_of_derivatives()]
+    //! @param[out] dJdq0: gradient w.r.t. the states at t_0
+    //! @return the states at t_N
+    std::array<scalar,NSTATE> adjoint(Dynamic_model_t& vehicle, const Control_t& control, const std::vector<scalar>& times,
+                                      const std::array<scalar,NSTATE>& q0, const std::array<scalar,NSTATE>& dJdq,
+                                      std::vector<scalar>& dJdx, std::array<scalar,NSTATE>& dJdq0) const;
+
+    //! Evaluate the vehicle and its Jacobians: with CppAD for AD vehicles, by central differences otherwise
+    //! @param[out] dqdt: time derivative of the states
+    //! @param[out] jac_q: Jacobian w.r.t. the states, row-major [NSTATE x NSTATE]
+    //! @param[out] jac_u: Jacobian w.r.t. the controls, row-major [NSTATE x NCONTROL]
+    static void jacobian(Dynamic_model_t& vehicle, const std::array<scalar,NSTATE>& q, const std::array<scalar,NCONTROL>& u, const scalar t,
+                         std::array<scalar,NSTATE>& dqdt, std::array<scalar,NSTATE*NSTATE>& jac_q, std::array<scalar,NSTATE*NCONTROL>& jac_u);
+
+ private:
+
+    //! The stages of one step, with the Jacobians of the vehicle at each of them
+    struct Stages
+    {
+        std::array<std::array<scalar,NSTATE>,NSTAGES> k;                //! Time derivatives
+        std::array<std::array<scalar,NSTATE*NSTATE>,NSTAGES> jac_q;     //! Jacobians w.r.t. the states
+        std::array<std::array<scalar,NSTATE*NCONTROL>,NSTAGES> jac_u;   //! Jacobians w.r.t. the controls
+        std::array<std::vector<scalar>,NSTAGES> dudx;                   //! Derivatives of the controls w.r.t. the parameters
+        std::array<std::vector<scalar>,NSTAGES> jac_p;                  //! Jacobians w.r.t. the vehicle parameters
+    };
+
+    //! Compute the Jacobian of the vehicle w.r.t. the vehicle parameters by central differences
+    //! @param[in,out] vehicle: the vehicle to perturb. The nominal values are restored on exit
+    //! @param[out] jac_p: row-major [NSTATE x n_vehicle_parameters]
+    void parameter_jacobian(Dynamic_model_t& vehicle, const std::array<scalar,NSTATE>& q, const std::array<scalar,NCONTROL>& u,
+                            const scalar t, std::vector<scalar>& jac_p) const;
+
+    //! Evaluate the vehicle
+    static std::array<scalar,NSTATE> evaluate(Dynamic_model_t& vehicle, const std::array<scalar,NSTATE>& q,
+                                              const std::array<scalar,NCONTROL>& u, const scalar t);
+
+    //! Get the values of the controls
+    static std::array<scalar,NCONTROL> get_controls(const Control_t& control, const std::array<scalar,NSTATE>& q, const scalar t);
+
+    //! Take one step of the scheme without Jacobians
+    static void step(Dynamic_model_t& vehicle, const Control_t& control, std::array<scalar,NSTATE>& q, const scalar t, const scalar h);
+
+    //! Compute the stages of one step with their Jacobians. Returns the states at the end of the step
+    //! @param[in,out] vehicle_perturbed: copy of the vehicle used for the Jacobian w.r.t. the vehicle parameters
+    std::array<scalar,NSTATE> compute_stages(Dynamic_model_t& vehicle, Dynamic_model_t& vehicle_perturbed, const Control_t& control,
+                                             const std::array<scalar,NSTATE>& q, const scalar t, const scalar h, Stages& stages) const;
+
+    size_t _n_parameters;           //! Number of parameters of the controls
+    size_t _checkpoint_interval;    //! Number of steps between stored states in adjoint()
+    std::vector<std::pair<std::string,scalar>> _vehicle_parameters;   //! Names and nominal values of the vehicle parameters
+};
+
+#include "dormand_prince_sensitivity.hpp"
+
+#endif
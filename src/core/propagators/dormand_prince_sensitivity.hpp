@@ -0,0 +1,423 @@
+#ifndef __DORMAND_PRINCE_SENSITIVITY_HPP__
+#define __DORMAND_PRINCE_SENSITIVITY_HPP__
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+
+namespace dormand_prince_tableau
+{
+    //! Nodes of the stages
+    constexpr std::array<scalar,6> c = {0.0, 1.0/5.0, 3.0/10.0, 4.0/5.0, 8.0/9.0, 1.0};
+
+    //! Coefficients of the stages, a[i][j] for j < i
+    constexpr std::array<std::array<scalar,6>,6> a =
+    {{
+        {0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+        {1.0/5.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+        {3.0/40.0, 9.0/40.0, 0.0, 0.0, 0.0, 0.0},
+        {44.0/45.0, -56.0/15.0, 32.0/9.0, 0.0, 0.0, 0.0},
+        {19372.0/6561.0, -25360.0/2187.0, 64448.0/6561.0, -212.0/729.0, 0.0, 0.0},
+        {9017.0/3168.0, -355.0/33.0, 46732.0/5247.0, 49.0/176.0, -5103.0/18656.0, 0.0}
+    }};
+
+    //! Weights of the fifth order solution
+    constexpr std::array<scalar,6> b = {35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0};
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline void Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::forward(Dynamic_model_t& vehicle, const Control_t& control,
+    const std::vector<scalar>& times, std::array<scalar,NSTATE>& q, std::vector<scalar>& dqdx) const
+{
+    using namespace dormand_prince_tableau;
+
+    const size_t nc = _n_parameters;
+    const size_t nv = _vehicle_parameters.size();
+    const size_t np = nc + nv;
+
+    dqdx.assign(NSTATE*np, 0.0);
+
+    auto vehicle_perturbed = vehicle;
+
+    Stages stages;
+    std::array<std::vector<scalar>,NSTAGES> dkdx;   // Sensitivities of the stages [NSTATE x np]
+    std::vector<scalar> dydx(NSTATE*np);            // Sensitivities of the stage states [NSTATE x np]
+
+    for (auto& dkdx_i : dkdx) dkdx_i.resize(NSTATE*np);
+
+    for (size_t n = 0; n + 1 < times.size(); ++n)
+    {
+        const scalar h = times[n+1] - times[n];
+
+        // (1) Compute the stages: they are needed for the sensitivities of the following stages
+        const auto q_next = compute_stages(vehicle, vehicle_perturbed, control, q, times[n], h, stages);
+
+        for (size_t i = 0; i < NSTAGES; ++i)
+        {
+            // (2) Sensitivities of the stage states: dydx = dqdx + h.sum_j a_ij.dkdx_j
+            dydx = dqdx;
+            for (size_t j = 0; j < i; ++j)
+                for (size_t l = 0; l < NSTATE*np; ++l)
+                    dydx[l] += h*a[i][j]*dkdx[j][l];
+
+            // (3) Sensitivities of the stages: dkdx = jac_q.dydx + [jac_u.dudx, jac_p]
+            std::fill(dkdx[i].begin(), dkdx[i].end(), 0.0);
+
+            for (size_t r = 0; r < NSTATE; ++r)
+            {
+                for (size_t m = 0; m < NSTATE; ++m)
+                {
+                    const scalar jac = stages.jac_q[i][r*NSTATE + m];
+                    if ( jac == 0.0 ) continue;
+
+                    for (size_t p = 0; p < np; ++p)
+                        dkdx[i][r*np + p] += jac*dydx[m*np + p];
+                }
+
+                for (size_t m = 0; m < NCONTROL; ++m)
+                {
+                    const scalar jac = stages.jac_u[i][r*NCONTROL + m];
+                    if ( jac == 0.0 ) continue;
+
+                    for (size_t p = 0; p < nc; ++p)
+                        dkdx[i][r*np + p] += jac*stages.dudx[i][m*nc + p];
+                }
+
+                for (size_t v = 0; v < nv; ++v)
+                    dkdx[i][r*np + nc + v] += stages.jac_p[i][r*nv + v];
+            }
+        }
+
+        // (4) Update: dqdx += h.sum_i b_i.dkdx_i
+        for (size_t i = 0; i < NSTAGES; ++i)
+            for (size_t l = 0; l < NSTATE*np; ++l)
+                dqdx[l] += h*b[i]*dkdx[i][l];
+
+        q = q_next;
+    }
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline std::array<scalar,NSTATE> Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::adjoint(Dynamic_model_t& vehicle,
+    const Control_t& control, const std::vector<scalar>& times, const std::array<scalar,NSTATE>& q0, const std::array<scalar,NSTATE>& dJdq,
+    std::vector<scalar>& dJdx, std::array<scalar,NSTATE>& dJdq0) const
+{
+    using namespace dormand_prince_tableau;
+
+    const size_t nc = _n_parameters;
+    const size_t nv = _vehicle_parameters.size();
+    const size_t n_steps = (times.size() > 0 ? times.size() - 1 : 0);
+
+    auto vehicle_perturbed = vehicle;
+
+    // (1) Forward sweep: store the states every _checkpoint_interval steps
+    std::vector<std::array<scalar,NSTATE>> checkpoints;
+    checkpoints.reserve(n_steps/_checkpoint_interval + 1);
+
+    auto q = q0;
+    for (size_t n = 0; n < n_steps; ++n)
+    {
+        if ( n % _checkpoint_interval == 0 )
+            checkpoints.push_back(q);
+
+        step(vehicle, control, q, times[n], times[n+1] - times[n]);
+    }
+
+    const auto q_final = q;
+
+    // (2) Backward sweep, one interval at a time
+    auto lambda = dJdq;
+    dJdx.assign(nc + nv, 0.0);
+
+    std::vector<std::array<scalar,NSTATE>> q_interval;
+    q_interval.reserve(_checkpoint_interval);
+
+    Stages stages;
+    std::array<std::array<scalar,NSTATE>,NSTAGES> g;    // Adjoints of the stages
+    std::array<std::array<scalar,NSTATE>,NSTAGES> w;    // Adjoints of the stage states
+    std::array<scalar,NCONTROL> dJdu;
+
+    for (size_t c = checkpoints.size(); c-- > 0; )
+    {
+        // (2.1) Recompute the states of the interval from its checkpoint
+        const size_t n_begin = c*_checkpoint_interval;
+        const size_t n_end   = std::min(n_begin + _checkpoint_interval, n_steps);
+
+        q_interval.clear();
+        q = checkpoints[c];
+        for (size_t n = n_begin; n < n_end; ++n)
+        {
+            q_interval.push_back(q);
+
+            if ( n + 1 < n_end )
+                step(vehicle, control, q, times[n], times[n+1] - times[n]);
+        }
+
+        // (2.2) Go backwards through the steps of the interval
+        for (size_t n = n_end; n-- > n_begin; )
+        {
+            const scalar h = times[n+1] - times[n];
+
+            compute_stages(vehicle, vehicle_perturbed, control, q_interval[n - n_begin], times[n], h, stages);
+
+            for (size_t i = NSTAGES; i-- > 0; )
+            {
+                // g_i = h.b_i.lambda + h.sum_{j>i} a_ji.w_j
+                for (size_t r = 0; r < NSTATE; ++r)
+                {
+                    g[i][r] = h*b[i]*lambda[r];
+
+                    for (size_t j = i+1; j < NSTAGES; ++j)
+                        g[i][r] += h*a[j][i]*w[j][r];
+                }
+
+                // w_i = jac_q^T.g_i
+                w[i].fill(0.0);
+                for (size_t r = 0; r < NSTATE; ++r)
+                    for (size_t m = 0; m < NSTATE; ++m)
+                        w[i][m] += stages.jac_q[i][r*NSTATE + m]*g[i][r];
+
+                // dJdx += dudx^T.jac_u^T.g_i
+                dJdu.fill(0.0);
+                for (size_t r = 0; r < NSTATE; ++r)
+                    for (size_t m = 0; m < NCONTROL; ++m)
+                        dJdu[m] += stages.jac_u[i][r*NCONTROL + m]*g[i][r];
+
+                for (size_t m = 0; m < NCONTROL; ++m)
+                    for (size_t p = 0; p < nc; ++p)
+                        dJdx[p] += stages.dudx[i][m*nc + p]*dJdu[m];
+
+                // dJdp += jac_p^T.g_i
+                for (size_t r = 0; r < NSTATE; ++r)
+                    for (size_t v = 0; v < nv; ++v)
+                        dJdx[nc + v] += stages.jac_p[i][r*nv + v]*g[i][r];
+            }
+
+            // lambda_n = lambda_{n+1} + sum_i w_i
+            for (size_t i = 0; i < NSTAGES; ++i)
+                for (size_t r = 0; r < NSTATE; ++r)
+                    lambda[r] += w[i][r];
+        }
+    }
+
+    dJdq0 = lambda;
+
+    return q_final;
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline void Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::jacobian(Dynamic_model_t& vehicle, const std::array<scalar,NSTATE>& q,
+    const std::array<scalar,NCONTROL>& u, const scalar t, std::array<scalar,NSTATE>& dqdt, std::array<scalar,NSTATE*NSTATE>& jac_q,
+    std::array<scalar,NSTATE*NCONTROL>& jac_u)
+{
+    if constexpr (std::is_same_v<Timeseries_t,CppAD::AD<scalar>>)
+    {
+        std::array<scalar,NSTATE*NINPUTS> jac;
+
+        if constexpr (has_equations_tape<Dynamic_model_t>::value)
+        {
+            // (1) Reuse the recorded equations tape of the vehicle, whose inputs are [q,qa,u] with no qa
+            vehicle.equations(dqdt.data(), nullptr, jac.data(), nullptr, nullptr, nullptr, q, {}, u, t);
+        }
+        else
+        {
+            // (2) Record the vehicle at this point
+            std::vector<scalar> x(NINPUTS);
+            std::copy(q.cbegin(), q.cend(), x.begin());
+            std::copy(u.cbegin(), u.cend(), x.begin() + NSTATE);
+
+            std::vector<CppAD::AD<scalar>> x_ad(x.cbegin(), x.cend());
+            CppAD::Independent(x_ad);
+
+            std::array<Timeseries_t,NSTATE> q_ad;
+            std::array<Timeseries_t,NCONTROL> u_ad;
+            std::copy(x_ad.cbegin(), x_ad.cbegin() + NSTATE, q_ad.begin());
+            std::copy(x_ad.cbegin() + NSTATE, x_ad.cend(), u_ad.begin());
+
+            const auto dqdt_ad = vehicle(q_ad, u_ad, t);
+            std::vector<CppAD::AD<scalar>> y_ad(dqdt_ad.cbegin(), dqdt_ad.cend());
+
+            CppAD::ADFun<scalar> f(x_ad, y_ad);
+
+            const auto y = f.Forward(0, x);
+            std::copy(y.cbegin(), y.cend(), dqdt.begin());
+
+            const auto jac_x = f.Jacobian(x);
+            std::copy(jac_x.cbegin(), jac_x.cend(), jac.begin());
+        }
+
+        // (3) Split the Jacobian, row-major [NSTATE x NINPUTS], into the states and controls parts
+        for (size_t r = 0; r < NSTATE; ++r)
+        {
+            std::copy_n(jac.cbegin() + r*NINPUTS, NSTATE, jac_q.begin() + r*NSTATE);
+            std::copy_n(jac.cbegin() + r*NINPUTS + NSTATE, NCONTROL, jac_u.begin() + r*NCONTROL);
+        }
+    }
+    else
+    {
+        // Central differences, with steps scaled by the magnitude of each input. The step cbrt(eps) balances the truncation 
+        // error O(delta^2) and the round-off error O(eps/delta)
+        const scalar epsilon = std::cbrt(std::numeric_limits<scalar>::epsilon());
+
+        dqdt = evaluate(vehicle, q, u, t);
+
+        for (size_t m = 0; m < NINPUTS; ++m)
+        {
+            auto q_plus  = q, q_minus = q;
+            auto u_plus  = u, u_minus = u;
+
+            scalar& x_plus  = (m < NSTATE ? q_plus[m]  : u_plus[m - NSTATE]);
+            scalar& x_minus = (m < NSTATE ? q_minus[m] : u_minus[m - NSTATE]);
+
+            const scalar delta = epsilon*std::max(1.0, std::abs(x_plus));
+            x_plus  += delta;
+            x_minus -= delta;
+
+            const auto dqdt_plus  = evaluate(vehicle, q_plus, u_plus, t);
+            const auto dqdt_minus = evaluate(vehicle, q_minus, u_minus, t);
+
+            for (size_t r = 0; r < NSTATE; ++r)
+            {
+                const scalar derivative = (dqdt_plus[r] - dqdt_minus[r])/(2.0*delta);
+
+                if ( m < NSTATE )
+                    jac_q[r*NSTATE + m] = derivative;
+                else
+                    jac_u[r*NCONTROL + m - NSTATE] = derivative;
+            }
+        }
+    }
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline void Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::parameter_jacobian(Dynamic_model_t& vehicle, 
+    const std::array<scalar,NSTATE>& q, const std::array<scalar,NCONTROL>& u, const scalar t, std::vector<scalar>& jac_p) const
+{
+    const size_t nv = _vehicle_parameters.size();
+    const scalar epsilon = std::cbrt(std::numeric_limits<scalar>::epsilon());
+
+    jac_p.resize(NSTATE*nv);
+
+    for (size_t v = 0; v < nv; ++v)
+    {
+        const auto& [name, value] = _vehicle_parameters[v];
+        const scalar delta = epsilon*std::max(1.0, std::abs(value));
+
+        vehicle.set_parameter(name, value + delta);
+        const auto dqdt_plus = evaluate(vehicle, q, u, t);
+
+        vehicle.set_parameter(name, value - delta);
+        const auto dqdt_minus = evaluate(vehicle, q, u, t);
+
+        vehicle.set_parameter(name, value);
+
+        for (size_t r = 0; r < NSTATE; ++r)
+            jac_p[r*nv + v] = (dqdt_plus[r] - dqdt_minus[r])/(2.0*delta);
+    }
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline std::array<scalar,NSTATE> Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::evaluate(Dynamic_model_t& vehicle,
+    const std::array<scalar,NSTATE>& q, const std::array<scalar,NCONTROL>& u, const scalar t)
+{
+    std::array<Timeseries_t,NSTATE> q_eval;
+    std::array<Timeseries_t,NCONTROL> u_eval;
+    std::copy(q.cbegin(), q.cend(), q_eval.begin());
+    std::copy(u.cbegin(), u.cend(), u_eval.begin());
+
+    const auto dqdt_eval = vehicle(q_eval, u_eval, t);
+
+    std::array<scalar,NSTATE> dqdt;
+    for (size_t r = 0; r < NSTATE; ++r)
+        dqdt[r] = Value(dqdt_eval[r]);
+
+    return dqdt;
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline std::array<scalar,Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::NCONTROL> Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::get_controls(
+    const Control_t& control, const std::array<scalar,NSTATE>& q, const scalar t)
+{
+    std::array<Timeseries_t,NSTATE> q_eval;
+    std::copy(q.cbegin(), q.cend(), q_eval.begin());
+
+    const auto u_eval = control(q_eval, t);
+
+    std::array<scalar,NCONTROL> u;
+    for (size_t m = 0; m < NCONTROL; ++m)
+        u[m] = Value(u_eval[m]);
+
+    return u;
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline void Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::step(Dynamic_model_t& vehicle, const Control_t& control,
+    std::array<scalar,NSTATE>& q, const scalar t, const scalar h)
+{
+    using namespace dormand_prince_tableau;
+
+    std::array<std::array<scalar,NSTATE>,NSTAGES> k;
+    std::array<scalar,NSTATE> y;
+
+    for (size_t i = 0; i < NSTAGES; ++i)
+    {
+        y = q;
+        for (size_t j = 0; j < i; ++j)
+            for (size_t r = 0; r < NSTATE; ++r)
+                y[r] += h*a[i][j]*k[j][r];
+
+        const scalar t_stage = t + c[i]*h;
+        k[i] = evaluate(vehicle, y, get_controls(control, y, t_stage), t_stage);
+    }
+
+    for (size_t i = 0; i < NSTAGES; ++i)
+        for (size_t r = 0; r < NSTATE; ++r)
+            q[r] += h*b[i]*k[i][r];
+}
+
+
+template<typename Dynamic_model_t, typename Control_t, size_t NSTATE>
+inline std::array<scalar,NSTATE> Dormand_prince_sensitivity<Dynamic_model_t,Control_t,NSTATE>::compute_stages(Dynamic_model_t& vehicle,
+    Dynamic_model_t& vehicle_perturbed, const Control_t& control, const std::array<scalar,NSTATE>& q, const scalar t, const scalar h, 
+    Stages& stages) const
+{
+    using namespace dormand_prince_tableau;
+
+    std::array<scalar,NSTATE> y;
+    auto q_next = q;
+
+    for (size_t i = 0; i < NSTAGES; ++i)
+    {
+        y = q;
+        for (size_t j = 0; j < i; ++j)
+            for (size_t r = 0; r < NSTATE; ++r)
+                y[r] += h*a[i][j]*stages.k[j][r];
+
+        const scalar t_stage = t + c[i]*h;
+
+        const auto u = get_controls(control, y, t_stage);
+
+        jacobian(vehicle, y, u, t_stage, stages.k[i], stages.jac_q[i], stages.jac_u[i]);
+
+        if ( !_vehicle_parameters.empty() )
+            parameter_jacobian(vehicle_perturbed, y, u, t_stage, stages.jac_p[i]);
+
+        stages.dudx[i].resize(NCONTROL*_n_parameters);
+        control.jacobian(t_stage, stages.dudx[i]);
+
+        for (size_t r = 0; r < NSTATE; ++r)
+            q_next[r] += h*b[i]*stages.k[i][r];
+    }
+
+    return q_next;
+}
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef __SIMPLIFIED_NEWTON_CRANK_NICOLSON_H__
+#define __SIMPLIFIED_NEWTON_CRANK_NICOLSON_H__
+
+#include <array>
+#include "lion/foundation/types.h"
+#include "lion/thirdparty/include/cppad/cppad.hpp"
+
+//!     Crank-Nicolson propagator with simplified Newton iterations
+//!     ------------------------------------------------------------
+//!
+//! Solves the steps of the sigma-scheme
+//!
+//!     q_{n+1} = q_n + ds.[(1-sigma).f(q_n,qa_n,u_n,s_n) + sigma.f(q_{n+1},qa_{n+1},u_{n+1},s_{n+1})]
+//!           0 = g(q_{n+1},qa_{n+1},u_{n+1},s_{n+1})
+//!
+//! The iteration matrix of Newton's method is factorized once and reused across iterations and steps.
+//! The Jacobian of the vehicle is only evaluated again when the iterations converge slowly or fail. If the
+//! step size changes, the iteration matrix is factorized again from the stored Jacobian. The function
+//! values at the end of a step are reused as the values at the start of the next one.
+//!
+//! integrate() adapts the step size in arclength (or time) from an estimate of the local error, computed
+//! as the difference between the solution and an explicit Adams-Bashforth prediction (Milne's device).
+//! Steps whose error is above the tolerances with the minimum step size are not accepted: an exception is thrown
+//!
+//! Vehicles with automatic differentiation are evaluated through their recorded equations. Scalar vehicles are
+//! evaluated directly, and their Jacobian is approximated by forward differences when it is refreshed: the 
+//! iteration matrix only drives the convergence, the solution satisfies the equations to the given tolerance
+//!
+//! One instance shall be used for one vehicle. Call reset() if the vehicle is modified
+//!
+template<typename Dynamic_model_t>
+class Simplified_newton_crank_nicolson
+{
+ public:
+    using Timeseries_t = typename Dynamic_model_t::Timeseries_type;
+
+    //! If the vehicle uses automatic differentiation
+    constexpr static bool is_ad = std::is_same<Timeseries_t,CppAD::AD<scalar>>::value;
+
+    constexpr static size_t NSTATE     = Dynamic_model_t::NSTATE;
+    constexpr static size_t NALGEBRAIC = Dynamic_model_t::NALGEBRAIC;
+    constexpr static size_t NCONTROL   = Dynamic_model_t::NCONTROL;
+    constexpr static size_t NINPUTS    = Dynamic_model_t::NINPUTS;
+    constexpr static size_t NOUTPUTS   = Dynamic_model_t::NOUTPUTS;
+
+    //! Number of unknowns of each step: [q, qa]
+    constexpr static size_t NX = NSTATE + NALGEBRAIC;
+
+    struct Options
+    {
+        scalar sigma               = 0.5;       //! Implicitness of the scheme: 0.5 for Crank-Nicolson, 1.0 for implicit Euler
+        size_t max_iter            = 20;        //! Maximum number of Newton iterations per attempt
+        scalar error_tolerance     = 1.0e-10;   //! Tolerance on the corrections, relative to max(1,|x|)
+        scalar maximum_contraction = 0.5;       //! The iteration matrix is refreshed if |dx_{k+1}| > maximum_contraction.|dx_k|
+
+        // Adaptive step size (integrate() only)
+        scalar relative_tolerance  = 1.0e-6;    //! Relative tolerance of the local error
+        scalar absolute_tolerance  = 1.0e-8;    //! Absolute tolerance of the local error
+        scalar ds_initial          = 0.1;       //! Initial step size
+        scalar ds_min              = 1.0e-4;    //! Minimum step size
+        scalar ds_max              = 5.0;       //! Maximum step size
+        scalar safety_factor       = 0.9;       //! Safety factor of the step size controller
+        scalar maximum_growth      = 4.0;       //! Maximum ratio between consecutive step sizes
+        scalar minimum_shrink      = 0.2;       //! Minimum ratio between consecutive step sizes
+    };
+
+    struct Statistics
+    {
+        size_t n_steps                = 0;      //! Number of accepted steps
+        size_t n_rejected_steps       = 0;      //! Number of steps rejected by the error control, or not converged
+        size_t n_newton_iterations    = 0;      //! Total number of Newton iterations
+        size_t n_function_evaluations = 0;      //! Number of evaluations of the vehicle equations without Jacobian
+        size_t n_jacobian_evaluations = 0;      //! Number of evaluations of the vehicle equations with Jacobian (or finite differences)
+        size_t n_factorizations       = 0;      //! Number of LU factorizations of the iteration matrix
+    };
+
+    //! Constructor
+    //! @param[in] car: the vehicle, which shall outlive this object
+    //! @param[in] options: the integrator options
+    Simplified_newton_crank_nicolson(Dynamic_model_t& car, const Options& options = Options())
+        : _car(car), _options(options), _ds(options.ds_initial) {}
+
+    //! Take one step of fixed size
+    //! @param[in] u: controls at s
+    //! @param[in] u_next: controls at s + ds
+    //! @param[in,out] q: states at s on input, at s + ds on output
+    //! @param[in,out] qa: algebraic states at s on input, at s + ds on output
+    //! @param[in] s: arclength (or time) at the start of the step
+    //! @param[in] ds: step size
+    void take_step(const std::array<scalar,NCONTROL>& u, const std::array<scalar,NCONTROL>& u_next,
+                   std::array<scalar,NSTATE>& q, std::array<scalar,NALGEBRAIC>& qa, const scalar s, const scalar ds);
+
+    //! Integrate from s_start to s_final with adaptive step size
+    //! @param[in] control: controls as a function of the arclength, called as control(s) -> std::array<scalar,NCONTROL>
+    //! @param[in,out] q: states at s_start on input, at s_final on output
+    //! @param[in,out] qa: algebraic states at s_start on input, at s_final on output
+    //! @param[in] s_start: initial arclength
+    //! @param[in] s_final: final arclength
+    template<typename Control_t>
+    void integrate(const Control_t& control, std::array<scalar,NSTATE>& q, std::array<scalar,NALGEBRAIC>& qa,
+                   const scalar s_start, const scalar s_final);
+
+    //! Step size proposed for the next step of integrate()
+    scalar get_step_size() const { return _ds; }
+
+    //! Set the step size of the next step of integrate()
+    void set_step_size(const scalar ds) { _ds = ds; }
+
+    //! Get the statistics
+    const Statistics& get_statistics() const { return _statistics; }
+
+    //! Discard the stored Jacobian and function values. To be called if the vehicle is modified
+    void reset() { _is_jacobian_valid = false; _is_factorized = false; _is_end_valid = false; }
+
+ private:
+
+    //! Evaluate the vehicle at x = [q,qa], with its Jacobian w.r.t. x if requested
+    //! @param[out] values: [f, g] at x
+    void evaluate(const std::array<scalar,NX>& x, const std::array<scalar,NCONTROL>& u, const scalar s,
+                  std::array<scalar,NX>& values, const bool compute_jacobian);
+
+    //! Get the values at the start of a step, reusing the end of the previous step if possible
+    void evaluate_start(const std::array<scalar,NX>& x, const std::array<scalar,NCONTROL>& u, const scalar s, std::array<scalar,NX>& values);
+
+    //! Construct and factorize the iteration matrix for a given step size
+    void factorize(const scalar ds);
+
+    //! Solve M.dx = b using the factorized iteration matrix
+    void solve(std::array<scalar,NX>& b) const;
+
+    //! Solve the nonlinear equations of a step. Returns false if Newton's method did not converge
+    //! @param[in] x_start: [q,qa] at the start of the step
+    //! @param[in] values_start: [f,g] at the start of the step
+    //! @param[out] x: [q,qa] at the end of the step
+    //! @param[out] values: [f,g] at the end of the step
+    bool solve_step(const std::array<scalar,NX>& x_start, const std::array<scalar,NX>& values_start, const std::array<scalar,NCONTROL>& u_next,
+                    const scalar s_next, const scalar ds, std::array<scalar,NX>& x, std::array<scalar,NX>& values);
+
+    //! Store the end of an accepted step, to be reused as the start of the next one
+    void save_end(const std::array<scalar,NX>& x, const std::array<scalar,NCONTROL>& u, const scalar s, const std::array<scalar,NX>& values)
+        { _x_end = x; _u_end = u; _s_end = s; _values_end = values; _is_end_valid = true; }
+
+    Dynamic_model_t& _car;                              //! The vehicle
+    Options _options;                                   //! The options
+    Statistics _statistics;                             //! The statistics
+
+    scalar _ds;                                         //! Step size proposed for the next step of integrate()
+
+    std::array<std::array<scalar,NX>,NX> _jacobian;     //! Jacobian of [f,g] w.r.t. [q,qa], from the last refresh
+    bool _is_jacobian_valid = false;                    //! If _jacobian was computed
+
+    std::array<std::array<scalar,NX>,NX> _lu;           //! LU factors of the iteration matrix
+    std::array<size_t,NX> _pivots;                      //! Row permutation of the LU factors
+    scalar _ds_factorized = 0.0;                        //! Step size used in the factorized matrix
+    bool _is_factorized = false;                        //! If _lu is valid for _jacobian
+
+    std::array<scalar,NX> _x_end;                       //! [q,qa] at the end of the last step
+    std::array<scalar,NCONTROL> _u_end;                 //! Controls at the end of the last step
+    scalar _s_end = 0.0;                                //! Arclength at the end of the last step
+    std::array<scalar,NX> _values_end;                  //! [f,g] at the end of the last step
+    bool _is_end_valid = false;                         //! If the end of the last step is stored
+};
+
+#include "simplified_newton_crank_nicolson.hpp"
+
+#endif
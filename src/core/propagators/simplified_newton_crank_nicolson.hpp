@@ -0,0 +1,373 @@
+#ifndef __SIMPLIFIED_NEWTON_CRANK_NICOLSON_HPP__
+#define __SIMPLIFIED_NEWTON_CRANK_NICOLSON_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+template<typename Dynamic_model_t>
+inline void Simplified_newton_crank_nicolson<Dynamic_model_t>::take_step(const std::array<scalar,NCONTROL>& u,
+    const std::array<scalar,NCONTROL>& u_next, std::array<scalar,NSTATE>& q, std::array<scalar,NALGEBRAIC>& qa, const scalar s, const scalar ds)
+{
+    // (1) Get the start of the step
+    std::array<scalar,NX> x_start;
+    std::copy(q.cbegin(), q.cend(), x_start.begin());
+    std::copy(qa.cbegin(), qa.cend(), x_start.begin() + NSTATE);
+
+    std::array<scalar,NX> values_start;
+    evaluate_start(x_start, u, s, values_start);
+
+    // (2) Solve the step
+    std::array<scalar,NX> x;
+    std::array<scalar,NX> values;
+
+    if ( !solve_step(x_start, values_start, u_next, s + ds, ds, x, values) )
+        throw std::runtime_error("Simplified_newton_crank_nicolson: the step at s = " + std::to_string(s) + " did not converge");
+
+    // (3) Save the end of the step, and return the solution
+    save_end(x, u_next, s + ds, values);
+    ++_statistics.n_steps;
+
+    std::copy_n(x.cbegin(), NSTATE, q.begin());
+    std::copy_n(x.cbegin() + NSTATE, NALGEBRAIC, qa.begin());
+}
+
+
+template<typename Dynamic_model_t>
+template<typename Control_t>
+inline void Simplified_newton_crank_nicolson<Dynamic_model_t>::integrate(const Control_t& control, std::array<scalar,NSTATE>& q,
+    std::array<scalar,NALGEBRAIC>& qa, const scalar s_start, const scalar s_final)
+{
+    // (1) Get the start of the integration
+    std::array<scalar,NX> x_start;
+    std::copy(q.cbegin(), q.cend(), x_start.begin());
+    std::copy(qa.cbegin(), qa.cend(), x_start.begin() + NSTATE);
+
+    std::array<scalar,NCONTROL> u_start = control(s_start);
+    std::array<scalar,NX> values_start;
+    evaluate_start(x_start, u_start, s_start, values_start);
+
+    // Derivatives at the previous step, for the Adams-Bashforth predictor
+    std::array<scalar,NX> values_previous;
+    scalar ds_previous = 0.0;
+    bool has_previous = false;
+
+    scalar s = s_start;
+    const scalar s_tolerance = 1.0e-12*std::max(1.0, std::abs(s_final));
+
+    std::array<scalar,NX> x;
+    std::array<scalar,NX> values;
+
+    while ( s < s_final - s_tolerance )
+    {
+        // (2) Choose the step size, landing exactly on s_final
+        _ds = std::min(std::max(_ds, _options.ds_min), _options.ds_max);
+        const scalar ds = (s + _ds > s_final - _options.ds_min ? s_final - s : _ds);
+        const auto u_next = control(s + ds);
+
+        // (3) Solve the step. If it did not converge, reduce the step size
+        if ( !solve_step(x_start, values_start, u_next, s + ds, ds, x, values) )
+        {
+            if ( ds <= _options.ds_min )
+                throw std::runtime_error("Simplified_newton_crank_nicolson: the step at s = " + std::to_string(s) + " did not converge with the minimum step size");
+
+            ++_statistics.n_rejected_steps;
+            _ds = std::max(0.5*ds, _options.ds_min);
+            continue;
+        }
+
+        // (4) Estimate the local error from an explicit prediction: Adams-Bashforth 2 if a previous step exists,
+        //     explicit Euler otherwise
+        std::array<scalar,NSTATE> q_predicted;
+        scalar error_constant;
+
+        if ( has_previous )
+        {
+            const scalar ratio = ds/(2.0*ds_previous);
+            for (size_t i = 0; i < NSTATE; ++i)
+                q_predicted[i] = x_start[i] + ds*((1.0 + ratio)*values_start[i] - ratio*values_previous[i]);
+
+            // Error constants: -1/12 for the trapezoidal rule, 5/12 for Adams-Bashforth 2
+            error_constant = 1.0/6.0;
+        }
+        else
+        {
+            for (size_t i = 0; i < NSTATE; ++i)
+                q_predicted[i] = x_start[i] + ds*values_start[i];
+
+            error_constant = 0.5;
+        }
+
+        scalar error = 0.0;
+        for (size_t i = 0; i < NSTATE; ++i)
+        {
+            const scalar scale = _options.absolute_tolerance + _options.relative_tolerance*std::max(std::abs(x_start[i]), std::abs(x[i]));
+            const scalar error_i = error_constant*(x[i] - q_predicted[i])/scale;
+            error += error_i*error_i;
+        }
+
+        error = std::sqrt(error/NSTATE);
+
+        // (5) Compute the next step size
+        const scalar factor = (error > 0.0 ? _options.safety_factor*std::pow(error, -1.0/3.0) : _options.maximum_growth);
+
+        if ( error > 1.0 )
+        {
+            // Reject the step. It cannot be accepted if the step size cannot be reduced
+            if ( ds <= _options.ds_min )
+                throw std::runtime_error("Simplified_newton_crank_nicolson: the local error at s = " + std::to_string(s) 
+                    + " is above the tolerances with the minimum step size (error = " + std::to_string(error) + ")");
+
+            ++_statistics.n_rejected_steps;
+            _ds = std::max(ds*std::max(factor, _options.minimum_shrink), _options.ds_min);
+            continue;
+        }
+
+        // (6) Accept the step
+        values_previous = values_start;
+        ds_previous = ds;
+        has_previous = true;
+
+        x_start = x;
+        values_start = values;
+        s += ds;
+
+        save_end(x, u_next, s, values);
+        ++_statistics.n_steps;
+
+        // Steps shortened to land on s_final do not limit the next step size
+        if ( ds == _ds || factor < 1.0 )
+            _ds = ds*std::min(std::max(factor, _options.minimum_shrink), _options.maximum_growth);
+    }
+
+    std::copy_n(x_start.cbegin(), NSTATE, q.begin());
+    std::copy_n(x_start.cbegin() + NSTATE, NALGEBRAIC, qa.begin());
+}
+
+
+template<typename Dynamic_model_t>
+inline void Simplified_newton_crank_nicolson<Dynamic_model_t>::evaluate(const std::array<scalar,NX>& x, const std::array<scalar,NCONTROL>& u,
+    const scalar s, std::array<scalar,NX>& values, const bool compute_jacobian)
+{
+    std::array<scalar,NSTATE> q;
+    std::array<scalar,NALGEBRAIC> qa;
+
+    std::copy_n(x.cbegin(), NSTATE, q.begin());
+    std::copy_n(x.cbegin() + NSTATE, NALGEBRAIC, qa.begin());
+
+    if constexpr (is_ad)
+    {
+        if ( !compute_jacobian )
+        {
+            _car.equations(values.data(), values.data() + NSTATE, nullptr, nullptr, nullptr, nullptr, q, qa, u, s);
+            ++_statistics.n_function_evaluations;
+            return;
+        }
+
+        // Compute the full Jacobian, and keep the derivatives w.r.t. [q,qa]
+        std::array<scalar,NOUTPUTS*NINPUTS> jacobian;
+
+        _car.equations(values.data(), values.data() + NSTATE, jacobian.data(), (NALGEBRAIC > 0 ? jacobian.data() + NSTATE*NINPUTS : nullptr),
+                       nullptr, nullptr, q, qa, u, s);
+
+        for (size_t i = 0; i < NX; ++i)
+            std::copy_n(jacobian.cbegin() + i*NINPUTS, NX, _jacobian[i].begin());
+    }
+    else
+    {
+        // (1) Evaluate the scalar vehicle
+        auto evaluate_values = [&](const std::array<scalar,NSTATE>& q_eval, const std::array<scalar,NALGEBRAIC>& qa_eval, std::array<scalar,NX>& values_eval)
+        {
+            const auto [dqdt, dqa] = _car(q_eval, qa_eval, u, s);
+            std::copy(dqdt.cbegin(), dqdt.cend(), values_eval.begin());
+            std::copy(dqa.cbegin(), dqa.cend(), values_eval.begin() + NSTATE);
+        };
+
+        evaluate_values(q, qa, values);
+
+        if ( !compute_jacobian )
+        {
+            ++_statistics.n_function_evaluations;
+            return;
+        }
+
+        // (2) Approximate the Jacobian by forward differences, with steps scaled by the magnitude of each variable
+        const scalar epsilon = std::sqrt(std::numeric_limits<scalar>::epsilon());
+        std::array<scalar,NX> values_plus;
+
+        for (size_t j = 0; j < NX; ++j)
+        {
+            auto q_plus  = q;
+            auto qa_plus = qa;
+            scalar& x_plus = (j < NSTATE ? q_plus[j] : qa_plus[j - NSTATE]);
+
+            const scalar delta = epsilon*std::max(1.0, std::abs(x_plus));
+            x_plus += delta;
+
+            evaluate_values(q_plus, qa_plus, values_plus);
+
+            for (size_t i = 0; i < NX; ++i)
+                _jacobian[i][j] = (values_plus[i] - values[i])/delta;
+        }
+    }
+
+    _is_jacobian_valid = true;
+    _is_factorized = false;
+    ++_statistics.n_jacobian_evaluations;
+}
+
+
+template<typename Dynamic_model_t>
+inline void Simplified_newton_crank_nicolson<Dynamic_model_t>::evaluate_start(const std::array<scalar,NX>& x, const std::array<scalar,NCONTROL>& u,
+    const scalar s, std::array<scalar,NX>& values)
+{
+    if ( _is_end_valid && s == _s_end && x == _x_end && u == _u_end )
+        values = _values_end;
+    else
+        evaluate(x, u, s, values, false);
+}
+
+
+template<typename Dynamic_model_t>
+inline void Simplified_newton_crank_nicolson<Dynamic_model_t>::factorize(const scalar ds)
+{
+    // (1) Construct the iteration matrix M = [I - ds.sigma.df/dx ; dg/dx]
+    for (size_t i = 0; i < NSTATE; ++i)
+        for (size_t j = 0; j < NX; ++j)
+            _lu[i][j] = (i == j ? 1.0 : 0.0) - ds*_options.sigma*_jacobian[i][j];
+
+    for (size_t i = NSTATE; i < NX; ++i)
+        _lu[i] = _jacobian[i];
+
+    // (2) LU factorization with partial pivoting
+    for (size_t i = 0; i < NX; ++i)
+        _pivots[i] = i;
+
+    for (size_t k = 0; k < NX; ++k)
+    {
+        size_t i_pivot = k;
+        for (size_t i = k+1; i < NX; ++i)
+            if ( std::abs(_lu[i][k]) > std::abs(_lu[i_pivot][k]) )
+                i_pivot = i;
+
+        if ( _lu[i_pivot][k] == 0.0 )
+            throw std::runtime_error("Simplified_newton_crank_nicolson: the iteration matrix is singular");
+
+        std::swap(_lu[k], _lu[i_pivot]);
+        std::swap(_pivots[k], _pivots[i_pivot]);
+
+        for (size_t i = k+1; i < NX; ++i)
+        {
+            _lu[i][k] /= _lu[k][k];
+
+            for (size_t j = k+1; j < NX; ++j)
+                _lu[i][j] -= _lu[i][k]*_lu[k][j];
+        }
+    }
+
+    _ds_factorized = ds;
+    _is_factorized = true;
+    ++_statistics.n_factorizations;
+}
+
+
+template<typename Dynamic_model_t>
+inline void Simplified_newton_crank_nicolson<Dynamic_model_t>::solve(std::array<scalar,NX>& b) const
+{
+    // (1) Apply the permutation
+    std::array<scalar,NX> y;
+    for (size_t i = 0; i < NX; ++i)
+        y[i] = b[_pivots[i]];
+
+    // (2) Forward substitution with L (unit diagonal)
+    for (size_t i = 0; i < NX; ++i)
+        for (size_t j = 0; j < i; ++j)
+            y[i] -= _lu[i][j]*y[j];
+
+    // (3) Backward substitution with U
+    for (size_t i = NX; i-- > 0; )
+    {
+        for (size_t j = i+1; j < NX; ++j)
+            y[i] -= _lu[i][j]*y[j];
+
+        y[i] /= _lu[i][i];
+    }
+
+    b = y;
+}
+
+
+template<typename Dynamic_model_t>
+inline bool Simplified_newton_crank_nicolson<Dynamic_model_t>::solve_step(const std::array<scalar,NX>& x_start, const std::array<scalar,NX>& values_start,
+    const std::array<scalar,NCONTROL>& u_next, const scalar s_next, const scalar ds, std::array<scalar,NX>& x, std::array<scalar,NX>& values)
+{
+    const scalar sigma = _options.sigma;
+
+    // Two attempts: the first one with the stored iteration matrix, the second one with a fresh Jacobian
+    for (size_t attempt = 0; attempt < 2; ++attempt)
+    {
+        // (1) Predictor: explicit Euler for the states, previous values for the algebraic states
+        x = x_start;
+        for (size_t i = 0; i < NSTATE; ++i)
+            x[i] += ds*values_start[i];
+
+        // (2) Refresh the Jacobian at the predictor if needed, and factorize the iteration matrix
+        const bool is_fresh = ( !_is_jacobian_valid || attempt == 1 );
+
+        if ( is_fresh )
+            evaluate(x, u_next, s_next, values, true);
+
+        if ( !_is_factorized || ds != _ds_factorized )
+            factorize(ds);
+
+        // (3) Simplified Newton iterations
+        scalar norm_previous = 0.0;
+
+        for (size_t iter = 0; iter < _options.max_iter; ++iter)
+        {
+            if ( !(is_fresh && iter == 0) )
+                evaluate(x, u_next, s_next, values, false);
+
+            ++_statistics.n_newton_iterations;
+
+            // (3.1) Residual: r = [q - q_n - ds.((1-sigma).f_n + sigma.f) ; g]
+            std::array<scalar,NX> dx;
+
+            for (size_t i = 0; i < NSTATE; ++i)
+                dx[i] = -(x[i] - x_start[i] - ds*((1.0-sigma)*values_start[i] + sigma*values[i]));
+
+            for (size_t i = NSTATE; i < NX; ++i)
+                dx[i] = -values[i];
+
+            // (3.2) Correction
+            solve(dx);
+
+            scalar norm = 0.0;
+            for (size_t i = 0; i < NX; ++i)
+            {
+                x[i] += dx[i];
+                norm = std::max(norm, std::abs(dx[i])/std::max(1.0, std::abs(x[i])));
+            }
+
+            // (3.3) Check convergence, and evaluate the solution to be reused as the start of the next step
+            if ( norm < _options.error_tolerance )
+            {
+                evaluate(x, u_next, s_next, values, false);
+                return true;
+            }
+
+            // (3.4) Stop if the iterations diverge or converge slowly
+            if ( !std::isfinite(norm) || (iter > 0 && norm > _options.maximum_contraction*norm_previous) )
+                break;
+
+            norm_previous = norm;
+        }
+
+        if ( is_fresh )
+            break;
+    }
+
+    return false;
+}
+
+#endif
@@ -172,9 +172,65 @@ struct Pacejka_simple_model
         { "lambda-max-2", _lambda_max2_deg },
         { "Qx", _Qx },
         { "Qy", _Qy } 
-    ); 
+    );
+
+
+};
+
 
+//! Pacejka simple model whose parameters are frozen at compile time
+//!
+//! The parameters are provided by a struct with static constexpr members (as generated by
+//! fastestlap_freeze_vehicle from a vehicle database). The derived constants (Sx, Sy, slopes
+//! between the two reference loads) are folded by the compiler.
+//! @param Params: struct with the frozen parameters: Fz1, Fz2, mu_x_max1, mu_x_max2, mu_y_max1,
+//!                mu_y_max2, kappa_max1, kappa_max2, lambda_max1, lambda_max2 [rad], Qx, Qy, Sx, Sy, mu_min
+template<typename Params>
+struct Pacejka_simple_model_frozen
+{
+    using parameters_type = Params;
+
+    //! Nothing to be computed: all constants are known at compile time
+    void initialise() {}
 
+    //! Compute the combined longitudinal force
+    template<typename Timeseries_t>
+    Timeseries_t force_combined_longitudinal_magic(Timeseries_t kappa, Timeseries_t lambda, Timeseries_t Fz) const;
+
+    //! Compute the combined lateral force
+    template<typename Timeseries_t>
+    Timeseries_t force_combined_lateral_magic(Timeseries_t kappa, Timeseries_t lambda, Timeseries_t Fz) const;
+
+    //! Print the frozen parameters
+    std::ostream& print(std::ostream& os) const;
+
+    //! Frozen parameters cannot be read from a database, or modified
+    std::vector<Database_parameter_mutable> get_parameters() { return {}; }
+
+    //! Frozen parameters are written to a database with the names of Pacejka_simple_model
+    std::vector<Database_parameter_const> get_parameters() const { return 
+    {
+        { "reference-load-1", Params::Fz1 },
+        { "reference-load-2", Params::Fz2 },
+        { "mu-x-max-1", Params::mu_x_max1 },
+        { "mu-x-max-2", Params::mu_x_max2 },
+        { "mu-y-max-1", Params::mu_y_max1 },
+        { "mu-y-max-2", Params::mu_y_max2 },
+        { "kappa-max-1", Params::kappa_max1 },
+        { "kappa-max-2", Params::kappa_max2 },
+        { "lambda-max-1", _lambda_max1_deg },
+        { "lambda-max-2", _lambda_max2_deg },
+        { "Qx", Params::Qx },
+        { "Qy", Params::Qy } 
+    };}
+
+    // Constants derived at compile time
+    static constexpr const scalar _lambda_max1_deg = Params::lambda_max1*180.0/pi;
+    static constexpr const scalar _lambda_max2_deg = Params::lambda_max2*180.0/pi;
+    static constexpr const scalar _dmu_x_max_dFz   = (Params::mu_x_max2 - Params::mu_x_max1)/(Params::Fz2 - Params::Fz1);
+    static constexpr const scalar _dmu_y_max_dFz   = (Params::mu_y_max2 - Params::mu_y_max1)/(Params::Fz2 - Params::Fz1);
+    static constexpr const scalar _dkappa_max_dFz  = (Params::kappa_max2 - Params::kappa_max1)/(Params::Fz2 - Params::Fz1);
+    static constexpr const scalar _dlambda_max_dFz = (Params::lambda_max2 - Params::lambda_max1)/(Params::Fz2 - Params::Fz1);
 };
 
 template<typename Timeseries_t, typename Pacejka_model, size_t STATE0, size_t CONTROL0>
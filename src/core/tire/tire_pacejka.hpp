@@ -224,6 +224,65 @@ Timeseries_t Pacejka_simple_model::force_combined_lateral_magic(Timeseries_t kap
 }
 
 
+template<typename Params>
+template<typename Timeseries_t>
+inline Timeseries_t Pacejka_simple_model_frozen<Params>::force_combined_longitudinal_magic(Timeseries_t kappa, Timeseries_t lambda, Timeseries_t Fz) const
+{
+    const Timeseries_t dFz        = Fz - Params::Fz1;
+    const Timeseries_t mu_x_max   = smooth_pos(dFz*_dmu_x_max_dFz + (Params::mu_x_max1-Params::mu_min),1.0e-5)+Params::mu_min;
+    const Timeseries_t kappa_max  = dFz*_dkappa_max_dFz + Params::kappa_max1;
+    const Timeseries_t lambda_max = dFz*_dlambda_max_dFz + Params::lambda_max1;
+
+    const Timeseries_t kappa_n = kappa/kappa_max;
+    const Timeseries_t lambda_n = lambda/lambda_max;
+    const Timeseries_t rho = sqrt(kappa_n*kappa_n + lambda_n*lambda_n + 1.0e-12);
+
+    const Timeseries_t mu_x = mu_x_max*sin(Params::Qx*atan(Params::Sx*rho));
+
+    return mu_x*Fz*kappa_n/(rho);
+}
+
+
+template<typename Params>
+template<typename Timeseries_t>
+inline Timeseries_t Pacejka_simple_model_frozen<Params>::force_combined_lateral_magic(Timeseries_t kappa, Timeseries_t lambda, Timeseries_t Fz) const
+{
+    const Timeseries_t dFz        = Fz - Params::Fz1;
+    const Timeseries_t mu_y_max   = smooth_pos(dFz*_dmu_y_max_dFz + (Params::mu_y_max1-Params::mu_min),1.0e-5)+Params::mu_min;
+    const Timeseries_t kappa_max  = dFz*_dkappa_max_dFz + Params::kappa_max1;
+    const Timeseries_t lambda_max = dFz*_dlambda_max_dFz + Params::lambda_max1;
+
+    const Timeseries_t kappa_n = kappa/kappa_max;
+    const Timeseries_t lambda_n = lambda/lambda_max;
+    const Timeseries_t rho = sqrt(kappa_n*kappa_n + lambda_n*lambda_n + 1.0e-12);
+
+    const Timeseries_t mu_y = mu_y_max*sin(Params::Qy*atan(Params::Sy*rho));
+
+    return mu_y*Fz*lambda_n/(rho);
+}
+
+
+template<typename Params>
+inline std::ostream& Pacejka_simple_model_frozen<Params>::print(std::ostream& os) const
+{
+    out(2) << std::left << std::setw(16) << "   * Fz1: "  << std::right << std::setw(5) << Params::Fz1 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * Fz2: "  << std::right << std::setw(5) << Params::Fz2 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * mu_x_max1: "  << std::right << std::setw(5) << Params::mu_x_max1 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * mu_x_max2: "  << std::right << std::setw(5) << Params::mu_x_max2 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * mu_y_max1: "  << std::right << std::setw(5) << Params::mu_y_max1 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * mu_y_max2: "  << std::right << std::setw(5) << Params::mu_y_max2 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * kappa_max1: "  << std::right << std::setw(5) << Params::kappa_max1 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * kappa_max2: "  << std::right << std::setw(5) << Params::kappa_max2 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * lambda_max1: "  << std::right << std::setw(5) << Params::lambda_max1 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * lambda_max2: "  << std::right << std::setw(5) << Params::lambda_max2 << std::endl;
+    out(2) << std::left << std::setw(16) << "   * Qx: "  << std::right << std::setw(5) << Params::Qx << std::endl;
+    out(2) << std::left << std::setw(16) << "   * Qy: "  << std::right << std::setw(5) << Params::Qy << std::endl;
+    out(2) << std::left << std::setw(16) << "   * (frozen)" << std::endl;
+
+    return os;
+}
+
+
 template<typename Timeseries_t, typename Pacejka_model, size_t STATE0, size_t CONTROL0>
 inline std::ostream& Tire_pacejka<Timeseries_t,Pacejka_model,STATE0,CONTROL0>::print(std::ostream& os) const
 {
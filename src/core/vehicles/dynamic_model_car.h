@@ -7,6 +7,7 @@
 #include "src/core/chassis/chassis_car_6dof.h"
 #include "src/core/chassis/axle_car_6dof.h"
 #include "src/core/tire/tire_pacejka.h"
+#include "lion/thirdparty/include/cppad/cppad.hpp"
 
 //!      The dynamic model of a Car
 //!      --------------------------
@@ -38,6 +39,15 @@ class Dynamic_model_car
     //! The number of control variables
     constexpr static size_t NCONTROL  = _NCONTROL; 
 
+    //! The number of inputs of the equations: x = [q, qa, u]
+    constexpr static size_t NINPUTS   = _NSTATE + NALGEBRAIC + _NCONTROL;
+
+    //! The number of outputs of the equations: y = [dqdt, dqa]
+    constexpr static size_t NOUTPUTS  = _NSTATE + NALGEBRAIC;
+
+    //! The number of track geometry parameters, recorded as dynamic parameters of the equations tape
+    constexpr static size_t NGEOMETRY = RoadModel_t::NGEOMETRY;
+
     //! Default constructor
     Dynamic_model_car(const RoadModel_t& road = RoadModel_t() ) : _chassis(), _road(road) {}
 
@@ -49,14 +59,18 @@ class Dynamic_model_car
     //! @param[in] rear_right_tire_type: type of the rear right tire 
     //! @param[in] road: the road
     Dynamic_model_car(Xml_document& database, const RoadModel_t& road = RoadModel_t()) 
-        : _chassis(database), _road(road), _variable_parameters() {};
+        : _chassis(database), _road(road), _variable_parameters(), _equations_tape() {};
 
     //! Modifyer to set a parameter
     template<typename T>
-    void set_parameter(const std::string& parameter, const T value) { get_chassis().set_parameter(parameter,value); }
+    void set_parameter(const std::string& parameter, const T value) { get_chassis().set_parameter(parameter,value); reset_equations_tape(); }
 
     //! Add a variable parameter
-    void add_variable_parameter(const std::string& parameter_name, const sPolynomial& parameter_value) { _variable_parameters[parameter_name] = parameter_value; }
+    void add_variable_parameter(const std::string& parameter_name, const sPolynomial& parameter_value) 
+        { _variable_parameters[parameter_name] = parameter_value; reset_equations_tape(); }
+
+    //! If the model has parameters that vary with time/arclength
+    bool has_variable_parameters() const { return !_variable_parameters.empty(); }
 
     //! The time derivative functor, dqdt = operator()(q,u,t)
     //! Only enabled if the dynamic model has no algebraic equations
@@ -103,6 +117,34 @@ class Dynamic_model_car
                         const std::array<scalar,_NCONTROL>& u,
                         scalar t);
 
+    //! The time derivative functor + algebraic equations, their Jacobians, and Hessians into flat buffers
+    //! The equations are recorded once, with the track geometry at t as dynamic parameters, and the tape is
+    //! reused for any t. Models with variable parameters are recorded again when t changes. Jacobians and
+    //! Hessians are computed using their sparsity patterns, the Hessian ones on their first use.
+    //! The inputs are sorted as x = [q, qa, u] (NINPUTS), the outputs as y = [dqdt, dqa] (NOUTPUTS)
+    //! @param[out] dqdt: time derivative of the states [NSTATE]
+    //! @param[out] dqa: algebraic equations [NALGEBRAIC]
+    //! @param[out] jac_dqdt: Jacobian of dqdt, row-major [NSTATE x NINPUTS]. Skipped if nullptr
+    //! @param[out] jac_dqa: Jacobian of dqa, row-major [NALGEBRAIC x NINPUTS]. Skipped if nullptr
+    //! @param[out] hess_dqdt: Hessians of dqdt, row-major [NSTATE x NINPUTS x NINPUTS]. Skipped if nullptr
+    //! @param[out] hess_dqa: Hessians of dqa, row-major [NALGEBRAIC x NINPUTS x NINPUTS]. Skipped if nullptr
+    //! @param[in] q: state vector
+    //! @param[in] qa: constraint variables vector
+    //! @param[in] u: controls vector
+    //! @param[in] t: time/arclength
+    void equations(scalar* dqdt, scalar* dqa, scalar* jac_dqdt, scalar* jac_dqa, scalar* hess_dqdt, scalar* hess_dqa,
+                   const std::array<scalar,_NSTATE>& q,
+                   const std::array<scalar,NALGEBRAIC>& qa,
+                   const std::array<scalar,_NCONTROL>& u,
+                   scalar t);
+
+    //! Discard the recorded equations tape. To be called if the chassis or the road are modified
+    //! through get_chassis() or get_road()
+    void reset_equations_tape() { _equations_tape.is_valid = false; }
+
+    //! Number of times the equations tape has been recorded by this vehicle
+    size_t get_number_of_equations_recordings() const { return _equations_tape.n_recordings; }
+
     static std::tuple<std::string,std::array<std::string,_NSTATE>,std::array<std::string,Chassis_t::NALGEBRAIC>,std::array<std::string,_NCONTROL>> 
         get_state_and_control_names();
 
@@ -126,10 +168,49 @@ class Dynamic_model_car
     }
 
  private:
+
+    //! The recorded equations and the sparse derivatives workspace
+    struct Equations_tape
+    {
+        using sparse_pattern = CppAD::sparse_rc<std::vector<size_t>>;
+        using sparse_matrix  = CppAD::sparse_rcv<std::vector<size_t>,std::vector<scalar>>;
+
+        Equations_tape() = default;
+
+        //! Copies do not share the tape, it is recorded again on their first use
+        Equations_tape(const Equations_tape&) : Equations_tape() {}
+        Equations_tape& operator=(const Equations_tape&) { is_valid = false; return *this; }
+
+        bool is_valid = false;  //! If the tape has been recorded
+        scalar t = 0.0;         //! Time/arclength used to record the tape, only relevant with variable parameters
+        size_t n_recordings = 0;  //! Number of recordings of the tape
+
+        CppAD::ADFun<scalar> f; //! The tape, y = f(x)
+
+        sparse_pattern          jac_pattern;    //! Sparsity pattern of the Jacobian
+        sparse_matrix           jac_subset;     //! Sparse Jacobian
+        CppAD::sparse_jac_work  jac_work;       //! Workspace for the Jacobian
+
+        std::array<bool,NOUTPUTS>                    is_hes_pattern_valid = {};  //! If the Hessian sparsity of each output is computed
+        std::array<sparse_pattern,NOUTPUTS>          hes_pattern;    //! Sparsity pattern of the Hessian of each output
+        std::array<sparse_matrix,NOUTPUTS>           hes_subset;     //! Sparse Hessian of each output
+        std::array<CppAD::sparse_hes_work,NOUTPUTS>  hes_work;       //! Workspace for the Hessian of each output
+    };
+
+    //! Record the equations tape and compute the sparsity pattern of the Jacobian
+    //! @param[in] x: the inputs [q, qa, u]
+    //! @param[in] t: time/arclength
+    void record_equations_tape(const std::vector<scalar>& x, scalar t);
+
+    //! Compute the sparsity pattern of the Hessian of the i-th output of the recorded tape
+    void compute_hessian_sparsity(const size_t i);
+
     Chassis_t _chassis;    //! The chassis
     RoadModel_t _road;     //! The road
 
     std::map<std::string,sPolynomial> _variable_parameters;
+
+    Equations_tape _equations_tape;   //! Recorded equations for equations()
 };
 
 #include "dynamic_model_car.hpp"
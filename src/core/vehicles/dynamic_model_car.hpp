@@ -1,6 +1,7 @@
 #ifndef __CAR_HPP__
 #define __CAR_HPP__
 
+#include <algorithm>
 #include "lion/math/matrix_extensions.h"
 
 template<typename Timeseries_t, typename Chassis_t, typename RoadModel_t, size_t _NSTATE, size_t _NCONTROL>
@@ -21,7 +22,7 @@ std::pair<std::array<Timeseries_t,_NSTATE>,std::array<Timeseries_t,Chassis_t::NA
 
     // (1) Set the variable parameters
     for (auto const& [name, value] : _variable_parameters )
-        set_parameter(name, value(t));
+        _chassis.set_parameter(name, value(t));
 
     // (2) Set state and controls
     _chassis.set_state_and_controls(q,qa,u);
@@ -53,102 +54,209 @@ typename Dynamic_model_car<Timeseries_t,Chassis_t,RoadModel_t,_NSTATE,_NCONTROL>
         (const std::array<scalar,_NSTATE>& q, const std::array<scalar,NALGEBRAIC>& qa,
          const std::array<scalar,_NCONTROL>& u, scalar t)
 {
-    // Put the states into a single vector, which will be declared as independent variables
-    constexpr const size_t n_total = _NSTATE + NALGEBRAIC + _NCONTROL;
-    std::vector<CppAD::AD<double>> x0(n_total);
+    Equations solution;
 
-    for (size_t i = 0; i < _NSTATE; ++i)
-        x0[i] = q[i];
+    // The nested arrays are filled as flat row-major buffers
+    static_assert(sizeof(solution.jac_dqdt)  == sizeof(scalar)*_NSTATE*NINPUTS);
+    static_assert(sizeof(solution.hess_dqdt) == sizeof(scalar)*_NSTATE*NINPUTS*NINPUTS);
 
-    for (size_t i = 0; i < NALGEBRAIC; ++i)
-        x0[i+_NSTATE] = qa[i];
+    scalar* jac_dqa  = nullptr;
+    scalar* hess_dqa = nullptr;
 
-    for (size_t i = 0; i < _NCONTROL; ++i)
-        x0[i+_NSTATE+NALGEBRAIC] = u[i];
+    if constexpr (NALGEBRAIC > 0)
+    {
+        static_assert(sizeof(solution.jac_dqa)   == sizeof(scalar)*NALGEBRAIC*NINPUTS);
+        static_assert(sizeof(solution.hess_dqa)  == sizeof(scalar)*NALGEBRAIC*NINPUTS*NINPUTS);
 
-    // Declare the contents of x0 as the independent variables
-    CppAD::Independent(x0);
+        jac_dqa  = solution.jac_dqa.data()->data();
+        hess_dqa = solution.hess_dqa.data()->data()->data();
+    }
 
-    // Create new inputs to the operator() of the vehicle 
-    std::array<CppAD::AD<double>,_NSTATE>     q0;
-    std::array<CppAD::AD<double>,NALGEBRAIC> qa0;
-    std::array<CppAD::AD<double>,_NCONTROL>   u0;
+    equations(solution.dqdt.data(), solution.dqa.data(), solution.jac_dqdt.data()->data(), jac_dqa, 
+              solution.hess_dqdt.data()->data()->data(), hess_dqa, q, qa, u, t);
 
-    for (size_t i = 0; i < _NSTATE; ++i)
-        q0[i] = x0[i];
+    return solution;
+}
 
-    for (size_t i = 0; i < NALGEBRAIC; ++i)
-        qa0[i] = x0[i+_NSTATE];
 
-    for (size_t i = 0; i < _NCONTROL; ++i)
-        u0[i] = x0[i+_NSTATE+NALGEBRAIC];
+template<typename Timeseries_t, typename Chassis_t, typename RoadModel_t, size_t _NSTATE, size_t _NCONTROL>
+void Dynamic_model_car<Timeseries_t,Chassis_t,RoadModel_t,_NSTATE,_NCONTROL>::equations
+    (scalar* dqdt, scalar* dqa, scalar* jac_dqdt, scalar* jac_dqa, scalar* hess_dqdt, scalar* hess_dqa,
+     const std::array<scalar,_NSTATE>& q, const std::array<scalar,NALGEBRAIC>& qa,
+     const std::array<scalar,_NCONTROL>& u, scalar t)
+{
+    // (1) Put the states into a single vector
+    std::vector<scalar> x(NINPUTS);
+
+    std::copy(q.cbegin(), q.cend(), x.begin());
+    std::copy(qa.cbegin(), qa.cend(), x.begin() + _NSTATE);
+    std::copy(u.cbegin(), u.cend(), x.begin() + _NSTATE + NALGEBRAIC);
+
+    // (2) Record the tape if it does not exist. The track geometry is a dynamic parameter, so that the tape is valid
+    //     for any t, but variable parameters are not: with them, the tape is only valid for the t it was recorded
+    auto& tape = _equations_tape;
+
+    if ( !tape.is_valid || (has_variable_parameters() && tape.t != t) )
+        record_equations_tape(x,t);
+
+    if constexpr (NGEOMETRY > 0)
+    {
+        const auto geometry = _road.get_geometry(t);
+        tape.f.new_dynamic(std::vector<scalar>(geometry.cbegin(), geometry.cend()));
+    }
+
+    // (3) Evaluate y = f(x). If a comparison changed its result w.r.t. the recorded one, the operation
+    //     sequence is not valid for this x and t, and the tape is recorded again
+    auto y = tape.f.Forward(0, x);
+
+    if ( tape.f.compare_change_number() > 0 )
+    {
+        record_equations_tape(x,t);
+        y = tape.f.Forward(0, x);
+    }
+
+    std::copy_n(y.cbegin(), _NSTATE, dqdt);
+    std::copy_n(y.cbegin() + _NSTATE, NALGEBRAIC, dqa);
+
+    // (4) Compute the sparse Jacobian
+    if ( jac_dqdt != nullptr || jac_dqa != nullptr )
+    {
+        if ( jac_dqdt != nullptr ) std::fill_n(jac_dqdt, _NSTATE*NINPUTS, 0.0);
+        if ( jac_dqa != nullptr )  std::fill_n(jac_dqa, NALGEBRAIC*NINPUTS, 0.0);
+
+        tape.f.sparse_jac_for(1, x, tape.jac_subset, tape.jac_pattern, "cppad", tape.jac_work);
+
+        const auto& row = tape.jac_subset.row();
+        const auto& col = tape.jac_subset.col();
+        const auto& val = tape.jac_subset.val();
+
+        for (size_t k = 0; k < tape.jac_subset.nnz(); ++k)
+        {
+            if ( row[k] < _NSTATE )
+            {
+                if ( jac_dqdt != nullptr ) jac_dqdt[row[k]*NINPUTS + col[k]] = val[k];
+            }
+            else
+            {
+                if ( jac_dqa != nullptr ) jac_dqa[(row[k]-_NSTATE)*NINPUTS + col[k]] = val[k];
+            }
+        }
+    }
 
-    // Call operator(), transform arrays to vectors
-    auto [dqdt_out,dqa_out] = (*this)(q0,qa0,u0,0.0);
-    std::vector<CppAD::AD<double>> out_vector(dqdt_out.cbegin(), dqdt_out.cend());
-    out_vector.insert(out_vector.end(), dqa_out.cbegin(), dqa_out.cend());
+    // (5) Compute the sparse Hessians, one per output
+    if ( hess_dqdt != nullptr || hess_dqa != nullptr )
+    {
+        if ( hess_dqdt != nullptr ) std::fill_n(hess_dqdt, _NSTATE*NINPUTS*NINPUTS, 0.0);
+        if ( hess_dqa != nullptr )  std::fill_n(hess_dqa, NALGEBRAIC*NINPUTS*NINPUTS, 0.0);
 
-    // Create the AD functions and stop the recording
-    CppAD::ADFun<double> f;
-    f.Dependent(x0,out_vector);
+        std::vector<scalar> w(NOUTPUTS, 0.0);
 
-    // Transform x0 to double, to evaluate the functions
-    std::vector<scalar> x0_double(x0.size());
+        for (size_t i = 0; i < NOUTPUTS; ++i)
+        {
+            scalar* hess_i = (i < _NSTATE ? (hess_dqdt == nullptr ? nullptr : hess_dqdt + i*NINPUTS*NINPUTS) 
+                                          : (hess_dqa == nullptr ? nullptr : hess_dqa + (i-_NSTATE)*NINPUTS*NINPUTS));
 
-    for (size_t i = 0; i < x0.size(); ++i)
-        x0_double[i] = Value(x0[i]);
+            if ( hess_i == nullptr )
+                continue;
 
-    // Evaluate y = f(q0,u0,0)
-    auto out0 = f.Forward(0, x0_double);
-    auto out0_jacobian = f.Jacobian(x0_double);
-    
-    std::vector<std::vector<double>> out0_hessian(_NSTATE+NALGEBRAIC);
+            if ( !tape.is_hes_pattern_valid[i] )
+                compute_hessian_sparsity(i);
 
-    for (size_t i = 0; i < _NSTATE + NALGEBRAIC; ++i)
-        out0_hessian[i] = f.Hessian(x0_double,i);
+            if ( tape.hes_subset[i].nnz() == 0 )
+                continue;
 
-    // Fill the solution struct
-    Equations solution;
+            w[i] = 1.0;
+            tape.f.sparse_hes(x, w, tape.hes_subset[i], tape.hes_pattern[i], "cppad.symmetric", tape.hes_work[i]);
+            w[i] = 0.0;
 
-    for (size_t i = 0; i < _NSTATE; ++i)
-        solution.dqdt[i] = out0[i];
+            const auto& row = tape.hes_subset[i].row();
+            const auto& col = tape.hes_subset[i].col();
+            const auto& val = tape.hes_subset[i].val();
 
-    for (size_t i = 0; i < NALGEBRAIC; ++i)
-        solution.dqa[i] = out0[i+_NSTATE];
+            for (size_t k = 0; k < tape.hes_subset[i].nnz(); ++k)
+                hess_i[row[k]*NINPUTS + col[k]] = val[k];
+        }
+    }
+}
 
-    for (size_t i = 0; i < _NSTATE; ++i)
-        for (size_t j = 0; j < n_total; ++j)
-            // The CppAD jacobian is sorted as [dy1/dx1, ..., dy1/dxn, dy2/dx1, ..., dy2/dxn, ...]
-            solution.jac_dqdt[i][j] = out0_jacobian[j + n_total*i];
 
-    for (size_t i = 0; i < NALGEBRAIC; ++i)
-        for (size_t j = 0; j < n_total; ++j)
-            solution.jac_dqa[i][j] = out0_jacobian[j + n_total*(i+_NSTATE)];
+template<typename Timeseries_t, typename Chassis_t, typename RoadModel_t, size_t _NSTATE, size_t _NCONTROL>
+void Dynamic_model_car<Timeseries_t,Chassis_t,RoadModel_t,_NSTATE,_NCONTROL>::record_equations_tape(const std::vector<scalar>& x, scalar t)
+{
+    auto& tape = _equations_tape;
 
-    for (size_t var = 0; var < _NSTATE; ++var)
-        for (size_t i = 0; i < n_total; ++i)
-            for (size_t j = 0; j < n_total; ++j)
-            {
-                solution.hess_dqdt[var][i][j] = out0_hessian[var][j + n_total*i];
-    
-                // Check its symmetry
-                assert(std::abs(out0_hessian[var][j + n_total*i]-out0_hessian[var][i + n_total*j]) 
-                         < 1.0e-10*std::max(1.0,std::abs(out0_hessian[var][j+n_total*i])));
+    // (1) Declare x as the independent variables, and the track geometry at t as dynamic parameters
+    std::vector<CppAD::AD<scalar>> x_ad(x.cbegin(), x.cend());
+    std::array<CppAD::AD<scalar>,NGEOMETRY> geometry;
 
-            }
+    if constexpr (NGEOMETRY > 0)
+    {
+        const auto geometry_t = _road.get_geometry(t);
+        std::vector<CppAD::AD<scalar>> geometry_ad(geometry_t.cbegin(), geometry_t.cend());
 
-    for (size_t var = 0; var < NALGEBRAIC; ++var)
-        for (size_t i = 0; i < n_total; ++i)
-            for (size_t j = 0; j < n_total; ++j)
-            {
-                solution.hess_dqa[var][i][j] = out0_hessian[var+_NSTATE][j + n_total*i];
+        CppAD::Independent(x_ad, 0, true, geometry_ad);
+        std::copy(geometry_ad.cbegin(), geometry_ad.cend(), geometry.begin());
+    }
+    else
+        CppAD::Independent(x_ad);
 
-                // Check its symmetry
-                assert(std::abs(out0_hessian[var+_NSTATE][j + n_total*i]-out0_hessian[var+_NSTATE][i + n_total*j]) 
-                         < 1.0e-10*std::max(1.0,std::abs(out0_hessian[var+_NSTATE][j+n_total*i])));
-            }
+    // (2) Call operator(), with the geometry overriden by the dynamic parameters
+    std::array<CppAD::AD<scalar>,_NSTATE>     q;
+    std::array<CppAD::AD<scalar>,NALGEBRAIC> qa;
+    std::array<CppAD::AD<scalar>,_NCONTROL>   u;
 
-    return solution;
+    std::copy_n(x_ad.cbegin(), _NSTATE, q.begin());
+    std::copy_n(x_ad.cbegin() + _NSTATE, NALGEBRAIC, qa.begin());
+    std::copy_n(x_ad.cbegin() + _NSTATE + NALGEBRAIC, _NCONTROL, u.begin());
+
+    if constexpr (NGEOMETRY > 0)
+        _road.set_geometry_override(geometry);
+
+    auto [dqdt,dqa] = (*this)(q,qa,u,t);
+
+    if constexpr (NGEOMETRY > 0)
+        _road.clear_geometry_override();
+
+    std::vector<CppAD::AD<scalar>> y(dqdt.cbegin(), dqdt.cend());
+    y.insert(y.end(), dqa.cbegin(), dqa.cend());
+
+    // (3) Stop the recording and optimize the tape, since it will be reused
+    tape.f.Dependent(x_ad, y);
+    tape.f.optimize();
+
+    tape.t = t;
+    tape.is_valid = true;
+    ++tape.n_recordings;
+
+    // (4) Compute the sparsity pattern of the Jacobian
+    typename Equations_tape::sparse_pattern identity(NINPUTS, NINPUTS, NINPUTS);
+
+    for (size_t k = 0; k < NINPUTS; ++k)
+        identity.set(k, k, k);
+
+    tape.f.for_jac_sparsity(identity, false, false, false, tape.jac_pattern);
+    tape.jac_subset = typename Equations_tape::sparse_matrix(tape.jac_pattern);
+    tape.jac_work.clear();
+
+    // (5) The sparsity patterns of the Hessians are computed on their first use
+    tape.is_hes_pattern_valid.fill(false);
+}
+
+
+template<typename Timeseries_t, typename Chassis_t, typename RoadModel_t, size_t _NSTATE, size_t _NCONTROL>
+void Dynamic_model_car<Timeseries_t,Chassis_t,RoadModel_t,_NSTATE,_NCONTROL>::compute_hessian_sparsity(const size_t i)
+{
+    auto& tape = _equations_tape;
+
+    std::vector<bool> select_domain(NINPUTS, true);
+    std::vector<bool> select_range(NOUTPUTS, false);
+    select_range[i] = true;
+
+    tape.f.for_hes_sparsity(select_domain, select_range, false, tape.hes_pattern[i]);
+
+    tape.hes_subset[i] = typename Equations_tape::sparse_matrix(tape.hes_pattern[i]);
+    tape.hes_work[i].clear();
+    tape.is_hes_pattern_valid[i] = true;
 }
 
 
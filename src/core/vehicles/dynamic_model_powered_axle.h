@@ -29,6 +29,10 @@ class Dynamic_model_powered_axle
 
     const Axle_t& get_axle() const { return _axle; }
 
+    //! Modifyer to set a parameter: the chassis mass "vehicle/chassis/mass", or a parameter of the tires
+    template<typename T>
+    void set_parameter(const std::string& parameter, const T value);
+
 
  private:
     Axle_type _axle;
@@ -25,6 +25,17 @@ Dynamic_model_powered_axle<Timeseries_t,Axle_t,STATE0,CONTROL0>::Dynamic_model_p
 } 
 
 
+template<typename Timeseries_t, typename Axle_t, size_t STATE0, size_t CONTROL0>
+template<typename T>
+void Dynamic_model_powered_axle<Timeseries_t,Axle_t,STATE0,CONTROL0>::set_parameter(const std::string& parameter, const T value)
+{
+    if ( parameter == "vehicle/chassis/mass" )
+        _m = value;
+    else if ( !_axle.set_parameter(parameter, value) )
+        throw std::runtime_error("Parameter \"" + parameter + "\" was not found");
+}
+
+
 template<typename Timeseries_t, typename Axle_t, size_t STATE0, size_t CONTROL0>
 std::array<Timeseries_t,Dynamic_model_powered_axle<Timeseries_t,Axle_t,STATE0,CONTROL0>::NSTATE> Dynamic_model_powered_axle<Timeseries_t,Axle_t,STATE0,CONTROL0>::operator()(
     const std::array<Timeseries_t,Dynamic_model_powered_axle<Timeseries_t,Axle_t,STATE0,CONTROL0>::NSTATE>& q, 
@@ -0,0 +1,171 @@
+// Generated by fastestlap_freeze_vehicle from database/limebeer-2014-f1.xml. Do not edit.
+#ifndef __LIMEBEER_2014_F1_FROZEN_H__
+#define __LIMEBEER_2014_F1_FROZEN_H__
+
+#include "lion/foundation/types.h"
+
+//! Frozen parameters of a limebeer-2014-f1 vehicle
+struct limebeer_2014_f1_frozen
+{
+    //! Type of the vehicle
+    static constexpr const char* vehicle_type = "limebeer-2014-f1";
+
+    //! Parameters of the front-tire (tire-pacejka-simple)
+    struct front_tire
+    {
+        static constexpr const scalar Fz1          = 2.0000000000000000e+03;
+        static constexpr const scalar Fz2          = 6.0000000000000000e+03;
+        static constexpr const scalar mu_x_max1    = 1.7500000000000000e+00;
+        static constexpr const scalar mu_x_max2    = 1.3999999999999999e+00;
+        static constexpr const scalar mu_y_max1    = 1.8000000000000000e+00;
+        static constexpr const scalar mu_y_max2    = 1.4500000000000000e+00;
+        static constexpr const scalar kappa_max1   = 1.1000000000000000e-01;
+        static constexpr const scalar kappa_max2   = 1.0000000000000001e-01;
+        static constexpr const scalar lambda_max1  = 1.5707963267948966e-01;
+        static constexpr const scalar lambda_max2  = 1.3962634015954636e-01;
+        static constexpr const scalar Qx           = 1.8999999999999999e+00;
+        static constexpr const scalar Qy           = 1.8999999999999999e+00;
+        static constexpr const scalar Sx           = 1.4459815188962739e+00;
+        static constexpr const scalar Sy           = 1.4459815188962739e+00;
+        static constexpr const scalar mu_min       = 1.0000000000000000e+00;
+    };
+
+    //! Parameters of the rear-tire (tire-pacejka-simple)
+    struct rear_tire
+    {
+        static constexpr const scalar Fz1          = 2.0000000000000000e+03;
+        static constexpr const scalar Fz2          = 6.0000000000000000e+03;
+        static constexpr const scalar mu_x_max1    = 1.7500000000000000e+00;
+        static constexpr const scalar mu_x_max2    = 1.3999999999999999e+00;
+        static constexpr const scalar mu_y_max1    = 1.8000000000000000e+00;
+        static constexpr const scalar mu_y_max2    = 1.4500000000000000e+00;
+        static constexpr const scalar kappa_max1   = 1.1000000000000000e-01;
+        static constexpr const scalar kappa_max2   = 1.0000000000000001e-01;
+        static constexpr const scalar lambda_max1  = 1.5707963267948966e-01;
+        static constexpr const scalar lambda_max2  = 1.3962634015954636e-01;
+        static constexpr const scalar Qx           = 1.8999999999999999e+00;
+        static constexpr const scalar Qy           = 1.8999999999999999e+00;
+        static constexpr const scalar Sx           = 1.4459815188962739e+00;
+        static constexpr const scalar Sy           = 1.4459815188962739e+00;
+        static constexpr const scalar mu_min       = 1.0000000000000000e+00;
+    };
+
+    //! The source database, used to construct the parameters that are not frozen
+    static constexpr const char* database = R"xml(<!--
+  This model represents the dynamics of a f1 car using a 3DOF chassis
+  Reference: https://www.tandfonline.com/doi/abs/10.1080/00423114.2014.889315
+
+  (*) This parameter does not belong to the model. 
+      Taken from "[Roberto Lot] - Minimum time optimal control
+                                  simulation of a GP2 race car"
+           
+-->
+<vehicle type="limebeer-2014-f1">
+    <front-axle model="axle-car"> 
+        <track units="m"> 1.46 </track>
+        <inertia units="kg.m2"> 1.00 </inertia>   <!-- (*) -->
+        <smooth_throttle_coeff> 1.0e-5 </smooth_throttle_coeff>
+        <brakes>
+            <max_torque units="N.m">5000.0</max_torque>
+        </brakes>
+    </front-axle>
+
+    <rear-axle>
+        <track units="m"> 1.46 </track>
+        <inertia units="kg.m2"> 1.55 </inertia>   <!-- (*) -->
+        <smooth_throttle_coeff> 1.0e-5 </smooth_throttle_coeff>
+        <differential_stiffness units="N.m.s/rad"> 10.47 </differential_stiffness>
+        <brakes>
+            <max_torque units="N.m">5000.0</max_torque>
+        </brakes>
+        <engine>
+            <maximum-power units="kW"> 735.499 </maximum-power>
+        </engine>
+    </rear-axle>
+
+    <chassis>
+        <mass units="kg"> 660.0 </mass>
+
+        <!-- 
+            Inertia matrix: this 3DOF model only uses Izz
+        -->
+        <inertia units="kg.m">
+             0.0  0.0  0.0
+             0.0  0.0  0.0
+             0.0  0.0 450.0
+        </inertia>
+
+        <aerodynamics>
+            <rho units="kg/m3"> 1.2 </rho>
+            <area units="m2"> 1.5 </area>
+            <cd> 0.9 </cd>
+            <cl> 3.0 </cl>
+        </aerodynamics>
+
+        <com units="m"> 
+            <x> 0.0 </x>
+            <y> 0.0 </y>
+            <z> -0.3 </z> 
+        </com>
+        <front_axle units="m"> 
+            <x>  1.8  </x> 
+            <y>  0.0  </y> 
+            <z> -0.33 </z> 
+        </front_axle>
+        <rear_axle units="m"> 
+            <x> -1.6  </x> 
+            <y>  0.0  </y> 
+            <z> -0.33 </z> 
+        </rear_axle>
+        <pressure_center units="m"> 
+            <x> -0.1 </x> 
+            <y>  0.0 </y> 
+            <z> -0.3 </z>
+        </pressure_center>
+        <brake_bias> 0.6 </brake_bias>
+        <roll_balance_coefficient> 0.5 </roll_balance_coefficient>
+        <Fz_max_ref2> 1.0 </Fz_max_ref2>
+    </chassis>
+
+    <front-tire model="tire-pacejka-simple" type="normal">
+        <radius units="m">0.330</radius> 
+        <radial-stiffness>0.0</radial-stiffness>
+        <radial-damping>0.0</radial-damping>
+        <Fz-max-ref2> 1.0 </Fz-max-ref2>
+        <reference-load-1 units="N"> 2000.0 </reference-load-1> 
+        <reference-load-2 units="N"> 6000.0 </reference-load-2> 
+        <mu-x-max-1> 1.75 </mu-x-max-1>
+        <mu-x-max-2> 1.40 </mu-x-max-2>
+        <kappa-max-1> 0.11 </kappa-max-1>
+        <kappa-max-2> 0.10 </kappa-max-2>
+        <mu-y-max-1> 1.80 </mu-y-max-1>
+        <mu-y-max-2> 1.45 </mu-y-max-2>
+        <lambda-max-1 units="deg"> 9.0 </lambda-max-1>
+        <lambda-max-2 units="deg"> 8.0 </lambda-max-2>
+        <Qx> 1.9 </Qx>
+        <Qy> 1.9 </Qy>
+    </front-tire>
+
+    <rear-tire model="tire-pacejka-simple" type="normal">
+        <radius units="m">0.330</radius> 
+        <radial-stiffness>0.0</radial-stiffness>
+        <radial-damping>0.0</radial-damping>
+        <Fz-max-ref2> 1.0 </Fz-max-ref2>
+        <reference-load-1 units="N"> 2000.0 </reference-load-1> 
+        <reference-load-2 units="N"> 6000.0 </reference-load-2> 
+        <mu-x-max-1> 1.75 </mu-x-max-1>
+        <mu-x-max-2> 1.40 </mu-x-max-2>
+        <kappa-max-1> 0.11 </kappa-max-1>
+        <kappa-max-2> 0.10 </kappa-max-2>
+        <mu-y-max-1> 1.80 </mu-y-max-1>
+        <mu-y-max-2> 1.45 </mu-y-max-2>
+        <lambda-max-1 units="deg"> 9.0 </lambda-max-1>
+        <lambda-max-2 units="deg"> 8.0 </lambda-max-2>
+        <Qx> 1.9 </Qx>
+        <Qy> 1.9 </Qy>
+    </rear-tire>
+</vehicle>
+)xml";
+};
+
+#endif
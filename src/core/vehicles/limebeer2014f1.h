@@ -11,16 +11,39 @@
 #include "src/core/vehicles/dynamic_model_car.h"
 #include "lion/thirdparty/include/cppad/cppad.hpp"
 
-template<typename Timeseries_t>
+//! Tire models of the limebeer2014f1 vehicle
+//! @param FrozenParams: parameters frozen at compile time (see fastestlap_freeze_vehicle)
+template<typename FrozenParams>
+struct limebeer2014f1_tire_models
+{
+    using front = Pacejka_simple_model_frozen<typename FrozenParams::front_tire>;
+    using rear  = Pacejka_simple_model_frozen<typename FrozenParams::rear_tire>;
+};
+
+//! Tire models of the limebeer2014f1 vehicle: parameters read from the database at runtime
+template<>
+struct limebeer2014f1_tire_models<void>
+{
+    using front = Pacejka_simple_model;
+    using rear  = Pacejka_simple_model;
+};
+
+//! F1 car model from Limebeer et al. 2014
+//! @param Timeseries_t: scalar or CppAD::AD<scalar>
+//! @param FrozenParams: if void, all the parameters are read from the database. Otherwise, a struct
+//!                      generated by fastestlap_freeze_vehicle whose tire parameters are compile-time constants
+template<typename Timeseries_t, typename FrozenParams = void>
 class limebeer2014f1
 {
  public:
     limebeer2014f1() = delete;
 
-    using Front_left_tire_type  = Tire_pacejka_simple<Timeseries_t,0,0>;
-    using Front_right_tire_type = Tire_pacejka_simple<Timeseries_t,Front_left_tire_type::STATE_END,Front_left_tire_type::CONTROL_END>;
-    using Rear_left_tire_type   = Tire_pacejka_simple<Timeseries_t,Front_right_tire_type::STATE_END,Front_right_tire_type::CONTROL_END>;
-    using Rear_right_tire_type  = Tire_pacejka_simple<Timeseries_t,Rear_left_tire_type::STATE_END,Rear_left_tire_type::CONTROL_END>;
+    using Tire_models_t         = limebeer2014f1_tire_models<FrozenParams>;
+
+    using Front_left_tire_type  = Tire_pacejka<Timeseries_t,typename Tire_models_t::front,0,0>;
+    using Front_right_tire_type = Tire_pacejka<Timeseries_t,typename Tire_models_t::front,Front_left_tire_type::STATE_END,Front_left_tire_type::CONTROL_END>;
+    using Rear_left_tire_type   = Tire_pacejka<Timeseries_t,typename Tire_models_t::rear,Front_right_tire_type::STATE_END,Front_right_tire_type::CONTROL_END>;
+    using Rear_right_tire_type  = Tire_pacejka<Timeseries_t,typename Tire_models_t::rear,Rear_left_tire_type::STATE_END,Rear_left_tire_type::CONTROL_END>;
 
     using Front_axle_t          = Axle_car_3dof<Timeseries_t,Front_left_tire_type,Front_right_tire_type,STEERING,Rear_right_tire_type::STATE_END,Rear_right_tire_type::CONTROL_END>;
     using Rear_axle_t           = Axle_car_3dof<Timeseries_t,Rear_left_tire_type,Rear_right_tire_type,POWERED,Front_axle_t::STATE_END,Front_axle_t::CONTROL_END>;
@@ -12,6 +12,9 @@ class Road
     enum State { STATE_END = STATE0};
     enum Controls { CONTROL_END = CONTROL0 };
 
+    //! Number of track geometry parameters used by the equations (none by default)
+    constexpr static size_t NGEOMETRY = 0;
+
     constexpr const Timeseries_t& get_x() const { return _x; }
 
     constexpr const Timeseries_t& get_y() const { return _y; }
@@ -17,6 +17,12 @@ class Road_curvilinear : public Road<Timeseries_t,STATE0,CONTROL0>
 
     enum State { ITIME = base_type::STATE_END, IN, IALPHA, STATE_END };
     enum Controls { CONTROL_END = base_type::CONTROL_END };
+
+    //! Track geometry parameters used by the equations: centerline position, normal vector, heading angle,
+    //! curvature, and norm of the centerline derivative
+    enum Geometry { IGEOM_X, IGEOM_Y, IGEOM_NX, IGEOM_NY, IGEOM_THETA, IGEOM_KAPPA, IGEOM_DRNORM, GEOMETRY_END };
+
+    constexpr static size_t NGEOMETRY = GEOMETRY_END;
     
     constexpr static size_t IIDTIME  = ITIME;
     constexpr static size_t IIDN     = IN;
@@ -47,6 +53,18 @@ class Road_curvilinear : public Road<Timeseries_t,STATE0,CONTROL0>
 
     constexpr const Track_t& get_track() const { return _track; }
 
+    //! Compute the track geometry parameters at a given arclength
+    //! @param[in] t: arclength
+    std::array<scalar,NGEOMETRY> get_geometry(const scalar t) const;
+
+    //! Use the given geometry parameters instead of the ones computed from the track in update_track().
+    //! Used to record the equations with the geometry as a parameter (e.g. CppAD dynamic parameters)
+    //! @param[in] geometry: the track geometry parameters
+    void set_geometry_override(const std::array<Timeseries_t,NGEOMETRY>& geometry) { _geometry = geometry; _is_geometry_overriden = true; }
+
+    //! Go back to compute the geometry parameters from the track
+    void clear_geometry_override() { _is_geometry_overriden = false; }
+
     void update(const Timeseries_t u, const Timeseries_t v, const Timeseries_t omega);
 
     template<size_t N>
@@ -77,6 +95,8 @@ class Road_curvilinear : public Road<Timeseries_t,STATE0,CONTROL0>
     scalar _k;
     scalar _theta;
 
+    std::array<Timeseries_t,NGEOMETRY> _geometry;   //! Geometry parameters used by the equations
+    bool _is_geometry_overriden = false;            //! If true, _geometry is not computed by update_track()
 
     Timeseries_t _time;  //! The simulation time
     Timeseries_t _n;     //! The normal distance to the road centerline
@@ -11,9 +11,10 @@ inline Road_curvilinear<Timeseries_t,Track_t,STATE0,CONTROL0>::Road_curvilinear(
 template<typename Timeseries_t,typename Track_t,size_t STATE0, size_t CONTROL0>
 void Road_curvilinear<Timeseries_t,Track_t,STATE0,CONTROL0>::update(const Timeseries_t u, const Timeseries_t v, const Timeseries_t omega)
 {
-    const Timeseries_t dtimeds = (1.0 - _n*_k)/(u*cos(_alpha) - v*sin(_alpha));
+    const Timeseries_t& k = _geometry[IGEOM_KAPPA];
+    const Timeseries_t dtimeds = (1.0 - _n*k)/(u*cos(_alpha) - v*sin(_alpha));
 
-    base_type::_dtimedt = dtimeds*_drnorm;
+    base_type::_dtimedt = dtimeds*_geometry[IGEOM_DRNORM];
 
     // dtimedtime
     _dtime = 1.0;
@@ -22,7 +23,7 @@ void Road_curvilinear<Timeseries_t,Track_t,STATE0,CONTROL0>::update(const Timese
     _dn = u*sin(_alpha) + v*cos(_alpha);
 
     // dalphadtime
-    _dalpha = omega - _k/dtimeds;
+    _dalpha = omega - k/dtimeds;
 }
 
 
@@ -59,9 +60,9 @@ void Road_curvilinear<Timeseries_t,Track_t,STATE0,CONTROL0>::set_state_and_contr
     // Compute x,y and psi from the track
     
     // Frenet frame (tan,nor,bi)
-    base_type::_x   = _r[X] + _n*_nor[X];
-    base_type::_y   = _r[Y] + _n*_nor[Y];
-    base_type::_psi = _alpha + _theta;
+    base_type::_x   = _geometry[IGEOM_X] + _n*_geometry[IGEOM_NX];
+    base_type::_y   = _geometry[IGEOM_Y] + _n*_geometry[IGEOM_NY];
+    base_type::_psi = _alpha + _geometry[IGEOM_THETA];
 }
 
 
@@ -102,5 +103,21 @@ inline void Road_curvilinear<Timeseries_t,Track_t,STATE0,CONTROL0>::update_track
 
     // Curvature
     _k = curvature(_dr,_d2r,_drnorm);
+
+    // Geometry parameters used by the equations
+    if ( !_is_geometry_overriden )
+        _geometry = { _r[X], _r[Y], _nor[X], _nor[Y], _theta, _k, _drnorm };
+}
+
+
+template<typename Timeseries_t,typename Track_t,size_t STATE0, size_t CONTROL0>
+inline std::array<scalar,Road_curvilinear<Timeseries_t,Track_t,STATE0,CONTROL0>::NGEOMETRY> 
+    Road_curvilinear<Timeseries_t,Track_t,STATE0,CONTROL0>::get_geometry(const scalar t) const
+{
+    const auto [r, dr, d2r] = _track(t);
+    const scalar drnorm = dr.norm();
+    const sVector3d tan = dr/drnorm;
+
+    return { r[X], r[Y], -tan[Y], tan[X], atan2(tan[Y],tan[X]), curvature(dr,d2r,drnorm), drnorm };
 }
 #endif
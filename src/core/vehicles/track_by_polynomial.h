@@ -1,40 +1,90 @@
 #ifndef __TRACK_BY_POLYNOMIAL_H__
 #define __TRACK_BY_POLYNOMIAL_H__
 
+#include <memory>
 #include "lion/io/Xml_document.h"
 #include "src/core/applications/circuit_preprocessor.h"
 
+//!     Track defined by the polynomials of its centerline and track limits
+//!     --------------------------------------------------------------------
+//!
+//! The track data is immutable and reference counted: copies share it, so that binding a track to a
+//! road (e.g. Road_curvilinear::change_track) is O(1), and the memory does not grow with the number of
+//! vehicles that use it. The circuit preprocessor used to construct the track is kept optionally
+//!
+//! Tracks constructed from a preprocessor are piecewise linear between its nodes. They keep the nodes, with a
+//! uniform bucket index of their segments, so that the segment of s is found in O(1), and the centerline, its
+//! derivatives, and the track limits are evaluated in one pass (evaluate()). A Cursor also reuses the segment
+//! of the previous query, for monotone sequences of s. Other tracks are evaluated with their polynomials
+//!
 class Track_by_polynomial
 {
+    struct Polynomials;
+
  public:
 
-    Track_by_polynomial() = default;
+    //! Centerline, derivatives, and track limits at one arclength
+    struct Geometry
+    {
+        sVector3d r;        //! Position
+        sVector3d dr;       //! First derivative of the position
+        sVector3d d2r;      //! Second derivative of the position
+        scalar wl;          //! Distance to the left track limit
+        scalar wr;          //! Distance to the right track limit
+    };
+
+    //! Sequential evaluator: starts the segment search from the segment of the previous query
+    class Cursor
+    {
+     public:
+        Cursor(const Track_by_polynomial& track) : _polynomials(track._polynomials) {}
+
+        Geometry operator()(const scalar s);
 
-    Track_by_polynomial(Xml_document& doc);
+     private:
+        std::shared_ptr<const Polynomials> _polynomials;    //! Data of the track, kept alive by the cursor
+        size_t _segment = 0;                                //! Segment of the previous query
+    };
+
+    Track_by_polynomial() : _polynomials(get_empty_polynomials()) {}
+
+    //! Constructor from an xml document, in "by-polynomial" or "discrete" format
+    //! @param[in] doc: the xml document
+    //! @param[in] keep_preprocessor: if true and the format is "discrete", keep the preprocessor in the track
+    Track_by_polynomial(Xml_document& doc, const bool keep_preprocessor = true);
 
     Track_by_polynomial(const vPolynomial& r, const sPolynomial& wl, const sPolynomial& wr) 
-        : _r(r), _dr(_r.derivative()), _d2r(_dr.derivative()), _wl(wl), _wr(wr) {}
+        : Track_by_polynomial(r, r.derivative(), r.derivative().derivative(), wl, wr) {}
 
     Track_by_polynomial(const vPolynomial& r, const vPolynomial& dr, const vPolynomial& d2r, const sPolynomial& wl, const sPolynomial& wr)
-        : _r(r), _dr(dr), _d2r(d2r), _wl(wl), _wr(wr) {}
+        : _polynomials(std::make_shared<const Polynomials>(Polynomials{r, dr, d2r, wl, wr})) {}
 
-    Track_by_polynomial(const Circuit_preprocessor& circuit_preprocessor);
+    //! Constructor from a circuit preprocessor
+    //! @param[in] circuit_preprocessor: the preprocessed circuit
+    //! @param[in] keep_preprocessor: if true, keep a copy of the preprocessor in the track
+    Track_by_polynomial(const Circuit_preprocessor& circuit_preprocessor, const bool keep_preprocessor = true);
 
     Track_by_polynomial(std::tuple<vPolynomial,sPolynomial,sPolynomial> p) : Track_by_polynomial(std::get<0>(p), std::get<1>(p), std::get<2>(p)) {}
 
-    scalar get_left_track_limit(scalar s) const { return _wl(s); }
+    scalar get_left_track_limit(scalar s) const;
+
+    scalar get_right_track_limit(scalar s) const;
 
-    scalar get_right_track_limit(scalar s) const { return _wr(s); }
+    const scalar& get_total_length() const { return _polynomials->r.get_right_bound(); } 
 
-    constexpr const scalar& get_total_length() const { return _r.get_right_bound(); } 
+    std::tuple<sVector3d,sVector3d,sVector3d> operator()(const scalar& t) const;
 
-    std::tuple<sVector3d,sVector3d,sVector3d> operator()(const scalar& t) { return std::make_tuple(_r(t),_dr(t),_d2r(t)); }
+    //! Evaluate the centerline, its derivatives, and the track limits in one pass
+    Geometry evaluate(const scalar s) const;
+
+    //! If the track is evaluated from its nodes, with O(1) segment lookup
+    bool has_nodes() const { return !_polynomials->nodes.s.empty(); }
 
     template<typename Timeseries_t>
-    Vector3d<Timeseries_t> position_at(const scalar t, const Timeseries_t& w)
+    Vector3d<Timeseries_t> position_at(const scalar t, const Timeseries_t& w) const
     {
-        auto r = _r(t);
-        auto dr = _dr(t);
+        auto r = _polynomials->r(t);
+        auto dr = _polynomials->dr(t);
                 
         return 
         {  
@@ -42,19 +92,74 @@ class Track_by_polynomial
         };
     }
 
-    const Circuit_preprocessor& get_preprocessor() const { return _preprocessor; }
+    //! If the track keeps the preprocessor used to compute it
+    bool has_preprocessor() const { return _preprocessor != nullptr; }
+
+    const Circuit_preprocessor& get_preprocessor() const 
+    { 
+        if ( _preprocessor == nullptr )
+            throw std::runtime_error("Track_by_polynomial: the track does not keep its preprocessor");
+
+        return *_preprocessor; 
+    }
+
+    //! Get a track that shares the polynomials of this one, without the preprocessor
+    Track_by_polynomial without_preprocessor() const { Track_by_polynomial track(*this); track._preprocessor = nullptr; return track; }
+
+    //! If both tracks share the same data
+    bool is_same_track(const Track_by_polynomial& other) const { return _polynomials == other._polynomials; }
 
  private:
-    vPolynomial _r;     //! Position vector polynomial
-    vPolynomial _dr;    //! Position vector derivative polynomial
-    vPolynomial _d2r;   //! Position vector second derivative polynomial
 
-    sPolynomial _wl;    //! Distance to the left track limit
-    sPolynomial _wr;    //! Distance to the right track limit
+    //! Nodes of a piecewise linear track, with a uniform bucket index of its segments
+    struct Nodes
+    {
+        enum { IX, IY, IDX, IDY, ID2X, ID2Y, IWL, IWR, NVALUES };
 
-    Circuit_preprocessor _preprocessor;     //! Save the preprocessor used to compute this track
+        std::vector<scalar> s;                                  //! Arclength of the nodes
+        std::vector<std::array<scalar,NVALUES>> values;         //! Values at the nodes
+
+        scalar bucket_size = 1.0;                               //! Length of the buckets
+        std::vector<size_t> bucket_segment;                     //! Segment of the start of each bucket
+
+        //! Construct the bucket index: as many buckets as segments
+        void build_index();
+
+        //! Segment that contains s, in O(1) for meshes of bounded element size ratio
+        size_t find_segment(const scalar s) const;
+
+        //! Segment that contains s, searched from a nearby segment
+        size_t find_segment(const scalar s, const size_t segment_hint) const;
+
+        //! Linear interpolation in the given segment
+        Geometry evaluate(const scalar s, const size_t segment) const;
+    };
+
+    //! Immutable track data, shared by all the copies
+    struct Polynomials
+    {
+        vPolynomial r;      //! Position vector polynomial
+        vPolynomial dr;     //! Position vector derivative polynomial
+        vPolynomial d2r;    //! Position vector second derivative polynomial
+
+        sPolynomial wl;     //! Distance to the left track limit
+        sPolynomial wr;     //! Distance to the right track limit
+
+        Nodes nodes;        //! Nodes, if the track is piecewise linear
+    };
+
+    std::shared_ptr<const Polynomials> _polynomials;                //! Polynomials of the track
+
+    std::shared_ptr<const Circuit_preprocessor> _preprocessor;      //! The preprocessor used to compute this track, if kept
+
+    //! Data of default constructed tracks
+    static const std::shared_ptr<const Polynomials>& get_empty_polynomials() 
+        { static const auto empty = std::make_shared<const Polynomials>(); return empty; }
 
     static std::tuple<vPolynomial,sPolynomial,sPolynomial> compute_track_polynomial(Xml_document& doc);
+
+    //! Evaluate the track from its polynomials
+    static Geometry evaluate_polynomials(const Polynomials& polynomials, const scalar s);
 };
 
 #include "track_by_polynomial.hpp"
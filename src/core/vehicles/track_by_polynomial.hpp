@@ -2,7 +2,7 @@
 #define __TRACK_BY_POLYNOMIAL_HPP__
 
 
-inline Track_by_polynomial::Track_by_polynomial(Xml_document& doc)
+inline Track_by_polynomial::Track_by_polynomial(Xml_document& doc, const bool keep_preprocessor)
 {
     if ( doc.get_root_element().get_attribute("format") == "by-polynomial" )
         *this = Track_by_polynomial(compute_track_polynomial(doc));
@@ -10,14 +10,14 @@ inline Track_by_polynomial::Track_by_polynomial(Xml_document& doc)
     else if ( doc.get_root_element().get_attribute("format") == "discrete" )
     {
         Circuit_preprocessor circuit(doc);
-        *this = Track_by_polynomial(circuit);
+        *this = Track_by_polynomial(circuit, keep_preprocessor);
     }
     else
         throw std::runtime_error("Format is not recognized. Options are \"by-polynomial\" and \"discrete\"");
 }
 
 
-inline Track_by_polynomial::Track_by_polynomial(const Circuit_preprocessor& circuit)
+inline Track_by_polynomial::Track_by_polynomial(const Circuit_preprocessor& circuit, const bool keep_preprocessor)
 {
     auto s = circuit.s;
     auto r_centerline = circuit.r_centerline;
@@ -57,17 +57,165 @@ inline Track_by_polynomial::Track_by_polynomial(const Circuit_preprocessor& circ
         d2r[i] = kappa[i]*sVector3d(-sin(theta[i]), cos(theta[i]), 0.0);
     
     
+    // Keep the nodes, for the O(1) evaluation of the piecewise linear track
+    Nodes nodes;
+    nodes.s = s;
+    nodes.values.resize(s.size());
+
+    for (size_t i = 0; i < s.size(); ++i)
+        nodes.values[i] = {r_centerline[i].x(), r_centerline[i].y(), dr[i].x(), dr[i].y(), d2r[i].x(), d2r[i].y(), nl[i], nr[i]};
+
+    nodes.build_index();
+    
     // Construct the polynomials
-    _r   = {s,r_centerline,1,false};
-    _dr  = {s,dr,1,false};
-    _d2r = {s,d2r,1,false};
-    _wl  = {s,nl,1,false};
-    _wr  = {s,nr,1,false};
+    _polynomials = std::make_shared<const Polynomials>(Polynomials{{s,r_centerline,1,false}, {s,dr,1,false}, {s,d2r,1,false}, 
+                                                                   {s,nl,1,false}, {s,nr,1,false}, std::move(nodes)});
 
     // Save the preprocessor
-    _preprocessor = circuit;
+    if ( keep_preprocessor )
+        _preprocessor = std::make_shared<const Circuit_preprocessor>(circuit);
+}
+
+inline scalar Track_by_polynomial::get_left_track_limit(scalar s) const
+{
+    const auto& nodes = _polynomials->nodes;
+
+    if ( nodes.s.empty() )
+        return _polynomials->wl(s);
+
+    const size_t i = nodes.find_segment(s);
+    const scalar xi = (s - nodes.s[i])/(nodes.s[i+1] - nodes.s[i]);
+
+    return nodes.values[i][Nodes::IWL] + xi*(nodes.values[i+1][Nodes::IWL] - nodes.values[i][Nodes::IWL]);
+}
+
+
+inline scalar Track_by_polynomial::get_right_track_limit(scalar s) const
+{
+    const auto& nodes = _polynomials->nodes;
+
+    if ( nodes.s.empty() )
+        return _polynomials->wr(s);
+
+    const size_t i = nodes.find_segment(s);
+    const scalar xi = (s - nodes.s[i])/(nodes.s[i+1] - nodes.s[i]);
+
+    return nodes.values[i][Nodes::IWR] + xi*(nodes.values[i+1][Nodes::IWR] - nodes.values[i][Nodes::IWR]);
+}
+
+
+inline std::tuple<sVector3d,sVector3d,sVector3d> Track_by_polynomial::operator()(const scalar& t) const
+{
+    if ( _polynomials->nodes.s.empty() )
+        return std::make_tuple(_polynomials->r(t),_polynomials->dr(t),_polynomials->d2r(t));
+
+    const auto geometry = evaluate(t);
+    return std::make_tuple(geometry.r, geometry.dr, geometry.d2r);
+}
+
+
+inline Track_by_polynomial::Geometry Track_by_polynomial::evaluate(const scalar s) const
+{
+    const auto& nodes = _polynomials->nodes;
+
+    if ( nodes.s.empty() )
+        return evaluate_polynomials(*_polynomials, s);
+
+    return nodes.evaluate(s, nodes.find_segment(s));
+}
+
+
+inline Track_by_polynomial::Geometry Track_by_polynomial::evaluate_polynomials(const Polynomials& polynomials, const scalar s)
+{
+    return {polynomials.r(s), polynomials.dr(s), polynomials.d2r(s), polynomials.wl(s), polynomials.wr(s)};
+}
+
+
+inline Track_by_polynomial::Geometry Track_by_polynomial::Cursor::operator()(const scalar s)
+{
+    const auto& nodes = _polynomials->nodes;
+
+    if ( nodes.s.empty() )
+        return evaluate_polynomials(*_polynomials, s);
+
+    const size_t n_segments = nodes.s.size() - 1;
+
+    // (1) Same segment as the previous query, or the next one: no lookup. Otherwise use the buckets
+    const bool is_in_segment = (s >= nodes.s[_segment]) && ((_segment + 1 == n_segments) || (s < nodes.s[_segment+1]));
+
+    if ( !is_in_segment )
+    {
+        const bool is_in_next_segment = (_segment + 1 < n_segments) && (s >= nodes.s[_segment+1]) 
+                                     && ((_segment + 2 == n_segments) || (s < nodes.s[_segment+2]));
+
+        _segment = (is_in_next_segment ? _segment + 1 : nodes.find_segment(s));
+    }
+
+    // (2) Evaluate
+    return nodes.evaluate(s, _segment);
+}
+
+
+inline void Track_by_polynomial::Nodes::build_index()
+{
+    if ( s.size() < 2 )
+        throw std::runtime_error("Track_by_polynomial: at least two nodes are required");
+
+    const size_t n_segments = s.size() - 1;
+    bucket_size = (s.back() - s.front())/n_segments;
+    bucket_segment.resize(n_segments);
+
+    size_t segment = 0;
+    for (size_t b = 0; b < n_segments; ++b)
+    {
+        const scalar s_bucket = s.front() + b*bucket_size;
+
+        while ( (segment + 1 < n_segments) && (s[segment+1] <= s_bucket) )
+            ++segment;
+
+        bucket_segment[b] = segment;
+    }
+}
+
+
+inline size_t Track_by_polynomial::Nodes::find_segment(const scalar s_query) const
+{
+    const size_t n_segments = s.size() - 1;
+    const scalar position = (s_query - s.front())/bucket_size;
+    const size_t bucket = (position > 0.0 ? std::min(static_cast<size_t>(std::min(position, static_cast<scalar>(n_segments))), n_segments - 1) : 0);
+
+    return find_segment(s_query, bucket_segment[bucket]);
+}
+
+
+inline size_t Track_by_polynomial::Nodes::find_segment(const scalar s_query, const size_t segment_hint) const
+{
+    const size_t n_segments = s.size() - 1;
+    size_t segment = std::min(segment_hint, n_segments - 1);
+
+    while ( (segment + 1 < n_segments) && (s_query >= s[segment+1]) )
+        ++segment;
+
+    while ( (segment > 0) && (s_query < s[segment]) )
+        --segment;
+
+    return segment;
 }
 
+
+inline Track_by_polynomial::Geometry Track_by_polynomial::Nodes::evaluate(const scalar s_query, const size_t segment) const
+{
+    const auto& a = values[segment];
+    const auto& b = values[segment+1];
+    const scalar xi = (s_query - s[segment])/(s[segment+1] - s[segment]);
+
+    auto interpolate = [&](const size_t j) { return a[j] + xi*(b[j] - a[j]); };
+
+    return { sVector3d(interpolate(IX), interpolate(IY), 0.0), sVector3d(interpolate(IDX), interpolate(IDY), 0.0),
+             sVector3d(interpolate(ID2X), interpolate(ID2Y), 0.0), interpolate(IWL), interpolate(IWR) };
+}
+
+
 inline std::tuple<vPolynomial,sPolynomial,sPolynomial> Track_by_polynomial::compute_track_polynomial(Xml_document& doc)   
 {
     auto xml_segments = doc.get_root_element().get_children();
@@ -0,0 +1,108 @@
+#ifndef __TRACK_CACHE_H__
+#define __TRACK_CACHE_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include "src/core/vehicles/track_by_polynomial.h"
+#include "src/core/applications/circuit_preprocessor.h"
+
+//!     Cache of preprocessed tracks
+//!     ----------------------------
+//!
+//! Stores the preprocessed circuits in a compact binary format, in a local directory, keyed by a hash of their
+//! inputs: the contents of the source files, the preprocessor options, and the constructor arguments. Loading
+//! a cached track maps the file and copies its arrays, instead of parsing the XML or solving the preprocessor.
+//!
+//! Binary format (native endianness, checked on load):
+//!     header: "FLTRACK" magic [8], format version [u32], endianness mark [u32], key [u64], payload size [u64], payload hash [u64]
+//!     payload: the scalars of the preprocessor, then its arrays, each as its size [u64] followed by its values [f64]
+//!
+//! Files with another version, key, or hash are ignored and overwritten. Files are written to a temporary file
+//! and renamed, so that concurrent processes never read partial files.
+//!
+class Track_cache
+{
+ public:
+    //! Version of the binary format
+    constexpr static uint32_t FORMAT_VERSION = 1;
+
+    //! Incremental 64-bit FNV-1a hash
+    class Content_hash
+    {
+     public:
+        Content_hash& add_bytes(const void* data, const size_t size);
+
+        //! Add the contents of a file
+        Content_hash& add_file(const std::string& filename);
+
+        Content_hash& add(const std::string& value);
+
+        //! Integers are hashed as 64-bit, so that the hash does not depend on the type of the literals
+        template<typename T>
+        std::enable_if_t<std::is_arithmetic_v<T>,Content_hash&> add(const T value);
+
+        //! Add the options that change the result of the preprocessor
+        Content_hash& add(const Circuit_preprocessor::Options& options);
+
+        Content_hash& add(const Circuit_preprocessor::Coordinates& coordinates);
+
+        template<typename T1, typename T2>
+        Content_hash& add(const std::pair<T1,T2>& value) { add(value.first); return add(value.second); }
+
+        template<typename T>
+        Content_hash& add(const std::vector<T>& values);
+
+        uint64_t get() const { return _hash; }
+
+     private:
+        uint64_t _hash = 14695981039346656037ull;
+    };
+
+    //! Constructor
+    //! @param[in] directory: the cache directory, created if needed
+    explicit Track_cache(const std::string& directory = get_default_directory());
+
+    //! Default directory: $FASTESTLAP_CACHE_DIR, $XDG_CACHE_HOME/fastest-lap, $HOME/.cache/fastest-lap, or ./.fastest-lap-cache
+    static std::string get_default_directory();
+
+    //! Get the track of an xml file in "discrete" format, from the cache if present
+    //! @param[in] track_file: the xml file
+    //! @param[in] keep_preprocessor: if true, keep the preprocessor in the track
+    Track_by_polynomial get_track(const std::string& track_file, const bool keep_preprocessor = true) const;
+
+    //! Get the preprocessed circuit of two KML/KMZ files, from the cache if present
+    //! @param[in] args: the arguments of the Circuit_preprocessor constructor, after the options
+    template<typename ... Args>
+    Circuit_preprocessor get_preprocessor(const std::string& coord_left_file, const std::string& coord_right_file,
+                                          const Circuit_preprocessor::Options& options, Args&&... args) const;
+
+    //! Path of the file of a key
+    std::string get_path(const uint64_t key) const;
+
+    //! Load a circuit from the cache
+    //! @return false if the file does not exist, or is not valid for this key
+    bool load(const uint64_t key, Circuit_preprocessor& circuit) const;
+
+    //! Store a circuit in the cache
+    //! @return false if the file could not be written
+    bool store(const uint64_t key, const Circuit_preprocessor& circuit) const;
+
+    //! Write a circuit in the binary format
+    static std::vector<char> serialize(const uint64_t key, const Circuit_preprocessor& circuit);
+
+    //! Read a circuit in the binary format
+    //! @return false if the data is not valid for this key
+    static bool deserialize(const char* data, const size_t size, const uint64_t key, Circuit_preprocessor& circuit);
+
+ private:
+    std::string _directory;     //! The cache directory
+
+    constexpr static size_t HEADER_SIZE = 40;
+    constexpr static uint32_t ENDIANNESS_MARK = 0x01020304;
+};
+
+#include "track_cache.hpp"
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef __TRACK_CACHE_HPP__
+#define __TRACK_CACHE_HPP__
+
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include "src/core/foundation/mapped_file.h"
+
+inline Track_cache::Content_hash& Track_cache::Content_hash::add_bytes(const void* data, const size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        _hash ^= bytes[i];
+        _hash *= 1099511628211ull;
+    }
+
+    return *this;
+}
+
+
+inline Track_cache::Content_hash& Track_cache::Content_hash::add_file(const std::string& filename)
+{
+    const Mapped_file file(filename);
+    add(static_cast<uint64_t>(file.size()));
+    return add_bytes(file.data(), file.size());
+}
+
+
+inline Track_cache::Content_hash& Track_cache::Content_hash::add(const std::string& value)
+{
+    add(static_cast<uint64_t>(value.size()));
+    return add_bytes(value.data(), value.size());
+}
+
+
+template<typename T>
+inline std::enable_if_t<std::is_arithmetic_v<T>,Track_cache::Content_hash&> Track_cache::Content_hash::add(const T value)
+{
+    if constexpr (std::is_integral_v<T>)
+    {
+        const int64_t value_64 = static_cast<int64_t>(value);
+        return add_bytes(&value_64, sizeof(int64_t));
+    }
+    else
+    {
+        const double value_64 = static_cast<double>(value);
+        return add_bytes(&value_64, sizeof(double));
+    }
+}
+
+
+inline Track_cache::Content_hash& Track_cache::Content_hash::add(const Circuit_preprocessor::Options& options)
+{
+    // All the options, except print_level
+    add(options.eps_d).add(options.eps_k).add(options.eps_n).add(options.eps_c);
+    add(options.maximum_kappa).add(options.maximum_dkappa).add(options.maximum_dn).add(options.maximum_distance_find);
+    add(options.adaption_aspect_ratio_max).add(options.maximum_association_iterations);
+    add(options.multilevel_levels).add(options.multilevel_coarsening).add(options.multilevel_minimum_elements);
+    return add(options.parallel_chunks).add(options.chunk_overlap);
+}
+
+
+inline Track_cache::Content_hash& Track_cache::Content_hash::add(const Circuit_preprocessor::Coordinates& coordinates)
+{
+    return add(coordinates.longitude).add(coordinates.latitude);
+}
+
+
+template<typename T>
+inline Track_cache::Content_hash& Track_cache::Content_hash::add(const std::vector<T>& values)
+{
+    add(static_cast<uint64_t>(values.size()));
+
+    for (const auto& value : values)
+        add(value);
+
+    return *this;
+}
+
+
+inline Track_cache::Track_cache(const std::string& directory)
+: _directory(directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(_directory, error);
+}
+
+
+inline std::string Track_cache::get_default_directory()
+{
+    if ( const char* directory = std::getenv("FASTESTLAP_CACHE_DIR") )
+        return directory;
+
+    if ( const char* xdg_cache = std::getenv("XDG_CACHE_HOME") )
+        return (std::filesystem::path(xdg_cache) / "fastest-lap").string();
+
+    if ( const char* home = std::getenv("HOME") )
+        return (std::filesystem::path(home) / ".cache" / "fastest-lap").string();
+
+    return ".fastest-lap-cache";
+}
+
+
+inline std::string Track_cache::get_path(const uint64_t key) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".fltrack";
+
+    return (std::filesystem::path(_directory) / name.str()).string();
+}
+
+
+inline Track_by_polynomial Track_cache::get_track(const std::string& track_file, const bool keep_preprocessor) const
+{
+    // (1) Key: the contents of the file
+    const uint64_t key = Content_hash().add(std::string("discrete")).add_file(track_file).get();
+
+    // (2) Load from the cache, or read the xml and store it
+    Circuit_preprocessor circuit;
+
+    if ( !load(key, circuit) )
+    {
+        Xml_document track_xml(track_file, true);
+        circuit = Circuit_preprocessor(track_xml);
+        store(key, circuit);
+    }
+
+    return Track_by_polynomial(circuit, keep_preprocessor);
+}
+
+
+template<typename ... Args>
+inline Circuit_preprocessor Track_cache::get_preprocessor(const std::string& coord_left_file, const std::string& coord_right_file,
+    const Circuit_preprocessor::Options& options, Args&&... args) const
+{
+    // (1) Key: the contents of the files, the options, and the arguments
+    Content_hash hash;
+    hash.add(std::string("kml")).add_file(coord_left_file).add_file(coord_right_file).add(options);
+    (hash.add(args), ...);
+
+    const uint64_t key = hash.get();
+
+    // (2) Load from the cache, or preprocess and store it
+    Circuit_preprocessor circuit;
+
+    if ( !load(key, circuit) )
+    {
+        circuit = Circuit_preprocessor(coord_left_file, coord_right_file, options, std::forward<Args>(args)...);
+        store(key, circuit);
+    }
+
+    return circuit;
+}
+
+
+inline bool Track_cache::load(const uint64_t key, Circuit_preprocessor& circuit) const
+{
+    const std::string path = get_path(key);
+
+    try
+    {
+        if ( !std::filesystem::exists(path) )
+            return false;
+
+        const Mapped_file file(path);
+        return deserialize(file.data(), file.size(), key, circuit);
+    }
+    catch (const std::runtime_error&)
+    {
+        return false;
+    }
+}
+
+
+inline bool Track_cache::store(const uint64_t key, const Circuit_preprocessor& circuit) const
+{
+    const std::vector<char> data = serialize(key, circuit);
+
+    // Write to a file unique to this thread, and rename it
+    const std::string path = get_path(key);
+    const std::string temporary_path = path + ".tmp"
+        + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^ std::chrono::steady_clock::now().time_since_epoch().count());
+
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+
+        if ( !file )
+            return false;
+
+        file.write(data.data(), data.size());
+
+        if ( !file )
+        {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+
+    if ( error )
+    {
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
+
+    return true;
+}
+
+
+inline std::vector<char> Track_cache::serialize(const uint64_t key, const Circuit_preprocessor& circuit)
+{
+    std::vector<char> data(HEADER_SIZE, 0);
+
+    auto write = [&](const auto value)
+    {
+        const size_t position = data.size();
+        data.resize(position + sizeof(value));
+        std::memcpy(data.data() + position, &value, sizeof(value));
+    };
+
+    auto write_vector = [&](const std::vector<scalar>& values)
+    {
+        write(static_cast<uint64_t>(values.size()));
+        const size_t position = data.size();
+        data.resize(position + values.size()*sizeof(double));
+        std::memcpy(data.data() + position, values.data(), values.size()*sizeof(double));
+    };
+
+    auto write_points = [&](const std::vector<sVector3d>& points)
+    {
+        write(static_cast<uint64_t>(points.size()));
+        for (const auto& point : points)
+        {
+            write(static_cast<double>(point.x()));
+            write(static_cast<double>(point.y()));
+            write(static_cast<double>(point.z()));
+        }
+    };
+
+    // (1) Payload: scalars
+    write(static_cast<uint64_t>(circuit.is_closed));
+    write(static_cast<int64_t>(circuit.direction));
+    write(static_cast<uint64_t>(circuit.n_points));
+    write(static_cast<uint64_t>(circuit.n_elements));
+
+    for (const scalar value : {circuit.x0, circuit.y0, circuit.phi0, circuit.theta0, circuit.phi_ref, circuit.R_earth, circuit.track_length,
+                               circuit.left_boundary_max_error, circuit.right_boundary_max_error, circuit.left_boundary_L2_error, circuit.right_boundary_L2_error,
+                               circuit.options.eps_d, circuit.options.eps_k, circuit.options.eps_n, circuit.options.eps_c,
+                               circuit.options.maximum_kappa, circuit.options.maximum_dkappa})
+        write(static_cast<double>(value));
+
+    // (2) Payload: arrays
+    for (const auto* points : {&circuit.r_left, &circuit.r_right, &circuit.r_centerline, &circuit.r_left_measured, &circuit.r_right_measured})
+        write_points(*points);
+
+    for (const auto* values : {&circuit.s, &circuit.theta, &circuit.kappa, &circuit.nl, &circuit.nr, &circuit.dkappa, &circuit.dnl, &circuit.dnr})
+        write_vector(*values);
+
+    // (3) Header
+    const uint64_t payload_size = data.size() - HEADER_SIZE;
+    const uint64_t payload_hash = Content_hash().add_bytes(data.data() + HEADER_SIZE, payload_size).get();
+
+    std::memcpy(data.data(), "FLTRACK", 8);
+    std::memcpy(data.data() + 8 , &FORMAT_VERSION , sizeof(uint32_t));
+    std::memcpy(data.data() + 12, &ENDIANNESS_MARK, sizeof(uint32_t));
+    std::memcpy(data.data() + 16, &key            , sizeof(uint64_t));
+    std::memcpy(data.data() + 24, &payload_size   , sizeof(uint64_t));
+    std::memcpy(data.data() + 32, &payload_hash   , sizeof(uint64_t));
+
+    return data;
+}
+
+
+inline bool Track_cache::deserialize(const char* data, const size_t size, const uint64_t key, Circuit_preprocessor& circuit)
+{
+    // (1) Check the header
+    if ( size < HEADER_SIZE || std::memcmp(data, "FLTRACK", 8) != 0 )
+        return false;
+
+    uint32_t version, endianness_mark;
+    uint64_t file_key, payload_size, payload_hash;
+    std::memcpy(&version        , data + 8 , sizeof(uint32_t));
+    std::memcpy(&endianness_mark, data + 12, sizeof(uint32_t));
+    std::memcpy(&file_key       , data + 16, sizeof(uint64_t));
+    std::memcpy(&payload_size   , data + 24, sizeof(uint64_t));
+    std::memcpy(&payload_hash   , data + 32, sizeof(uint64_t));
+
+    if ( version != FORMAT_VERSION || endianness_mark != ENDIANNESS_MARK || file_key != key || payload_size != size - HEADER_SIZE )
+        return false;
+
+    if ( Content_hash().add_bytes(data + HEADER_SIZE, payload_size).get() != payload_hash )
+        return false;
+
+    // (2) Read the payload. The hash is valid, but the sizes are still checked against the end of the data
+    size_t position = HEADER_SIZE;
+
+    auto read = [&](auto& value)
+    {
+        if ( position + sizeof(value) > size )
+            throw std::runtime_error("Track_cache: truncated data");
+
+        std::memcpy(&value, data + position, sizeof(value));
+        position += sizeof(value);
+    };
+
+    auto read_size = [&](const size_t element_size)
+    {
+        uint64_t n;
+        read(n);
+
+        if ( n > (size - position)/element_size )
+            throw std::runtime_error("Track_cache: truncated data");
+
+        return static_cast<size_t>(n);
+    };
+
+    auto read_vector = [&](std::vector<scalar>& values)
+    {
+        values.resize(read_size(sizeof(double)));
+        std::memcpy(values.data(), data + position, values.size()*sizeof(double));
+        position += values.size()*sizeof(double);
+    };
+
+    auto read_points = [&](std::vector<sVector3d>& points)
+    {
+        points.resize(read_size(3*sizeof(double)));
+        for (auto& point : points)
+        {
+            double x, y, z;
+            read(x); read(y); read(z);
+            point = sVector3d(x, y, z);
+        }
+    };
+
+    try
+    {
+        uint64_t is_closed, n_points, n_elements;
+        int64_t direction;
+        read(is_closed); read(direction); read(n_points); read(n_elements);
+
+        circuit.is_closed  = (is_closed != 0);
+        circuit.direction  = static_cast<int>(direction);
+        circuit.n_points   = static_cast<size_t>(n_points);
+        circuit.n_elements = static_cast<size_t>(n_elements);
+
+        for (scalar* value : {&circuit.x0, &circuit.y0, &circuit.phi0, &circuit.theta0, &circuit.phi_ref, &circuit.R_earth, &circuit.track_length,
+                              &circuit.left_boundary_max_error, &circuit.right_boundary_max_error, &circuit.left_boundary_L2_error, &circuit.right_boundary_L2_error,
+                              &circuit.options.eps_d, &circuit.options.eps_k, &circuit.options.eps_n, &circuit.options.eps_c,
+                              &circuit.options.maximum_kappa, &circuit.options.maximum_dkappa})
+        {
+            double value_64;
+            read(value_64);
+            *value = value_64;
+        }
+
+        for (auto* points : {&circuit.r_left, &circuit.r_right, &circuit.r_centerline, &circuit.r_left_measured, &circuit.r_right_measured})
+            read_points(*points);
+
+        for (auto* values : {&circuit.s, &circuit.theta, &circuit.kappa, &circuit.nl, &circuit.nr, &circuit.dkappa, &circuit.dnl, &circuit.dnr})
+            read_vector(*values);
+    }
+    catch (const std::runtime_error&)
+    {
+        return false;
+    }
+
+    // (3) Check the sizes of the nodal arrays
+    if ( position != size || circuit.s.size() != circuit.n_points || circuit.r_centerline.size() != circuit.n_points )
+        return false;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef __TRACK_PROJECTION_H__
+#define __TRACK_PROJECTION_H__
+
+#include <vector>
+#include "src/core/vehicles/track_by_polynomial.h"
+#include "src/core/foundation/polyline_spatial_index.h"
+
+//!     Projection of cartesian points onto a track
+//!     -------------------------------------------
+//!
+//! Computes the curvilinear coordinates (s,n) of points (x,y): s is the arclength of the closest point of the
+//! centerline, and n the lateral distance, positive to the left, as in Track_by_polynomial::position_at().
+//!
+//! The centerline is sampled into a polyline with a spatial index, which gives a first guess of s. It is then
+//! refined with Newton iterations on (r(s) - p).dr(s) = 0, using the polynomials of the track.
+//!
+//! Sequential mode: with a hint (e.g. the arclength of the previous telemetry sample), the Newton iterations
+//! start from the hint, and the spatial index is only used if they do not converge close to it.
+//!
+class Track_projection
+{
+ public:
+
+    struct Options
+    {
+        scalar sampling_distance   = 2.0;       //! Distance between the samples of the centerline polyline [m]
+        scalar tolerance           = 1.0e-8;    //! Tolerance of the Newton iterations on s [m]
+        size_t maximum_iterations  = 20;        //! Maximum number of Newton iterations
+        scalar hint_window         = 50.0;      //! Maximum distance from the hint to accept a sequential projection [m]
+        scalar hint_maximum_n      = 50.0;      //! Maximum |n| to accept a sequential projection [m]
+    };
+
+    //! Result of a projection
+    struct Projection
+    {
+        scalar s;           //! Arclength of the closest point of the centerline
+        scalar n;           //! Lateral distance, positive to the left
+    };
+
+    //! Constructor
+    //! @param[in] track: the track. Closed if its preprocessor says so, or if the ends of the centerline coincide
+    Track_projection(const Track_by_polynomial& track, const Options& options = {});
+
+    //! Constructor
+    //! @param[in] closed: if the track is closed, the arclength is periodic
+    Track_projection(const Track_by_polynomial& track, const bool closed, const Options& options = {});
+
+    //! Project one point, using the spatial index
+    Projection project(const sVector3d& p) const;
+
+    //! Project one point, starting from the arclength of a nearby point
+    Projection project(const sVector3d& p, const scalar s_hint) const;
+
+    //! Project a sequence of points. Each projection is used as the hint of the next one
+    //! @param[in] parallel: if true, the sequence is split in chunks projected by the thread pool
+    std::vector<Projection> project(const std::vector<sVector3d>& points, const bool parallel = true) const;
+
+    //! If the track is closed
+    bool is_closed() const { return _closed; }
+
+    const Track_by_polynomial& get_track() const { return _track; }
+
+ private:
+
+    //! Newton iterations from s0
+    //! @param[out] result: the projection
+    //! @return true if the iterations converged
+    bool refine(const sVector3d& p, const scalar s0, const scalar maximum_step, Projection& result) const;
+
+    //! Bring s into the track: periodic for closed tracks, bounded for open tracks
+    scalar wrap(const scalar s) const;
+
+    Track_by_polynomial _track;         //! The track, sharing its data
+    bool _closed;                       //! If the track is closed
+    scalar _track_length;               //! Length of the track
+    Options _options;                   //! Options
+
+    std::vector<scalar> _s_samples;     //! Arclength of the samples of the centerline
+    Polyline_spatial_index _index;      //! Spatial index of the samples
+};
+
+#include "track_projection.hpp"
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef __TRACK_PROJECTION_HPP__
+#define __TRACK_PROJECTION_HPP__
+
+#include <cmath>
+#include <algorithm>
+#include "src/core/foundation/thread_pool.h"
+
+inline Track_projection::Track_projection(const Track_by_polynomial& track, const Options& options)
+: Track_projection(track, track.has_preprocessor() ? track.get_preprocessor().is_closed
+                                                   : norm(std::get<0>(track(0.0)) - std::get<0>(track(track.get_total_length()))) < 1.0e-6*track.get_total_length(),
+                   options)
+{}
+
+
+inline Track_projection::Track_projection(const Track_by_polynomial& track, const bool closed, const Options& options)
+: _track(track.without_preprocessor()), _closed(closed), _track_length(track.get_total_length()), _options(options)
+{
+    if ( _track_length <= 0.0 )
+        throw std::runtime_error("Track_projection: the track is empty");
+
+    if ( _options.sampling_distance <= 0.0 )
+        throw std::runtime_error("Track_projection: sampling_distance shall be positive");
+
+    // (1) Sample the centerline. Closed tracks do not repeat the first point
+    const size_t n_segments = std::max<size_t>(16, static_cast<size_t>(std::ceil(_track_length/_options.sampling_distance)));
+    const size_t n_samples = (_closed ? n_segments : n_segments + 1);
+
+    _s_samples.resize(n_samples);
+    std::vector<sVector3d> r_samples(n_samples);
+
+    for (size_t i = 0; i < n_samples; ++i)
+    {
+        _s_samples[i] = _track_length*i/n_segments;
+        r_samples[i] = std::get<0>(_track(_s_samples[i]));
+    }
+
+    // (2) Index the samples
+    _index = Polyline_spatial_index(r_samples, _closed);
+}
+
+
+inline scalar Track_projection::wrap(const scalar s) const
+{
+    if ( _closed )
+    {
+        const scalar s_wrapped = std::fmod(s, _track_length);
+        return (s_wrapped < 0.0 ? s_wrapped + _track_length : s_wrapped);
+    }
+    else
+        return std::clamp(s, 0.0, _track_length);
+}
+
+
+inline bool Track_projection::refine(const sVector3d& p, const scalar s0, const scalar maximum_step, Projection& result) const
+{
+    scalar s = wrap(s0);
+    bool converged = false;
+
+    for (size_t iter = 0; iter < _options.maximum_iterations; ++iter)
+    {
+        // (1) Minimise |r(s) - p|^2: f = (r - p).dr, f' = dr.dr + (r - p).d2r
+        const auto [r, dr, d2r] = _track(s);
+
+        const scalar dx = r.x() - p.x();
+        const scalar dy = r.y() - p.y();
+        const scalar dr2 = dr.x()*dr.x() + dr.y()*dr.y();
+
+        const scalar f = dx*dr.x() + dy*dr.y();
+        scalar df = dr2 + dx*d2r.x() + dy*d2r.y();
+
+        // (2) Far from the minimum the Hessian can be negative: use the Gauss-Newton approximation
+        if ( df <= 0.0 )
+            df = dr2;
+
+        const scalar step = std::clamp(-f/df, -maximum_step, maximum_step);
+        const scalar s_next = wrap(s + step);
+
+        // (3) Converged, or stopped at the end of an open track
+        if ( std::abs(step) < _options.tolerance || s_next == s )
+        {
+            s = s_next;
+            converged = true;
+            break;
+        }
+
+        s = s_next;
+    }
+
+    // (4) Lateral distance along the normal of position_at()
+    const auto [r, dr, d2r] = _track(s);
+    const scalar dr_norm = std::sqrt(dr.x()*dr.x() + dr.y()*dr.y());
+
+    result.s = s;
+    result.n = ((p.x() - r.x())*(-dr.y()) + (p.y() - r.y())*dr.x())/dr_norm;
+
+    return converged;
+}
+
+
+inline Track_projection::Projection Track_projection::project(const sVector3d& p) const
+{
+    // (1) First guess from the polyline
+    const auto [r_closest, dist2, i_segment] = _index.find_closest_point(p);
+
+    const scalar s_start = _s_samples[i_segment[0]];
+    const scalar s_end = (i_segment[1] == 0 ? _track_length : _s_samples[i_segment[1]]);
+
+    const sVector3d r_start = std::get<0>(_track(s_start));
+    const sVector3d r_end = std::get<0>(_track(s_end));
+    const scalar segment_length = s_end - s_start;
+    const scalar xi = norm(r_closest - r_start)/std::max(norm(r_end - r_start), 1.0e-12);
+
+    // (2) Refine, with steps bounded by the sampling distance
+    Projection result;
+    refine(p, s_start + std::clamp(xi, 0.0, 1.0)*segment_length, segment_length, result);
+
+    return result;
+}
+
+
+inline Track_projection::Projection Track_projection::project(const sVector3d& p, const scalar s_hint) const
+{
+    // (1) Refine from the hint
+    Projection result;
+    const bool converged = refine(p, s_hint, _options.sampling_distance, result);
+
+    // (2) Accept it if it is close to the hint and to the centerline
+    scalar distance_to_hint = std::abs(result.s - wrap(s_hint));
+
+    if ( _closed )
+        distance_to_hint = std::min(distance_to_hint, _track_length - distance_to_hint);
+
+    if ( converged && (distance_to_hint <= _options.hint_window) && (std::abs(result.n) <= _options.hint_maximum_n) )
+        return result;
+
+    // (3) Otherwise, use the spatial index
+    return project(p);
+}
+
+
+inline std::vector<Track_projection::Projection> Track_projection::project(const std::vector<sVector3d>& points, const bool parallel) const
+{
+    std::vector<Projection> result(points.size());
+
+    // Each chunk projects its first point with the index, and the rest from the previous point
+    auto project_chunk = [&](const size_t begin, const size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            result[i] = (i == begin ? project(points[i]) : project(points[i], result[i-1].s));
+    };
+
+    if ( parallel )
+        Thread_pool::get().parallel_for_chunks(points.size(), project_chunk);
+    else
+        project_chunk(0, points.size());
+
+    return result;
+}
+
+#endif
@@ -3,21 +3,108 @@
 
 #include <fstream>
 #include "lion/math/polynomial.h"
-#include "lion/propagators/ode45.h"
+#include "src/core/propagators/dormand_prince.h"
+#include "src/core/propagators/dormand_prince_sensitivity.h"
+#include "src/core/foundation/trajectory_sink.h"
 
 template<class DynamicModel_t>
 class Track_run
 {
  public:
     using Timeseries_t = typename DynamicModel_t::Timeseries_type;
+
+    //! Evaluates the controls as u = controls(q,t) for the propagator
+    struct Controls
+    {
+        const Polynomial_array<scalar,DynamicModel_t::NCONTROL>& polynomials;
+        const std::vector<sPolynomial>* basis = nullptr;    //! Controls obtained with a unit value at each parameter
+        const std::vector<size_t>* basis_control = nullptr; //! Control variable of each parameter
+
+        std::array<Timeseries_t,DynamicModel_t::NCONTROL> operator()(const std::array<Timeseries_t,DynamicModel_t::NSTATE>& q, const scalar t) const;
+
+        //! Derivatives of the controls w.r.t. the parameters, row-major [NCONTROL x n_parameters]. Requires the basis
+        void jacobian(const scalar t, std::vector<scalar>& dudx) const;
+    };
+
+    using Integrator_type = Dormand_prince<DynamicModel_t,Controls,DynamicModel_t::NSTATE>;
+    using Integrator_options = typename Integrator_type::Options;
+
+    using Sensitivity_type = Dormand_prince_sensitivity<DynamicModel_t,Controls,DynamicModel_t::NSTATE>;
+
+    //! Method used to compute the gradient of the objective
+    enum Gradient_method { FORWARD, ADJOINT };
+
+    //! Output of simulate_and_return. Can be reused across runs to avoid reallocations
+    struct Output
+    {
+        std::vector<Timeseries_t> t;                                        //! Output times
+        std::vector<std::array<Timeseries_t,DynamicModel_t::NSTATE>> q;     //! States at the output times
+    };
+
+    //! Points of a simulation sent to a trajectory sink
+    struct Output_options
+    {
+        scalar dt_output  = 0.0;    //! If > 0, interpolate the solution at t_start + k.dt_output (dense output)
+        size_t decimation = 1;      //! Otherwise, send one of every decimation accepted steps
+    };
+
     Track_run() {};
 
     Track_run(const DynamicModel_t& vehicle, const std::array<Timeseries_t,DynamicModel_t::NSTATE>& q0, size_t n_control_variables);
 
     Timeseries_t operator()(const std::vector<Timeseries_t>& x, const double t_start, const double t_final, const double dt, bool write=false);
 
+    //! Compute the objective and its gradient w.r.t. x and the gradient parameters. The derivatives are those of the computed 
+    //! solution, along its steps
+    //! @param[out] gradient: the gradient of the objective, [x, gradient parameters] [number_total_variables() + n_gradient_parameters]
+    //! @param[in] method: FORWARD propagates the sensitivities of all the states, ADJOINT only the gradient (cheaper for large x)
+    Timeseries_t operator()(const std::vector<Timeseries_t>& x, const double t_start, const double t_final, const double dt,
+                            std::vector<scalar>& gradient, const Gradient_method method = ADJOINT);
+
+    //! Compute the final states and their sensitivities w.r.t. x and the gradient parameters
+    //! @param[out] dqdx: sensitivities of the final states, row-major [NSTATE x (number_total_variables() + n_gradient_parameters)]
+    //! @return the final states
+    std::array<scalar,DynamicModel_t::NSTATE> final_state_sensitivities(const std::vector<Timeseries_t>& x, const double t_start,
+                                                                         const double t_final, const double dt, std::vector<scalar>& dqdx);
+
     std::pair<std::vector<Timeseries_t>,std::vector<std::array<Timeseries_t,DynamicModel_t::NSTATE>>> simulate_and_return(const std::vector<Timeseries_t>& x, const double t_start, const double t_final, const double dt, bool write = false);
 
+    //! Simulate and store the trajectory in a preallocated output
+    //! @param[out] output: the trajectory. Its storage is reused
+    //! @param[in] decimation: store one of every decimation accepted steps. The initial and final points are always stored
+    void simulate_and_return(const std::vector<Timeseries_t>& x, const double t_start, const double t_final, const double dt, Output& output,
+                             const size_t decimation = 1);
+
+    //! Simulate and stream the trajectory to a sink. The initial and final points are always sent, and flush() is called at the end
+    //! @param[in] sink: the destination of the points (e.g. Trajectory_ring_buffer, Trajectory_file_writer)
+    //! @param[in] output_options: the points sent
+    //! @return the objective, as in operator()
+    Timeseries_t simulate_to_sink(const std::vector<Timeseries_t>& x, const double t_start, const double t_final, const double dt,
+                                  Trajectory_sink<DynamicModel_t::NSTATE>& sink, const Output_options& output_options = Output_options());
+
+    //! Run one simulation per control vector, in parallel. Each run uses its own copy of this object
+    //! @param[in] x: the control vectors
+    //! @return the objective (as in operator()) of each run
+    std::vector<Timeseries_t> run_batch(const std::vector<std::vector<Timeseries_t>>& x, const double t_start, const double t_final,
+                                        const double dt) const;
+
+    //! Get the options of the integrator
+    const Integrator_options& get_integrator_options() const { return _integrator_options; }
+
+    //! Set the options of the integrator, used by this instance only
+    void set_integrator_options(const Integrator_options& options) { _integrator_options = options; }
+
+    //! Set the file written by operator() when write is true, as CSV
+    void set_output_file(const std::string& file_name) { _output_file = file_name; }
+
+    //! Set the number of steps between the states stored by the adjoint gradient
+    void set_checkpoint_interval(const size_t checkpoint_interval) { _checkpoint_interval = checkpoint_interval; }
+
+    //! Set a vehicle parameter, and include it in the gradients after x. Setting it again only updates its value
+    //! @param[in] parameter: the name of the parameter, as in the vehicle set_parameter()
+    //! @param[in] value: the value of the parameter
+    void add_gradient_parameter(const std::string& parameter, const scalar value);
+
     constexpr void set_number_of_blocks(size_t i, size_t n_blocks);
 
     constexpr void set_polynomial_order(size_t p);
@@ -41,6 +128,33 @@ class Track_run
 
     Timeseries_t simulate(const double t_start, const double t_final, const double dt, bool write);
 
+    //! Construct the controls obtained with a unit value at each parameter, used by the sensitivities
+    void construct_control_basis(const double t_start);
+
+    //! Integrate from the initial condition and return the times of the accepted steps, from t_start to t_final
+    //! @param[out] q_final: the states at t_final
+    std::vector<scalar> compute_step_times(const double t_start, const double t_final, std::array<scalar,DynamicModel_t::NSTATE>& q_final);
+
+    //! Integrate from the initial condition, sending the points to sink if not nullptr
+    //! @return the states at t_final
+    std::array<Timeseries_t,DynamicModel_t::NSTATE> integrate(const double t_start, const double t_final, Trajectory_sink<DynamicModel_t::NSTATE>* sink,
+                                                              const Output_options& output_options);
+
+    //! The objective of a simulation with inputs x that ended in q. Used by the simulations, and taped by objective_gradient()
+    template<typename T>
+    static T objective(const std::array<T,DynamicModel_t::NSTATE>& q, const std::vector<T>& x)
+        { const T x_difference = x[10] - x[11]; return q[DynamicModel_t::Road_type::IX] - x_difference*x_difference/1.0e1; }
+
+    //! The objective of a simulation with the current inputs that ended in q
+    Timeseries_t objective(const std::array<Timeseries_t,DynamicModel_t::NSTATE>& q) const { return objective(q, _x); }
+
+    //! Gradient of the objective with the current inputs, w.r.t. the final states and w.r.t. the inputs explicitly
+    //! @param[in] q: the final states
+    //! @param[out] dJdq: gradient w.r.t. the final states
+    //! @param[out] dJdx: gradient w.r.t. the inputs, with the final states fixed [number_total_variables()]
+    void objective_gradient(const std::array<scalar,DynamicModel_t::NSTATE>& q, std::array<scalar,DynamicModel_t::NSTATE>& dJdq,
+                            std::vector<scalar>& dJdx) const;
+
     DynamicModel_t _vehicle;                             //! Vehicle to run
     std::array<Timeseries_t,DynamicModel_t::NSTATE> _q0;   //! Initial condition
 
@@ -58,6 +172,14 @@ class Track_run
 
     std::vector<scalar> _max_u;
     std::vector<scalar> _min_u;
+
+    std::vector<sPolynomial> _control_basis;        //! Controls obtained with a unit value at each parameter
+    std::vector<size_t> _control_basis_variable;    //! Control variable of each parameter
+
+    Integrator_options _integrator_options; //! Options of the integrator of this run
+    size_t _checkpoint_interval = 50;       //! Number of steps between the states stored by the adjoint
+    std::vector<std::pair<std::string,scalar>> _gradient_parameters;    //! Vehicle parameters included in the gradients
+    std::string _output_file = "best_simulation.dat"; //! File written by operator() when write is true
 };
 
 #include "track_run.hpp"
@@ -3,7 +3,9 @@
 
 #include "lion/math/matrix_extensions.h"
 #include "lion/propagators/explicit_euler.h"
+#include "src/core/foundation/thread_pool.h"
 #include <math.h>
+#include <algorithm>
 
 template<class DynamicModel_t>
 inline Track_run<DynamicModel_t>::Track_run(const DynamicModel_t& vehicle, const std::array<typename DynamicModel_t::Timeseries_type,DynamicModel_t::NSTATE>& q0, 
@@ -21,37 +23,108 @@ inline Track_run<DynamicModel_t>::Track_run(const DynamicModel_t& vehicle, const
 {}
 
 
+template<class DynamicModel_t>
+inline std::array<typename DynamicModel_t::Timeseries_type,DynamicModel_t::NCONTROL> Track_run<DynamicModel_t>::Controls::operator()(
+    const std::array<Timeseries_t,DynamicModel_t::NSTATE>& q, const scalar t) const
+{
+    std::array<Timeseries_t,DynamicModel_t::NCONTROL> u;
+
+    for (size_t i = 0; i < DynamicModel_t::NCONTROL; ++i)
+        u[i] = polynomials.at(i)[t];
+
+    return u;
+}
+
+
+template<class DynamicModel_t>
+inline void Track_run<DynamicModel_t>::Controls::jacobian(const scalar t, std::vector<scalar>& dudx) const
+{
+    if ( basis == nullptr || basis_control == nullptr )
+        throw std::runtime_error("Track_run::Controls: the basis of the controls was not constructed");
+
+    const size_t n_parameters = basis->size();
+
+    dudx.assign(DynamicModel_t::NCONTROL*n_parameters, 0.0);
+
+    // The controls are linear in the parameters: the derivatives are the controls with a unit value at each parameter
+    for (size_t j = 0; j < n_parameters; ++j)
+        dudx[(*basis_control)[j]*n_parameters + j] = (*basis)[j][t];
+}
+
+
 template<class DynamicModel_t>
 inline std::pair<std::vector<typename DynamicModel_t::Timeseries_type>,std::vector<std::array<typename DynamicModel_t::Timeseries_type,DynamicModel_t::NSTATE>>> Track_run<DynamicModel_t>::simulate_and_return(const std::vector<typename DynamicModel_t::Timeseries_type>& x, const double t_start, const double t_final, const double dt, bool write)
 {
+    Output output;
+    simulate_and_return(x, t_start, t_final, dt, output, 1);
+
+    return {std::move(output.t), std::move(output.q)};
+}
+
+
+template<class DynamicModel_t>
+inline void Track_run<DynamicModel_t>::simulate_and_return(const std::vector<Timeseries_t>& x, const double t_start, const double t_final,
+    const double dt, Output& output, const size_t decimation)
+{
+    if ( decimation == 0 )
+        throw std::runtime_error("Track_run: decimation shall be greater than 0");
+
     _x = x;
 
     set_control_points(_x);
     construct_controls(t_start, t_final);
 
-    ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::set("max h",0.02);
-    ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::set("relative error",1.0e-8);
-    ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::set("absolute error",1.0e-6);
+    Integrator_type integrator(_integrator_options);
+    const Controls controls = {_controls};
+
     scalar t = t_start;
 
     bool t_end_reached = false;
     double dti = 1.0;
 
-    std::vector<std::array<Timeseries_t,DynamicModel_t::NSTATE>> qout = {_q0};
-    std::vector<Timeseries_t> tout = {t};
     std::array<Timeseries_t,DynamicModel_t::NSTATE> q = _q0;
 
-    while (!t_end_reached)
+    // (1) Reserve for the number of steps at max h. The storage of a reused output is kept
+    const size_t n_steps_estimate = static_cast<size_t>(std::ceil((t_final - t_start)/_integrator_options.max_h));
+    output.t.clear();
+    output.q.clear();
+    output.t.reserve(n_steps_estimate/decimation + 2);
+    output.q.reserve(n_steps_estimate/decimation + 2);
+
+    output.t.push_back(t);
+    output.q.push_back(q);
+
+    // (2) Simulate, and store one of every decimation steps, and the final point
+    for (size_t i_step = 1; !t_end_reached; ++i_step)
     {
-        ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::take_step(_vehicle, _controls, q, t, dti, t_final, t_end_reached);
-        qout.push_back(q);
-        tout.push_back(t);
-    }
+        integrator.take_step(_vehicle, controls, q, t, dti, t_final, t_end_reached);
 
-    return {tout,qout};
+        if ( (i_step % decimation == 0) || t_end_reached )
+        {
+            output.t.push_back(t);
+            output.q.push_back(q);
+        }
+    }
 }
 
 
+template<class DynamicModel_t>
+inline std::vector<typename DynamicModel_t::Timeseries_type> Track_run<DynamicModel_t>::run_batch(const std::vector<std::vector<Timeseries_t>>& x,
+    const double t_start, const double t_final, const double dt) const
+{
+    std::vector<Timeseries_t> result(x.size());
+
+    Thread_pool::get().parallel_for_chunks(x.size(), [&](const size_t begin, const size_t end)
+    {
+        Track_run run(*this);
+
+        for (size_t i = begin; i < end; ++i)
+            result[i] = run(x[i], t_start, t_final, dt, false);
+    });
+
+    return result;
+}
+
 
 template<class DynamicModel_t>
 inline typename DynamicModel_t::Timeseries_type Track_run<DynamicModel_t>::operator()(const std::vector<typename DynamicModel_t::Timeseries_type>& x, const double t_start, const double t_final, const double dt, bool write)
@@ -65,27 +138,282 @@ inline typename DynamicModel_t::Timeseries_type Track_run<DynamicModel_t>::opera
 }
 
 
+template<class DynamicModel_t>
+inline typename DynamicModel_t::Timeseries_type Track_run<DynamicModel_t>::operator()(const std::vector<Timeseries_t>& x, const double t_start,
+    const double t_final, const double dt, std::vector<scalar>& gradient, const Gradient_method method)
+{
+    _x = x;
+
+    set_control_points(_x);
+    construct_controls(t_start, t_final);
+    construct_control_basis(t_start);
+
+    const size_t n_parameters = _x.size();
+    const Controls controls = {_controls, &_control_basis, &_control_basis_variable};
+    const Sensitivity_type sensitivity(n_parameters, _checkpoint_interval, _gradient_parameters);
+    const size_t n_derivatives = sensitivity.number_of_derivatives();
+
+    // (1) Steps and final states of the nominal solution
+    std::array<scalar,DynamicModel_t::NSTATE> q_nominal;
+    const auto times = compute_step_times(t_start, t_final, q_nominal);
+
+    // (2) Derivatives of the objective w.r.t. the final states, and its explicit dependency on x
+    std::array<scalar,DynamicModel_t::NSTATE> dJdq;
+    std::vector<scalar> dJdx_explicit;
+    objective_gradient(q_nominal, dJdq, dJdx_explicit);
+
+    std::array<scalar,DynamicModel_t::NSTATE> q;
+    for (size_t i = 0; i < DynamicModel_t::NSTATE; ++i)
+        q[i] = Value(_q0[i]);
+
+    // (3) Contribution of the final states, chained with their sensitivities
+    if ( method == FORWARD )
+    {
+        std::vector<scalar> dqdx;
+        sensitivity.forward(_vehicle, controls, times, q, dqdx);
+
+        gradient.assign(n_derivatives, 0.0);
+
+        for (size_t r = 0; r < DynamicModel_t::NSTATE; ++r)
+            for (size_t p = 0; p < n_derivatives; ++p)
+                gradient[p] += dJdq[r]*dqdx[r*n_derivatives + p];
+    }
+    else
+    {
+        std::array<scalar,DynamicModel_t::NSTATE> dJdq0;
+        q = sensitivity.adjoint(_vehicle, controls, times, q, dJdq, gradient, dJdq0);
+    }
+
+    // (4) Explicit contribution of x. The objective does not depend explicitly on the vehicle parameters
+    for (size_t p = 0; p < n_parameters; ++p)
+        gradient[p] += dJdx_explicit[p];
+
+    std::array<Timeseries_t,DynamicModel_t::NSTATE> q_final;
+    std::copy(q.cbegin(), q.cend(), q_final.begin());
+
+    return objective(q_final);
+}
+
+
+template<class DynamicModel_t>
+inline std::array<scalar,DynamicModel_t::NSTATE> Track_run<DynamicModel_t>::final_state_sensitivities(const std::vector<Timeseries_t>& x,
+    const double t_start, const double t_final, const double dt, std::vector<scalar>& dqdx)
+{
+    _x = x;
+
+    set_control_points(_x);
+    construct_controls(t_start, t_final);
+    construct_control_basis(t_start);
+
+    const Controls controls = {_controls, &_control_basis, &_control_basis_variable};
+    const Sensitivity_type sensitivity(_x.size(), _checkpoint_interval, _gradient_parameters);
+
+    std::array<scalar,DynamicModel_t::NSTATE> q;
+    const auto times = compute_step_times(t_start, t_final, q);
+
+    for (size_t i = 0; i < DynamicModel_t::NSTATE; ++i)
+        q[i] = Value(_q0[i]);
+
+    sensitivity.forward(_vehicle, controls, times, q, dqdx);
+
+    return q;
+}
+
+
+template<class DynamicModel_t>
+inline typename DynamicModel_t::Timeseries_type Track_run<DynamicModel_t>::simulate_to_sink(const std::vector<Timeseries_t>& x, const double t_start,
+    const double t_final, const double dt, Trajectory_sink<DynamicModel_t::NSTATE>& sink, const Output_options& output_options)
+{
+    _x = x;
+
+    set_control_points(_x);
+    construct_controls(t_start, t_final);
+
+    return objective(integrate(t_start, t_final, &sink, output_options));
+}
+
+
 template<class DynamicModel_t>
 inline typename DynamicModel_t::Timeseries_type Track_run<DynamicModel_t>::simulate(const double t_start, const double t_final, const double dt, bool write)
 {
-    ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::set("max h",0.01);
-    ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::set("relative error",1.0e-8);
-    ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::set("absolute error",1.0e-6);
+    if ( write ) 
+    {
+        Trajectory_file_writer<DynamicModel_t::NSTATE> file(_output_file, Trajectory_file_writer<DynamicModel_t::NSTATE>::CSV);
+        return objective(integrate(t_start, t_final, &file, Output_options()));
+    }
+    else
+        return objective(integrate(t_start, t_final, nullptr, Output_options()));
+}
+
+
+template<class DynamicModel_t>
+inline std::array<typename DynamicModel_t::Timeseries_type,DynamicModel_t::NSTATE> Track_run<DynamicModel_t>::integrate(const double t_start,
+    const double t_final, Trajectory_sink<DynamicModel_t::NSTATE>* sink, const Output_options& output_options)
+{
+    const bool is_dense_output = (sink != nullptr) && (output_options.dt_output > 0.0);
+
+    if ( (sink != nullptr) && (output_options.decimation == 0) )
+        throw std::runtime_error("Track_run: decimation shall be greater than 0");
+
+    auto integrator_options = _integrator_options;
+    integrator_options.dense_output = is_dense_output;
+
+    Integrator_type integrator(integrator_options);
+    const Controls controls = {_controls};
+
     std::array<Timeseries_t,DynamicModel_t::NSTATE> q(_q0);
     scalar t = t_start;
 
-    std::ofstream file;
-    if ( write ) 
-        file.open("best_simulation.dat");
-
     bool t_end_reached = false;
-//  double dti = ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::initial_dt_estimation(_vehicle,_controls, q, t_start, t_final);
     double dti = 1.0;
 
-    while (!t_end_reached)
-        ODE45<DynamicModel_t,Polynomial_array<scalar,DynamicModel_t::NCONTROL>,DynamicModel_t::NSTATE>::take_step(_vehicle, _controls, q, t, dti, t_final, t_end_reached);
+    // The sinks receive the values of the states
+    auto send = [&sink](const scalar t_point, const std::array<Timeseries_t,DynamicModel_t::NSTATE>& q_point)
+    {
+        std::array<scalar,DynamicModel_t::NSTATE> q_values;
+        for (size_t i = 0; i < DynamicModel_t::NSTATE; ++i)
+            q_values[i] = Value(q_point[i]);
+
+        sink->write(t_point, q_values);
+    };
+
+    if ( sink != nullptr )
+        send(t, q);
+
+    size_t i_output = 1;
+
+    for (size_t i_step = 1; !t_end_reached; ++i_step)
+    {
+        integrator.take_step(_vehicle, controls, q, t, dti, t_final, t_end_reached);
+
+        if ( sink == nullptr )
+            continue;
+
+        if ( is_dense_output )
+        {
+            // (1) Interpolate at the output points covered by this step. The final point is sent from the step itself
+            for (scalar t_output = t_start + i_output*output_options.dt_output; 
+                 (t_output <= t) && (t_output < t_final - 1.0e-12*std::max(1.0,std::abs(t_final)));
+                 t_output = t_start + (++i_output)*output_options.dt_output)
+            {
+                send(t_output, integrator.interpolate(t_output));
+            }
+
+            if ( t_end_reached )
+                send(t, q);
+        }
+        else if ( (i_step % output_options.decimation == 0) || t_end_reached )
+        {
+            // (2) Send one of every decimation steps, and the final point
+            send(t, q);
+        }
+    }
+
+    if ( sink != nullptr )
+        sink->flush();
 
-    return q[DynamicModel_t::Road_type::IX] - std::pow(_x[10]-_x[11],2)/1.0e1;
+    return q;
+}
+
+
+template<class DynamicModel_t>
+inline void Track_run<DynamicModel_t>::add_gradient_parameter(const std::string& parameter, const scalar value)
+{
+    _vehicle.set_parameter(parameter, value);
+
+    auto it = std::find_if(_gradient_parameters.begin(), _gradient_parameters.end(), 
+                           [&parameter](const auto& gradient_parameter) { return gradient_parameter.first == parameter; });
+
+    if ( it != _gradient_parameters.end() )
+        it->second = value;
+    else
+        _gradient_parameters.emplace_back(parameter, value);
+}
+
+
+template<class DynamicModel_t>
+inline void Track_run<DynamicModel_t>::objective_gradient(const std::array<scalar,DynamicModel_t::NSTATE>& q,
+    std::array<scalar,DynamicModel_t::NSTATE>& dJdq, std::vector<scalar>& dJdx) const
+{
+    constexpr size_t NSTATE = DynamicModel_t::NSTATE;
+    const size_t n_parameters = _x.size();
+
+    // (1) Record the objective w.r.t. z = [q,x]
+    std::vector<scalar> z_values(NSTATE + n_parameters);
+    std::copy(q.cbegin(), q.cend(), z_values.begin());
+
+    for (size_t p = 0; p < n_parameters; ++p)
+        z_values[NSTATE + p] = Value(_x[p]);
+
+    std::vector<CppAD::AD<scalar>> z(z_values.cbegin(), z_values.cend());
+    CppAD::Independent(z);
+
+    std::array<CppAD::AD<scalar>,NSTATE> q_ad;
+    std::copy(z.cbegin(), z.cbegin() + NSTATE, q_ad.begin());
+    const std::vector<CppAD::AD<scalar>> x_ad(z.cbegin() + NSTATE, z.cend());
+
+    std::vector<CppAD::AD<scalar>> J = {objective(q_ad, x_ad)};
+    CppAD::ADFun<scalar> f(z, J);
+
+    // (2) Compute the gradient, and split it
+    const auto gradient = f.Jacobian(z_values);
+
+    std::copy(gradient.cbegin(), gradient.cbegin() + NSTATE, dJdq.begin());
+    dJdx.assign(gradient.cbegin() + NSTATE, gradient.cend());
+}
+
+
+template<class DynamicModel_t>
+inline std::vector<scalar> Track_run<DynamicModel_t>::compute_step_times(const double t_start, const double t_final,
+    std::array<scalar,DynamicModel_t::NSTATE>& q_final)
+{
+    //! Sink that only keeps the times
+    struct Step_times : public Trajectory_sink<DynamicModel_t::NSTATE>
+    {
+        std::vector<scalar> t;
+        void write(const scalar t_point, const std::array<scalar,DynamicModel_t::NSTATE>&) override { t.push_back(t_point); }
+    };
+
+    Step_times step_times;
+    step_times.t.reserve(static_cast<size_t>(std::ceil((t_final - t_start)/_integrator_options.max_h)) + 2);
+
+    const auto q = integrate(t_start, t_final, &step_times, Output_options());
+
+    for (size_t i = 0; i < DynamicModel_t::NSTATE; ++i)
+        q_final[i] = Value(q[i]);
+
+    return std::move(step_times.t);
+}
+
+
+template<class DynamicModel_t>
+inline void Track_run<DynamicModel_t>::construct_control_basis(const double t_start)
+{
+    _control_basis.clear();
+    _control_basis_variable.clear();
+
+    // The parameters are ordered as in set_control_points
+    for (size_t i = 0; i < _n_control_variables; ++i)
+    {
+        if ( _n_blocks[i] == 0 ) break;
+
+        std::vector<scalar> lengths(_lengths.at(i).size());
+        for (size_t n = 0; n < lengths.size(); ++n)
+            lengths[n] = Value(_lengths.at(i)[n]);
+
+        std::vector<std::vector<scalar>> u0(_n_blocks.at(i), std::vector<scalar>(_p+1, 0.0));
+
+        for (size_t n = 0; n < _n_blocks.at(i); ++n)
+        {
+            for (size_t k = 0; k <= _p; ++k)
+            {
+                u0[n][k] = 1.0;
+                _control_basis.push_back(sPolynomial(t_start, lengths, u0));
+                _control_basis_variable.push_back(i);
+                u0[n][k] = 0.0;
+            }
+        }
+    }
 }
 
 
@@ -148,13 +476,24 @@ void inline Track_run<DynamicModel_t>::construct_controls(const double t_start,
     for (size_t i = 0; i < _n_control_variables; ++i)
     {
 //      L must be scaled such that it sums the track_length
-        const scalar L = std::accumulate(_lengths.at(i).cbegin(), _lengths.at(i).cend(), 0.0);
+        const scalar L = Value(std::accumulate(_lengths.at(i).cbegin(), _lengths.at(i).cend(), Timeseries_t(0.0)));
         const scalar factor = (t_end - t_start) / L;
 
         for (auto il = _lengths.at(i).begin(); il != _lengths.at(i).end(); ++il)
             *il *= factor;
 
-        _controls.at(i) = sPolynomial(t_start, _lengths.at(i), _u0.at(i));
+        // The controls are scalar polynomials: their derivatives w.r.t. x are given by the basis of the sensitivities
+        std::vector<scalar> lengths(_lengths.at(i).size());
+        std::transform(_lengths.at(i).cbegin(), _lengths.at(i).cend(), lengths.begin(), [](const Timeseries_t& l) { return Value(l); });
+
+        std::vector<std::vector<scalar>> u0(_u0.at(i).size());
+        for (size_t n = 0; n < u0.size(); ++n)
+        {
+            u0[n].resize(_u0.at(i)[n].size());
+            std::transform(_u0.at(i)[n].cbegin(), _u0.at(i)[n].cend(), u0[n].begin(), [](const Timeseries_t& u) { return Value(u); });
+        }
+
+        _controls.at(i) = sPolynomial(t_start, lengths, u0);
     }
 }
 
@@ -2,86 +2,178 @@
 #include <iostream>
 #include <unordered_map>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <functional>
 
 #include "src/core/vehicles/lot2016kart.h"
 #include "src/core/vehicles/limebeer2014f1.h"
 #include "src/core/applications/steady_state.h"
 #include "src/core/applications/optimal_laptime.h"
+#include "src/core/applications/vehicle_channels.h"
 #include "lion/propagators/crank_nicolson.h"
+#include "src/core/propagators/simplified_newton_crank_nicolson.h"
+#include "src/core/foundation/thread_pool.h"
+#include "src/core/vehicles/track_cache.h"
+#include "src/core/applications/racing_line.h"
 
-// Persistent vehicles
-std::unordered_map<std::string,lot2016kart_all> vehicles_lot2016kart;
-std::unordered_map<std::string,limebeer2014f1_all> vehicles_limebeer2014f1;
+//! An optimal laptime computation, run by the job executor
+struct Optimal_laptime_job
+{
+    Ipopt_progress progress;                //! Progress reported by the solver, and cancellation flag
+    std::atomic<int> state = JOB_QUEUED;    //! One of c_Job_state
+    std::future<void> result;               //! Finished when the job ends. Holds the error of failed jobs
+};
+
+
+//! Tables owned by a context. Every API call locks its context, so that independent contexts run in parallel
+struct fastestlap_context
+{
+    // CppAD thread number of the calls on this context. Declared first, so that it outlives the vehicles
+    Thread_pool::Reserved_thread_number thread_number;
+
+    std::mutex mutex;
 
-// Persistent tracks
-std::unordered_map<std::string,Track_by_polynomial> table_track;
+    // Persistent vehicles
+    std::unordered_map<std::string,lot2016kart_all> vehicles_lot2016kart;
+    std::unordered_map<std::string,limebeer2014f1_all> vehicles_limebeer2014f1;
 
-// Persistent scalars
-std::unordered_map<std::string,scalar> table_scalar;
+    // Persistent tracks: read-only, and shared between contexts
+    std::unordered_map<std::string,std::shared_ptr<const Track_by_polynomial>> table_track;
 
-// Persistent vectors
-std::unordered_map<std::string,std::vector<scalar>> table_vector;
+    // Persistent scalars
+    std::unordered_map<std::string,scalar> table_scalar;
 
-// Persistent warm start variables
-struct
+    // Persistent vectors: read-only once inserted, and shared with the vector views
+    std::unordered_map<std::string,std::shared_ptr<const std::vector<scalar>>> table_vector;
+
+    // Persistent warm start variables
+    struct
+    {
+        std::vector<double> s;
+        std::vector<double> zl;
+        std::vector<double> zu;
+        std::vector<double> lambda;
+        std::vector<std::vector<double>> q;
+        std::vector<std::vector<double>> qa;
+        std::vector<std::vector<double>> u;
+    } warm_start_variables;
+
+    // Submitted jobs. Protected by their own mutex, so that jobs are polled without waiting for the calls on the context
+    std::mutex jobs_mutex;
+    int next_job_id = 0;
+    std::unordered_map<int,std::shared_ptr<Optimal_laptime_job>> jobs;
+};
+
+
+//! Run f(context) on the calling thread with the context locked
+//! The vehicles hold CppAD objects, whose memory shall be returned under the CppAD thread number it was allocated 
+//! with: the caller is registered with the thread number of the context during the call, whichever thread it is. 
+//! The lock ensures that only one thread uses that number. The pool is only used by the parallel loops within f
+template<typename F>
+static auto run_in_context(struct fastestlap_context* context, F&& f)
 {
-    std::vector<double> s;
-    std::vector<double> zl;
-    std::vector<double> zu;
-    std::vector<double> lambda;
-    std::vector<std::vector<double>> q;
-    std::vector<std::vector<double>> qa;
-    std::vector<std::vector<double>> u;
-} warm_start_variables;
+    if ( context == nullptr )
+        throw std::runtime_error("The fastestlap context is null");
+
+    std::lock_guard<std::mutex> lock(context->mutex);
+    Thread_pool::Caller_registration registration(context->thread_number);
+
+    return f(*context);
+}
 
 
-void create_vehicle(struct c_Vehicle* vehicle, const char* name, const char* vehicle_type, const char* database_file)
+struct fastestlap_context* create_context()
 {
-    const std::string s_database = database_file;
+    // Start the pool before any CppAD object is created, since it sets up CppAD for multithreading. The context 
+    // reserves one of its thread numbers
+    Thread_pool::get();
 
-    // Copy the vehicle name
-    vehicle->name = new char[strlen(name)+1];
-    memcpy(vehicle->name, name, strlen(name));
-    vehicle->name[strlen(name)] = '\0';
- 
-    // Copy the database file path
-    vehicle->database_file = new char[strlen(database_file)+1];
-    memcpy(vehicle->database_file, database_file, strlen(database_file));
-    vehicle->database_file[strlen(database_file)] = '\0';
+    return new fastestlap_context;
+}
+
+
+void delete_context(struct fastestlap_context* context)
+{
+    if ( context == nullptr )
+        return;
 
-    if ( std::string(vehicle_type) == "roberto-lot-kart-2016" )
+    // Cancel the jobs and wait for them
+    std::unordered_map<int,std::shared_ptr<Optimal_laptime_job>> jobs;
     {
-        // Check if the vehicle exists
-        if ( vehicles_lot2016kart.count(name) != 0 )
-            throw std::runtime_error(std::string("Vehicle of type roberto-lot-kart-2016 with name \"") + name + "\" already exists"); 
+        std::lock_guard<std::mutex> lock(context->jobs_mutex);
+        std::swap(jobs, context->jobs);
+    }
 
-        vehicle->type = LOT2016KART;
+    for (auto& [id, job] : jobs)
+        job->progress.cancel_requested = true;
 
-        // Open the database as Xml
-        Xml_document database = { database_file, true }; 
+    for (auto& [id, job] : jobs)
+        job->result.wait();
 
-        // Get vehicle type from the database file
-        const std::string vehicle_type_db = database.get_root_element().get_attribute("type");
+    // Destroy the vehicles under the thread number of the context, and wait for any running call
+    run_in_context(context, [](fastestlap_context& context) 
+    { 
+        context.vehicles_lot2016kart.clear(); 
+        context.vehicles_limebeer2014f1.clear(); 
+    });
 
-        if ( vehicle_type_db != std::string(vehicle_type) )
-            throw std::runtime_error("vehicle type read from the database is not \"roberto-lot-kart-2016\"");
+    delete context;
+}
 
-        auto out = vehicles_lot2016kart.insert({name,{database}});
-        if (out.second==false) 
-        {
-            throw std::runtime_error("The insertion to the map failed");
-        }
+
+void share_track(struct fastestlap_context* context, struct fastestlap_context* source, struct c_Track* c_track)
+{
+    if ( source == nullptr )
+        throw std::runtime_error("The source fastestlap context is null");
+
+    // (1) Get the track from the source context
+    std::shared_ptr<const Track_by_polynomial> track;
+    {
+        std::lock_guard<std::mutex> lock(source->mutex);
+        track = source->table_track.at(c_track->name);
     }
-    else if ( std::string(vehicle_type) == "limebeer-2014-f1" )
+
+    // (2) Insert it into the context
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        // Check if the vehicle exists
-        if ( vehicles_limebeer2014f1.count(name) != 0 )
-            throw std::runtime_error(std::string("Vehicle of type limebeer-2014-f1 with name \"") + name + "\" already exists"); 
+        if ( context.table_track.count(c_track->name) != 0 )
+            throw std::runtime_error(std::string("Track with name \"") + c_track->name + "\" already exists"); 
 
-        vehicle->type = LIMEBEER2014F1;
-        
-        if ( strlen(database_file) > 0 )
+        context.table_track.insert({c_track->name, track});
+    });
+}
+
+
+void create_vehicle(struct fastestlap_context* context, struct c_Vehicle* vehicle, const char* name, const char* vehicle_type, const char* database_file)
+{
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        const std::string s_database = database_file;
+
+        // Copy the vehicle name
+        vehicle->name = new char[strlen(name)+1];
+        memcpy(vehicle->name, name, strlen(name));
+        vehicle->name[strlen(name)] = '\0';
+ 
+        // Copy the database file path
+        vehicle->database_file = new char[strlen(database_file)+1];
+        memcpy(vehicle->database_file, database_file, strlen(database_file));
+        vehicle->database_file[strlen(database_file)] = '\0';
+
+        if ( std::string(vehicle_type) == "roberto-lot-kart-2016" )
         {
+            // Check if the vehicle exists
+            if ( context.vehicles_lot2016kart.count(name) != 0 )
+                throw std::runtime_error(std::string("Vehicle of type roberto-lot-kart-2016 with name \"") + name + "\" already exists"); 
+
+            vehicle->type = LOT2016KART;
+
             // Open the database as Xml
             Xml_document database = { database_file, true }; 
 
@@ -89,131 +181,221 @@ void create_vehicle(struct c_Vehicle* vehicle, const char* name, const char* veh
             const std::string vehicle_type_db = database.get_root_element().get_attribute("type");
 
             if ( vehicle_type_db != std::string(vehicle_type) )
-                throw std::runtime_error("vehicle type read from the database is not \"limebeer-2014-f1\"");
-
-            auto out = vehicles_limebeer2014f1.insert({name,{database}});
+                throw std::runtime_error("vehicle type read from the database is not \"roberto-lot-kart-2016\"");
 
+            auto out = context.vehicles_lot2016kart.insert({name,{database}});
             if (out.second==false) 
             {
-                throw std::runtime_error("Vehicle already exists");
-            }        
+                throw std::runtime_error("The insertion to the map failed");
+            }
         }
-        else
+        else if ( std::string(vehicle_type) == "limebeer-2014-f1" )
         {
-            // Construct a default car
-            auto out = vehicles_limebeer2014f1.insert({name,{}});
+            // Check if the vehicle exists
+            if ( context.vehicles_limebeer2014f1.count(name) != 0 )
+                throw std::runtime_error(std::string("Vehicle of type limebeer-2014-f1 with name \"") + name + "\" already exists"); 
 
-            if (out.second==false) 
+            vehicle->type = LIMEBEER2014F1;
+        
+            if ( strlen(database_file) > 0 )
             {
-                throw std::runtime_error("The insertion to the map failed");
+                // Open the database as Xml
+                Xml_document database = { database_file, true }; 
+
+                // Get vehicle type from the database file
+                const std::string vehicle_type_db = database.get_root_element().get_attribute("type");
+
+                if ( vehicle_type_db != std::string(vehicle_type) )
+                    throw std::runtime_error("vehicle type read from the database is not \"limebeer-2014-f1\"");
+
+                auto out = context.vehicles_limebeer2014f1.insert({name,{database}});
+
+                if (out.second==false) 
+                {
+                    throw std::runtime_error("Vehicle already exists");
+                }        
             }
-        }
+            else
+            {
+                // Construct a default car
+                auto out = context.vehicles_limebeer2014f1.insert({name,{}});
 
-    }
-    else
-    {
-        throw std::runtime_error("Vehicle type not recognized");
-    }
+                if (out.second==false) 
+                {
+                    throw std::runtime_error("The insertion to the map failed");
+                }
+            }
+
+        }
+        else
+        {
+            throw std::runtime_error("Vehicle type not recognized");
+        }
+    });
 }
 
-void create_track(struct c_Track* track, const char* name, const char* track_file, const char* options)
+void create_track(struct fastestlap_context* context, struct c_Track* track, const char* name, const char* track_file, const char* options)
 {
-    // (1) Check that the track does not exists in the map
-    if ( table_track.count(name) != 0 )
-        throw std::runtime_error(std::string("Track with name \"") + name + "\" already exists"); 
-
-    // (2) Process options
-    std::string save_variables_prefix;
-    std::vector<std::string> variables_to_save;
-    if ( strlen(options) > 0 )
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        // Parse the options in XML format
-        // Example:
-        //      <options>
-        //          <save_variables>
-        //              <prefix>
-        //              <variables>
-        //                  <s/>
-        //                  <theta/>
-        //                  ...
-        //              </variables>
-        //          </save_variables>
-        //      </options>
-        //
-        std::string s_options(options);
-        Xml_document doc;
-        doc.parse(s_options);
-
-        // Save variables
-        if ( doc.has_element("options/save_variables") )
+        // (1) Check that the track does not exists in the map
+        if ( context.table_track.count(name) != 0 )
+            throw std::runtime_error(std::string("Track with name \"") + name + "\" already exists"); 
+
+        // (2) Process options
+        std::string save_variables_prefix;
+        std::vector<std::string> variables_to_save;
+        std::string cache_directory;
+        size_t racing_line_elements = 0;
+        Minimum_curvature_path::Options racing_line_options;
+        if ( strlen(options) > 0 )
         {
-            save_variables_prefix = doc.get_element("options/save_variables/prefix").get_value();
+            // Parse the options in XML format
+            // Example:
+            //      <options>
+            //          <cache_directory>path</cache_directory>   (optional, empty for the default directory)
+            //          <racing_line>                               (optional, use the minimum curvature path as reference)
+            //              <n_elements>1000</n_elements>
+            //              <margin>0.5</margin>                    (optional, distance kept to the track limits)
+            //          </racing_line>
+            //          <save_variables>
+            //              <prefix>
+            //              <variables>
+            //                  <s/>
+            //                  <theta/>
+            //                  ...
+            //              </variables>
+            //          </save_variables>
+            //      </options>
+            //
+            std::string s_options(options);
+            Xml_document doc;
+            doc.parse(s_options);
+
+            // Save variables
+            if ( doc.has_element("options/save_variables") )
+            {
+                save_variables_prefix = doc.get_element("options/save_variables/prefix").get_value();
     
-            for (auto& variables : doc.get_element("options/save_variables/variables").get_children() )
-                variables_to_save.push_back(variables.get_name());
+                for (auto& variables : doc.get_element("options/save_variables/variables").get_children() )
+                    variables_to_save.push_back(variables.get_name());
+            }
+
+            // Cache of preprocessed tracks
+            if ( doc.has_element("options/cache_directory") )
+            {
+                cache_directory = doc.get_element("options/cache_directory").get_value();
+
+                if ( cache_directory.empty() )
+                    cache_directory = Track_cache::get_default_directory();
+            }
+
+            // Racing line as the reference of the curvilinear coordinates
+            if ( doc.has_element("options/racing_line") )
+            {
+                const int n_elements = doc.get_element("options/racing_line/n_elements").get_value(int());
+
+                if ( n_elements <= 0 )
+                    throw std::runtime_error("options/racing_line/n_elements shall be positive");
+
+                racing_line_elements = n_elements;
+
+                if ( doc.has_element("options/racing_line/margin") )
+                    racing_line_options.margin = doc.get_element("options/racing_line/margin").get_value(scalar());
+            }
         }
-    }
 
-    // (3) Open the track
-    // Copy the track name
-    const std::string s_track_file = track_file;
-    track->name = new char[strlen(name)+1];
-    memcpy(track->name, name, strlen(name));
-    track->name[strlen(name)] = '\0';
+        // (3) Open the track
+        // Copy the track name
+        const std::string s_track_file = track_file;
+        track->name = new char[strlen(name)+1];
+        memcpy(track->name, name, strlen(name));
+        track->name[strlen(name)] = '\0';
  
-    // Copy the track file path
-    track->track_file = new char[strlen(track_file)+1];
-    memcpy(track->track_file, track_file, strlen(track_file));
-    track->track_file[strlen(track_file)] = '\0';
+        // Copy the track file path
+        track->track_file = new char[strlen(track_file)+1];
+        memcpy(track->track_file, track_file, strlen(track_file));
+        track->track_file[strlen(track_file)] = '\0';
+
+        // Load the track from the cache: the xml is only read if the track is not cached
+        std::shared_ptr<const Track_by_polynomial> track_ptr;
+
+        if ( !cache_directory.empty() )
+        {
+            track_ptr = std::make_shared<const Track_by_polynomial>(Track_cache(cache_directory).get_track(s_track_file));
+            track->is_closed = track_ptr->get_preprocessor().is_closed;
+        }
+        else
+        {
+            // Open the track as Xml
+            Xml_document track_xml = { track_file, true }; 
 
-    // Open the track as Xml
-    Xml_document track_xml = { track_file, true }; 
+            // Read type: open or closed
+            const std::string track_type = track_xml.get_root_element().get_attribute("type");
+            bool is_closed;
 
-    // Read type: open or closed
-    const std::string track_type = track_xml.get_root_element().get_attribute("type");
-    bool is_closed;
+            if ( track_type == "closed" )
+                is_closed = true;
 
-    if ( track_type == "closed" )
-        is_closed = true;
+            else if ( track_type == "open" )
+                is_closed = false;
 
-    else if ( track_type == "open" )
-        is_closed = false;
+            else
+                throw std::runtime_error("Track attribute type \"" + track_type + "\" shall be \"open\" or \"closed\"");
 
-    else
-        throw std::runtime_error("Track attribute type \"" + track_type + "\" shall be \"open\" or \"closed\"");
+            // Read format: only discrete tracks are supported by the C API
+            const std::string track_format = track_xml.get_root_element().get_attribute("format");
 
-    // Read format: only discrete tracks are supported by the C API
-    const std::string track_format = track_xml.get_root_element().get_attribute("format");
+            track->is_closed = is_closed;
 
-    track->is_closed = is_closed;
-    
-    if ( track_format != "discrete")
-        throw std::runtime_error(std::string("Track format \"") + track_format + "\" is not supported");
+            if ( track_format != "discrete")
+                throw std::runtime_error(std::string("Track format \"") + track_format + "\" is not supported");
 
-    table_track.insert({name,{track_xml}});
+            track_ptr = std::make_shared<const Track_by_polynomial>(track_xml);
+        }
 
-    // (4) Save variables
+        // Replace the track by the one along its minimum curvature path
+        if ( racing_line_elements > 0 )
+            track_ptr = std::make_shared<const Track_by_polynomial>(Racing_line(*track_ptr, racing_line_elements, track->is_closed, racing_line_options).get_track());
 
-    // Get alias to the track preprocessor
-    const auto& preprocessor = table_track[name].get_preprocessor();
+        context.table_track.insert({name,track_ptr});
 
-    for (const auto& variable_name : variables_to_save )
-    {
-        // Check that the variable does not exist in any of the tables
-        if ( table_scalar.count(save_variables_prefix + variable_name) != 0 )
-            throw std::runtime_error(std::string("Variable \"") + save_variables_prefix + variable_name + "\" already exists in the scalar table");
+        // (4) Save variables
 
-        if ( table_vector.count(save_variables_prefix + variable_name) != 0 )
-            throw std::runtime_error(std::string("Variable \"") + save_variables_prefix + variable_name + "\" already exists in the vector table");
+        // Get alias to the track preprocessor
+        const auto& preprocessor = context.table_track.at(name)->get_preprocessor();
 
+        for (const auto& variable_name : variables_to_save )
+        {
+            // Check that the variable does not exist in any of the tables
+            if ( context.table_scalar.count(save_variables_prefix + variable_name) != 0 )
+                throw std::runtime_error(std::string("Variable \"") + save_variables_prefix + variable_name + "\" already exists in the scalar table");
 
-        if ( variable_name == "s" )
-            table_vector.insert({save_variables_prefix+variable_name, preprocessor.s});
-        else
-            throw std::runtime_error(std::string("Variable \"") + variable_name + "\" is not implemented");
+            if ( context.table_vector.count(save_variables_prefix + variable_name) != 0 )
+                throw std::runtime_error(std::string("Variable \"") + save_variables_prefix + variable_name + "\" already exists in the vector table");
+
+
+            if ( variable_name == "s" )
+                context.table_vector.insert({save_variables_prefix+variable_name, std::make_shared<const std::vector<scalar>>(preprocessor.s)});
+            else
+                throw std::runtime_error(std::string("Variable \"") + variable_name + "\" is not implemented");
+        }
+    });
+}
+
+//! Bind a track to a curvilinear vehicle. Tracks share their data, so that binding is O(1), and the equations
+//! tape is only reset if the track changes
+template<typename Vehicle_t>
+static void bind_track(Vehicle_t& car, const Track_by_polynomial& track)
+{
+    if ( !car.get_road().get_track().is_same_track(track) )
+    {
+        car.get_road().change_track(track);
+        car.reset_equations_tape();
     }
 }
 
+
 template<typename Vehicle_t>
 double get_vehicle_property_generic(Vehicle_t& vehicle, const double* c_q, const double* c_qa, const double* c_u, const double s, const char* c_property_name)
 {
@@ -226,343 +408,321 @@ double get_vehicle_property_generic(Vehicle_t& vehicle, const double* c_q, const
     std::copy_n(c_qa, Vehicle_t::NALGEBRAIC, qa.begin());
     std::copy_n(c_u, Vehicle_t::NCONTROL, u.begin());
 
-    std::string property_name(c_property_name);
-
-    vehicle(q, qa, u, s);
+    // (2) Evaluate the vehicle and get the property
+    Vehicle_channels<Vehicle_t> channels({std::string(c_property_name)});
 
-    if ( property_name == "x" ) 
-        return vehicle.get_road().get_x();
+    scalar value;
+    channels.evaluate(vehicle, q, qa, u, s, &value);
 
-    else if ( property_name == "y" )
-        return vehicle.get_road().get_y();
-
-    else if ( property_name == "s" )
-        return s;
-
-    else if ( property_name == "n" )
-        return q[Vehicle_t::Road_type::IN];
-
-    else if ( property_name == "alpha" )
-        return q[Vehicle_t::Road_type::IALPHA];
-
-    else if ( property_name == "u" )
-        return q[Vehicle_t::Chassis_type::IU];
-
-    else if ( property_name == "v" )
-        return q[Vehicle_t::Chassis_type::IV];
-
-    else if ( property_name == "time" )
-        return q[Vehicle_t::Road_type::ITIME];
-
-    else if ( property_name == "delta" )
-        return u[Vehicle_t::Chassis_type::Front_axle_type::ISTEERING];
-
-    else if ( property_name == "psi" )
-        return vehicle.get_road().get_psi();
+    return value;
+}
 
-    else if ( property_name == "omega" )
-        return q[Vehicle_t::Chassis_type::IOMEGA];
 
-    else if ( property_name == "throttle" )
+double get_vehicle_property(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const double* q, const double* qa, const double* u, const double s, const char* property_name)
+{
+    return run_in_context(context, [&](fastestlap_context& context)
     {
-        if constexpr (std::is_same<Vehicle_t, lot2016kart_all>::value)
+        if ( c_vehicle->type == LOT2016KART )
         {
-            return u[Vehicle_t::Chassis_type::Rear_axle_type::ITORQUE];
+            return get_vehicle_property_generic(context.vehicles_lot2016kart.at(c_vehicle->name).curvilinear_scalar, q, qa, u, s, property_name);
         }
-
-        else if constexpr (std::is_same<Vehicle_t, limebeer2014f1_all>::value)
+        else if ( c_vehicle->type == LIMEBEER2014F1 )
         {
-            return u[Vehicle_t::Chassis_type::ITHROTTLE];
+            return get_vehicle_property_generic(context.vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_scalar, q, qa, u, s, property_name);
         }
         else
         {
-            throw std::runtime_error("[ERROR] Vehicle type is not defined");
+            throw std::runtime_error("[ERROR] libfastestlapc::get_vehicle_property -> vehicle type is not defined");
         }
-    }
-    else if ( property_name == "rear_axle.left_tire.x" )
-        return vehicle.get_chassis().get_rear_axle().template get_tire<0>().get_position().at(0);
-
-    else if ( property_name == "rear_axle.left_tire.y" )
-        return vehicle.get_chassis().get_rear_axle().template get_tire<0>().get_position().at(1);
+    });
+}
 
-    else if ( property_name == "rear_axle.right_tire.x" )
-        return vehicle.get_chassis().get_rear_axle().template get_tire<1>().get_position().at(0);
 
-    else if ( property_name == "rear_axle.right_tire.y" )
-        return vehicle.get_chassis().get_rear_axle().template get_tire<1>().get_position().at(1);
+int download_vector_table_variable_size(struct fastestlap_context* context, const char* name_c)
+{
+    return run_in_context(context, [&](fastestlap_context& context)
+    {
+        std::string name(name_c);
 
-    else if ( property_name == "front_axle.left_tire.x" )
-        return vehicle.get_chassis().get_front_axle().template get_tire<0>().get_position().at(0);
+        // Look for the item in the table
+        const auto& item = context.table_vector.find(name);
 
-    else if ( property_name == "front_axle.left_tire.y" )
-        return vehicle.get_chassis().get_front_axle().template get_tire<0>().get_position().at(1);
+        // Check that it was found
+        if ( item == context.table_vector.end() )
+            throw std::runtime_error(std::string("Variable \"") + name + "\" does not exists in the vector table");
 
-    else if ( property_name == "front_axle.right_tire.x" )
-        return vehicle.get_chassis().get_front_axle().template get_tire<1>().get_position().at(0);
+        const auto& table_data = *item->second;
+    
+        return table_data.size();
+    });
+}
 
-    else if ( property_name == "front_axle.right_tire.y" )
-        return vehicle.get_chassis().get_front_axle().template get_tire<1>().get_position().at(1);
 
-    else if ( property_name == "front_axle.left_tire.kappa" )
-        return vehicle.get_chassis().get_front_axle().template get_tire<0>().get_kappa();
+void download_vector_table_variable(struct fastestlap_context* context, double* data, const int n, const char* name_c)
+{
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        std::string name(name_c);
 
-    else if ( property_name == "front_axle.right_tire.kappa" )
-        return vehicle.get_chassis().get_front_axle().template get_tire<1>().get_kappa();
+        // Look for the item in the table
+        const auto& item = context.table_vector.find(name);
 
-    else if ( property_name == "rear_axle.left_tire.kappa" )
-        return vehicle.get_chassis().get_rear_axle().template get_tire<0>().get_kappa();
+        // Check that it was found
+        if ( item == context.table_vector.end() )
+            throw std::runtime_error(std::string("Variable \"") + name + "\" does not exists in the vector table");
 
-    else if ( property_name == "rear_axle.right_tire.kappa" )
-        return vehicle.get_chassis().get_rear_axle().template get_tire<1>().get_kappa();
+        // Check input consistency
+        const auto& table_data = *item->second;
 
-    else if ( property_name == "Fz_fl" )
-    {
-        if constexpr (std::is_same<Vehicle_t, limebeer2014f1_all>::value)
-        {
-            return qa[Vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZFL];
-        }
-        else 
-        {
-            throw std::runtime_error("Fz_fl is only defined for limebeer2014f1 models");
-        }
-    }
+        if ( table_data.size() != static_cast<size_t>(n) )
+            throw std::runtime_error(std::string("Incorrect input size for variable \"") + name + "\". Input: " 
+                + std::to_string(n) + ", should be " + std::to_string(table_data.size()));
 
-    else if ( property_name == "Fz_fr" )
-    {
-        if constexpr (std::is_same<Vehicle_t, limebeer2014f1_all>::value)
-        {
-            return qa[Vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZFR];
-        }
-        else 
-        {
-            throw std::runtime_error("Fz_fr is only defined for limebeer2014f1 models");
-        }
-    }
+        // Copy the data into the provided pointer
+        std::copy(table_data.cbegin(), table_data.cend(), data);
 
-    else if ( property_name == "Fz_rl" )
-    {
-        if constexpr (std::is_same<Vehicle_t, limebeer2014f1_all>::value)
-        {
-            return qa[Vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZRL];
-        }
-        else 
-        {
-            throw std::runtime_error("Fz_rl is only defined for limebeer2014f1 models");
-        }
-    }
-
-    else if ( property_name == "Fz_rr" )
-    {
-        if constexpr (std::is_same<Vehicle_t, limebeer2014f1_all>::value)
-        {
-            return qa[Vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZRR];
-        }
-        else 
-        {
-            throw std::runtime_error("Fz_rr is only defined for limebeer2014f1 models");
-        }
-    }
-
-    else
-    {
-        throw std::runtime_error("Variable \"" + property_name + "\" is not defined");
-    }
+        return;
+    });
 }
 
 
-double get_vehicle_property(struct c_Vehicle* c_vehicle, const double* q, const double* qa, const double* u, const double s, const char* property_name)
+void acquire_vector_table_variable_view(struct fastestlap_context* context, struct c_Vector_view* view, const char* name_c)
 {
-    if ( c_vehicle->type == LOT2016KART )
-    {
-        return get_vehicle_property_generic(vehicles_lot2016kart.at(c_vehicle->name).curvilinear_scalar, q, qa, u, s, property_name);
-    }
-    else if ( c_vehicle->type == LIMEBEER2014F1 )
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        return get_vehicle_property_generic(vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_scalar, q, qa, u, s, property_name);
-    }
-    else
-    {
-        throw std::runtime_error("[ERROR] libfastestlapc::get_vehicle_property -> vehicle type is not defined");
-    }
-}
-
+        std::string name(name_c);
 
-int download_vector_table_variable_size(const char* name_c)
-{
-    std::string name(name_c);
+        // Look for the item in the table
+        const auto& item = context.table_vector.find(name);
 
-    // Look for the item in the table
-    const auto& item = table_vector.find(name);
+        // Check that it was found
+        if ( item == context.table_vector.end() )
+            throw std::runtime_error(std::string("Variable \"") + name + "\" does not exists in the vector table");
 
-    // Check that it was found
-    if ( item == table_vector.end() )
-        throw std::runtime_error(std::string("Variable \"") + name + "\" does not exists in the vector table");
+        // The view owns a reference to the data, which is never modified once in the table
+        auto handle = new std::shared_ptr<const std::vector<scalar>>(item->second);
 
-    const auto& table_data = item->second;
-    
-    return table_data.size();
+        view->data   = (*handle)->data();
+        view->size   = static_cast<int>((*handle)->size());
+        view->handle = handle;
+    });
 }
 
 
-void download_vector_table_variable(double* data, const int n, const char* name_c)
+void release_vector_view(struct c_Vector_view* view)
 {
-    std::string name(name_c);
-
-    // Look for the item in the table
-    const auto& item = table_vector.find(name);
-
-    // Check that it was found
-    if ( item == table_vector.end() )
-        throw std::runtime_error(std::string("Variable \"") + name + "\" does not exists in the vector table");
-
-    // Check input consistency
-    const auto& table_data = item->second;
+    if ( view == nullptr )
+        return;
 
-    if ( table_data.size() != static_cast<size_t>(n) )
-        throw std::runtime_error(std::string("Incorrect input size for variable \"") + name + "\". Input: " 
-            + std::to_string(n) + ", should be " + std::to_string(table_data.size()));
+    // No CppAD objects are involved: the view can be released from any thread
+    delete static_cast<std::shared_ptr<const std::vector<scalar>>*>(view->handle);
 
-    // Copy the data into the provided pointer
-    std::copy(table_data.cbegin(), table_data.cend(), data);
-
-    return;
+    view->data   = nullptr;
+    view->size   = 0;
+    view->handle = nullptr;
 }
 
 
-void load_vector_table_variable(double* data, const int n, const char* name_c)
+void load_vector_table_variable(struct fastestlap_context* context, double* data, const int n, const char* name_c)
 {
-    std::string name(name_c);
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        std::string name(name_c);
 
-    // Check that the variable does not exist
-    if ( table_vector.count(name) != 0 )
-        throw std::runtime_error(std::string("Variable \"") + name + "\" already exists in the vector table");
+        // Check that the variable does not exist
+        if ( context.table_vector.count(name) != 0 )
+            throw std::runtime_error(std::string("Variable \"") + name + "\" already exists in the vector table");
 
-    table_vector.insert({name,{data,data+n}});
+        context.table_vector.insert({name,std::make_shared<const std::vector<scalar>>(data,data+n)});
+    });
 }
 
 
-void clear_tables()
+void clear_tables(struct fastestlap_context* context)
 {
-    table_scalar.clear();
-    table_vector.clear();
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        context.table_scalar.clear();
+        context.table_vector.clear();
+    });
 }
 
 
-void clear_tables_by_prefix(const char* prefix_c)
+void clear_tables_by_prefix(struct fastestlap_context* context, const char* prefix_c)
 {
-    std::string prefix(prefix_c);
-
-    // Scalar map
-    for (auto it = table_scalar.cbegin(); it != table_scalar.cend(); )
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        if ( it->first.find(prefix) == 0 ) 
-        {
-            it = table_scalar.erase(it); 
-        }
-        else
+        std::string prefix(prefix_c);
+
+        // Scalar map
+        for (auto it = context.table_scalar.cbegin(); it != context.table_scalar.cend(); )
         {
-            ++it;
+            if ( it->first.find(prefix) == 0 ) 
+            {
+                it = context.table_scalar.erase(it); 
+            }
+            else
+            {
+                ++it;
+            }
         }
-    }
 
 
-    // Vector map
-    for (auto it = table_vector.cbegin(); it != table_vector.cend(); )
-    {
-        if ( it->first.find(prefix) == 0 ) 
+        // Vector map
+        for (auto it = context.table_vector.cbegin(); it != context.table_vector.cend(); )
         {
-            it = table_vector.erase(it); 
-        }
-        else
-        {
-            ++it;
+            if ( it->first.find(prefix) == 0 ) 
+            {
+                it = context.table_vector.erase(it); 
+            }
+            else
+            {
+                ++it;
+            }
         }
-    }
+    });
 }
 
 
-void delete_vehicle(struct c_Vehicle* c_vehicle)
+void delete_vehicle(struct fastestlap_context* context, struct c_Vehicle* c_vehicle)
 {
-    if ( c_vehicle->type == LIMEBEER2014F1 )
-        vehicles_limebeer2014f1.erase(c_vehicle->name);
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        if ( c_vehicle->type == LIMEBEER2014F1 )
+            context.vehicles_limebeer2014f1.erase(c_vehicle->name);
 
-    else if ( c_vehicle->type == LOT2016KART )
-        vehicles_lot2016kart.erase(c_vehicle->name);
+        else if ( c_vehicle->type == LOT2016KART )
+            context.vehicles_lot2016kart.erase(c_vehicle->name);
     
-    else
-        throw std::runtime_error("Vehicle type is not recognized");
+        else
+            throw std::runtime_error("Vehicle type is not recognized");
+    });
 }
 
-void set_scalar_parameter(struct c_Vehicle* c_vehicle, const char* parameter, const double value)
+void set_scalar_parameter(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const char* parameter, const double value)
 {
-    if ( c_vehicle->type == LIMEBEER2014F1 )
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        vehicles_limebeer2014f1.at(c_vehicle->name).set_parameter(parameter, value);
-    }
+        if ( c_vehicle->type == LIMEBEER2014F1 )
+        {
+            context.vehicles_limebeer2014f1.at(c_vehicle->name).set_parameter(parameter, value);
+        }
+    });
 }
 
 
-void set_vector_parameter(struct c_Vehicle* c_vehicle, const char* parameter, const double value[3])
+void set_vector_parameter(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const char* parameter, const double value[3])
 {
-    if ( c_vehicle->type == LIMEBEER2014F1 )
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        sVector3d v_value = { value[0], value[1], value[2] };
-        vehicles_limebeer2014f1.at(c_vehicle->name).set_parameter(parameter, v_value);
-    }
+        if ( c_vehicle->type == LIMEBEER2014F1 )
+        {
+            sVector3d v_value = { value[0], value[1], value[2] };
+            context.vehicles_limebeer2014f1.at(c_vehicle->name).set_parameter(parameter, v_value);
+        }
+    });
 }
 
 
-void set_matrix_parameter(struct c_Vehicle* c_vehicle, const char* parameter, const double value[9])
+void set_matrix_parameter(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const char* parameter, const double value[9])
 {
-    if ( c_vehicle->type == LIMEBEER2014F1 )
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        sMatrix3x3 m_value = { value[0], value[1], value[2], value[3], value[4], value[5], value[6], value[7], value[8] };
-        vehicles_limebeer2014f1.at(c_vehicle->name).set_parameter(parameter, m_value);
-    }
+        if ( c_vehicle->type == LIMEBEER2014F1 )
+        {
+            sMatrix3x3 m_value = { value[0], value[1], value[2], value[3], value[4], value[5], value[6], value[7], value[8] };
+            context.vehicles_limebeer2014f1.at(c_vehicle->name).set_parameter(parameter, m_value);
+        }
+    });
 }
 
 
-void add_variable_parameter(struct c_Vehicle* c_vehicle, const char* parameter_name, const int n, const double* s, const double* values)
+void add_variable_parameter(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const char* parameter_name, const int n, const double* s, const double* values)
 {
-    std::vector<scalar> v_s(s,s+n);
-    std::vector<scalar> v_values(values,values+n);
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        std::vector<scalar> v_s(s,s+n);
+        std::vector<scalar> v_values(values,values+n);
 
-    sPolynomial p(v_s,v_values,1,true);
+        sPolynomial p(v_s,v_values,1,true);
     
-    if ( c_vehicle->type == LIMEBEER2014F1 )
-        vehicles_limebeer2014f1.at(c_vehicle->name).add_variable_parameter(std::string(parameter_name), p);
-
-    else if ( c_vehicle->type == LOT2016KART )
-        vehicles_lot2016kart.at(c_vehicle->name).add_variable_parameter(std::string(parameter_name), p);
-
-    else
-        throw std::runtime_error("Vehicle type not recognized");
-}
-
-
-void vehicle_equations(double* dqdt, double* dqa, double** jac_dqdt, double** jac_dqa, double*** h_dqdt, double*** h_dqa, struct c_Vehicle* vehicle, double* q, double* qa, double* u, double s)
-{
+        if ( c_vehicle->type == LIMEBEER2014F1 )
+            context.vehicles_limebeer2014f1.at(c_vehicle->name).add_variable_parameter(std::string(parameter_name), p);
 
+        else if ( c_vehicle->type == LOT2016KART )
+            context.vehicles_lot2016kart.at(c_vehicle->name).add_variable_parameter(std::string(parameter_name), p);
 
+        else
+            throw std::runtime_error("Vehicle type not recognized");
+    });
 }
 
 
 template<typename Vehicle_t>
-void compute_propagation(Vehicle_t car, double* c_q, double* c_qa, double* c_u, double s, double ds, double* c_u_next, const char* c_options)
+void compute_vehicle_equations(Vehicle_t& car, double* dqdt, double* dqa, double* jac_dqdt, double* jac_dqa, double* h_dqdt, double* h_dqa, 
+    const double* c_q, const double* c_qa, const double* c_u, double s)
 {
     // (1) Construct Cpp version of the C inputs
     std::array<scalar,Vehicle_t::NSTATE> q;
     std::array<scalar,Vehicle_t::NALGEBRAIC> qa;
     std::array<scalar,Vehicle_t::NCONTROL> u;
-    std::array<scalar,Vehicle_t::NCONTROL> u_next;
 
     std::copy_n(c_q, Vehicle_t::NSTATE, q.begin());
     std::copy_n(c_qa, Vehicle_t::NALGEBRAIC, qa.begin());
     std::copy_n(c_u, Vehicle_t::NCONTROL, u.begin());
-    std::copy_n(c_u_next, Vehicle_t::NCONTROL, u_next.begin());
 
-    // (2) Parse options
+    // (2) Evaluate the equations directly into the output buffers
+    car.equations(dqdt, dqa, jac_dqdt, jac_dqa, h_dqdt, h_dqa, q, qa, u, s);
+}
+
+
+void vehicle_equations(struct fastestlap_context* context, double* dqdt, double* dqa, double* jac_dqdt, double* jac_dqa, double* h_dqdt, double* h_dqa, struct c_Vehicle* c_vehicle, 
+    struct c_Track* c_track, const double* q, const double* qa, const double* u, double s, bool use_circuit)
+{
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        if ( c_vehicle->type == LOT2016KART )
+        {
+            auto& vehicle = context.vehicles_lot2016kart.at(c_vehicle->name);
+
+            if ( use_circuit )
+            {
+                bind_track(vehicle.curvilinear_ad, *context.table_track.at(c_track->name));
+                compute_vehicle_equations(vehicle.curvilinear_ad, dqdt, dqa, jac_dqdt, jac_dqa, h_dqdt, h_dqa, q, qa, u, s);
+            }
+            else
+            {
+                compute_vehicle_equations(vehicle.cartesian_ad, dqdt, dqa, jac_dqdt, jac_dqa, h_dqdt, h_dqa, q, qa, u, s);
+            }
+        }
+        else if ( c_vehicle->type == LIMEBEER2014F1 )
+        {
+            auto& vehicle = context.vehicles_limebeer2014f1.at(c_vehicle->name);
+
+            if ( use_circuit )
+            {
+                bind_track(vehicle.curvilinear_ad, *context.table_track.at(c_track->name));
+                compute_vehicle_equations(vehicle.curvilinear_ad, dqdt, dqa, jac_dqdt, jac_dqa, h_dqdt, h_dqa, q, qa, u, s);
+            }
+            else
+            {
+                compute_vehicle_equations(vehicle.cartesian_ad, dqdt, dqa, jac_dqdt, jac_dqa, h_dqdt, h_dqa, q, qa, u, s);
+            }
+        }
+        else
+        {
+            throw std::runtime_error("[ERROR] libfastestlapc::vehicle_equations -> vehicle type is not defined");
+        }
+    });
+}
+
+
+//! Parse the options of the Crank-Nicolson propagator
+template<typename Vehicle_t>
+static auto parse_propagation_options(const char* c_options)
+{
     typename Crank_nicolson<Vehicle_t,Vehicle_t::NSTATE,Vehicle_t::NALGEBRAIC,Vehicle_t::NCONTROL>::Options opts;
+
     if ( strlen(c_options) > 0 )
     {
         std::string options = c_options;
@@ -575,42 +735,227 @@ void compute_propagation(Vehicle_t car, double* c_q, double* c_qa, double* c_u,
         if ( doc.has_element("options/relaxation_factor") ) opts.relaxation_factor = doc.get_element("options/relaxation_factor").get_value(scalar());
     }
 
-    // (3) Take step
-    Crank_nicolson<Vehicle_t,Vehicle_t::NSTATE,Vehicle_t::NALGEBRAIC,Vehicle_t::NCONTROL>::take_step(car, u, u_next, q, qa, s, ds, opts);
+    return opts;
+}
+
+
+template<typename Vehicle_t>
+void compute_propagation(Vehicle_t car, double* c_q, double* c_qa, double* c_u, double s, double ds, double* c_u_next, const char* c_options)
+{
+    // (1) Construct Cpp version of the C inputs
+    std::array<scalar,Vehicle_t::NSTATE> q;
+    std::array<scalar,Vehicle_t::NALGEBRAIC> qa;
+    std::array<scalar,Vehicle_t::NCONTROL> u;
+    std::array<scalar,Vehicle_t::NCONTROL> u_next;
+
+    std::copy_n(c_q, Vehicle_t::NSTATE, q.begin());
+    std::copy_n(c_qa, Vehicle_t::NALGEBRAIC, qa.begin());
+    std::copy_n(c_u, Vehicle_t::NCONTROL, u.begin());
+    std::copy_n(c_u_next, Vehicle_t::NCONTROL, u_next.begin());
+
+    // (2) Parse options
+    auto opts = parse_propagation_options<Vehicle_t>(c_options);
+
+    // (3) Take step
+    Crank_nicolson<Vehicle_t,Vehicle_t::NSTATE,Vehicle_t::NALGEBRAIC,Vehicle_t::NCONTROL>::take_step(car, u, u_next, q, qa, s, ds, opts);
+
+    // (4) Return the variables to the c version
+    std::copy_n(q.begin(), Vehicle_t::NSTATE, c_q);
+    std::copy_n(qa.begin(), Vehicle_t::NALGEBRAIC, c_qa);
+}
+
+void propagate(struct fastestlap_context* context, double* q, double* qa, double* u, struct c_Vehicle* c_vehicle, struct c_Track* c_track, double s, double ds, double* u_next, bool use_circuit, const char* options)
+{
+    if ( use_circuit && c_track == nullptr )
+        throw std::runtime_error("[ERROR] libfastestlapc::propagate -> the track is null, and use_circuit is true");
+
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        if ( c_vehicle->type == LOT2016KART )
+        {
+            if ( use_circuit )
+            {
+                bind_track(context.vehicles_lot2016kart.at(c_vehicle->name).curvilinear_ad, *context.table_track.at(c_track->name));
+                bind_track(context.vehicles_lot2016kart.at(c_vehicle->name).curvilinear_scalar, *context.table_track.at(c_track->name));
+                compute_propagation(context.vehicles_lot2016kart.at(c_vehicle->name).curvilinear_ad, q, qa, u, s, ds, u_next, options);
+            }
+            else
+            {
+                compute_propagation(context.vehicles_lot2016kart.at(c_vehicle->name).cartesian_ad, q, qa, u, s, ds, u_next, options);
+            }
+        }
+        else
+        {
+            if ( use_circuit )
+            {
+                bind_track(context.vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_ad, *context.table_track.at(c_track->name));
+                bind_track(context.vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_scalar, *context.table_track.at(c_track->name));
+                compute_propagation(context.vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_ad, q, qa, u, s, ds, u_next, options);
+            }
+            else
+            {
+                compute_propagation(context.vehicles_limebeer2014f1.at(c_vehicle->name).cartesian_ad, q, qa, u, s, ds, u_next, options);
+            }
+        }
+    });
+}
+
+
+//! Options of simulate(): the integrator, and the options of the simplified Newton integrator
+template<typename Vehicle_t>
+struct Simulation_options
+{
+    bool use_simplified_newton = true;      //! Use Simplified_newton_crank_nicolson instead of Crank_nicolson
+    bool is_adaptive = false;               //! Adapt the step size between the points (simplified Newton only)
+    typename Simplified_newton_crank_nicolson<Vehicle_t>::Options simplified_newton;
+};
+
+
+template<typename Vehicle_t>
+static Simulation_options<Vehicle_t> parse_simulation_options(const char* c_options)
+{
+    Simulation_options<Vehicle_t> opts;
+
+    if ( strlen(c_options) == 0 )
+        return opts;
+
+    std::string options = c_options;
+    Xml_document doc;
+    doc.parse(options);
+
+    if ( doc.has_element("options/integrator") )
+    {
+        const std::string integrator = doc.get_element("options/integrator").get_value();
+
+        if ( integrator == "crank_nicolson" )
+            opts.use_simplified_newton = false;
+        else if ( integrator != "simplified_newton" )
+            throw std::runtime_error("Integrator \"" + integrator + "\" is not recognized. Options are \"crank_nicolson\" and \"simplified_newton\"");
+    }
+
+    auto& sn = opts.simplified_newton;
+    if ( doc.has_element("options/adaptive") )            opts.is_adaptive = doc.get_element("options/adaptive").get_value(bool());
+    if ( doc.has_element("options/sigma") )               sn.sigma = doc.get_element("options/sigma").get_value(scalar());
+    if ( doc.has_element("options/max_iter") )            sn.max_iter = doc.get_element("options/max_iter").get_value(scalar());
+    if ( doc.has_element("options/error_tolerance") )     sn.error_tolerance = doc.get_element("options/error_tolerance").get_value(scalar());
+    if ( doc.has_element("options/relative_tolerance") )  sn.relative_tolerance = doc.get_element("options/relative_tolerance").get_value(scalar());
+    if ( doc.has_element("options/absolute_tolerance") )  sn.absolute_tolerance = doc.get_element("options/absolute_tolerance").get_value(scalar());
+    if ( doc.has_element("options/ds_min") )              sn.ds_min = doc.get_element("options/ds_min").get_value(scalar());
+    if ( doc.has_element("options/ds_max") )              sn.ds_max = doc.get_element("options/ds_max").get_value(scalar());
 
-    // (4) Return the variables to the c version
-    std::copy_n(q.begin(), Vehicle_t::NSTATE, c_q);
-    std::copy_n(qa.begin(), Vehicle_t::NALGEBRAIC, c_qa);
+    if ( opts.is_adaptive && !opts.use_simplified_newton )
+        throw std::runtime_error("Adaptive step size is only available with the \"simplified_newton\" integrator");
+
+    return opts;
 }
 
-void propagate(double* q, double* qa, double* u, struct c_Vehicle* c_vehicle, struct c_Track* c_track, double s, double ds, double* u_next, bool use_circuit, const char* options)
+
+//! Integrate a control schedule. The simplified Newton integrator runs on the scalar vehicle, and only lion's Crank_nicolson,
+//! which records the vehicle at every step, needs the AD vehicle
+template<typename Vehicle_ad_t, typename Vehicle_scalar_t>
+void compute_simulation(Vehicle_ad_t& car_ad, Vehicle_scalar_t& car_scalar, double* c_q, double* c_qa, const int n_points, const double* s, 
+    const double* c_u, const char* c_options)
 {
-    if ( c_vehicle->type == LOT2016KART )
+    constexpr const size_t NSTATE     = Vehicle_scalar_t::NSTATE;
+    constexpr const size_t NALGEBRAIC = Vehicle_scalar_t::NALGEBRAIC;
+    constexpr const size_t NCONTROL   = Vehicle_scalar_t::NCONTROL;
+
+    if ( n_points < 1 )
+        throw std::runtime_error("simulate: at least one point is required");
+
+    // (1) Parse options once
+    auto opts = parse_propagation_options<Vehicle_ad_t>(c_options);
+    const auto simulation_opts = parse_simulation_options<Vehicle_scalar_t>(c_options);
+
+    // The simplified Newton integrator keeps its iteration matrix across the whole simulation
+    Simplified_newton_crank_nicolson<Vehicle_scalar_t> simplified_newton(car_scalar, simulation_opts.simplified_newton);
+
+    // (2) Get the initial condition
+    std::array<scalar,NSTATE> q;
+    std::array<scalar,NALGEBRAIC> qa;
+    std::array<scalar,NCONTROL> u;
+    std::array<scalar,NCONTROL> u_next;
+
+    std::copy_n(c_q, NSTATE, q.begin());
+    std::copy_n(c_qa, NALGEBRAIC, qa.begin());
+    std::copy_n(c_u, NCONTROL, u_next.begin());
+
+    // (3) Integrate the control schedule, writing the states of each point in its row
+    for (int i = 1; i < n_points; ++i)
     {
-        if ( use_circuit )
+        u = u_next;
+        std::copy_n(c_u + i*NCONTROL, NCONTROL, u_next.begin());
+
+        if ( simulation_opts.is_adaptive )
         {
-            vehicles_lot2016kart.at(c_vehicle->name).curvilinear_ad.get_road().change_track(table_track.at(c_track->name));
-            vehicles_lot2016kart.at(c_vehicle->name).curvilinear_scalar.get_road().change_track(table_track.at(c_track->name));
-            compute_propagation(vehicles_lot2016kart.at(c_vehicle->name).curvilinear_ad, q, qa, u, s, ds, u_next, options);
+            // Controls are interpolated linearly between the points
+            const auto control = [&, s_start = s[i-1], ds = s[i]-s[i-1]](const scalar s_eval)
+            {
+                std::array<scalar,NCONTROL> u_eval;
+                const scalar xi = (s_eval - s_start)/ds;
+
+                for (size_t j = 0; j < NCONTROL; ++j)
+                    u_eval[j] = (1.0-xi)*u[j] + xi*u_next[j];
+
+                return u_eval;
+            };
+
+            simplified_newton.integrate(control, q, qa, s[i-1], s[i]);
         }
+        else if ( simulation_opts.use_simplified_newton )
+            simplified_newton.take_step(u, u_next, q, qa, s[i-1], s[i]-s[i-1]);
         else
-        {
-            compute_propagation(vehicles_lot2016kart.at(c_vehicle->name).cartesian_ad, q, qa, u, s, ds, u_next, options);
-        }
+            Crank_nicolson<Vehicle_ad_t,NSTATE,NALGEBRAIC,NCONTROL>::take_step(car_ad, u, u_next, q, qa, s[i-1], s[i]-s[i-1], opts);
+
+        std::copy_n(q.cbegin(), NSTATE, c_q + i*NSTATE);
+        std::copy_n(qa.cbegin(), NALGEBRAIC, c_qa + i*NALGEBRAIC);
     }
-    else
+}
+
+
+void simulate(struct fastestlap_context* context, double* q, double* qa, struct c_Vehicle* c_vehicle, struct c_Track* c_track, const int n_points, 
+    const double* s, const double* u, bool use_circuit, const char* options)
+{
+    if ( use_circuit && c_track == nullptr )
+        throw std::runtime_error("[ERROR] libfastestlapc::simulate -> the track is null, and use_circuit is true");
+
+    run_in_context(context, [&](fastestlap_context& context)
     {
-        if ( use_circuit )
+        if ( c_vehicle->type == LOT2016KART )
+        {
+            auto& vehicle = context.vehicles_lot2016kart.at(c_vehicle->name);
+
+            if ( use_circuit )
+            {
+                bind_track(vehicle.curvilinear_ad, *context.table_track.at(c_track->name));
+                bind_track(vehicle.curvilinear_scalar, *context.table_track.at(c_track->name));
+                compute_simulation(vehicle.curvilinear_ad, vehicle.curvilinear_scalar, q, qa, n_points, s, u, options);
+            }
+            else
+            {
+                compute_simulation(vehicle.cartesian_ad, vehicle.cartesian_scalar, q, qa, n_points, s, u, options);
+            }
+        }
+        else if ( c_vehicle->type == LIMEBEER2014F1 )
         {
-            vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_ad.get_road().change_track(table_track.at(c_track->name));
-            vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_scalar.get_road().change_track(table_track.at(c_track->name));
-            compute_propagation(vehicles_limebeer2014f1.at(c_vehicle->name).curvilinear_ad, q, qa, u, s, ds, u_next, options);
+            auto& vehicle = context.vehicles_limebeer2014f1.at(c_vehicle->name);
+
+            if ( use_circuit )
+            {
+                bind_track(vehicle.curvilinear_ad, *context.table_track.at(c_track->name));
+                bind_track(vehicle.curvilinear_scalar, *context.table_track.at(c_track->name));
+                compute_simulation(vehicle.curvilinear_ad, vehicle.curvilinear_scalar, q, qa, n_points, s, u, options);
+            }
+            else
+            {
+                compute_simulation(vehicle.cartesian_ad, vehicle.cartesian_scalar, q, qa, n_points, s, u, options);
+            }
         }
         else
         {
-            compute_propagation(vehicles_limebeer2014f1.at(c_vehicle->name).cartesian_ad, q, qa, u, s, ds, u_next, options);
+            throw std::runtime_error("[ERROR] libfastestlapc::simulate -> vehicle type is not defined");
         }
-    }
+    });
 }
 
 
@@ -629,60 +974,89 @@ void compute_gg_diagram(vehicle_t& car, double* ay, double* ax_max, double* ax_m
 }
 
 
-void gg_diagram(double* ay, double* ax_max, double* ax_min, struct c_Vehicle* c_vehicle, double v, const int n_points)
+void gg_diagram(struct fastestlap_context* context, double* ay, double* ax_max, double* ax_min, struct c_Vehicle* c_vehicle, double v, const int n_points)
 {
-    if ( c_vehicle->type == LOT2016KART )
-        compute_gg_diagram(vehicles_lot2016kart.at(c_vehicle->name).cartesian_ad, ay, ax_max, ax_min, v, n_points);
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        if ( c_vehicle->type == LOT2016KART )
+            compute_gg_diagram(context.vehicles_lot2016kart.at(c_vehicle->name).cartesian_ad, ay, ax_max, ax_min, v, n_points);
 
-    else if ( c_vehicle->type == LIMEBEER2014F1 )
-        compute_gg_diagram(vehicles_limebeer2014f1.at(c_vehicle->name).cartesian_ad, ay, ax_max, ax_min, v, n_points);
+        else if ( c_vehicle->type == LIMEBEER2014F1 )
+            compute_gg_diagram(context.vehicles_limebeer2014f1.at(c_vehicle->name).cartesian_ad, ay, ax_max, ax_min, v, n_points);
+    });
 }
 
 
-void track_coordinates(double* x_center, double* y_center, double* x_left, double* y_left, double* x_right, double* y_right, double* theta, struct c_Track* c_track, const int n_points)
+void track_coordinates(struct fastestlap_context* context, double* x_center, double* y_center, double* x_left, double* y_left, double* x_right, double* y_right, double* theta, struct c_Track* c_track, const int n_points)
 {
-    std::string name = c_track->name;
-    auto& track = table_track.at(name);
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        std::string name = c_track->name;
+        const auto& track = *context.table_track.at(name);
 
-    const scalar& L = track.get_total_length();
-    const scalar ds = L/((scalar)(n_points-1));
+        const scalar& L = track.get_total_length();
+        const scalar ds = L/((scalar)(n_points-1));
+
+        // The samples are monotone: the cursor reuses the segment of the previous one
+        Track_by_polynomial::Cursor cursor(track);
     
-    for (int i = 0; i < n_points; ++i)
-    {
-        const scalar s = ((double)i)*ds;
+        for (int i = 0; i < n_points; ++i)
+        {
+            const scalar s = ((double)i)*ds;
 
-        // Compute centerline
-        auto [r_c,v_c,a_c] = track(s);
+            // Compute centerline, its derivatives, and the track limits
+            const auto geometry = cursor(s);
+            const auto& r_c = geometry.r;
+            const auto& v_c = geometry.dr;
 
-        x_center[i] = r_c[0];
-        y_center[i] = r_c[1];
+            x_center[i] = r_c[0];
+            y_center[i] = r_c[1];
 
-        // Heading angle (theta)
-        theta[i] = atan2(v_c[1],v_c[0]);
+            // Heading angle (theta)
+            theta[i] = atan2(v_c[1],v_c[0]);
 
-        // Compute left boundary
-        auto [r_l] = track.position_at(s,track.get_right_track_limit(s));
+            // Normal, as in Track_by_polynomial::position_at
+            const sVector3d normal = sVector3d(-v_c[1],v_c[0],0.0)/norm(v_c);
 
-        x_left[i] = r_l[0];
-        y_left[i] = r_l[1];
+            // Compute left boundary
+            const sVector3d r_l = r_c + geometry.wr*normal;
 
-        // Compute right boundary
-        auto [r_r] = track.position_at(s,-track.get_left_track_limit(s));
+            x_left[i] = r_l[0];
+            y_left[i] = r_l[1];
 
-        x_right[i] = r_r[0];
-        y_right[i] = r_r[1];
-    }
+            // Compute right boundary
+            const sVector3d r_r = r_c - geometry.wl*normal;
+
+            x_right[i] = r_r[0];
+            y_right[i] = r_r[1];
+        }
     
-    return;
+        return;
+    });
 }
 
 
+//! An optimal laptime: a copy of its inputs, taken from the locked context, and its results. It owns a copy of the 
+//! vehicle, so that it is solved without the context lock
 template<typename vehicle_t>
-void compute_optimal_laptime(vehicle_t& vehicle, Track_by_polynomial& track, struct c_Vehicle* c_vehicle, const int n_points, const double* s, const char* options)
+struct Optimal_laptime_run
 {
-    // (1) Process options
+    using vehicle_ad_curvilinear = typename vehicle_t::vehicle_ad_curvilinear;
+
+    Optimal_laptime_run(const vehicle_t& vehicle_, const std::shared_ptr<const Track_by_polynomial>& track_, const int vehicle_type_)
+    : vehicle(vehicle_), track(track_), vehicle_type(vehicle_type_) {}
+
+    // Inputs
+    vehicle_t vehicle;
+    std::shared_ptr<const Track_by_polynomial> track;
+    int vehicle_type;
+    std::vector<scalar> arclength;
+
     bool warm_start                   = false;
     bool save_warm_start              = false;
+    std::string warm_start_file;
+    std::string save_warm_start_file;
+    bool compress_warm_start          = false;
     bool write_xml                    = false;
     std::string xml_file_name;
     size_t print_level                = 0;
@@ -692,18 +1066,37 @@ void compute_optimal_laptime(vehicle_t& vehicle, Track_by_polynomial& track, str
     std::array<scalar,2> dissipations = {1.0e-2, 200*200*1.0e-10};
     bool set_initial_condition        = false;
     scalar sigma                      = 0.5;
-    std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NSTATE>     q_start;
-    std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NALGEBRAIC> qa_start;
-    std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NCONTROL>   u_start;
+    std::array<scalar,vehicle_ad_curvilinear::NSTATE>     q_start;
+    std::array<scalar,vehicle_ad_curvilinear::NALGEBRAIC> qa_start;
+    std::array<scalar,vehicle_ad_curvilinear::NCONTROL>   u_start;
 
     std::string save_variables_prefix;
     std::vector<std::string> variables_to_save;
+    std::vector<std::string> vector_variables;
+
+    decltype(fastestlap_context::warm_start_variables) warm_start_variables;    //! Copy of the warm start of the context
+
+    // Results
+    Optimal_laptime<vehicle_ad_curvilinear> opt_laptime;
+    std::vector<std::vector<scalar>> columns;   //! Values of vector_variables
+};
+
+
+//! Copy the inputs of an optimal laptime from the locked context
+template<typename vehicle_t>
+static Optimal_laptime_run<vehicle_t> prepare_optimal_laptime(const fastestlap_context& context, const vehicle_t& vehicle, const int vehicle_type, 
+    const std::string& track_name, const int n_points, const double* s, const char* options)
+{
+    Optimal_laptime_run<vehicle_t> run(vehicle, context.table_track.at(track_name), vehicle_type);
+
+    run.arclength = std::vector<scalar>(s,s+n_points);
 
-    if ( c_vehicle->type == LIMEBEER2014F1 )
+    // (1) Process options
+    if ( vehicle_type == LIMEBEER2014F1 )
     {
-        is_direct = true;
-        dissipations[0] = 5.0;
-        dissipations[1] = 8.0e-4;
+        run.is_direct = true;
+        run.dissipations[0] = 5.0;
+        run.dissipations[1] = 8.0e-4;
     }
     
     if ( strlen(options) > 0 )
@@ -713,6 +1106,9 @@ void compute_optimal_laptime(vehicle_t& vehicle, Track_by_polynomial& track, str
         //      <options>
         //          <warm_start> false </warm_start>
         //          <save_warm_start> true </save_warm_start>
+        //          <warm_start_file> run.flcol </warm_start_file>          (optional, warm start from a file instead of the context)
+        //          <save_warm_start_file> run.flcol </save_warm_start_file> (optional, save the results as warm start file)
+        //          <compress_warm_start> false </compress_warm_start>
         //          <write_xml> true </write_xml>
         //          <xml_file_name> run.xml </xml_file_name>
         //          <print_level> 5 </print_level>
@@ -739,339 +1135,498 @@ void compute_optimal_laptime(vehicle_t& vehicle, Track_by_polynomial& track, str
         doc.parse(s_options);
 
         // Use warm start
-        if ( doc.has_element("options/warm_start") ) warm_start = doc.get_element("options/warm_start").get_value(bool());
+        if ( doc.has_element("options/warm_start") ) run.warm_start = doc.get_element("options/warm_start").get_value(bool());
 
         // Save new warm start data
-        if ( doc.has_element("options/save_warm_start") ) save_warm_start = doc.get_element("options/save_warm_start").get_value(bool());
+        if ( doc.has_element("options/save_warm_start") ) run.save_warm_start = doc.get_element("options/save_warm_start").get_value(bool());
+
+        // Warm start files
+        if ( doc.has_element("options/warm_start_file") )
+        {
+            run.warm_start_file = doc.get_element("options/warm_start_file").get_value();
+            run.warm_start = true;
+        }
+
+        if ( doc.has_element("options/save_warm_start_file") ) run.save_warm_start_file = doc.get_element("options/save_warm_start_file").get_value();
+
+        if ( doc.has_element("options/compress_warm_start") ) run.compress_warm_start = doc.get_element("options/compress_warm_start").get_value(bool());
 
         // Write xml file
-        if ( doc.has_element("options/write_xml") ) write_xml = doc.get_element("options/write_xml").get_value(bool());
+        if ( doc.has_element("options/write_xml") ) run.write_xml = doc.get_element("options/write_xml").get_value(bool());
 
         // XML file name
-        if ( write_xml )
-            xml_file_name = doc.get_element("options/xml_file_name").get_value();
+        if ( run.write_xml )
+            run.xml_file_name = doc.get_element("options/xml_file_name").get_value();
 
         // Print level
-        if ( doc.has_element("options/print_level") ) print_level = doc.get_element("options/print_level").get_value(int());
+        if ( doc.has_element("options/print_level") ) run.print_level = doc.get_element("options/print_level").get_value(int());
 
         // Output variables
         if ( doc.has_element("options/save_variables") )
         {
-            save_variables_prefix = doc.get_element("options/save_variables/prefix").get_value();
+            run.save_variables_prefix = doc.get_element("options/save_variables/prefix").get_value();
 
             auto variables_node = doc.get_element("options/save_variables/variables");
 
             for (auto& variable : variables_node.get_children())
-                variables_to_save.push_back(variable.get_name());
+                run.variables_to_save.push_back(variable.get_name());
         }
 
-        if ( doc.has_element("options/initial_speed") ) initial_speed = doc.get_element("options/initial_speed").get_value(scalar());
+        if ( doc.has_element("options/initial_speed") ) run.initial_speed = doc.get_element("options/initial_speed").get_value(scalar());
     
-        if ( doc.has_element("options/closed_simulation") ) is_closed = doc.get_element("options/closed_simulation").get_value(bool());
+        if ( doc.has_element("options/closed_simulation") ) run.is_closed = doc.get_element("options/closed_simulation").get_value(bool());
 
         if ( doc.has_element("options/initial_condition") )
         {
-            set_initial_condition = true;
-            auto v_q_start  = table_vector.at(doc.get_element("options/initial_condition/q").get_attribute("from_table"));
-            auto v_qa_start = table_vector.at(doc.get_element("options/initial_condition/qa").get_attribute("from_table"));
-            auto v_u_start  = table_vector.at(doc.get_element("options/initial_condition/u").get_attribute("from_table"));
-
-            std::copy(v_q_start.cbegin() , v_q_start.cend() , q_start.begin());
-            std::copy(v_qa_start.cbegin(), v_qa_start.cend(), qa_start.begin());
-            std::copy(v_u_start.cbegin() , v_u_start.cend() , u_start.begin());
+            run.set_initial_condition = true;
+            const auto& v_q_start  = *context.table_vector.at(doc.get_element("options/initial_condition/q").get_attribute("from_table"));
+            const auto& v_qa_start = *context.table_vector.at(doc.get_element("options/initial_condition/qa").get_attribute("from_table"));
+            const auto& v_u_start  = *context.table_vector.at(doc.get_element("options/initial_condition/u").get_attribute("from_table"));
+
+            std::copy(v_q_start.cbegin() , v_q_start.cend() , run.q_start.begin());
+            std::copy(v_qa_start.cbegin(), v_qa_start.cend(), run.qa_start.begin());
+            std::copy(v_u_start.cbegin() , v_u_start.cend() , run.u_start.begin());
         }
 
-        if ( doc.has_element("options/sigma") ) sigma = doc.get_element("options/sigma").get_value(scalar());
+        if ( doc.has_element("options/sigma") ) run.sigma = doc.get_element("options/sigma").get_value(scalar());
     }
-    
-    // (2) Get aliases to cars
-    auto& car_curv = vehicle.get_curvilinear_ad_car();
-    auto& car_curv_sc = vehicle.get_curvilinear_scalar_car();
 
-    auto& car_cart = vehicle.cartesian_ad;
-    auto& car_cart_sc = vehicle.cartesian_scalar;
+    // (2) Vector variables are computed all together after the solve
+    for (const auto& variable_name : run.variables_to_save)
+    {
+        if ( variable_name != "laptime" )
+            run.vector_variables.push_back(variable_name);
+    }
+
+    // (3) Copy the warm start of the context
+    if ( run.warm_start && run.warm_start_file.empty() )
+        run.warm_start_variables = context.warm_start_variables;
+
+    return run;
+}
+
+
+//! Solve an optimal laptime. It does not use the context
+template<typename vehicle_t>
+static void solve_optimal_laptime(Optimal_laptime_run<vehicle_t>& run, Ipopt_progress* progress)
+{
+    using vehicle_ad_curvilinear = typename vehicle_t::vehicle_ad_curvilinear;
+
+    // (1) Get aliases to cars
+    auto& car_curv = run.vehicle.get_curvilinear_ad_car();
+    auto& car_curv_sc = run.vehicle.get_curvilinear_scalar_car();
+
+    auto& car_cart = run.vehicle.cartesian_ad;
+    auto& car_cart_sc = run.vehicle.cartesian_scalar;
 
-    // (3) Set the track into the curvilinear car dynamic model
-    car_curv.get_road().change_track(track);
-    car_curv_sc.get_road().change_track(track);
+    // (2) Set the track into the curvilinear car dynamic model
+    bind_track(car_curv, *run.track);
+    bind_track(car_curv_sc, *run.track);
 
-    // (4) Start from the steady-state values at 0g    
-    scalar v = initial_speed*KMH;
+    // (3) Start from the steady-state values at 0g    
+    scalar v = run.initial_speed*KMH;
 
     auto ss = Steady_state(car_cart).solve(v,0.0,0.0); 
 
-    if ( c_vehicle->type == LOT2016KART )
+    if ( run.vehicle_type == LOT2016KART )
         ss.u[1] = 0.0;
 
     std::tie(ss.dqdt, std::ignore) = car_cart_sc(ss.q, ss.qa, ss.u, 0.0);
 
-    // (5) Compute optimal laptime
+    // (4) Compute optimal laptime
+    const size_t n_points = run.arclength.size();
+    auto& opt_laptime = run.opt_laptime;
+    typename Optimal_laptime<vehicle_ad_curvilinear>::Options opts;
+    opts.print_level = run.print_level;
+    opts.sigma       = run.sigma;
+    opts.progress    = progress;
 
-    // (5.1) Get arclength
-    std::vector<scalar> arclength(s,s+n_points);
-    Optimal_laptime<typename vehicle_t::vehicle_ad_curvilinear> opt_laptime;
-    typename Optimal_laptime<typename vehicle_t::vehicle_ad_curvilinear>::Options opts;
-    opts.print_level = print_level;
-    opts.sigma       = sigma;
-
-    // (5.2.a) Start from steady-state
-    if ( !warm_start )
+    // (4.a) Start from steady-state
+    if ( !run.warm_start )
     {
-        std::vector<std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NSTATE>> q0  = {static_cast<size_t>(n_points),ss.q};
-        std::vector<std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NALGEBRAIC>> qa0 = {static_cast<size_t>(n_points),ss.qa};
-        std::vector<std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NCONTROL>> u0  = {static_cast<size_t>(n_points),ss.u};
+        std::vector<std::array<scalar,vehicle_ad_curvilinear::NSTATE>> q0  = {n_points,ss.q};
+        std::vector<std::array<scalar,vehicle_ad_curvilinear::NALGEBRAIC>> qa0 = {n_points,ss.qa};
+        std::vector<std::array<scalar,vehicle_ad_curvilinear::NCONTROL>> u0  = {n_points,ss.u};
 
-        if ( set_initial_condition )
+        if ( run.set_initial_condition )
         {
-            q0.front()  = q_start;
-            qa0.front() = qa_start;
-            u0.front()  = u_start;
+            q0.front()  = run.q_start;
+            qa0.front() = run.qa_start;
+            u0.front()  = run.u_start;
         }
 
-        opt_laptime = Optimal_laptime(arclength, is_closed, is_direct, car_curv, q0, qa0, u0, dissipations, opts);
+        opt_laptime = Optimal_laptime(run.arclength, run.is_closed, run.is_direct, car_curv, q0, qa0, u0, run.dissipations, opts);
+    }
+    // (4.b) Warm start from a file, written by a previous run
+    else if ( !run.warm_start_file.empty() )
+    {
+        const Optimal_laptime<vehicle_ad_curvilinear> saved(Columnar_file{run.warm_start_file});
+
+        opt_laptime = Optimal_laptime(saved.s, run.is_closed, run.is_direct, car_curv, saved.q, saved.qa, saved.u, run.dissipations, saved.optimization_data.zl, 
+                        saved.optimization_data.zu, saved.optimization_data.lambda, opts);
     }
-    // (5.2.b) Warm start
+    // (4.c) Warm start from the context
     else
     {
-        std::vector<std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NSTATE>> q;
-        std::vector<std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NALGEBRAIC>> qa;
-        std::vector<std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NCONTROL>> u;
+        const auto& warm_start_variables = run.warm_start_variables;
+        std::vector<std::array<scalar,vehicle_ad_curvilinear::NSTATE>> q;
+        std::vector<std::array<scalar,vehicle_ad_curvilinear::NALGEBRAIC>> qa;
+        std::vector<std::array<scalar,vehicle_ad_curvilinear::NCONTROL>> u;
         
         for (const auto& q_vector : warm_start_variables.q)
         {
-            std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NSTATE> q_arr;
-            std::copy_n(q_vector.cbegin(), vehicle_t::vehicle_ad_curvilinear::NSTATE, q_arr.begin());
+            std::array<scalar,vehicle_ad_curvilinear::NSTATE> q_arr;
+            std::copy_n(q_vector.cbegin(), vehicle_ad_curvilinear::NSTATE, q_arr.begin());
             q.push_back(q_arr);
         }
 
         for (const auto& qa_vector : warm_start_variables.qa)
         {
-            std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NALGEBRAIC> qa_arr;
-            std::copy_n(qa_vector.cbegin(), vehicle_t::vehicle_ad_curvilinear::NALGEBRAIC, qa_arr.begin());
+            std::array<scalar,vehicle_ad_curvilinear::NALGEBRAIC> qa_arr;
+            std::copy_n(qa_vector.cbegin(), vehicle_ad_curvilinear::NALGEBRAIC, qa_arr.begin());
             qa.push_back(qa_arr);
         }
 
         for (const auto& u_vector : warm_start_variables.u)
         {
-            std::array<scalar,vehicle_t::vehicle_ad_curvilinear::NCONTROL> u_arr;
-            std::copy_n(u_vector.cbegin(), vehicle_t::vehicle_ad_curvilinear::NCONTROL, u_arr.begin());
+            std::array<scalar,vehicle_ad_curvilinear::NCONTROL> u_arr;
+            std::copy_n(u_vector.cbegin(), vehicle_ad_curvilinear::NCONTROL, u_arr.begin());
             u.push_back(u_arr);
         }
 
-        opt_laptime = Optimal_laptime(warm_start_variables.s, is_closed, is_direct, car_curv, q, qa, u, dissipations, warm_start_variables.zl, 
+        opt_laptime = Optimal_laptime(warm_start_variables.s, run.is_closed, run.is_direct, car_curv, q, qa, u, run.dissipations, warm_start_variables.zl, 
                         warm_start_variables.zu, warm_start_variables.lambda, opts);
     }
 
-    // (6) Save results -----------------------------------------------------------------------
+    // (5) Save the files
+    if ( run.write_xml )
+        opt_laptime.xml()->save(run.xml_file_name);
 
-    // (6.1) Save xml file
-    if ( write_xml )
-        opt_laptime.xml()->save(xml_file_name);
+    if ( !run.save_warm_start_file.empty() )
+        opt_laptime.save(run.save_warm_start_file, run.compress_warm_start ? Columnar_file::XOR_RLE : Columnar_file::NONE);
 
-    // (6.2) Save outputs
-    for (const auto& variable_name : variables_to_save)
+    // (6) Evaluate the vehicle once per point to compute all the vector variables
+    Vehicle_channels<typename vehicle_t::vehicle_scalar_curvilinear> channels(run.vector_variables);
+    run.columns = channels.compute(car_curv_sc, opt_laptime.s, opt_laptime.q, opt_laptime.qa, opt_laptime.u);
+}
+
+
+//! Save the results of an optimal laptime into the locked context
+template<typename vehicle_t>
+static void publish_optimal_laptime(fastestlap_context& context, std::unordered_map<std::string,vehicle_t>& vehicles, const std::string& vehicle_name, 
+    Optimal_laptime_run<vehicle_t>& run)
+{
+    const auto& opt_laptime = run.opt_laptime;
+
+    // (1) Save outputs
+    for (const auto& variable_name : run.variables_to_save)
     {
         // Check if the variable_name exists in any of the tables
-        if ( table_scalar.count(save_variables_prefix + variable_name) != 0 )
-            throw std::runtime_error(std::string("Variable \"") + save_variables_prefix + variable_name + "\" already exists in the scalar table");
+        if ( context.table_scalar.count(run.save_variables_prefix + variable_name) != 0 )
+            throw std::runtime_error(std::string("Variable \"") + run.save_variables_prefix + variable_name + "\" already exists in the scalar table");
 
-        if ( table_vector.count(save_variables_prefix + variable_name) != 0 )
-            throw std::runtime_error(std::string("Variable \"") + save_variables_prefix + variable_name + "\" already exists in the vector table");
-
-        bool is_vector = true;
+        if ( context.table_vector.count(run.save_variables_prefix + variable_name) != 0 )
+            throw std::runtime_error(std::string("Variable \"") + run.save_variables_prefix + variable_name + "\" already exists in the vector table");
 
         // Scalar variables
         if ( variable_name == "laptime" )
+            context.table_scalar.insert({run.save_variables_prefix+variable_name, opt_laptime.laptime});
+    }
+
+    for (size_t j = 0; j < run.vector_variables.size(); ++j)
+        context.table_vector.insert({run.save_variables_prefix + run.vector_variables[j], std::make_shared<const std::vector<scalar>>(std::move(run.columns[j]))});
+
+    // (2) Save warm start for next runs
+    if (run.save_warm_start)
+    {
+        context.warm_start_variables.s  = opt_laptime.s;
+        context.warm_start_variables.zl = opt_laptime.optimization_data.zl;
+        context.warm_start_variables.zu = opt_laptime.optimization_data.zu;
+        context.warm_start_variables.lambda = opt_laptime.optimization_data.lambda;
+
+        context.warm_start_variables.q.clear();
+        context.warm_start_variables.qa.clear();
+        context.warm_start_variables.u.clear();
+
+        for (size_t i = 0; i < opt_laptime.q.size(); ++i)
         {
-            table_scalar.insert({save_variables_prefix+variable_name, opt_laptime.laptime});
-            is_vector = false;
+            std::vector<double> q(opt_laptime.q[i].cbegin(), opt_laptime.q[i].cend());
+            std::vector<double> qa(opt_laptime.qa[i].cbegin(), opt_laptime.qa[i].cend());
+            std::vector<double> u(opt_laptime.u[i].cbegin(), opt_laptime.u[i].cend());
+
+            context.warm_start_variables.q.push_back(q);
+            context.warm_start_variables.qa.push_back(qa);
+            context.warm_start_variables.u.push_back(u);
         }
+    }
 
-        // Vector variables
-        if ( is_vector ) 
-        {
-            std::vector<scalar> data(n_points);
-            for (int i = 0; i < n_points; ++i)
-            {
-                car_curv_sc(opt_laptime.q[i], opt_laptime.qa[i], opt_laptime.u[i], s[i]);
-    
-                if ( variable_name == "x" ) 
-                    data[i] = car_curv_sc.get_road().get_x();
-        
-                else if ( variable_name == "y" )
-                    data[i] = car_curv_sc.get_road().get_y();
-    
-                else if ( variable_name == "s" )
-                    data[i] = s[i];
+    // (3) The vehicle of the context keeps the track bound, for the calls that follow. It may have been deleted meanwhile
+    auto vehicle = vehicles.find(vehicle_name);
 
-                else if ( variable_name == "n" )
-                    data[i] = opt_laptime.q[i][vehicle_t::vehicle_scalar_curvilinear::Road_type::IN];
-    
-                else if ( variable_name == "alpha" )
-                    data[i] = opt_laptime.q[i][vehicle_t::vehicle_scalar_curvilinear::Road_type::IALPHA];
-    
-                else if ( variable_name == "u" )
-                    data[i] = opt_laptime.q[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IU];
-    
-                else if ( variable_name == "v" )
-                    data[i] = opt_laptime.q[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IV];
-    
-                else if ( variable_name == "time" )
-                    data[i] = opt_laptime.q[i][vehicle_t::vehicle_scalar_curvilinear::Road_type::ITIME];
-    
-                else if ( variable_name == "delta" )
-                    data[i] = opt_laptime.u[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::Front_axle_type::ISTEERING];
-    
-                else if ( variable_name == "psi" )
-                    data[i] = car_curv_sc.get_road().get_psi();
-    
-                else if ( variable_name == "omega" )
-                    data[i] = opt_laptime.q[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IOMEGA];
-    
-                else if ( variable_name == "throttle" )
-                {
-                    if constexpr (std::is_same<vehicle_t, lot2016kart_all>::value)
-                    {
-                        data[i] = opt_laptime.u[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::Rear_axle_type::ITORQUE];
-                    }
-    
-                    else if constexpr (std::is_same<vehicle_t, limebeer2014f1_all>::value)
-                    {
-                        data[i] = opt_laptime.u[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::ITHROTTLE];
-                    }
-                }
-                else if ( variable_name == "rear_axle.left_tire.x" )
-                    data[i] = car_curv_sc.get_chassis().get_rear_axle().template get_tire<0>().get_position().at(0);
-    
-                else if ( variable_name == "rear_axle.left_tire.y" )
-                    data[i] = car_curv_sc.get_chassis().get_rear_axle().template get_tire<0>().get_position().at(1);
-    
-                else if ( variable_name == "rear_axle.right_tire.x" )
-                    data[i] = car_curv_sc.get_chassis().get_rear_axle().template get_tire<1>().get_position().at(0);
-    
-                else if ( variable_name == "rear_axle.right_tire.y" )
-                    data[i] = car_curv_sc.get_chassis().get_rear_axle().template get_tire<1>().get_position().at(1);
-    
-                else if ( variable_name == "front_axle.left_tire.x" )
-                    data[i] = car_curv_sc.get_chassis().get_front_axle().template get_tire<0>().get_position().at(0);
-    
-                else if ( variable_name == "front_axle.left_tire.y" )
-                    data[i] = car_curv_sc.get_chassis().get_front_axle().template get_tire<0>().get_position().at(1);
-    
-                else if ( variable_name == "front_axle.right_tire.x" )
-                    data[i] = car_curv_sc.get_chassis().get_front_axle().template get_tire<1>().get_position().at(0);
-    
-                else if ( variable_name == "front_axle.right_tire.y" )
-                    data[i] = car_curv_sc.get_chassis().get_front_axle().template get_tire<1>().get_position().at(1);
+    if ( vehicle != vehicles.end() )
+    {
+        bind_track(vehicle->second.get_curvilinear_ad_car(), *run.track);
+        bind_track(vehicle->second.get_curvilinear_scalar_car(), *run.track);
+    }
+}
 
-                else if ( variable_name == "front_axle.left_tire.kappa" )
-                    data[i] = car_curv_sc.get_chassis().get_front_axle().template get_tire<0>().get_kappa();
-    
-                else if ( variable_name == "front_axle.right_tire.kappa" )
-                    data[i] = car_curv_sc.get_chassis().get_front_axle().template get_tire<1>().get_kappa();
-    
-                else if ( variable_name == "rear_axle.left_tire.kappa" )
-                    data[i] = car_curv_sc.get_chassis().get_rear_axle().template get_tire<0>().get_kappa();
-    
-                else if ( variable_name == "rear_axle.right_tire.kappa" )
-                    data[i] = car_curv_sc.get_chassis().get_rear_axle().template get_tire<1>().get_kappa();
-    
-                else if ( variable_name == "Fz_fl" )
-                {
-                    if constexpr (std::is_same<vehicle_t, limebeer2014f1_all>::value)
-                    {
-                        data[i] = opt_laptime.qa[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZFL];
-                    }
-                    else 
-                    {
-                        throw std::runtime_error("Fz_fl is only defined for limebeer2014f1 models");
-                    }
-                }
-    
-                else if ( variable_name == "Fz_fr" )
-                {
-                    if constexpr (std::is_same<vehicle_t, limebeer2014f1_all>::value)
-                    {
-                        data[i] = opt_laptime.qa[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZFR];
-                    }
-                    else 
-                    {
-                        throw std::runtime_error("Fz_fr is only defined for limebeer2014f1 models");
-                    }
-                }
-    
-                else if ( variable_name == "Fz_rl" )
-                {
-                    if constexpr (std::is_same<vehicle_t, limebeer2014f1_all>::value)
-                    {
-                        data[i] = opt_laptime.qa[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZRL];
-                    }
-                    else 
-                    {
-                        throw std::runtime_error("Fz_rl is only defined for limebeer2014f1 models");
-                    }
-                }
-    
-                else if ( variable_name == "Fz_rr" )
-                {
-                    if constexpr (std::is_same<vehicle_t, limebeer2014f1_all>::value)
-                    {
-                        data[i] = opt_laptime.qa[i][vehicle_t::vehicle_scalar_curvilinear::Chassis_type::IFZRR];
-                    }
-                    else 
-                    {
-                        throw std::runtime_error("Fz_rr is only defined for limebeer2014f1 models");
-                    }
-                }
 
-                else
-                {
-                    throw std::runtime_error("Variable \"" + variable_name + "\" is not defined");
-                }
-    
-            }
-    
-            // Insert in the vector table
-            table_vector.insert({save_variables_prefix + variable_name, data});
-        }
+//! Run an optimal laptime. The context is locked to copy the inputs and to publish the results, but not during the
+//! solve, so that other calls on the context are not blocked by it
+template<typename vehicle_t>
+static void run_optimal_laptime(struct fastestlap_context* context, std::unordered_map<std::string,vehicle_t> fastestlap_context::* vehicles, 
+    const std::string& vehicle_name, const int vehicle_type, const std::string& track_name, const int n_points, const double* s, const char* options,
+    Ipopt_progress* progress)
+{
+    // The copy of the vehicle is created, used and destroyed under a thread number of the calling thread, instead of
+    // the one of the context, which is only used with the context locked
+    Thread_pool::Caller_registration registration;
+
+    // (1) Copy the inputs
+    auto run = [&]()
+    {
+        std::lock_guard<std::mutex> lock(context->mutex);
+        return prepare_optimal_laptime(*context, (context->*vehicles).at(vehicle_name), vehicle_type, track_name, n_points, s, options);
+    }();
+
+    // (2) Solve
+    solve_optimal_laptime(run, progress);
+
+    // (3) Publish the results
+    run_in_context(context, [&](fastestlap_context& context)
+    {
+        publish_optimal_laptime(context, context.*vehicles, vehicle_name, run);
+    });
+}
+
+
+//! Run an optimal laptime of a vehicle of any type
+static void run_optimal_laptime(struct fastestlap_context* context, const std::string& vehicle_name, const int vehicle_type, const std::string& track_name, 
+    const int n_points, const double* s, const char* options, Ipopt_progress* progress)
+{
+    if ( context == nullptr )
+        throw std::runtime_error("The fastestlap context is null");
+
+    if ( vehicle_type == LOT2016KART )
+    {
+        run_optimal_laptime(context, &fastestlap_context::vehicles_lot2016kart, vehicle_name, vehicle_type, track_name, n_points, s, options, progress);
+    }
+    else if ( vehicle_type == LIMEBEER2014F1 )
+    {
+        run_optimal_laptime(context, &fastestlap_context::vehicles_limebeer2014f1, vehicle_name, vehicle_type, track_name, n_points, s, options, progress);
+    }
+}
+
+
+void optimal_laptime(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const struct c_Track* c_track, const int n_points, const double* s, const char* options) 
+{
+    run_optimal_laptime(context, c_vehicle->name, c_vehicle->type, c_track->name, n_points, s, options, nullptr);
+}
+
+
+//! Runs the optimal laptime jobs of all the contexts on a fixed number of threads, in submission order
+class Job_executor
+{
+ public:
+
+    //! Two threads: one solving, and one preparing the next job. More would only wait, since the IPOPT solves 
+    //! run one at a time (see Ipopt_solver_lock)
+    static constexpr size_t n_threads = 2;
+
+    //! Get the executor, constructed on the first call
+    static Job_executor& get() { static Job_executor executor; return executor; }
+
+    //! Queue a task
+    std::future<void> submit(std::function<void()> f);
+
+    //! Drop the queued tasks, whose futures get a broken promise, and wait for the running ones
+    ~Job_executor();
+
+ private:
+
+    Job_executor();
+
+    //! Run the queued tasks until stopped
+    void work();
+
+    std::vector<std::thread> _threads;            //! The threads
+    std::deque<std::packaged_task<void()>> _tasks;  //! Queue of pending tasks
+    std::mutex _mutex;                            //! Protects _tasks and _stop
+    std::condition_variable _condition;           //! Signals new tasks or stop
+    bool _stop = false;                           //! Set by the destructor
+};
+
+
+Job_executor::Job_executor()
+{
+    // Construct the pool first, so that it outlives the executor
+    Thread_pool::get();
+
+    for (size_t i = 0; i < n_threads; ++i)
+        _threads.emplace_back(&Job_executor::work, this);
+}
+
+
+Job_executor::~Job_executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _tasks.clear();
     }
 
-    // (6.3) Save warm start for next runs
-    if (save_warm_start)
+    _condition.notify_all();
+
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+
+std::future<void> Job_executor::submit(std::function<void()> f)
+{
+    std::packaged_task<void()> task(std::move(f));
+    auto result = task.get_future();
+
     {
-        warm_start_variables.s  = opt_laptime.s;
-        warm_start_variables.zl = opt_laptime.optimization_data.zl;
-        warm_start_variables.zu = opt_laptime.optimization_data.zu;
-        warm_start_variables.lambda = opt_laptime.optimization_data.lambda;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
 
-        warm_start_variables.q.clear();
-        warm_start_variables.qa.clear();
-        warm_start_variables.u.clear();
+    _condition.notify_one();
+
+    return result;
+}
+
+
+void Job_executor::work()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
 
-        for (size_t i = 0; i < opt_laptime.q.size(); ++i)
         {
-            std::vector<double> q(opt_laptime.q[i].cbegin(), opt_laptime.q[i].cend());
-            std::vector<double> qa(opt_laptime.qa[i].cbegin(), opt_laptime.qa[i].cend());
-            std::vector<double> u(opt_laptime.u[i].cbegin(), opt_laptime.u[i].cend());
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _stop || !_tasks.empty(); });
 
-            warm_start_variables.q.push_back(q);
-            warm_start_variables.qa.push_back(qa);
-            warm_start_variables.u.push_back(u);
+            if ( _stop )
+                return;
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
         }
+
+        task();
     }
 }
 
 
-void optimal_laptime(struct c_Vehicle* c_vehicle, const struct c_Track* c_track, const int n_points, const double* s, const char* options) 
+int submit_optimal_laptime(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const struct c_Track* c_track, const int n_points, const double* s, const char* options)
 {
-    if ( c_vehicle->type == LOT2016KART )
+    if ( context == nullptr )
+        throw std::runtime_error("The fastestlap context is null");
+
+    // (1) Copy the inputs, the caller may release them before the job runs
+    auto job = std::make_shared<Optimal_laptime_job>();
+
+    const std::string vehicle_name(c_vehicle->name);
+    const int vehicle_type = c_vehicle->type;
+    const std::string track_name(c_track->name);
+    const std::vector<double> arclength(s, s + n_points);
+    const std::string s_options(options);
+
+    // (2) Register the job
+    int job_id;
     {
-        compute_optimal_laptime(vehicles_lot2016kart.at(c_vehicle->name), table_track.at(c_track->name), 
-                                c_vehicle, n_points, s, options);
+        std::lock_guard<std::mutex> lock(context->jobs_mutex);
+        job_id = context->next_job_id++;
+        context->jobs.insert({job_id, job});
     }
-    else if ( c_vehicle->type == LIMEBEER2014F1 )
+
+    // (3) Queue it in the executor, so that long solves do not hold the pool workers from other calls
+    job->result = Job_executor::get().submit([=]()
+    {
+        if ( job->progress.cancel_requested )
+        {
+            job->state = JOB_CANCELLED;
+            return;
+        }
+
+        try
+        {
+            job->state = JOB_RUNNING;
+
+            run_optimal_laptime(context, vehicle_name, vehicle_type, track_name, n_points, arclength.data(), s_options.c_str(), &job->progress);
+
+            job->state = (job->progress.cancel_requested ? JOB_CANCELLED : JOB_SUCCEEDED);
+        }
+        catch (...)
+        {
+            // A cancelled solve ends with an exception, which is not an error
+            if ( job->progress.cancel_requested )
+            {
+                job->state = JOB_CANCELLED;
+                return;
+            }
+
+            job->state = JOB_FAILED;
+            throw;
+        }
+    });
+
+    return job_id;
+}
+
+
+//! Get a job of the context
+static std::shared_ptr<Optimal_laptime_job> get_job(struct fastestlap_context* context, const int job_id)
+{
+    if ( context == nullptr )
+        throw std::runtime_error("The fastestlap context is null");
+
+    std::lock_guard<std::mutex> lock(context->jobs_mutex);
+
+    const auto job = context->jobs.find(job_id);
+
+    if ( job == context->jobs.end() )
+        throw std::runtime_error("Job " + std::to_string(job_id) + " does not exist");
+
+    return job->second;
+}
+
+
+void poll_job(struct fastestlap_context* context, struct c_Job_status* status, const int job_id)
+{
+    const auto job = get_job(context, job_id);
+
+    status->state                = job->state;
+    status->iteration            = job->progress.iteration;
+    status->objective            = job->progress.objective;
+    status->primal_infeasibility = job->progress.primal_infeasibility;
+    status->dual_infeasibility   = job->progress.dual_infeasibility;
+    status->solver_status        = job->progress.status;
+}
+
+
+void cancel_job(struct fastestlap_context* context, const int job_id)
+{
+    get_job(context, job_id)->progress.cancel_requested = true;
+}
+
+
+int wait_job(struct fastestlap_context* context, const int job_id)
+{
+    const auto job = get_job(context, job_id);
+
+    job->result.wait();
+
+    // The job is removed once finished
     {
-        compute_optimal_laptime(vehicles_limebeer2014f1.at(c_vehicle->name), table_track.at(c_track->name), 
-                                c_vehicle, n_points, s, options);
+        std::lock_guard<std::mutex> lock(context->jobs_mutex);
+        context->jobs.erase(job_id);
     }
+
+    // Rethrow the error of failed jobs
+    job->result.get();
+
+    return job->state;
 }
@@ -30,45 +30,122 @@ STRUCT c_Track
 };
 
 
+ENUM c_Job_state { JOB_QUEUED, JOB_RUNNING, JOB_SUCCEEDED, JOB_FAILED, JOB_CANCELLED };
+
+//! Final status of the solver of a job, as CppAD::ipopt::solve_result. SOLVER_RUNNING until the solver returns
+ENUM c_Solver_status { SOLVER_RUNNING = -1, SOLVER_NOT_DEFINED, SOLVER_SUCCESS, SOLVER_MAXITER_EXCEEDED, SOLVER_STOP_AT_TINY_STEP, 
+                       SOLVER_STOP_AT_ACCEPTABLE_POINT, SOLVER_LOCAL_INFEASIBILITY, SOLVER_USER_REQUESTED_STOP, SOLVER_FEASIBLE_POINT_FOUND,
+                       SOLVER_DIVERGING_ITERATES, SOLVER_RESTORATION_FAILURE, SOLVER_ERROR_IN_STEP_COMPUTATION, SOLVER_INVALID_NUMBER_DETECTED,
+                       SOLVER_TOO_FEW_DEGREES_OF_FREEDOM, SOLVER_INTERNAL_ERROR, SOLVER_UNKNOWN };
+
+STRUCT c_Job_status
+{
+    int state;
+    int iteration;
+    double objective;
+    double primal_infeasibility;
+    double dual_infeasibility;
+    int solver_status;
+};
+
+
+//! Read-only view into a vector of the tables. The data stays valid until the view is released, even if the
+//! variable is removed from the tables or its context is deleted
+STRUCT c_Vector_view
+{
+    const double* data;
+    int size;
+    void* handle;
+};
+
+
+//! Opaque context: owns its vehicles, tracks, tables, and warm start data. All the calls take a context.
+//! Calls on the same context are serialized, calls on different contexts run in parallel.
+//! Each context reserves a CppAD thread number until it is deleted: create_context throws if none is left
+struct fastestlap_context;
+
+// Contexts ------------------------------------------------------------------------------------------------------------
+struct fastestlap_context* create_context();
+
+void delete_context(struct fastestlap_context* context);
+
+//! Make a track of the source context available in the context. The track is read-only and shared, not copied
+void share_track(struct fastestlap_context* context, struct fastestlap_context* source, struct c_Track* track);
+
 // Factories -----------------------------------------------------------------------------------------------------------
-void create_vehicle(struct c_Vehicle* vehicle, const char* name, const char* vehicle_type, const char* database_file);
+void create_vehicle(struct fastestlap_context* context, struct c_Vehicle* vehicle, const char* name, const char* vehicle_type, const char* database_file);
 
-void create_track(struct c_Track* track, const char* name, const char* track_file, const char* options);
+void create_track(struct fastestlap_context* context, struct c_Track* track, const char* name, const char* track_file, const char* options);
 
-void delete_vehicle(struct c_Vehicle* vehicle);
+void delete_vehicle(struct fastestlap_context* context, struct c_Vehicle* vehicle);
 
-void clear_tables();
+void clear_tables(struct fastestlap_context* context);
 
-void clear_tables_by_prefix(const char* prefix_c);
+void clear_tables_by_prefix(struct fastestlap_context* context, const char* prefix_c);
 
 // Getters -------------------------------------------------------------------------------------------------------------
-int download_vector_table_variable_size(const char* name_c);
+int download_vector_table_variable_size(struct fastestlap_context* context, const char* name_c);
+
+void download_vector_table_variable(struct fastestlap_context* context, double* data, const int n, const char* name_c);
+
+//! Get a view into a vector of the tables, without copying it. Shall be released with release_vector_view
+void acquire_vector_table_variable_view(struct fastestlap_context* context, struct c_Vector_view* view, const char* name_c);
 
-void download_vector_table_variable(double* data, const int n, const char* name_c);
+//! Release a view. Its data shall not be accessed afterwards
+void release_vector_view(struct c_Vector_view* view);
 
-void load_vector_table_variable(double* data, const int n, const char* name_c);
+void load_vector_table_variable(struct fastestlap_context* context, double* data, const int n, const char* name_c);
 
-double get_vehicle_property(struct c_Vehicle* vehicle, const double* q, const double* qa, const double* u, const double s, const char* property_name);
+double get_vehicle_property(struct fastestlap_context* context, struct c_Vehicle* vehicle, const double* q, const double* qa, const double* u, const double s, const char* property_name);
 
 // Modifyers -----------------------------------------------------------------------------------------------------------
-void set_scalar_parameter(struct c_Vehicle* vehicle, const char* parameter, const double value);
+void set_scalar_parameter(struct fastestlap_context* context, struct c_Vehicle* vehicle, const char* parameter, const double value);
 
-void set_vector_parameter(struct c_Vehicle* vehicle, const char* parameter, const double value[3]);
+void set_vector_parameter(struct fastestlap_context* context, struct c_Vehicle* vehicle, const char* parameter, const double value[3]);
 
-void set_matrix_parameter(struct c_Vehicle* vehicle, const char* parameter, const double value[9]);
+void set_matrix_parameter(struct fastestlap_context* context, struct c_Vehicle* vehicle, const char* parameter, const double value[9]);
 
-void add_variable_parameter(struct c_Vehicle* c_vehicle, const char* parameter_name, const int n, const double* s, const double* values);
+void add_variable_parameter(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const char* parameter_name, const int n, const double* s, const double* values);
 
 // Applications --------------------------------------------------------------------------------------------------------
-//void vehicle_equations(double* dqdt, double* dqa, struct c_Vehicle* vehicle, double* q, double* qa, double* u, double s);
+//! Evaluate the vehicle equations and their derivatives. Inputs are sorted as x = [q, qa, u] (n_x entries).
+//! Jacobians are row-major (n_state x n_x, n_algebraic x n_x), and Hessians are row-major (n_state x n_x x n_x, 
+//! n_algebraic x n_x x n_x). Derivative buffers can be NULL to skip their computation
+void vehicle_equations(struct fastestlap_context* context, double* dqdt, double* dqa, double* jac_dqdt, double* jac_dqa, double* h_dqdt, double* h_dqa, struct c_Vehicle* c_vehicle, 
+    struct c_Track* c_track, const double* q, const double* qa, const double* u, double s, bool use_circuit);
+
+void propagate(struct fastestlap_context* context, double* q, double* qa, double* u, struct c_Vehicle* vehicle, struct c_Track* track, double s, double ds, double* u_next, bool use_circuit, const char* options);
+
+//! Integrate the vehicle along a control schedule, with the track bound and the options parsed once. States are 
+//! row-major, one row per point: q (n_points x n_state), qa (n_points x n_algebraic), and u (n_points x n_control).
+//! The first rows of q and qa contain the initial condition, and the rest are filled with the solution.
+//! Options: <integrator> simplified_newton (default), which runs the scalar vehicle and reuses its iteration matrix across steps, 
+//! or crank_nicolson, as propagate(). <adaptive> to adapt the step size between the points (simplified_newton only), 
+//! <relative_tolerance>, <absolute_tolerance>. The track can only be null if use_circuit is false
+void simulate(struct fastestlap_context* context, double* q, double* qa, struct c_Vehicle* vehicle, struct c_Track* track, const int n_points, 
+    const double* s, const double* u, bool use_circuit, const char* options);
+
+void gg_diagram(struct fastestlap_context* context, double* ay, double* ax_max, double* ax_min, struct c_Vehicle* vehicle, double v, const int n_points);
+
+void optimal_laptime(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const struct c_Track* c_track, const int n_points, const double* s, const char* options);
+
+//! Submit an optimal laptime to a queue shared by all the contexts, and return its job id. The inputs are copied. The 
+//! vehicle, track and warm start are taken from the context when the job starts, and the results are saved into the 
+//! context tables when it finishes. The context is not locked during the solve, and the IPOPT solves of all the jobs 
+//! run one at a time
+int submit_optimal_laptime(struct fastestlap_context* context, struct c_Vehicle* c_vehicle, const struct c_Track* c_track, const int n_points, const double* s, const char* options);
 
-void propagate(double* q, double* qa, double* u, struct c_Vehicle* vehicle, struct c_Track* track, double s, double ds, double* u_next, bool use_circuit, const char* options);
+//! Get the state of a job and the progress of its solver: iteration, objective, infeasibilities, and its final status 
+//! (c_Solver_status), which tells why a failed job did not converge
+void poll_job(struct fastestlap_context* context, struct c_Job_status* status, const int job_id);
 
-void gg_diagram(double* ay, double* ax_max, double* ax_min, struct c_Vehicle* vehicle, double v, const int n_points);
+//! Request a job to stop. The solver stops at its next iteration
+void cancel_job(struct fastestlap_context* context, const int job_id);
 
-void optimal_laptime(struct c_Vehicle* c_vehicle, const struct c_Track* c_track, const int n_points, const double* s, const char* options);
+//! Wait for a job to finish, release it, and return its final state. Errors of failed jobs are rethrown
+int wait_job(struct fastestlap_context* context, const int job_id);
 
-void track_coordinates(double* x_center, double* y_center, double* x_left, double* y_left, double* x_right, double* y_right, double* theta, struct c_Track* c_track, const int n_points);
+void track_coordinates(struct fastestlap_context* context, double* x_center, double* y_center, double* x_left, double* y_left, double* x_right, double* y_right, double* theta, struct c_Track* c_track, const int n_points);
 
 #ifdef __cplusplus
 }
@@ -20,141 +20,220 @@ class c_Track(c.Structure):
                 ("is_closed", c.c_bool)
                ]
 
-def load_vehicle(name,vehicle_type,database_file):
+class c_Vector_view(c.Structure):
+    _fields_ = [("data", c.POINTER(c.c_double)),
+                ("size", c.c_int),
+                ("handle", c.c_void_p)
+               ]
+
+c_lib.create_context.restype = c.c_void_p
+c_lib.delete_context.argtypes = [c.c_void_p]
+c_lib.share_track.argtypes = [c.c_void_p, c.c_void_p, c.POINTER(c_Track)]
+
+# Independent contexts own their vehicles, tracks and results, and can be used from different threads
+def create_context():
+	return c.c_void_p(c_lib.create_context());
+
+def delete_context(context):
+	c_lib.delete_context(context);
+
+def share_track(context, source, track):
+	c_lib.share_track(context,  source, c.byref(track));
+
+# Context used when none is provided
+default_context = create_context();
+
+# Owns a vector view, and releases it when the last array that uses it is destroyed
+class _Vector_view_owner:
+	def __init__(self, view):
+		self.view = view;
+
+	def __del__(self):
+		c_lib.release_vector_view(c.byref(self.view));
+
+# Read-only NumPy array on a vector of the tables, without copying it
+def vector_table_variable(name,context=default_context):
+	view = c_Vector_view();
+	c_lib.acquire_vector_table_variable_view(context, c.byref(view), c.c_char_p((name).encode('utf-8')));
+
+	owner = _Vector_view_owner(view);
+
+	if ( view.size == 0 ):
+		return np.empty(0);
+
+	c_data = (c.c_double*view.size).from_address(c.addressof(view.data.contents));
+	c_data._owner = owner;
+
+	data = np.frombuffer(c_data, dtype=np.float64);
+	data.flags.writeable = False;
+
+	return data;
+
+# Pointer to the data of a NumPy array of doubles, to be filled by the C API
+def _as_c_pointer(data):
+	return data.ctypes.data_as(c.POINTER(c.c_double));
+
+def load_vehicle(name,vehicle_type,database_file,context=default_context):
 	name = c.c_char_p((name).encode('utf-8'))
 	database_file = c.c_char_p((database_file).encode('utf-8'))
 	vehicle_type = c.c_char_p((vehicle_type).encode('utf-8'))
 
 	vehicle = c_Vehicle()
-	c_lib.create_vehicle(c.byref(vehicle),name,vehicle_type,database_file)
+	c_lib.create_vehicle(context, c.byref(vehicle),name,vehicle_type,database_file)
 
 	return vehicle;
 
-def load_track(track_file,name):
+def load_track(track_file,name,context=default_context):
 	options="<options> <save_variables> <prefix>track/</prefix> <variables> <s/> </variables> </save_variables> </options>";
 	c_name = c.c_char_p((name).encode('utf-8'));
 	c_track_file = c.c_char_p((track_file).encode('utf-8'));
 	c_options = c.c_char_p((options).encode('utf-8'));
 
 	track = c_Track();
-	c_lib.create_track(c.byref(track),c_name,c_track_file,c_options);
+	c_lib.create_track(context, c.byref(track),c_name,c_track_file,c_options);
 
 	# Get the results
-	c_variable = c.c_char_p(("track/s").encode('utf-8'));
-	n_points = c_lib.download_vector_table_variable_size(c_variable);
-	c_s = (c.c_double*n_points)();
-	c_lib.download_vector_table_variable(c_s, c.c_int(n_points), c_variable);
-	s = [None]*n_points;
-	for i in range(n_points):
-		s[i] = c_s[i];
+	s = vector_table_variable("track/s",context);
 
 	# Clean up
-	c_lib.clear_tables_by_prefix(c.c_char_p(("track/").encode('utf-8')));
+	c_lib.clear_tables_by_prefix(context, c.c_char_p(("track/").encode('utf-8')));
 
 	return track,s;
 
-def set_scalar_parameter(vehicle,parameter_name,parameter_value):
+def set_scalar_parameter(vehicle,parameter_name,parameter_value,context=default_context):
 	parameter_name = c.c_char_p((parameter_name).encode('utf-8'));
-	c_lib.set_scalar_parameter(c.byref(vehicle),parameter_name,c.c_double(parameter_value))
+	c_lib.set_scalar_parameter(context, c.byref(vehicle),parameter_name,c.c_double(parameter_value))
 	return vehicle;
 
-def set_vector_parameter(vehicle,parameter_name,parameter_value):
+def set_vector_parameter(vehicle,parameter_name,parameter_value,context=default_context):
 	parameter_name = c.c_char_p((parameter_name).encode('utf-8'));
 	c_parameter_value = (c.c_double*3)(parameter_value[0],parameter_value[1],parameter_value[2]);
-	c_lib.set_vector_parameter(c.byref(vehicle),parameter_name,c_parameter_value)
+	c_lib.set_vector_parameter(context, c.byref(vehicle),parameter_name,c_parameter_value)
 	return vehicle;
 
-def set_matrix_parameter(vehicle,parameter_name,parameter_value):
+def set_matrix_parameter(vehicle,parameter_name,parameter_value,context=default_context):
 	parameter_name = c.c_char_p((parameter_name).encode('utf-8'));
 	c_parameter_value = (c.c_double*9)(parameter_value[0],parameter_value[1],parameter_value[2],  
 	                                   parameter_value[3],parameter_value[4],parameter_value[5],  
 	                                   parameter_value[6],parameter_value[7],parameter_value[8]); 
-	c_lib.set_matrix_parameter(c.byref(vehicle),parameter_name,c_parameter_value)
+	c_lib.set_matrix_parameter(context, c.byref(vehicle),parameter_name,c_parameter_value)
 	return vehicle;
 
-def gg_diagram(vehicle,speed,n_points):
-	ay_c = (c.c_double*n_points)();
-	ax_max_c = (c.c_double*n_points)();
-	ax_min_c = (c.c_double*n_points)();
-	c_lib.gg_diagram(ay_c, ax_max_c, ax_min_c, c.byref(vehicle), c.c_double(speed), c.c_int(n_points));
+def gg_diagram(vehicle,speed,n_points,context=default_context):
+	ay = np.empty(n_points);
+	ax_max = np.empty(n_points);
+	ax_min = np.empty(n_points);
+	c_lib.gg_diagram(context, _as_c_pointer(ay), _as_c_pointer(ax_max), _as_c_pointer(ax_min), c.byref(vehicle), c.c_double(speed), c.c_int(n_points));
 
-	ay = [None] * n_points;
-	ay_minus = [None] * n_points;
-	ax_max = [None] * n_points;
-	ax_min = [None] * n_points;
+	ay /= 9.81;
+	ax_max /= 9.81;
+	ax_min /= 9.81;
 
-	for i in range(n_points):
-        	ay[i] = ay_c[i]/9.81;
-        	ay_minus[i] = -ay[i];        
-        	ax_max[i] = ax_max_c[i]/9.81;
-        	ax_min[i] = ax_min_c[i]/9.81;
+	return ay,-ay,ax_max,ax_min;
 
-	return ay,ay_minus,ax_max,ax_min;
+# Integrate a control schedule u [len(s) x n_control] from the initial condition (q0,qa0). Returns q and qa, one row per point
+def simulate(vehicle, track, s, u, q0, qa0, options="", use_circuit=True, context=default_context):
+	if ( use_circuit and track is None ):
+		raise ValueError("simulate: a track is required when use_circuit is True");
 
-def optimal_laptime(vehicle, track, s, channels):
+	s = np.ascontiguousarray(s, dtype=np.float64);
+	u = np.ascontiguousarray(u, dtype=np.float64);
+	n_points = len(s);
 
-	# Get channels ready to be written by C++
-	n_channels = len(channels);
-	c_channels_name = ((c.c_char_p)*n_channels)();
-	c_channels_data = (c.POINTER(c.c_double)*n_channels)()
-	c_s = (c.c_double*len(s))();
+	q = np.zeros((n_points, len(q0)));
+	qa = np.zeros((n_points, len(qa0)));
+	q[0,:] = q0;
+	qa[0,:] = qa0;
 
-	for i in range(len(s)):
-		c_s[i] = s[i];
+	c_track = c.byref(track) if track is not None else None;
+	c_lib.simulate(context, _as_c_pointer(q), _as_c_pointer(qa), c.byref(vehicle), c_track, c.c_int(n_points), _as_c_pointer(s), _as_c_pointer(u), 
+	               c.c_bool(use_circuit), c.c_char_p((options).encode('utf-8')));
 
-	options = "<options> <save_variables> <prefix>run/</prefix> <variables>";
+	return q,qa;
+
+def optimal_laptime_options(channels,prefix):
+	options = "<options> <save_variables> <prefix>" + prefix + "</prefix> <variables>";
 
 	for channel in channels:
 		options += "<" + channel + "/> ";
 
 	options += "</variables> </save_variables> </options>";
-	
-	c_options = c.c_char_p((options).encode('utf-8'));
 
-	c_lib.optimal_laptime(c.byref(vehicle), c.byref(track), c.c_int(len(s)), c_s, c_options);
+	return c.c_char_p((options).encode('utf-8'));
 
-	# Get the results
+def download_channels(n_points,channels,prefix,context=default_context):
 	result = dict();
 	for channel in channels:
-		c_data = (c.c_double*len(s))();
-		c_variable = c.c_char_p(("run/" + channel).encode('utf-8'));
-		c_lib.download_vector_table_variable(c_data, c.c_int(len(s)), c_variable);
-		data = [None]*len(s);
-		for i in range(len(s)):
-			data[i] = c_data[i];
-		result[channel] = data;	
+		result[channel] = vector_table_variable(prefix + channel,context);
 
-	# Clean up
-	c_lib.clear_tables_by_prefix(c.c_char_p(("run/").encode('utf-8')));
+		if ( len(result[channel]) != n_points ):
+			raise RuntimeError("Channel \"" + channel + "\" has " + str(len(result[channel])) + " points, should be " + str(n_points));
+
+	# Clean up: the arrays keep their data alive
+	c_lib.clear_tables_by_prefix(context, c.c_char_p((prefix).encode('utf-8')));
 
 	return result;
 
-def track_coordinates(track,n_points):
-	c_x_center = (c.c_double*n_points)();
-	c_y_center = (c.c_double*n_points)();
-	c_x_left   = (c.c_double*n_points)();
-	c_y_left   = (c.c_double*n_points)();
-	c_x_right  = (c.c_double*n_points)();
-	c_y_right  = (c.c_double*n_points)();
-	c_theta    = (c.c_double*n_points)();
-	c_lib.track_coordinates(c_x_center, c_y_center, c_x_left, c_y_left, c_x_right, c_y_right, c_theta, c.byref(track), c.c_int(n_points));
-
-	x_center = [None] * n_points;
-	y_center = [None] * n_points;
-	x_left   = [None] * n_points;
-	y_left   = [None] * n_points;
-	x_right  = [None] * n_points;
-	y_right  = [None] * n_points;
-	theta    = [None] * n_points;
-
-	for i in range(n_points):
-        	x_center[i] = c_x_center[i];
-        	y_center[i] = c_y_center[i];
-        	x_left[i]   = c_x_left[i];
-        	y_left[i]   = c_y_left[i];
-        	x_right[i]  = c_x_right[i];
-        	y_right[i]  = c_y_right[i];
-        	theta[i]    = c_theta[i];   
+def optimal_laptime(vehicle, track, s, channels,context=default_context):
+
+	c_s = (c.c_double*len(s))(*s);
+	c_options = optimal_laptime_options(channels,"run/");
+
+	c_lib.optimal_laptime(context, c.byref(vehicle), c.byref(track), c.c_int(len(s)), c_s, c_options);
+
+	# Get the results
+	return download_channels(len(s),channels,"run/",context);
+
+# Asynchronous optimal laptime jobs
+JOB_QUEUED, JOB_RUNNING, JOB_SUCCEEDED, JOB_FAILED, JOB_CANCELLED = range(5);
+SOLVER_STATUS = ["not_defined", "success", "maxiter_exceeded", "stop_at_tiny_step", "stop_at_acceptable_point", "local_infeasibility",
+                 "user_requested_stop", "feasible_point_found", "diverging_iterates", "restoration_failure", "error_in_step_computation",
+                 "invalid_number_detected", "too_few_degrees_of_freedom", "internal_error", "unknown"];
+
+class c_Job_status(c.Structure):
+    _fields_ = [("state", c.c_int),
+                ("iteration", c.c_int),
+                ("objective", c.c_double),
+                ("primal_infeasibility", c.c_double),
+                ("dual_infeasibility", c.c_double),
+                ("solver_status", c.c_int)
+               ]
+
+def submit_optimal_laptime(vehicle, track, s, channels, prefix="run/", context=default_context):
+	c_s = (c.c_double*len(s))(*s);
+	c_options = optimal_laptime_options(channels,prefix);
+
+	return c_lib.submit_optimal_laptime(context, c.byref(vehicle), c.byref(track), c.c_int(len(s)), c_s, c_options);
+
+def poll_job(job_id, context=default_context):
+	status = c_Job_status();
+	c_lib.poll_job(context, c.byref(status), c.c_int(job_id));
+
+	return {"state": status.state, "iteration": status.iteration, "objective": status.objective,
+	        "primal_infeasibility": status.primal_infeasibility, "dual_infeasibility": status.dual_infeasibility,
+	        "solver_status": SOLVER_STATUS[status.solver_status] if status.solver_status >= 0 else "running"};
+
+def cancel_job(job_id, context=default_context):
+	c_lib.cancel_job(context, c.c_int(job_id));
+
+def wait_job(job_id, s, channels, prefix="run/", context=default_context):
+	state = c_lib.wait_job(context, c.c_int(job_id));
+
+	if ( state != JOB_SUCCEEDED ):
+		return None;
+
+	return download_channels(len(s),channels,prefix,context);
+
+def track_coordinates(track,n_points,context=default_context):
+	x_center = np.empty(n_points);
+	y_center = np.empty(n_points);
+	x_left   = np.empty(n_points);
+	y_left   = np.empty(n_points);
+	x_right  = np.empty(n_points);
+	y_right  = np.empty(n_points);
+	theta    = np.empty(n_points);
+	c_lib.track_coordinates(context, _as_c_pointer(x_center), _as_c_pointer(y_center), _as_c_pointer(x_left), _as_c_pointer(y_left), 
+	                        _as_c_pointer(x_right), _as_c_pointer(y_right), _as_c_pointer(theta), c.byref(track), c.c_int(n_points));
 
 	return x_center, y_center, x_left, y_left, x_right, y_right, theta;
 
@@ -222,6 +301,6 @@ def plot_track(x_center, y_center, x_left, y_left, x_right, y_right, theta):
 
 	return fig;
 
-def plot_optimal_laptime(x, y, track):
-	fig = plot_track(*track_coordinates(track,1000))
+def plot_optimal_laptime(x, y, track, context=default_context):
+	fig = plot_track(*track_coordinates(track,1000,context))
 	plt.plot(x,y,linewidth=2,color="orange");
@@ -0,0 +1,131 @@
+//!     fastestlap_freeze_vehicle
+//!     -------------------------
+//!
+//! Generate a header of compile-time parameters from a vehicle database, to be used as the
+//! FrozenParams argument of the vehicle templates (e.g. limebeer2014f1<Timeseries_t,FrozenParams>)
+//!
+//! Usage: fastestlap_freeze_vehicle <database.xml> <struct name> <output header>
+//!
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include "lion/io/Xml_document.h"
+#include "lion/io/database_parameters.h"
+#include "src/core/tire/tire_pacejka.h"
+
+//! Write the frozen parameters of a Pacejka simple tire model
+//! @param[inout] os: output stream
+//! @param[in] database: the vehicle database
+//! @param[in] tire_name: name of the tire node (front-tire, rear-tire)
+//! @param[in] struct_name: name of the struct to be written
+static void write_pacejka_simple(std::ostream& os, Xml_document& database, const std::string& tire_name, const std::string& struct_name)
+{
+    const std::string path = "vehicle/" + tire_name + "/";
+
+    const std::string model = database.get_element(path).get_attribute("model");
+
+    if ( model != "tire-pacejka-simple" )
+        throw std::runtime_error("Tire model \"" + model + "\" of \"" + tire_name + "\" cannot be frozen");
+
+    // (1) Read and initialise the runtime model, so that derived constants are computed identically
+    Pacejka_simple_model pacejka;
+    read_parameters(database, path, pacejka.get_parameters());
+    pacejka.initialise();
+
+    // (2) Write its members as constants
+    auto write = [&os](const std::string& name, const scalar value)
+        { os << "        static constexpr const scalar " << std::left << std::setw(12) << name << " = " << value << ";" << std::endl; };
+
+    os << "    //! Parameters of the " << tire_name << " (" << model << ")" << std::endl;
+    os << "    struct " << struct_name << std::endl;
+    os << "    {" << std::endl;
+    write("Fz1",         pacejka._Fz1);
+    write("Fz2",         pacejka._Fz2);
+    write("mu_x_max1",   pacejka._mu_x_max1);
+    write("mu_x_max2",   pacejka._mu_x_max2);
+    write("mu_y_max1",   pacejka._mu_y_max1);
+    write("mu_y_max2",   pacejka._mu_y_max2);
+    write("kappa_max1",  pacejka._kappa_max1);
+    write("kappa_max2",  pacejka._kappa_max2);
+    write("lambda_max1", pacejka._lambda_max1);
+    write("lambda_max2", pacejka._lambda_max2);
+    write("Qx",          pacejka._Qx);
+    write("Qy",          pacejka._Qy);
+    write("Sx",          pacejka._Sx);
+    write("Sy",          pacejka._Sy);
+    write("mu_min",      pacejka._mu_min);
+    os << "    };" << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    if ( argc != 4 )
+    {
+        std::cerr << "Usage: " << argv[0] << " <database.xml> <struct name> <output header>" << std::endl;
+        return 1;
+    }
+
+    const std::string database_file = argv[1];
+    const std::string struct_name   = argv[2];
+    const std::string output_file   = argv[3];
+
+    try
+    {
+        // (1) Read the raw database text, it is embedded in the header for the non-frozen parameters
+        std::ifstream database_stream(database_file);
+
+        if ( !database_stream.good() )
+            throw std::runtime_error("Database file \"" + database_file + "\" could not be opened");
+
+        std::stringstream database_text;
+        database_text << database_stream.rdbuf();
+
+        Xml_document database = { database_file, true };
+
+        const std::string vehicle_type = database.get_root_element().get_attribute("type");
+
+        if ( vehicle_type != "limebeer-2014-f1" )
+            throw std::runtime_error("Vehicle type \"" + vehicle_type + "\" cannot be frozen");
+
+        // (2) Write the header
+        std::string header_guard = struct_name;
+        std::transform(header_guard.begin(), header_guard.end(), header_guard.begin(), ::toupper);
+        header_guard = "__" + header_guard + "_H__";
+
+        std::ofstream os(output_file);
+        os << std::scientific << std::setprecision(16);
+
+        os << "// Generated by fastestlap_freeze_vehicle from " << database_file << ". Do not edit." << std::endl;
+        os << "#ifndef " << header_guard << std::endl;
+        os << "#define " << header_guard << std::endl;
+        os << std::endl;
+        os << "#include \"lion/foundation/types.h\"" << std::endl;
+        os << std::endl;
+        os << "//! Frozen parameters of a " << vehicle_type << " vehicle" << std::endl;
+        os << "struct " << struct_name << std::endl;
+        os << "{" << std::endl;
+        os << "    //! Type of the vehicle" << std::endl;
+        os << "    static constexpr const char* vehicle_type = \"" << vehicle_type << "\";" << std::endl;
+        os << std::endl;
+        write_pacejka_simple(os, database, "front-tire", "front_tire");
+        os << std::endl;
+        write_pacejka_simple(os, database, "rear-tire", "rear_tire");
+        os << std::endl;
+        os << "    //! The source database, used to construct the parameters that are not frozen" << std::endl;
+        os << "    static constexpr const char* database = R\"xml(" << database_text.str() << ")xml\";" << std::endl;
+        os << "};" << std::endl;
+        os << std::endl;
+        os << "#endif" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
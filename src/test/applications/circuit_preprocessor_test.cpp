@@ -1,5 +1,6 @@
 #include "src/core/applications/circuit_preprocessor.h"
 #include "gtest/gtest.h"
+#include <chrono>
 
 extern bool is_valgrind;
 
@@ -38,6 +39,12 @@ TEST(Circuit_preprocessor_test, museo_closed)
 
     EXPECT_EQ(circuit.n_points,100);
     EXPECT_EQ(circuit.r_centerline.size(),100);
+
+    // The node-segment associations shall converge before the maximum number of solves
+    EXPECT_GE(circuit.n_association_iterations, 1u);
+    EXPECT_LT(circuit.n_association_iterations, options.maximum_association_iterations);
+    EXPECT_TRUE(circuit.associations_converged);
+
     EXPECT_EQ(circuit.theta.size(),100);
     EXPECT_EQ(circuit.kappa.size(),100);
     EXPECT_EQ(circuit.nl.size(),100);
@@ -527,3 +534,352 @@ TEST(Circuit_preprocessor_test, vendrell)
         EXPECT_DOUBLE_EQ(lat, circuit.r_left_measured[i].y()/(circuit.R_earth)*RAD + phi0);
     }
 }
+
+
+TEST(Circuit_preprocessor_test, polyline_spatial_index)
+{
+    // Brute force search along all the segments
+    auto brute_force = [](const std::vector<sVector3d>& r, const bool closed, const sVector3d& p)
+    {
+        const size_t n_segments = (closed ? r.size() : r.size() - 1);
+        scalar dist2_best = std::numeric_limits<scalar>::infinity();
+        size_t i_best = 0;
+
+        for (size_t i = 0; i < n_segments; ++i)
+        {
+            const sVector3d& a = r[i];
+            const sVector3d& b = r[(i+1) % r.size()];
+            const scalar xi = std::clamp(dot(p-a,b-a)/dot(b-a,b-a), 0.0, 1.0);
+            const sVector3d closest = a + xi*(b-a);
+            const scalar dist2 = dot(p-closest,p-closest);
+
+            if ( dist2 < dist2_best ) { dist2_best = dist2; i_best = i; }
+        }
+
+        return std::make_pair(dist2_best, i_best);
+    };
+
+    Xml_document coord_left_kml("./database/google_earth/Catalunya_left.kml", true);
+
+    const std::vector<scalar> coord_left = coord_left_kml.get_element("kml/Document/Placemark/LineString/coordinates").get_value(std::vector<scalar>());
+
+    // Boundary in meters, around its first point
+    std::vector<sVector3d> r(coord_left.size()/3);
+    for (size_t i = 0; i < r.size(); ++i)
+        r[i] = sVector3d((coord_left[3*i]-coord_left[0])*DEG*6378388.0*cos(coord_left[1]*DEG), (coord_left[3*i+1]-coord_left[1])*DEG*6378388.0, 0.0);
+
+    for (const bool closed : {true, false})
+    {
+        const Polyline_spatial_index index(r, closed);
+
+        EXPECT_EQ(index.get_number_of_segments(), (closed ? r.size() : r.size() - 1));
+
+        // Points around the boundary, and some far from it
+        for (size_t i = 0; i < r.size(); i += 3)
+        {
+            for (const scalar offset : {0.0, 3.7, -12.0, 250.0})
+            {
+                const sVector3d p = r[i] + sVector3d(offset, 0.31*offset, 0.0);
+
+                const auto [closest, dist2, i_segment] = index.find_closest_point(p);
+                const auto [dist2_brute_force, i_brute_force] = brute_force(r, closed, p);
+
+                EXPECT_NEAR(dist2, dist2_brute_force, 1.0e-10*std::max(1.0,dist2_brute_force)) << "with i = " << i;
+                EXPECT_NEAR(dot(p-closest,p-closest), dist2, 1.0e-10*std::max(1.0,dist2));
+
+                // The segment can only differ in case of ties
+                if ( i_segment[0] != i_brute_force )
+                {
+                    EXPECT_NEAR(brute_force({r[i_segment[0]], r[i_segment[1]]}, false, p).first, dist2_brute_force, 1.0e-10*std::max(1.0,dist2_brute_force));
+                }
+
+                EXPECT_EQ(i_segment[1], (i_segment[0] + 1) % r.size());
+            }
+        }
+
+        // Search with maximum distance
+        Polyline_spatial_index::Result result;
+        EXPECT_TRUE(index.find_closest_point(result, r.front() + sVector3d(1.0,1.0,0.0), 2.0));
+        EXPECT_LE(std::get<1>(result), 2.0);
+
+        const sVector3d p_far(1.0e5, 1.0e5, 0.0);
+        EXPECT_FALSE(index.find_closest_point(result, p_far, 10.0));
+    }
+}
+
+
+TEST(Circuit_preprocessor_test, polyline_spatial_index_window)
+{
+    // Hairpin: two parallel straights 10m apart, joined at x = 100. The second straight is closer to points placed 
+    // just below it, but out of a window around the first one
+    std::vector<sVector3d> r;
+    for (size_t i = 0; i <= 100; ++i)
+        r.push_back(sVector3d(i, 0.0, 0.0));
+
+    for (size_t i = 0; i <= 100; ++i)
+        r.push_back(sVector3d(100.0 - i, 10.0, 0.0));
+
+    for (const bool closed : {true, false})
+    {
+        const Polyline_spatial_index index(r, closed);
+        const sVector3d p(50.5, 7.0, 0.0);
+
+        // (1) Without window: the second straight
+        Polyline_spatial_index::Result result;
+        ASSERT_TRUE(index.find_closest_point(result, p, 20.0));
+        EXPECT_NEAR(std::get<1>(result), 9.0, 1.0e-12);
+
+        // (2) Window of 20m around the segment 50: the first straight
+        ASSERT_TRUE(index.find_closest_point(result, p, 20.0, 50, 20.0));
+        EXPECT_NEAR(std::get<1>(result), 49.0, 1.0e-12);
+        EXPECT_EQ(std::get<2>(result)[0], 50u);
+
+        // (3) Window that does not reach any close segment
+        EXPECT_FALSE(index.find_closest_point(result, p, 5.0, 50, 20.0));
+
+        // (4) Closed polylines: the window wraps around the closing segment
+        if ( closed )
+        {
+            ASSERT_TRUE(index.find_closest_point(result, sVector3d(0.5, -1.0, 0.0), 20.0, r.size() - 1, 15.0));
+            EXPECT_EQ(std::get<2>(result)[0], 0u);
+        }
+    }
+}
+
+
+TEST(Circuit_preprocessor_test, hairpin_associations)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    // Stadium with 8m width and a hairpin at each end: the inner boundaries of the two straights are only 4m apart, 
+    // closer than the other boundary of the same straight
+    const scalar L = 200.0;             // Length of the straights
+    const scalar radius = 6.0;          // Radius of the centerline at the hairpins
+    const scalar half_width = 4.0;
+    const scalar R_earth = 6378388.0;
+
+    auto boundary = [&](const scalar r)
+    {
+        std::vector<Circuit_preprocessor::Coordinates> coordinates;
+        auto add = [&](const scalar x, const scalar y) { coordinates.push_back({x/(R_earth*DEG), y/(R_earth*DEG)}); };
+
+        for (scalar x = 0.0; x < L; x += 2.0)     add(x, radius - r);
+        for (size_t k = 0; k < 20; ++k)           add(L + r*sin(pi*k/20.0), radius - r*cos(pi*k/20.0));
+        for (scalar x = L; x > 0.0; x -= 2.0)     add(x, radius + r);
+        for (size_t k = 0; k < 20; ++k)           add(-r*sin(pi*k/20.0), radius + r*cos(pi*k/20.0));
+
+        return coordinates;
+    };
+
+    // Counterclockwise: the left boundary is the inner one
+    const auto coord_left  = boundary(radius - half_width);
+    const auto coord_right = boundary(radius + half_width);
+
+    Circuit_preprocessor::Options options;
+    options.maximum_kappa = 1.0;
+    options.maximum_dkappa = 1.0;
+
+    Circuit_preprocessor circuit(coord_left, coord_right, options, 200);
+
+    // The associations follow each boundary through the hairpins: the solution fits the measured boundaries
+    EXPECT_TRUE(circuit.associations_converged);
+    EXPECT_LT(circuit.left_boundary_max_error, 0.5);
+    EXPECT_LT(circuit.right_boundary_max_error, 0.5);
+
+    for (size_t i = 0; i < circuit.n_points; ++i)
+    {
+        EXPECT_NEAR(circuit.nl[i], half_width, 0.5) << "with i = " << i;
+        EXPECT_NEAR(circuit.nr[i], half_width, 0.5) << "with i = " << i;
+    }
+}
+
+
+TEST(Circuit_preprocessor_test, museo_closed_multilevel)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    Xml_document coord_left_kml("./database/google_earth/Museo_short_left.kml", true);
+    Xml_document coord_right_kml("./database/google_earth/Museo_short_right.kml", true);
+
+    Circuit_preprocessor::Options options;
+
+    options.eps_k *= 0.001;
+    options.eps_n *= 0.001;
+    options.eps_c *= 0.001;
+    options.eps_d *= 0.001;
+
+    options.maximum_kappa = 1.0;
+    options.maximum_dkappa = 1.0;
+
+    // (1) Direct solution
+    auto start = std::chrono::steady_clock::now();
+    Circuit_preprocessor circuit_direct(coord_left_kml, coord_right_kml, options, 100);
+    const std::chrono::duration<scalar> elapsed_direct = std::chrono::steady_clock::now() - start;
+
+    // (2) Multilevel solution: 25, 50, and 100 elements
+    options.multilevel_levels = 3;
+
+    start = std::chrono::steady_clock::now();
+    Circuit_preprocessor circuit(coord_left_kml, coord_right_kml, options, 100);
+    const std::chrono::duration<scalar> elapsed = std::chrono::steady_clock::now() - start;
+
+    out(2) << "[museo_closed_multilevel] direct: " << elapsed_direct.count() << "s" << std::endl;
+    for (const auto& level : circuit.level_statistics)
+        out(2) << "    level with " << level.n_elements << " elements: " << level.elapsed_time << "s, " << level.n_association_iterations << " solves" << std::endl;
+    out(2) << "    multilevel: " << elapsed.count() << "s, speedup: " << elapsed_direct.count()/elapsed.count() << std::endl;
+
+    ASSERT_EQ(circuit.level_statistics.size(), 3u);
+    EXPECT_EQ(circuit.level_statistics[0].n_elements, 25u);
+    EXPECT_EQ(circuit.level_statistics[1].n_elements, 50u);
+    EXPECT_EQ(circuit.level_statistics[2].n_elements, 100u);
+
+    for (const auto& level : circuit.level_statistics)
+        EXPECT_TRUE(level.associations_converged);
+
+    // (3) Both solve the same problem on the finest mesh
+    ASSERT_EQ(circuit.n_points, 100u);
+    EXPECT_NEAR(circuit.track_length, circuit_direct.track_length, 1.0e-6*circuit_direct.track_length);
+
+    for (size_t i = 0; i < circuit.n_points; ++i)
+    {
+        EXPECT_NEAR(circuit.r_centerline[i].x(), circuit_direct.r_centerline[i].x(), 1.0e-5) << " with i = " << i;
+        EXPECT_NEAR(circuit.r_centerline[i].y(), circuit_direct.r_centerline[i].y(), 1.0e-5) << " with i = " << i;
+        EXPECT_NEAR(circuit.theta[i]           , circuit_direct.theta[i]           , 1.0e-6) << " with i = " << i;
+        EXPECT_NEAR(circuit.kappa[i]           , circuit_direct.kappa[i]           , 1.0e-6) << " with i = " << i;
+        EXPECT_NEAR(circuit.nl[i]              , circuit_direct.nl[i]              , 1.0e-5) << " with i = " << i;
+        EXPECT_NEAR(circuit.nr[i]              , circuit_direct.nr[i]              , 1.0e-5) << " with i = " << i;
+    }
+}
+
+
+TEST(Circuit_preprocessor_test, museo_closed_parallel_chunks)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    Xml_document coord_left_kml("./database/google_earth/Museo_short_left.kml", true);
+    Xml_document coord_right_kml("./database/google_earth/Museo_short_right.kml", true);
+
+    Circuit_preprocessor::Options options;
+
+    options.eps_k *= 0.001;
+    options.eps_n *= 0.001;
+    options.eps_c *= 0.001;
+    options.eps_d *= 0.001;
+
+    options.maximum_kappa = 1.0;
+    options.maximum_dkappa = 1.0;
+
+    // (1) Direct solution
+    auto start = std::chrono::steady_clock::now();
+    Circuit_preprocessor circuit_direct(coord_left_kml, coord_right_kml, options, 100);
+    const std::chrono::duration<scalar> elapsed_direct = std::chrono::steady_clock::now() - start;
+
+    // (2) Solution from three open chunks, polished as a closed circuit
+    options.parallel_chunks = 3;
+    options.chunk_overlap = 30.0;
+
+    start = std::chrono::steady_clock::now();
+    Circuit_preprocessor circuit(coord_left_kml, coord_right_kml, options, 100);
+    const std::chrono::duration<scalar> elapsed = std::chrono::steady_clock::now() - start;
+
+    out(2) << "[museo_closed_parallel_chunks] direct: " << elapsed_direct.count() << "s, chunks: " << elapsed.count() 
+           << "s, speedup: " << elapsed_direct.count()/elapsed.count() << std::endl;
+
+    // (3) The polish solves the same closed problem
+    ASSERT_EQ(circuit.n_points, 100u);
+    EXPECT_TRUE(circuit.is_closed);
+    EXPECT_EQ(circuit.direction, circuit_direct.direction);
+    EXPECT_NEAR(circuit.track_length, circuit_direct.track_length, 1.0e-6*circuit_direct.track_length);
+
+    for (size_t i = 0; i < circuit.n_points; ++i)
+    {
+        EXPECT_NEAR(circuit.r_centerline[i].x(), circuit_direct.r_centerline[i].x(), 1.0e-5) << " with i = " << i;
+        EXPECT_NEAR(circuit.r_centerline[i].y(), circuit_direct.r_centerline[i].y(), 1.0e-5) << " with i = " << i;
+        EXPECT_NEAR(circuit.theta[i]           , circuit_direct.theta[i]           , 1.0e-6) << " with i = " << i;
+        EXPECT_NEAR(circuit.kappa[i]           , circuit_direct.kappa[i]           , 1.0e-6) << " with i = " << i;
+        EXPECT_NEAR(circuit.nl[i]              , circuit_direct.nl[i]              , 1.0e-5) << " with i = " << i;
+        EXPECT_NEAR(circuit.nr[i]              , circuit_direct.nr[i]              , 1.0e-5) << " with i = " << i;
+    }
+
+    // (4) Open circuits cannot be chunked
+    Xml_document catalunya_left_kml("./database/google_earth/Catalunya_left.kml", true);
+    Xml_document catalunya_right_kml("./database/google_earth/Catalunya_right.kml", true);
+
+    Circuit_preprocessor::Coordinates start_coordinates = {2.261, 41.57455};
+    Circuit_preprocessor::Coordinates finish_coordinates = {2.26325, 41.57385};
+
+    EXPECT_THROW(Circuit_preprocessor(catalunya_left_kml, catalunya_right_kml, options, start_coordinates, finish_coordinates, 20), std::runtime_error);
+}
+
+
+TEST(Circuit_preprocessor_test, kml_reader)
+{
+    const std::vector<std::string> tracks = {"Catalunya_left", "Catalunya_right", "Museo_short_left", "Museo_short_right", "vendrell_left", "vendrell_right"};
+
+    for (const auto& track : tracks)
+    {
+        // (1) Reference: the coordinates read through the XML tree
+        Xml_document kml("./database/google_earth/" + track + ".kml", true);
+        const std::vector<scalar> coordinates = kml.get_element("kml/Document/Placemark/LineString/coordinates").get_value(std::vector<scalar>());
+
+        // (2) Streamed from the KML and from the KMZ, in small chunks
+        for (const std::string extension : {".kml", ".kmz"})
+        {
+            std::vector<Kml_reader::Point> points;
+            size_t n_chunks = 0;
+
+            Kml_reader::read("./database/google_earth/" + track + extension, [&](const Kml_reader::Point* chunk, const size_t n)
+            {
+                EXPECT_LE(n, 50u);
+                points.insert(points.end(), chunk, chunk + n);
+                ++n_chunks;
+            }, 50);
+
+            ASSERT_EQ(3*points.size(), coordinates.size()) << track << extension;
+            EXPECT_EQ(n_chunks, (points.size() + 49)/50);
+
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                EXPECT_DOUBLE_EQ(points[i].longitude, coordinates[3*i]);
+                EXPECT_DOUBLE_EQ(points[i].latitude , coordinates[3*i+1]);
+                EXPECT_DOUBLE_EQ(points[i].altitude , coordinates[3*i+2]);
+            }
+        }
+    }
+
+    // (3) Text with comments, namespaces, points without altitude, and coordinates outside of a LineString
+    const std::string text = "<kml><!-- <LineString><coordinates>0,0</coordinates></LineString> --><Point><coordinates>9,9</coordinates></Point>"
+                             "<LineString><kml:coordinates>\n 1,2 3,4,5\n\t6,7 </kml:coordinates></LineString></kml>";
+
+    std::vector<Kml_reader::Point> points;
+    Kml_reader::read_kml_text(text.data(), text.size(), [&](const Kml_reader::Point* chunk, const size_t n) { points.insert(points.end(), chunk, chunk + n); });
+
+    ASSERT_EQ(points.size(), 3u);
+    EXPECT_DOUBLE_EQ(points[0].longitude, 1.0); EXPECT_DOUBLE_EQ(points[0].latitude, 2.0); EXPECT_DOUBLE_EQ(points[0].altitude, 0.0);
+    EXPECT_DOUBLE_EQ(points[1].longitude, 3.0); EXPECT_DOUBLE_EQ(points[1].latitude, 4.0); EXPECT_DOUBLE_EQ(points[1].altitude, 5.0);
+    EXPECT_DOUBLE_EQ(points[2].longitude, 6.0); EXPECT_DOUBLE_EQ(points[2].latitude, 7.0); EXPECT_DOUBLE_EQ(points[2].altitude, 0.0);
+
+    // (4) Malformed coordinates
+    auto read_text = [](const std::string& malformed) { Kml_reader::read_kml_text(malformed.data(), malformed.size(), [](const Kml_reader::Point*, const size_t) {}); };
+
+    EXPECT_THROW(read_text("<LineString><coordinates>1,2,3,4</coordinates></LineString>"), std::runtime_error);
+    EXPECT_THROW(read_text("<LineString><coordinates>1 2</coordinates></LineString>"), std::runtime_error);
+    EXPECT_THROW(read_text("<LineString><coordinates>1,2 3,4"), std::runtime_error);
+    EXPECT_THROW(read_text("<kml></kml>"), std::runtime_error);
+
+    // (5) The preprocessor gives the same result from the KMZ files
+    Xml_document coord_left_kml("./database/google_earth/Museo_short_left.kml", true);
+    Xml_document coord_right_kml("./database/google_earth/Museo_short_right.kml", true);
+
+    Circuit_preprocessor circuit_xml(coord_left_kml, coord_right_kml, {}, 20);
+    Circuit_preprocessor circuit_kmz(std::string("./database/google_earth/Museo_short_left.kmz"), std::string("./database/google_earth/Museo_short_right.kmz"), {}, 20);
+
+    ASSERT_EQ(circuit_kmz.n_points, circuit_xml.n_points);
+    EXPECT_DOUBLE_EQ(circuit_kmz.track_length, circuit_xml.track_length);
+
+    for (size_t i = 0; i < circuit_xml.n_points; ++i)
+    {
+        EXPECT_DOUBLE_EQ(circuit_kmz.r_centerline[i].x(), circuit_xml.r_centerline[i].x());
+        EXPECT_DOUBLE_EQ(circuit_kmz.r_centerline[i].y(), circuit_xml.r_centerline[i].y());
+    }
+}
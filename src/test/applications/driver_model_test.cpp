@@ -0,0 +1,206 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include "src/core/vehicles/limebeer2014f1.h"
+#include "src/core/vehicles/lot2016kart.h"
+#include "src/core/applications/driver_model.h"
+
+extern bool is_valgrind;
+
+class Driver_model_test : public ::testing::Test
+{
+ protected:
+    using Car_t    = limebeer2014f1<scalar>::curvilinear_p;
+    using Driver_t = Driver_model<Car_t>;
+
+    Driver_model_test()
+    {
+        // Use the optimal laptime as reference line and speed profile
+        Xml_document opt_saved("data/f1_optimal_laptime_catalunya_discrete.xml", true);
+
+        reference.s = opt_saved.get_element("optimal_laptime/arclength").get_value(std::vector<scalar>());
+        reference.n = opt_saved.get_element("optimal_laptime/n").get_value(std::vector<scalar>());
+        reference.u = opt_saved.get_element("optimal_laptime/u").get_value(std::vector<scalar>());
+
+        const std::vector<std::string> states = {"steering-kappa-left", "steering-kappa-right", "powered-kappa-left", "powered-kappa-right",
+                                                 "u", "v", "omega", "time", "n", "alpha"};
+        const std::vector<std::string> algebraic = {"Fz_fl", "Fz_fr", "Fz_rl", "Fz_rr"};
+
+        for (size_t j = 0; j < Car_t::NSTATE; ++j)
+            q0[j] = opt_saved.get_element("optimal_laptime/" + states[j]).get_value(std::vector<scalar>()).front();
+
+        for (size_t j = 0; j < Car_t::NALGEBRAIC; ++j)
+            qa0[j] = opt_saved.get_element("optimal_laptime/" + algebraic[j]).get_value(std::vector<scalar>()).front();
+
+        optimal_laptime = opt_saved.get_element("optimal_laptime/time").get_value(std::vector<scalar>()).back();
+    }
+
+    Xml_document database      = {"./database/limebeer-2014-f1.xml", true};
+    Xml_document catalunya_xml = {"./database/catalunya_discrete.xml", true};
+    Track_by_polynomial catalunya = {catalunya_xml};
+
+    Driver_t::Reference reference;
+    std::array<scalar,Car_t::NSTATE> q0;
+    std::array<scalar,Car_t::NALGEBRAIC> qa0;
+    scalar optimal_laptime;
+};
+
+
+TEST_F(Driver_model_test, speed_profile)
+{
+    Car_t::Road_t road(catalunya);
+
+    const scalar L = catalunya.get_total_length();
+    const size_t n = 1000;
+    std::vector<scalar> s(n);
+    for (size_t i = 0; i < n; ++i)
+        s[i] = L*i/n;
+
+    const scalar ay_max = 30.0, ax_max = 8.0, ax_min = 40.0, u_max = 90.0;
+    const auto u = Driver_t::compute_speed_profile(road, s, ay_max, ax_max, ax_min, u_max);
+
+    ASSERT_EQ(u.size(), n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const scalar kappa = std::abs(road.get_geometry(s[i])[Car_t::Road_type::IGEOM_KAPPA]);
+
+        EXPECT_LE(u[i], u_max + 1.0e-12);
+        EXPECT_LE(u[i]*u[i]*kappa, ay_max*(1.0 + 1.0e-12));
+
+        if ( i > 0 )
+        {
+            EXPECT_LE(u[i]*u[i] - u[i-1]*u[i-1], 2.0*ax_max*(s[i]-s[i-1])*(1.0 + 1.0e-12));
+            EXPECT_LE(u[i-1]*u[i-1] - u[i]*u[i], 2.0*ax_min*(s[i]-s[i-1])*(1.0 + 1.0e-12));
+        }
+    }
+}
+
+
+TEST_F(Driver_model_test, catalunya_lap)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    Car_t::Road_t road(catalunya);
+    Car_t car(database, road);
+
+    Driver_t driver(reference);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto result = driver.simulate(car, q0, qa0, 0.0, catalunya.get_total_length());
+    const std::chrono::duration<scalar> elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto& statistics = result.statistics;
+
+    out(2) << "[driver_model] lap of " << result.s.size() << " points in " << elapsed.count() << "s. Laptime: " << result.laptime
+           << "s, optimal: " << optimal_laptime << "s" << std::endl;
+    out(2) << "[driver_model] " << statistics.n_steps << " steps, " << statistics.n_function_evaluations << " evaluations, " 
+           << statistics.n_jacobian_evaluations << " jacobians, " << statistics.n_factorizations << " factorizations" << std::endl;
+
+    ASSERT_TRUE(result.success) << result.message;
+
+    // The Jacobian is reused across steps: the cost per step shall be a few evaluations of the vehicle
+    EXPECT_LT(statistics.n_jacobian_evaluations, statistics.n_steps/4);
+    EXPECT_LT(statistics.n_function_evaluations, 6*statistics.n_steps);
+
+    // A full lap shall run well under a second
+    EXPECT_LT(elapsed.count(), 1.0);
+
+    // The driver is not optimal, but it shall stay close to the optimal laptime
+    EXPECT_GT(result.laptime, 0.98*optimal_laptime);
+    EXPECT_LT(result.laptime, 1.10*optimal_laptime);
+
+    // The vehicle shall follow the reference line
+    for (size_t i = 0; i < result.s.size(); ++i)
+        EXPECT_LT(std::abs(result.q[i][Car_t::Road_type::IN]), 6.0) << "with s = " << result.s[i];
+}
+
+
+TEST_F(Driver_model_test, batch)
+{
+    Car_t::Road_t road(catalunya);
+    Car_t car(database, road);
+
+    Driver_t driver(reference);
+
+    // Three setups: the reference, and two different wing settings
+    std::vector<Car_t> cars(3, car);
+    cars[1].set_parameter("vehicle/chassis/aerodynamics/cl", 2.5);
+    cars[2].set_parameter("vehicle/chassis/aerodynamics/cl", 3.5);
+
+    const auto results = driver.simulate_batch(cars, q0, qa0, 0.0, 500.0);
+
+    ASSERT_EQ(results.size(), 3u);
+
+    // The batch shall give the same results as the sequential runs
+    for (size_t k = 0; k < cars.size(); ++k)
+    {
+        Car_t car_k(cars[k]);
+        const auto result = driver.simulate(car_k, q0, qa0, 0.0, 500.0);
+
+        EXPECT_EQ(results[k].success, result.success);
+        ASSERT_EQ(results[k].s.size(), result.s.size());
+
+        for (size_t i = 0; i < result.s.size(); ++i)
+            for (size_t j = 0; j < Car_t::NSTATE; ++j)
+                EXPECT_DOUBLE_EQ(results[k].q[i][j], result.q[i][j]);
+    }
+}
+
+
+TEST_F(Driver_model_test, longitudinal_bounds_from_vehicle)
+{
+    // (1) F1: the throttle is bounded by the vehicle
+    {
+        Car_t::Road_t road(catalunya);
+        Car_t car(database, road);
+
+        const auto vehicle = Driver_t(reference).get_vehicle_properties(car);
+
+        EXPECT_DOUBLE_EQ(vehicle.longitudinal_min, -1.0);
+        EXPECT_DOUBLE_EQ(vehicle.longitudinal_max, 1.0);
+        EXPECT_GT(vehicle.wheelbase, 3.0);
+    }
+
+    // (2) Kart: the rear axle torque is bounded by the vehicle
+    {
+        using Kart_t = lot2016kart<scalar>::curvilinear_p;
+
+        Xml_document kart_database("./database/roberto-lot-kart-2016.xml", true);
+        Kart_t::Road_t road(catalunya);
+        Kart_t kart(kart_database, road);
+
+        Driver_model<Kart_t>::Reference kart_reference = {reference.s, reference.n, reference.u};
+        const auto vehicle = Driver_model<Kart_t>(kart_reference).get_vehicle_properties(kart);
+        const auto [u_lb, u_ub, dudt_lb, dudt_ub] = kart.optimal_laptime_control_bounds();
+
+        EXPECT_DOUBLE_EQ(vehicle.longitudinal_min, u_lb[Driver_model<Kart_t>::ILONGITUDINAL]);
+        EXPECT_DOUBLE_EQ(vehicle.longitudinal_max, u_ub[Driver_model<Kart_t>::ILONGITUDINAL]);
+    }
+
+    // (3) The options override the vehicle
+    {
+        Car_t::Road_t road(catalunya);
+        Car_t car(database, road);
+
+        Driver_t::Options options;
+        options.longitudinal_min = -0.5;
+        options.longitudinal_max = 0.8;
+
+        const auto vehicle = Driver_t(reference, options).get_vehicle_properties(car);
+
+        EXPECT_DOUBLE_EQ(vehicle.longitudinal_min, -0.5);
+        EXPECT_DOUBLE_EQ(vehicle.longitudinal_max, 0.8);
+    }
+}
+
+
+TEST_F(Driver_model_test, s_final_not_after_s_start)
+{
+    Car_t::Road_t road(catalunya);
+    Car_t car(database, road);
+
+    Driver_t driver(reference);
+
+    EXPECT_THROW(driver.simulate(car, q0, qa0, 100.0, 100.0), std::runtime_error);
+    EXPECT_THROW(driver.simulate(car, q0, qa0, 100.0, 50.0), std::runtime_error);
+}
@@ -1,10 +1,12 @@
 #include "gtest/gtest.h"
+#include <filesystem>
 #include "lion/math/matrix_extensions.h"
 #include "src/core/applications/optimal_laptime.h"
 #include "src/core/vehicles/limebeer2014f1.h"
 #include "lion/thirdparty/include/cppad/cppad.hpp"
 #include "src/core/applications/steady_state.h"
 #include "src/core/applications/circuit_preprocessor.h"
+#include "src/core/applications/racing_line.h"
 
 extern bool is_valgrind;
 
@@ -101,6 +103,48 @@ TEST_F(F1_optimal_laptime_test, Catalunya_discrete)
 }
 
 
+TEST_F(F1_optimal_laptime_test, Catalunya_discrete_racing_line)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    Xml_document catalunya_xml("./database/catalunya_discrete.xml",true);
+    Circuit_preprocessor catalunya_pproc(catalunya_xml);
+    Track_by_polynomial catalunya(catalunya_pproc);
+
+    // Use the minimum curvature path as the reference of the curvilinear coordinates
+    Racing_line racing_line(catalunya, 1000);
+    
+    constexpr const size_t n = 500;
+
+    limebeer2014f1<CppAD::AD<scalar>>::curvilinear<Track_by_polynomial>::Road_t road(racing_line.get_track());
+    limebeer2014f1<CppAD::AD<scalar>>::curvilinear<Track_by_polynomial> car(database, road);
+
+    // Start from the steady-state values at 50km/h-0g    
+    const scalar v = 50.0*KMH;
+    auto ss = Steady_state(car_cartesian).solve(v,0.0,0.0); 
+
+    Optimal_laptime opt_laptime(n, true, true, car, ss.q, ss.qa, ss.u, {5.0e0,8.0e-4}, {});
+
+    // The laptime is the one computed around the centerline, and the lateral displacements are smaller
+    Xml_document opt_saved("data/f1_optimal_laptime_catalunya_discrete.xml", true);
+
+    EXPECT_TRUE(opt_laptime.success);
+    EXPECT_NEAR(opt_laptime.laptime, opt_saved.get_element("optimal_laptime/laptime").get_value(scalar()), 0.5);
+
+    auto n_saved = opt_saved.get_element("optimal_laptime/n").get_value(std::vector<scalar>());
+
+    scalar n_centerline = 0.0;
+    scalar n_racing_line = 0.0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        n_centerline += std::abs(n_saved[i]);
+        n_racing_line += std::abs(opt_laptime.q[i][limebeer2014f1<scalar>::curvilinear_p::Road_t::IN]);
+    }
+
+    EXPECT_LT(n_racing_line, n_centerline);
+}
+
 TEST_F(F1_optimal_laptime_test, Catalunya_adapted)
 {
     if ( is_valgrind ) GTEST_SKIP();
@@ -957,3 +1001,55 @@ TEST_F(F1_optimal_laptime_test, Ovaltrack_closed)
     for (size_t i = 0; i < n; ++i)
         EXPECT_NEAR(opt_laptime.u[i][limebeer2014f1<scalar>::Chassis_t::ITHROTTLE], throttle_saved[i], 1.0e-6);
 }
+
+
+TEST_F(F1_optimal_laptime_test, Catalunya_binary)
+{
+    using Optimal_laptime_t = Optimal_laptime<limebeer2014f1<CppAD::AD<scalar>>::curvilinear_p>;
+
+    Xml_document opt_xml("data/f1_optimal_laptime_catalunya_adapted.xml", true);
+    const Optimal_laptime_t opt_saved(opt_xml);
+
+    const std::string filename = (std::filesystem::temp_directory_path() / "fastest-lap-optimal-laptime-test.flcol").string();
+
+    for (const auto compression : {Columnar_file::NONE, Columnar_file::XOR_RLE})
+    {
+        // Write and read the file: the round trip is exact
+        opt_saved.save(filename, compression);
+        const Optimal_laptime_t opt_read(Columnar_file{filename});
+
+        EXPECT_EQ(opt_read.is_closed, opt_saved.is_closed);
+        EXPECT_EQ(opt_read.n_points, opt_saved.n_points);
+        EXPECT_EQ(opt_read.n_elements, opt_saved.n_elements);
+        EXPECT_EQ(opt_read.laptime, opt_saved.laptime);
+        EXPECT_EQ(opt_read.s, opt_saved.s);
+        EXPECT_EQ(opt_read.q, opt_saved.q);
+        EXPECT_EQ(opt_read.qa, opt_saved.qa);
+        EXPECT_EQ(opt_read.u, opt_saved.u);
+        EXPECT_EQ(opt_read.x_coord, opt_saved.x_coord);
+        EXPECT_EQ(opt_read.y_coord, opt_saved.y_coord);
+        EXPECT_EQ(opt_read.psi, opt_saved.psi);
+        EXPECT_EQ(opt_read.optimization_data.zl, opt_saved.optimization_data.zl);
+        EXPECT_EQ(opt_read.optimization_data.zu, opt_saved.optimization_data.zu);
+        EXPECT_EQ(opt_read.optimization_data.lambda, opt_saved.optimization_data.lambda);
+    }
+
+    std::filesystem::remove(filename);
+
+    // The compressed file is smaller
+    const auto data = opt_saved.columnar(Columnar_file::NONE).serialize();
+    const auto data_compressed = opt_saved.columnar(Columnar_file::XOR_RLE).serialize();
+
+    EXPECT_LT(data_compressed.size(), data.size());
+
+    // Corrupted data is detected when its channel is read
+    auto data_corrupted = data;
+    data_corrupted[data_corrupted.size()-1] ^= 1;
+
+    const Columnar_file file_corrupted(data_corrupted);
+    EXPECT_THROW(file_corrupted.get_channel("optimization_data/lambda"), std::runtime_error);
+    EXPECT_NO_THROW(file_corrupted.get_channel("arclength"));
+
+    // Files of other data are rejected
+    EXPECT_THROW(Optimal_laptime_t(Columnar_file(Columnar_file::Writer().add_channel("u",{1.0}).serialize())), std::runtime_error);
+}
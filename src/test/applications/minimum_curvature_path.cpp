@@ -1,4 +1,5 @@
 #include "gtest/gtest.h"
+#include <chrono>
 #include "lion/thirdparty/include/cppad/cppad.hpp"
 
 #define SKIP_TIMESERIES
@@ -6,6 +7,7 @@ using timeseries = CppAD::AD<double>;
 
 #include "src/core/vehicles/track_by_arcs.h"
 #include "src/core/applications/minimum_curvature_path.h"
+#include "lion/thirdparty/include/logger.hpp"
 
 
 TEST(Minimum_curvature_path,oval_50)
@@ -25,3 +27,63 @@ TEST(Minimum_curvature_path,oval_50)
         EXPECT_NEAR(x_saved[i], result.get_x()[i],5.0e-2);
 
 }
+
+
+TEST(Minimum_curvature_path,oval_50_ipopt)
+{
+    Xml_document track_xml("./database/ovaltrack.xml",true);
+    Track_by_arcs oval(track_xml,true);
+
+    Minimum_curvature_path::Options options;
+    options.solver = Minimum_curvature_path::IPOPT;
+
+    Minimum_curvature_path result_ipopt(oval,50,options);
+    Minimum_curvature_path result_qp(oval,50);
+
+    EXPECT_TRUE(result_ipopt.get_success());
+    EXPECT_TRUE(result_qp.get_success());
+
+    for (size_t i = 0; i < 50; ++i)
+        EXPECT_NEAR(result_ipopt.get_x()[i], result_qp.get_x()[i], 5.0e-3);
+
+    // The banded QP solution is not worse than the IPOPT one
+    auto objective = [&](const std::vector<double>& w)
+    {
+        const size_t n = w.size();
+        const double ds = oval.get_total_length()/n;
+        double result = 0.0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double dw = (w[(i+1)%n] - w[(i+n-1)%n])/(2.0*ds);
+            const double d2w = (w[(i+1)%n] + w[(i+n-1)%n] - 2.0*w[i])/(ds*ds);
+            result += oval.pseudo_curvature2_at(i*ds,w[i],dw,d2w)*ds;
+        }
+
+        return result;
+    };
+
+    EXPECT_LE(objective(result_qp.get_x()), objective(result_ipopt.get_x()) + 1.0e-10);
+}
+
+
+TEST(Minimum_curvature_path,oval_5000)
+{
+    Xml_document track_xml("./database/ovaltrack.xml",true);
+    Track_by_arcs oval(track_xml,true);
+
+    const auto start = std::chrono::steady_clock::now();
+    Minimum_curvature_path result(oval,5000);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    out(2) << "[Minimum_curvature_path] 5000 points: " << elapsed.count() << "s (" << result.get_iterations() << " iterations)" << std::endl;
+
+    EXPECT_TRUE(result.get_success());
+    EXPECT_EQ(result.get_x().size(), 5000u);
+
+    for (const auto& w : result.get_x())
+    {
+        EXPECT_LE(w, 10.0);
+        EXPECT_GE(w, -10.0);
+    }
+}
@@ -0,0 +1,116 @@
+#include "gtest/gtest.h"
+#include "src/core/vehicles/track_by_arcs.h"
+#include "src/core/vehicles/track_by_polynomial.h"
+#include "src/core/vehicles/track_projection.h"
+#include "src/core/applications/racing_line.h"
+
+
+TEST(Racing_line_test, ovaltrack)
+{
+    Xml_document track_xml("./database/ovaltrack.xml",true);
+    Track_by_arcs oval(track_xml,true);
+
+    constexpr const size_t n = 1000;
+
+    Racing_line racing_line(oval, n, true);
+    Minimum_curvature_path path(oval, n);
+
+    const auto& circuit = racing_line.get_track().get_preprocessor();
+
+    EXPECT_TRUE(circuit.is_closed);
+    EXPECT_EQ(circuit.n_points, n);
+
+    // The racing line is the minimum curvature path
+    for (size_t i = 0; i < n; ++i)
+        EXPECT_NEAR(racing_line.get_minimum_curvature_path().get_x()[i], path.get_x()[i], 1.0e-10);
+
+    // It is shorter and less curved than the centerline
+    EXPECT_LT(racing_line.get_track().get_total_length(), oval.get_total_length());
+
+    scalar kappa2_centerline = 0.0;
+    scalar kappa2_racing_line = 0.0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const auto [r, dr, d2r] = oval(racing_line.get_original_arclength()[i]);
+        kappa2_centerline += (dr[0]*d2r[1] - dr[1]*d2r[0])*(dr[0]*d2r[1] - dr[1]*d2r[0]);
+        kappa2_racing_line += circuit.kappa[i]*circuit.kappa[i];
+    }
+
+    EXPECT_LT(kappa2_racing_line, 0.75*kappa2_centerline);
+
+    // The new track limits are the limits of the oval: 10m from its centerline
+    for (size_t i = 0; i < n; i += 50)
+    {
+        for (const auto& p : {racing_line.get_track().get_preprocessor().r_left[i], racing_line.get_track().get_preprocessor().r_right[i]})
+        {
+            const sVector3d q(p.x(), -p.y(), 0.0);
+            scalar distance = 1.0e10;
+
+            for (scalar s = 0.0; s < oval.get_total_length(); s += 0.1)
+                distance = std::min(distance, norm(q - std::get<0>(oval(s))));
+
+            EXPECT_NEAR(distance, 10.0, 1.0e-3);
+        }
+    }
+}
+
+
+TEST(Racing_line_test, catalunya)
+{
+    Xml_document catalunya_xml = {"./database/catalunya_discrete.xml", true};
+    const Track_by_polynomial catalunya(catalunya_xml);
+
+    constexpr const size_t n = 1000;
+
+    Racing_line racing_line(catalunya, n);
+
+    const auto& path = racing_line.get_minimum_curvature_path();
+    const auto& track = racing_line.get_track();
+
+    EXPECT_TRUE(path.get_success());
+    EXPECT_TRUE(track.get_preprocessor().is_closed);
+    EXPECT_LT(track.get_total_length(), catalunya.get_total_length());
+
+    // The offsets satisfy the original track limits, and the new track limits are positive
+    for (size_t i = 0; i < n; ++i)
+    {
+        const scalar s = racing_line.get_original_arclength()[i];
+
+        EXPECT_LE(path.get_x()[i], catalunya.get_right_track_limit(s) + 1.0e-8);
+        EXPECT_GE(path.get_x()[i], -catalunya.get_left_track_limit(s) - 1.0e-8);
+        EXPECT_GE(track.get_preprocessor().nl[i], -1.0e-8);
+        EXPECT_GE(track.get_preprocessor().nr[i], -1.0e-8);
+    }
+
+    // The nodes of the racing line project onto the original track at their arclength and offset
+    const Track_projection projection(catalunya);
+
+    for (size_t i = 0; i < n; i += 10)
+    {
+        const auto r = std::get<0>(track(track.get_preprocessor().s[i]));
+        const auto result = projection.project(r);
+
+        EXPECT_NEAR(result.s, racing_line.get_original_arclength()[i], 1.0e-3);
+        EXPECT_NEAR(result.n, path.get_x()[i], 1.0e-3);
+    }
+
+    // The new track limits project onto the original track limits: the left limit at -wl, the right limit at +wr. The 
+    // catalunya limits are not symmetric, and the tolerance accounts for the limits assumed locally parallel to the centerline
+    for (size_t i = 0; i < n; i += 10)
+    {
+        const scalar s = track.get_preprocessor().s[i];
+
+        const auto left = projection.project(track.position_at(s, -track.get_left_track_limit(s)));
+        EXPECT_NEAR(left.n, -catalunya.get_left_track_limit(left.s), 0.25) << "with i = " << i;
+
+        const auto right = projection.project(track.position_at(s, track.get_right_track_limit(s)));
+        EXPECT_NEAR(right.n, catalunya.get_right_track_limit(right.s), 0.25) << "with i = " << i;
+    }
+
+    // The new track can be written and read as any preprocessed circuit
+    auto doc = track.get_preprocessor().xml();
+    const Track_by_polynomial track_read(*doc);
+
+    EXPECT_NEAR(track_read.get_total_length(), track.get_total_length(), 1.0e-6);
+}
@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include "src/core/applications/trajectory_linearisation.h"
+#include "src/core/applications/steady_state.h"
+#include "src/core/vehicles/limebeer2014f1.h"
+
+extern bool is_valgrind;
+
+class Trajectory_linearisation_test : public ::testing::Test
+{
+ protected:
+    using Car_t = limebeer2014f1<CppAD::AD<scalar>>::curvilinear<Track_by_arcs>;
+
+    Trajectory_linearisation_test()
+    {
+        // Construct a trajectory from the steady-state at 100km/h with varying lateral position and heading
+        auto ss = Steady_state(car_cartesian).solve(100.0*KMH,0.0,0.0);
+
+        const scalar L = car.get_road().track_length();
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            s.push_back(L*i/n);
+            q.push_back(ss.q);
+            qa.push_back(ss.qa);
+            u.push_back(ss.u);
+
+            q.back()[Car_t::Road_type::IN]     = 2.0*sin(2.0*pi*s.back()/L);
+            q.back()[Car_t::Road_type::IALPHA] = 2.0*DEG*cos(6.0*pi*s.back()/L);
+            u.back()[0] = 1.0*DEG*sin(4.0*pi*s.back()/L);
+        }
+    }
+
+    Xml_document database      = {"./database/limebeer-2014-f1.xml", true};
+    Xml_document ovaltrack_xml = {"./database/ovaltrack.xml", true};
+    Track_by_arcs ovaltrack    = {ovaltrack_xml,1.0,true};
+
+    limebeer2014f1<CppAD::AD<scalar>>::cartesian car_cartesian = { database };
+    Car_t car = { database, Car_t::Road_t(ovaltrack) };
+
+    const size_t n = 100;
+    std::vector<scalar> s;
+    std::vector<std::array<scalar,Car_t::NSTATE>> q;
+    std::vector<std::array<scalar,Car_t::NALGEBRAIC>> qa;
+    std::vector<std::array<scalar,Car_t::NCONTROL>> u;
+};
+
+
+TEST_F(Trajectory_linearisation_test, same_as_vehicle_equations)
+{
+    Trajectory_linearisation linearisation(car, s, q, qa, u);
+
+    EXPECT_EQ(linearisation.size(), n);
+
+    constexpr const size_t NSTATE  = Car_t::NSTATE;
+    constexpr const size_t NALG    = Car_t::NALGEBRAIC;
+    constexpr const size_t NINPUTS = Car_t::NINPUTS;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto equations = car.equations(q[i], qa[i], u[i], s[i]);
+
+        for (size_t j = 0; j < NSTATE; ++j)
+        {
+            EXPECT_NEAR(linearisation.get_dqdt(i)[j], equations.dqdt[j], 1.0e-10*std::max(1.0,fabs(equations.dqdt[j]))) << "with i = " << i << " and j = " << j;
+
+            for (size_t k = 0; k < NINPUTS; ++k)
+                EXPECT_NEAR(linearisation.jacobian(i,j,k), equations.jac_dqdt[j][k], 1.0e-10*std::max(1.0,fabs(equations.jac_dqdt[j][k])))
+                    << "with i = " << i << ", j = " << j << " and k = " << k;
+        }
+
+        for (size_t j = 0; j < NALG; ++j)
+        {
+            EXPECT_NEAR(linearisation.get_dqa(i)[j], equations.dqa[j], 1.0e-10*std::max(1.0,fabs(equations.dqa[j]))) << "with i = " << i << " and j = " << j;
+
+            for (size_t k = 0; k < NINPUTS; ++k)
+                EXPECT_NEAR(linearisation.jacobian(i,NSTATE+j,k), equations.jac_dqa[j][k], 1.0e-10*std::max(1.0,fabs(equations.jac_dqa[j][k])))
+                    << "with i = " << i << ", j = " << j << " and k = " << k;
+        }
+
+        // Check the A, B, and C accessors
+        EXPECT_DOUBLE_EQ(linearisation.get_A(i,0,1), equations.jac_dqdt[0][1]);
+        EXPECT_DOUBLE_EQ(linearisation.get_B(i,0,1), equations.jac_dqdt[0][NSTATE+NALG+1]);
+        EXPECT_DOUBLE_EQ(linearisation.get_C(i,0,1), equations.jac_dqdt[0][NSTATE+1]);
+    }
+}
+
+
+TEST_F(Trajectory_linearisation_test, variable_parameters)
+{
+    // With variable parameters, all the points are computed through the vehicle equations
+    const scalar L = car.get_road().track_length();
+    car.add_variable_parameter("vehicle/rear-axle/engine/maximum-power", sPolynomial({0.0, L}, {735.499, 1000.0}, 1, false));
+
+    Trajectory_linearisation linearisation(car, s, q, qa, u);
+
+    EXPECT_EQ(linearisation.get_number_of_fallback_points(), n);
+
+    for (size_t i = 0; i < n; i += 10)
+    {
+        auto equations = car.equations(q[i], qa[i], u[i], s[i]);
+
+        for (size_t j = 0; j < Car_t::NSTATE; ++j)
+            for (size_t k = 0; k < Car_t::NINPUTS; ++k)
+                EXPECT_NEAR(linearisation.jacobian(i,j,k), equations.jac_dqdt[j][k], 1.0e-10*std::max(1.0,fabs(equations.jac_dqdt[j][k])))
+                    << "with i = " << i << ", j = " << j << " and k = " << k;
+    }
+}
+
+
+TEST_F(Trajectory_linearisation_test, benchmark)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    // Repeat the trajectory to obtain a full lap resolution
+    const size_t n_repeat = 40;
+    std::vector<scalar> s_lap;
+    std::vector<std::array<scalar,Car_t::NSTATE>> q_lap;
+    std::vector<std::array<scalar,Car_t::NALGEBRAIC>> qa_lap;
+    std::vector<std::array<scalar,Car_t::NCONTROL>> u_lap;
+
+    for (size_t r = 0; r < n_repeat; ++r)
+    {
+        s_lap.insert(s_lap.end(), s.cbegin(), s.cend());
+        q_lap.insert(q_lap.end(), q.cbegin(), q.cend());
+        qa_lap.insert(qa_lap.end(), qa.cbegin(), qa.cend());
+        u_lap.insert(u_lap.end(), u.cbegin(), u.cend());
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    Trajectory_linearisation linearisation(car, s_lap, q_lap, qa_lap, u_lap);
+    const auto end = std::chrono::steady_clock::now();
+
+    out(2) << "[trajectory_linearisation] " << linearisation.size() << " points in " << std::chrono::duration<scalar>(end-start).count()
+           << "s, " << linearisation.get_number_of_fallback_points() << " fallback points" << std::endl;
+
+    for (size_t i = 0; i < n; ++i)
+        EXPECT_DOUBLE_EQ(linearisation.jacobian((n_repeat-1)*n+i,0,0), linearisation.jacobian(i,0,0));
+}
@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+#include "src/core/applications/vehicle_channels.h"
+#include "src/core/applications/steady_state.h"
+#include "src/core/vehicles/limebeer2014f1.h"
+
+class Vehicle_channels_test : public ::testing::Test
+{
+ protected:
+    using Car_t = limebeer2014f1<scalar>::curvilinear<Track_by_arcs>;
+
+    Vehicle_channels_test()
+    {
+        // Construct a trajectory from the steady-state at 100km/h with varying lateral position
+        auto ss = Steady_state(car_cartesian).solve(100.0*KMH,0.0,0.0);
+
+        const scalar L = car.get_road().track_length();
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            s.push_back(L*i/n);
+            q.push_back(ss.q);
+            qa.push_back(ss.qa);
+            u.push_back(ss.u);
+
+            q.back()[Car_t::Road_type::IN] = 2.0*sin(2.0*pi*s.back()/L);
+        }
+    }
+
+    Xml_document database      = {"./database/limebeer-2014-f1.xml", true};
+    Xml_document ovaltrack_xml = {"./database/ovaltrack.xml", true};
+    Track_by_arcs ovaltrack    = {ovaltrack_xml,1.0,true};
+
+    limebeer2014f1<CppAD::AD<scalar>>::cartesian car_cartesian = { database };
+    Car_t car = { database, Car_t::Road_t(ovaltrack) };
+
+    const size_t n = 50;
+    std::vector<scalar> s;
+    std::vector<std::array<scalar,Car_t::NSTATE>> q;
+    std::vector<std::array<scalar,Car_t::NALGEBRAIC>> qa;
+    std::vector<std::array<scalar,Car_t::NCONTROL>> u;
+};
+
+
+TEST_F(Vehicle_channels_test, same_as_vehicle)
+{
+    Vehicle_channels<Car_t> channels({"s", "n", "u", "x", "psi", "throttle", "Fz_fl", "front_axle.left_tire.kappa", "rear_axle.right_tire.Fy"});
+
+    const auto columns = channels.compute(car, s, q, qa, u);
+
+    EXPECT_EQ(columns.size(), channels.size());
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        car(q[i], qa[i], u[i], s[i]);
+
+        EXPECT_DOUBLE_EQ(columns[0][i], s[i]);
+        EXPECT_DOUBLE_EQ(columns[1][i], q[i][Car_t::Road_type::IN]);
+        EXPECT_DOUBLE_EQ(columns[2][i], q[i][Car_t::Chassis_type::IU]);
+        EXPECT_DOUBLE_EQ(columns[3][i], car.get_road().get_x());
+        EXPECT_DOUBLE_EQ(columns[4][i], car.get_road().get_psi());
+        EXPECT_DOUBLE_EQ(columns[5][i], u[i][Car_t::Chassis_type::ITHROTTLE]);
+        EXPECT_DOUBLE_EQ(columns[6][i], qa[i][Car_t::Chassis_type::IFZFL]);
+        EXPECT_DOUBLE_EQ(columns[7][i], car.get_chassis().get_front_axle().get_tire<0>().get_kappa());
+        EXPECT_DOUBLE_EQ(columns[8][i], car.get_chassis().get_rear_axle().get_tire<1>().get_force().at(1));
+
+        // Single point evaluation
+        std::vector<scalar> values(channels.size());
+        channels.evaluate(car, q[i], qa[i], u[i], s[i], values.data());
+
+        for (size_t j = 0; j < channels.size(); ++j)
+            EXPECT_DOUBLE_EQ(values[j], columns[j][i]);
+    }
+}
+
+
+TEST_F(Vehicle_channels_test, undefined_channel)
+{
+    EXPECT_THROW(Vehicle_channels<Car_t>({"u", "front_axle.center_tire.kappa"}), std::runtime_error);
+}
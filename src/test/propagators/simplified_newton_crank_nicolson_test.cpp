@@ -0,0 +1,336 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include "src/core/vehicles/limebeer2014f1.h"
+#include "src/core/vehicles/lot2016kart.h"
+#include "src/core/applications/circuit_preprocessor.h"
+#include "src/core/propagators/simplified_newton_crank_nicolson.h"
+#include "lion/thirdparty/include/cppad/cppad.hpp"
+#include "lion/propagators/crank_nicolson.h"
+
+extern bool is_valgrind;
+
+class Simplified_newton_crank_nicolson_test : public ::testing::Test
+{
+ protected:
+    using F1_t   = limebeer2014f1<CppAD::AD<scalar>>::curvilinear_p;
+    using Kart_t = lot2016kart<CppAD::AD<scalar>>::curvilinear_p;
+
+    using F1_scalar_t   = limebeer2014f1<scalar>::curvilinear_p;
+    using Kart_scalar_t = lot2016kart<scalar>::curvilinear_p;
+
+    //! A trajectory loaded from a saved optimal laptime
+    template<typename Dynamic_model_t>
+    struct Trajectory
+    {
+        std::vector<scalar> s;
+        std::vector<std::array<scalar,Dynamic_model_t::NSTATE>> q;
+        std::vector<std::array<scalar,Dynamic_model_t::NALGEBRAIC>> qa;
+        std::vector<std::array<scalar,Dynamic_model_t::NCONTROL>> u;
+    };
+
+    Simplified_newton_crank_nicolson_test()
+    {
+        // (1) F1 on Catalunya
+        Xml_document f1_saved("data/f1_optimal_laptime_catalunya_discrete.xml", true);
+
+        f1_trajectory.s = f1_saved.get_element("optimal_laptime/arclength").get_value(std::vector<scalar>());
+
+        const std::vector<std::string> f1_states = {"steering-kappa-left", "steering-kappa-right", "powered-kappa-left", "powered-kappa-right",
+                                                    "u", "v", "omega", "time", "n", "alpha"};
+        const std::vector<std::string> f1_algebraic = {"Fz_fl", "Fz_fr", "Fz_rl", "Fz_rr"};
+        const std::vector<std::string> f1_controls = {"delta", "throttle"};
+
+        f1_trajectory.q  = read_columns<F1_t::NSTATE>(f1_saved, f1_states);
+        f1_trajectory.qa = read_columns<F1_t::NALGEBRAIC>(f1_saved, f1_algebraic);
+        f1_trajectory.u  = read_columns<F1_t::NCONTROL>(f1_saved, f1_controls);
+
+        // (2) Kart on Vendrell
+        Xml_document kart_saved("data/vendrell_optimal.xml", true);
+
+        kart_trajectory.s = kart_saved.get_element("optimal_laptime/arclength").get_value(std::vector<scalar>());
+
+        std::vector<std::string> kart_states(Kart_t::NSTATE);
+        kart_states[lot2016kart<scalar>::Rear_axle_t::IOMEGA_AXLE] = "axle-omega";
+        kart_states[lot2016kart<scalar>::Chassis_t::IU]            = "u";
+        kart_states[lot2016kart<scalar>::Chassis_t::IV]            = "v";
+        kart_states[lot2016kart<scalar>::Chassis_t::IOMEGA]        = "omega";
+        kart_states[lot2016kart<scalar>::Chassis_t::IZ]            = "z";
+        kart_states[lot2016kart<scalar>::Chassis_t::IPHI]          = "phi";
+        kart_states[lot2016kart<scalar>::Chassis_t::IMU]           = "mu";
+        kart_states[lot2016kart<scalar>::Chassis_t::IDZ]           = "dzdt";
+        kart_states[lot2016kart<scalar>::Chassis_t::IDPHI]         = "dphidt";
+        kart_states[lot2016kart<scalar>::Chassis_t::IDMU]          = "dmudt";
+        kart_states[Kart_t::Road_type::ITIME]                      = "time";
+        kart_states[Kart_t::Road_type::IN]                         = "n";
+        kart_states[Kart_t::Road_type::IALPHA]                     = "alpha";
+
+        std::vector<std::string> kart_controls(Kart_t::NCONTROL);
+        kart_controls[lot2016kart<scalar>::Front_axle_t::ISTEERING] = "delta";
+        kart_controls[lot2016kart<scalar>::Rear_axle_t::ITORQUE]    = "torque";
+
+        kart_trajectory.q  = read_columns<Kart_t::NSTATE>(kart_saved, kart_states);
+        kart_trajectory.qa.resize(kart_trajectory.s.size());
+        kart_trajectory.u  = read_columns<Kart_t::NCONTROL>(kart_saved, kart_controls);
+    }
+
+    //! Read the given columns of a saved optimal laptime as a vector of arrays
+    template<size_t N>
+    static std::vector<std::array<scalar,N>> read_columns(Xml_document& saved, const std::vector<std::string>& names)
+    {
+        std::vector<std::array<scalar,N>> result;
+
+        for (size_t j = 0; j < N; ++j)
+        {
+            const auto column = saved.get_element("optimal_laptime/" + names.at(j)).get_value(std::vector<scalar>());
+            result.resize(column.size());
+
+            for (size_t i = 0; i < column.size(); ++i)
+                result[i][j] = column[i];
+        }
+
+        return result;
+    }
+
+    //! Run n_steps with lion's Crank-Nicolson and with the simplified Newton propagator, and check that both agree
+    template<typename Dynamic_model_t>
+    static void check_fixed_steps(Dynamic_model_t& car, const Trajectory<Dynamic_model_t>& trajectory, const size_t i_start, const size_t n_steps)
+    {
+        check_fixed_steps(car, car, trajectory, i_start, n_steps);
+    }
+
+    //! Same as check_fixed_steps, with the simplified Newton propagator on a different vehicle (e.g. the scalar version of car_reference)
+    template<typename Reference_model_t, typename Dynamic_model_t>
+    static void check_fixed_steps(Reference_model_t& car_reference, Dynamic_model_t& car, const Trajectory<Reference_model_t>& trajectory, 
+                                  const size_t i_start, const size_t n_steps)
+    {
+        constexpr size_t NSTATE     = Reference_model_t::NSTATE;
+        constexpr size_t NALGEBRAIC = Reference_model_t::NALGEBRAIC;
+        constexpr size_t NCONTROL   = Reference_model_t::NCONTROL;
+
+        auto q_reference  = trajectory.q[i_start];
+        auto qa_reference = trajectory.qa[i_start];
+        auto q            = trajectory.q[i_start];
+        auto qa           = trajectory.qa[i_start];
+
+        Simplified_newton_crank_nicolson<Dynamic_model_t> propagator(car);
+
+        for (size_t i = i_start; i < i_start + n_steps; ++i)
+        {
+            const scalar ds = trajectory.s[i+1] - trajectory.s[i];
+
+            Crank_nicolson<Reference_model_t,NSTATE,NALGEBRAIC,NCONTROL>::take_step(car_reference, trajectory.u[i], trajectory.u[i+1], 
+                                                                                    q_reference, qa_reference, trajectory.s[i], ds, {});
+
+            propagator.take_step(trajectory.u[i], trajectory.u[i+1], q, qa, trajectory.s[i], ds);
+
+            for (size_t j = 0; j < NSTATE; ++j)
+                EXPECT_NEAR(q[j], q_reference[j], 1.0e-8*std::max(1.0,std::abs(q_reference[j]))) << "with i = " << i << ", j = " << j;
+
+            for (size_t j = 0; j < NALGEBRAIC; ++j)
+                EXPECT_NEAR(qa[j], qa_reference[j], 1.0e-8*std::max(1.0,std::abs(qa_reference[j]))) << "with i = " << i << ", j = " << j;
+        }
+
+        // The Jacobian shall have been reused across steps
+        const auto& statistics = propagator.get_statistics();
+        EXPECT_EQ(statistics.n_steps, n_steps);
+        EXPECT_LT(statistics.n_jacobian_evaluations, n_steps);
+    }
+
+    //! Integrate with adaptive step size between two points of the trajectory, with linearly interpolated controls
+    template<typename Dynamic_model_t>
+    static void check_adaptive(Dynamic_model_t& car, const Trajectory<Dynamic_model_t>& trajectory, const size_t i_start, const size_t i_end,
+                               const scalar tolerance)
+    {
+        constexpr size_t NCONTROL = Dynamic_model_t::NCONTROL;
+
+        auto control = [&](const scalar s)
+        {
+            size_t i = i_start;
+            while ( (i < i_end - 1) && (trajectory.s[i+1] <= s) ) ++i;
+
+            const scalar xi = (s - trajectory.s[i])/(trajectory.s[i+1] - trajectory.s[i]);
+            std::array<scalar,NCONTROL> u;
+
+            for (size_t j = 0; j < NCONTROL; ++j)
+                u[j] = (1.0-xi)*trajectory.u[i][j] + xi*trajectory.u[i+1][j];
+
+            return u;
+        };
+
+        typename Simplified_newton_crank_nicolson<Dynamic_model_t>::Options options;
+        options.ds_initial = trajectory.s[i_start+1] - trajectory.s[i_start];
+        options.relative_tolerance = 1.0e-6;
+
+        Simplified_newton_crank_nicolson<Dynamic_model_t> propagator(car, options);
+
+        auto q  = trajectory.q[i_start];
+        auto qa = trajectory.qa[i_start];
+
+        propagator.integrate(control, q, qa, trajectory.s[i_start], trajectory.s[i_end]);
+
+        const auto& q_saved = trajectory.q[i_end];
+
+        for (size_t j = 0; j < Dynamic_model_t::NSTATE; ++j)
+            EXPECT_NEAR(q[j], q_saved[j], tolerance*std::max(1.0,std::abs(q_saved[j]))) << "with j = " << j;
+
+        const auto& statistics = propagator.get_statistics();
+        EXPECT_GT(statistics.n_steps, 0u);
+        EXPECT_LT(statistics.n_jacobian_evaluations, statistics.n_steps + statistics.n_rejected_steps);
+    }
+
+    //! Time n_steps with lion's Crank-Nicolson and with the simplified Newton propagator
+    template<typename Dynamic_model_t>
+    static void benchmark(const std::string& name, Dynamic_model_t& car, const Trajectory<Dynamic_model_t>& trajectory, const size_t n_steps)
+    {
+        constexpr size_t NSTATE     = Dynamic_model_t::NSTATE;
+        constexpr size_t NALGEBRAIC = Dynamic_model_t::NALGEBRAIC;
+        constexpr size_t NCONTROL   = Dynamic_model_t::NCONTROL;
+
+        // (1) lion's Crank-Nicolson: Jacobian and factorization on every iteration
+        auto q  = trajectory.q.front();
+        auto qa = trajectory.qa.front();
+
+        const auto start_reference = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n_steps; ++i)
+            Crank_nicolson<Dynamic_model_t,NSTATE,NALGEBRAIC,NCONTROL>::take_step(car, trajectory.u[i], trajectory.u[i+1], q, qa,
+                                                                                  trajectory.s[i], trajectory.s[i+1] - trajectory.s[i], {});
+        const std::chrono::duration<double> elapsed_reference = std::chrono::steady_clock::now() - start_reference;
+
+        // (2) Simplified Newton
+        q  = trajectory.q.front();
+        qa = trajectory.qa.front();
+
+        Simplified_newton_crank_nicolson<Dynamic_model_t> propagator(car);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n_steps; ++i)
+            propagator.take_step(trajectory.u[i], trajectory.u[i+1], q, qa, trajectory.s[i], trajectory.s[i+1] - trajectory.s[i]);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const auto& statistics = propagator.get_statistics();
+
+        out(2) << "[" << name << "] " << n_steps << " steps" << std::endl;
+        out(2) << "    Crank_nicolson:                   " << elapsed_reference.count() << "s" << std::endl;
+        out(2) << "    Simplified_newton_crank_nicolson: " << elapsed.count() << "s (" << statistics.n_newton_iterations << " iterations, "
+               << statistics.n_jacobian_evaluations << " jacobians, " << statistics.n_factorizations << " factorizations)" << std::endl;
+
+        EXPECT_LT(statistics.n_jacobian_evaluations, n_steps);
+    }
+
+    Xml_document f1_database   = {"./database/limebeer-2014-f1.xml", true};
+    Xml_document kart_database = {"./database/rental-kart.xml", true};
+
+    Xml_document catalunya_xml = {"./database/catalunya_discrete.xml", true};
+    Xml_document vendrell_xml  = {"./database/vendrell.xml", true};
+
+    Trajectory<F1_t> f1_trajectory;
+    Trajectory<Kart_t> kart_trajectory;
+};
+
+
+TEST_F(Simplified_newton_crank_nicolson_test, f1_fixed_steps)
+{
+    Track_by_polynomial catalunya(catalunya_xml);
+    F1_t::Road_t road(catalunya);
+    F1_t car(f1_database, road);
+
+    // Straight and corner entry
+    check_fixed_steps(car, f1_trajectory, 90, 20);
+}
+
+
+TEST_F(Simplified_newton_crank_nicolson_test, kart_fixed_steps)
+{
+    Circuit_preprocessor vendrell_pproc(vendrell_xml);
+    Track_by_polynomial vendrell(vendrell_pproc);
+    Kart_t::Road_t road(vendrell);
+    Kart_t car(kart_database, road);
+    car.get_chassis().get_rear_axle().enable_direct_torque();
+
+    check_fixed_steps(car, kart_trajectory, 100, 20);
+}
+
+
+TEST_F(Simplified_newton_crank_nicolson_test, f1_fixed_steps_scalar)
+{
+    Track_by_polynomial catalunya(catalunya_xml);
+    F1_t::Road_t road(catalunya);
+    F1_t car(f1_database, road);
+
+    F1_scalar_t::Road_t road_scalar(catalunya);
+    F1_scalar_t car_scalar(f1_database, road_scalar);
+
+    check_fixed_steps(car, car_scalar, f1_trajectory, 90, 20);
+}
+
+
+TEST_F(Simplified_newton_crank_nicolson_test, kart_fixed_steps_scalar)
+{
+    Circuit_preprocessor vendrell_pproc(vendrell_xml);
+    Track_by_polynomial vendrell(vendrell_pproc);
+    Kart_t::Road_t road(vendrell);
+    Kart_t car(kart_database, road);
+    car.get_chassis().get_rear_axle().enable_direct_torque();
+
+    Kart_scalar_t::Road_t road_scalar(vendrell);
+    Kart_scalar_t car_scalar(kart_database, road_scalar);
+    car_scalar.get_chassis().get_rear_axle().enable_direct_torque();
+
+    check_fixed_steps(car, car_scalar, kart_trajectory, 100, 20);
+}
+
+
+TEST_F(Simplified_newton_crank_nicolson_test, f1_adaptive)
+{
+    Track_by_polynomial catalunya(catalunya_xml);
+    F1_t::Road_t road(catalunya);
+    F1_t car(f1_database, road);
+
+    // The saved trajectory is itself a Crank-Nicolson solution on a fixed mesh: agreement is up to its discretization error
+    check_adaptive(car, f1_trajectory, 90, 110, 1.0e-3);
+}
+
+
+TEST_F(Simplified_newton_crank_nicolson_test, benchmark)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    Track_by_polynomial catalunya(catalunya_xml);
+    F1_t::Road_t f1_road(catalunya);
+    F1_t f1(f1_database, f1_road);
+
+    benchmark("limebeer2014f1", f1, f1_trajectory, 200);
+
+    Circuit_preprocessor vendrell_pproc(vendrell_xml);
+    Track_by_polynomial vendrell(vendrell_pproc);
+    Kart_t::Road_t kart_road(vendrell);
+    Kart_t kart(kart_database, kart_road);
+    kart.get_chassis().get_rear_axle().enable_direct_torque();
+
+    benchmark("lot2016kart", kart, kart_trajectory, 200);
+}
+
+
+TEST_F(Simplified_newton_crank_nicolson_test, f1_adaptive_error_at_minimum_step_size)
+{
+    Track_by_polynomial catalunya(catalunya_xml);
+    F1_scalar_t::Road_t road(catalunya);
+    F1_scalar_t car(f1_database, road);
+
+    // The tolerances cannot be met with the minimum step size: the step is not accepted
+    Simplified_newton_crank_nicolson<F1_scalar_t>::Options options;
+    options.ds_initial = 5.0;
+    options.ds_min = 5.0;
+    options.relative_tolerance = 1.0e-14;
+    options.absolute_tolerance = 1.0e-14;
+
+    Simplified_newton_crank_nicolson<F1_scalar_t> propagator(car, options);
+
+    auto q  = f1_trajectory.q[90];
+    auto qa = f1_trajectory.qa[90];
+
+    const auto control = [&](const scalar) { return f1_trajectory.u[90]; };
+
+    EXPECT_THROW(propagator.integrate(control, q, qa, f1_trajectory.s[90], f1_trajectory.s[90] + 20.0), std::runtime_error);
+    EXPECT_EQ(propagator.get_statistics().n_steps, 0u);
+}
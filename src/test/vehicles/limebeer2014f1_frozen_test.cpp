@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include "src/core/vehicles/limebeer2014f1.h"
+#include "src/core/vehicles/frozen/limebeer_2014_f1_frozen.h"
+
+extern bool is_valgrind;
+
+using Frozen_params = limebeer_2014_f1_frozen;
+
+class limebeer2014f1_frozen_test : public testing::Test
+{
+ protected:
+    limebeer2014f1_frozen_test() { frozen_database.parse(Frozen_params::database); }
+
+    Xml_document database   = {"./database/limebeer-2014-f1.xml", true};
+    Xml_document frozen_database;
+
+    // Inputs: 0g trim at 300km/h and made up inputs
+    std::vector<std::array<scalar,10>> q0  = { {0.0, 0.0, 0.0111971, 0.0111971, 83.3333, 0.0, 0.0, 0.0, 0.0, 0.0},
+                                               {-0.05, -0.08, 0.0200000, 0.0800000, 50.0000, -5.0, 0.4, 0.0, 0.0, 5.0*DEG} };
+    std::vector<std::array<scalar,4>>  qa0 = { {-0.874103, -0.874103, -1.07386, -1.07386},
+                                               {-0.674103, -0.474103, -0.80386, -0.70386} };
+    std::vector<std::array<scalar,2>>  u0  = { {0.0, 0.644468},
+                                               {-2.0*DEG, 0.100000} };
+};
+
+
+static_assert(limebeer2014f1<scalar,Frozen_params>::cartesian::NSTATE     == limebeer2014f1<scalar>::cartesian::NSTATE);
+static_assert(limebeer2014f1<scalar,Frozen_params>::cartesian::NALGEBRAIC == limebeer2014f1<scalar>::cartesian::NALGEBRAIC);
+static_assert(limebeer2014f1<scalar,Frozen_params>::cartesian::NCONTROL   == limebeer2014f1<scalar>::cartesian::NCONTROL);
+
+
+TEST_F(limebeer2014f1_frozen_test, same_equations_as_runtime_model)
+{
+    limebeer2014f1<scalar>::cartesian               car(database);
+    limebeer2014f1<scalar,Frozen_params>::cartesian car_frozen(frozen_database);
+
+    for (size_t i = 0; i < q0.size(); ++i)
+    {
+        auto [dqdt, dqa]               = car(q0[i],qa0[i],u0[i],0.0);
+        auto [dqdt_frozen, dqa_frozen] = car_frozen(q0[i],qa0[i],u0[i],0.0);
+
+        for (size_t j = 0; j < dqdt.size(); ++j)
+            EXPECT_NEAR(dqdt_frozen[j], dqdt[j], 1.0e-10*std::max(1.0,fabs(dqdt[j]))) << "with i = " << i << " and j = " << j;
+
+        for (size_t j = 0; j < dqa.size(); ++j)
+            EXPECT_NEAR(dqa_frozen[j], dqa[j], 1.0e-10*std::max(1.0,fabs(dqa[j]))) << "with i = " << i << " and j = " << j;
+    }
+}
+
+
+TEST_F(limebeer2014f1_frozen_test, frozen_parameters_cannot_be_modified)
+{
+    limebeer2014f1<scalar,Frozen_params>::cartesian car_frozen(frozen_database);
+
+    EXPECT_THROW(car_frozen.set_parameter("vehicle/front-tire/mu-x-max-1", 1.0), std::runtime_error);
+
+    // Parameters that are not frozen can still be modified
+    car_frozen.set_parameter("vehicle/chassis/mass", 700.0);
+}
+
+
+TEST_F(limebeer2014f1_frozen_test, frozen_parameters_are_written)
+{
+    limebeer2014f1<scalar>::cartesian               car(database);
+    limebeer2014f1<scalar,Frozen_params>::cartesian car_frozen(frozen_database);
+
+    // The xml of the frozen car contains the tire parameters, with the same values as the runtime car
+    auto xml = car.xml();
+    auto xml_frozen = car_frozen.xml();
+
+    for (const std::string tire : {"front-tire", "rear-tire"})
+        for (const std::string parameter : {"reference-load-1", "reference-load-2", "mu-x-max-1", "mu-x-max-2", "mu-y-max-1", "mu-y-max-2", 
+                                            "kappa-max-1", "kappa-max-2", "lambda-max-1", "lambda-max-2", "Qx", "Qy"})
+        {
+            const std::string path = "vehicle/" + tire + "/" + parameter;
+
+            ASSERT_TRUE(xml_frozen->has_element(path)) << path;
+            EXPECT_NEAR(xml_frozen->get_element(path).get_value(scalar()), xml->get_element(path).get_value(scalar()), 1.0e-12) << path;
+        }
+
+    // The tires can be printed
+    std::ostringstream os;
+    car_frozen.get_chassis().get_front_axle().get_tire<0>().print(os);
+    car_frozen.get_chassis().get_rear_axle().get_tire<0>().print(os);
+}
+
+
+TEST_F(limebeer2014f1_frozen_test, benchmark)
+{
+    if ( is_valgrind ) GTEST_SKIP();
+
+    limebeer2014f1<scalar>::cartesian               car(database);
+    limebeer2014f1<scalar,Frozen_params>::cartesian car_frozen(frozen_database);
+
+    const size_t n_evaluations = 100000;
+
+    auto time_evaluations = [&](auto& vehicle)
+    {
+        scalar checksum = 0.0;
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < n_evaluations; ++i)
+        {
+            auto [dqdt, dqa] = vehicle(q0[i%2],qa0[i%2],u0[i%2],0.0);
+            checksum += dqdt[0];
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        return std::make_pair(std::chrono::duration<scalar>(end-start).count(), checksum);
+    };
+
+    const auto [time_runtime, checksum_runtime] = time_evaluations(car);
+    const auto [time_frozen, checksum_frozen]   = time_evaluations(car_frozen);
+
+    out(2) << "[limebeer2014f1_frozen] " << n_evaluations << " evaluations. Runtime parameters: " << time_runtime
+           << "s, frozen parameters: " << time_frozen << "s, speedup: " << time_runtime/time_frozen << std::endl;
+
+    EXPECT_NEAR(checksum_frozen, checksum_runtime, 1.0e-8*std::max(1.0,fabs(checksum_runtime)));
+}
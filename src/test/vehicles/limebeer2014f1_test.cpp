@@ -547,3 +547,143 @@ TEST_F(limebeer2014f1_test,propagation_crank_nicolson_corner_exit)
     for (size_t i = 0; i < 4; ++i)
         EXPECT_NEAR(qa[i],qa_next[i],1.0e-10) << ", with i = " << i;
 }
+
+
+TEST_F(limebeer2014f1_test, equations_reuse_tape)
+{
+    limebeer2014f1<CppAD::AD<double>>::cartesian car_ad(database);
+
+    constexpr const size_t NX = limebeer2014f1<CppAD::AD<double>>::cartesian::NINPUTS;
+
+    std::array<double,10> q0 = {0.0, 0.0, 0.0111971, 0.0111971, 83.3333, 0.0, 0.0, 0.0, 0.0, 0.0};
+    std::array<double,4> qa0 = {-0.874103, -0.874103, -1.07386, -1.07386};
+    std::array<double,2> u0 = {0.0, 0.644468};
+
+    std::array<double,10> q1 = {-0.05, -0.08, 0.0200000, 0.0800000, 50.0000, -5.0, 0.4, 0.0, 0.0, 5.0*DEG};
+    std::array<double,4> qa1 = {-0.674103, -0.474103, -0.80386, -0.70386};
+    std::array<double,2> u1 = {-2.0*DEG, 0.100000};
+
+    // Record the tape on the first point, and reuse it on the second
+    car_ad.equations(q0,qa0,u0,0.0);
+
+    std::vector<double> dqdt(10), dqa(4), jac_dqdt(10*NX), jac_dqa(4*NX), hess_dqdt(10*NX*NX), hess_dqa(4*NX*NX);
+    car_ad.equations(dqdt.data(), dqa.data(), jac_dqdt.data(), jac_dqa.data(), hess_dqdt.data(), hess_dqa.data(), q1, qa1, u1, 0.0);
+
+    // Compare with a fresh vehicle, which records the tape on the second point
+    limebeer2014f1<CppAD::AD<double>>::cartesian car_ad_fresh(database);
+    auto solution = car_ad_fresh.equations(q1,qa1,u1,0.0);
+
+    for (size_t i = 0; i < 10; ++i)
+    {
+        EXPECT_DOUBLE_EQ(dqdt[i], solution.dqdt[i]);
+
+        for (size_t j = 0; j < NX; ++j)
+        {
+            EXPECT_DOUBLE_EQ(jac_dqdt[i*NX+j], solution.jac_dqdt[i][j]);
+
+            for (size_t k = 0; k < NX; ++k)
+                EXPECT_DOUBLE_EQ(hess_dqdt[(i*NX+j)*NX+k], solution.hess_dqdt[i][j][k]);
+        }
+    }
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        EXPECT_DOUBLE_EQ(dqa[i], solution.dqa[i]);
+
+        for (size_t j = 0; j < NX; ++j)
+        {
+            EXPECT_DOUBLE_EQ(jac_dqa[i*NX+j], solution.jac_dqa[i][j]);
+
+            for (size_t k = 0; k < NX; ++k)
+                EXPECT_DOUBLE_EQ(hess_dqa[(i*NX+j)*NX+k], solution.hess_dqa[i][j][k]);
+        }
+    }
+
+    // Check the Hessians symmetry
+    for (size_t i = 0; i < 10; ++i)
+        for (size_t j = 0; j < NX; ++j)
+            for (size_t k = 0; k < NX; ++k)
+                EXPECT_NEAR(hess_dqdt[(i*NX+j)*NX+k], hess_dqdt[(i*NX+k)*NX+j], 1.0e-10*std::max(1.0,fabs(hess_dqdt[(i*NX+j)*NX+k])));
+}
+
+
+TEST_F(limebeer2014f1_test, equations_reuse_tape_curvilinear)
+{
+    Xml_document catalunya_xml("./database/catalunya_discrete.xml",true);
+    Track_by_polynomial catalunya(catalunya_xml);
+
+    limebeer2014f1<CppAD::AD<scalar>>::curvilinear<Track_by_polynomial>::Road_t road(catalunya);
+    limebeer2014f1<CppAD::AD<scalar>>::curvilinear<Track_by_polynomial> car_ad(database, road);
+
+    constexpr const size_t NX = limebeer2014f1<CppAD::AD<scalar>>::curvilinear_p::NINPUTS;
+
+    Xml_document opt_saved("data/f1_optimal_laptime_catalunya_discrete.xml", true);
+
+    auto arclength_saved = opt_saved.get_element("optimal_laptime/arclength").get_value(std::vector<scalar>());
+    auto kappa_fl_saved = opt_saved.get_element("optimal_laptime/steering-kappa-left").get_value(std::vector<scalar>());
+    auto kappa_fr_saved = opt_saved.get_element("optimal_laptime/steering-kappa-right").get_value(std::vector<scalar>());
+    auto kappa_rl_saved = opt_saved.get_element("optimal_laptime/powered-kappa-left").get_value(std::vector<scalar>());
+    auto kappa_rr_saved = opt_saved.get_element("optimal_laptime/powered-kappa-right").get_value(std::vector<scalar>());
+    auto u_saved        = opt_saved.get_element("optimal_laptime/u").get_value(std::vector<scalar>());
+    auto v_saved        = opt_saved.get_element("optimal_laptime/v").get_value(std::vector<scalar>());
+    auto omega_saved    = opt_saved.get_element("optimal_laptime/omega").get_value(std::vector<scalar>());
+    auto time_saved     = opt_saved.get_element("optimal_laptime/time").get_value(std::vector<scalar>());
+    auto n_saved        = opt_saved.get_element("optimal_laptime/n").get_value(std::vector<scalar>());
+    auto alpha_saved    = opt_saved.get_element("optimal_laptime/alpha").get_value(std::vector<scalar>());
+    auto delta_saved    = opt_saved.get_element("optimal_laptime/delta").get_value(std::vector<scalar>());
+    auto throttle_saved = opt_saved.get_element("optimal_laptime/throttle").get_value(std::vector<scalar>());
+    auto Fz_fl_saved    = opt_saved.get_element("optimal_laptime/Fz_fl").get_value(std::vector<scalar>());
+    auto Fz_fr_saved    = opt_saved.get_element("optimal_laptime/Fz_fr").get_value(std::vector<scalar>());
+    auto Fz_rl_saved    = opt_saved.get_element("optimal_laptime/Fz_rl").get_value(std::vector<scalar>());
+    auto Fz_rr_saved    = opt_saved.get_element("optimal_laptime/Fz_rr").get_value(std::vector<scalar>());
+
+    // Evaluate the equations on several points of the lap: the tape is recorded once, with the track geometry
+    // as a dynamic parameter, and the results match the ones of a vehicle recorded on each point
+    for (size_t i : {112, 250, 400, 113, 112})
+    {
+        std::array<scalar,10> q = {kappa_fl_saved[i], kappa_fr_saved[i], kappa_rl_saved[i], kappa_rr_saved[i],
+                                   u_saved[i], v_saved[i], omega_saved[i], time_saved[i], n_saved[i], alpha_saved[i]};
+        std::array<scalar,4> qa = {Fz_fl_saved[i], Fz_fr_saved[i], Fz_rl_saved[i], Fz_rr_saved[i]};
+        std::array<scalar,2> u = {delta_saved[i], throttle_saved[i]};
+
+        auto solution = car_ad.equations(q,qa,u,arclength_saved[i]);
+
+        limebeer2014f1<CppAD::AD<scalar>>::curvilinear<Track_by_polynomial> car_ad_fresh(database, road);
+        auto solution_fresh = car_ad_fresh.equations(q,qa,u,arclength_saved[i]);
+
+        for (size_t j = 0; j < 10; ++j)
+        {
+            EXPECT_NEAR(solution.dqdt[j], solution_fresh.dqdt[j], 1.0e-10*std::max(1.0,fabs(solution_fresh.dqdt[j])));
+
+            for (size_t k = 0; k < NX; ++k)
+            {
+                EXPECT_NEAR(solution.jac_dqdt[j][k], solution_fresh.jac_dqdt[j][k], 1.0e-10*std::max(1.0,fabs(solution_fresh.jac_dqdt[j][k])));
+
+                for (size_t l = 0; l < NX; ++l)
+                    EXPECT_NEAR(solution.hess_dqdt[j][k][l], solution_fresh.hess_dqdt[j][k][l], 1.0e-10*std::max(1.0,fabs(solution_fresh.hess_dqdt[j][k][l])));
+            }
+        }
+
+        for (size_t j = 0; j < 4; ++j)
+        {
+            EXPECT_NEAR(solution.dqa[j], solution_fresh.dqa[j], 1.0e-10*std::max(1.0,fabs(solution_fresh.dqa[j])));
+
+            for (size_t k = 0; k < NX; ++k)
+                EXPECT_NEAR(solution.jac_dqa[j][k], solution_fresh.jac_dqa[j][k], 1.0e-10*std::max(1.0,fabs(solution_fresh.jac_dqa[j][k])));
+        }
+    }
+
+    // The same state on different points of the track only changes the dynamic parameters: no new recordings
+    limebeer2014f1<CppAD::AD<scalar>>::curvilinear<Track_by_polynomial> car_ad_geometry(database, road);
+
+    const size_t i = 112;
+    std::array<scalar,10> q = {kappa_fl_saved[i], kappa_fr_saved[i], kappa_rl_saved[i], kappa_rr_saved[i],
+                               u_saved[i], v_saved[i], omega_saved[i], time_saved[i], n_saved[i], alpha_saved[i]};
+    std::array<scalar,4> qa = {Fz_fl_saved[i], Fz_fr_saved[i], Fz_rl_saved[i], Fz_rr_saved[i]};
+    std::array<scalar,2> u = {delta_saved[i], throttle_saved[i]};
+
+    for (size_t j = 0; j < arclength_saved.size(); j += 10)
+        car_ad_geometry.equations(q,qa,u,arclength_saved[j]);
+
+    EXPECT_EQ(car_ad_geometry.get_number_of_equations_recordings(), 1);
+}
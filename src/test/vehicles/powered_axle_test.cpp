@@ -8,13 +8,22 @@
 #include "src/core/chassis/chassis_car_6dof.h"
 #include "lion/math/matrix_extensions.h"
 #include "lion/propagators/rk4.h"
+#include "src/core/propagators/dormand_prince.h"
+#include "src/core/vehicles/track_run.h"
+#include "src/core/foundation/trajectory_sink.h"
 #include <iomanip>
+#include <fstream>
 
 using Rear_left_tire = Tire_pacejka_std<scalar,0,0>;
 using Rear_right_tire = Tire_pacejka_std<scalar,Rear_left_tire::STATE_END,Rear_left_tire::CONTROL_END>;
 using Axle_type = Axle_car_6dof<scalar,Rear_left_tire,Rear_right_tire,POWERED_WITHOUT_DIFFERENTIAL,Rear_right_tire::STATE_END,Rear_right_tire::CONTROL_END>;
 using Dynamic_model_t = Dynamic_model_powered_axle<scalar,Axle_type,Axle_type::STATE_END,Axle_type::CONTROL_END>;
 
+using Rear_left_tire_ad = Tire_pacejka_std<CppAD::AD<scalar>,0,0>;
+using Rear_right_tire_ad = Tire_pacejka_std<CppAD::AD<scalar>,Rear_left_tire_ad::STATE_END,Rear_left_tire_ad::CONTROL_END>;
+using Axle_type_ad = Axle_car_6dof<CppAD::AD<scalar>,Rear_left_tire_ad,Rear_right_tire_ad,POWERED_WITHOUT_DIFFERENTIAL,Rear_right_tire_ad::STATE_END,Rear_right_tire_ad::CONTROL_END>;
+using Dynamic_model_ad_t = Dynamic_model_powered_axle<CppAD::AD<scalar>,Axle_type_ad,Axle_type_ad::STATE_END,Axle_type_ad::CONTROL_END>;
+
 const static std::map<std::string,scalar> Lot2016kart_rear_axle =
 {
      std::make_pair("rear-axle/track"               , 1.200      ), 
@@ -193,3 +202,333 @@ TEST_F(Dynamic_model_powered_axle_test, simulation)
     for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
         EXPECT_NEAR(Value(q[i]), Value(q_saved[i]), 1.0e-12);
 }
+
+
+TEST_F(Dynamic_model_powered_axle_test, simulation_dormand_prince)
+{
+    std::vector<scalar> torque_values = {141.4598, 140.2284, 139.8956, 138.8799, 137.6030, 136.0224, 134.8086, 133.9224, 133.0248, 129.2422};
+
+    std::array<scalar,5> q = {5.0/0.139,0.0,0.0,0.0,5.0};
+
+    Torque_maximum_accel control(torque_values);
+
+    Dormand_prince<Dynamic_model_t,Torque_maximum_accel,Dynamic_model_t::NSTATE>::Options options;
+    options.max_h = 0.05;
+
+    Dormand_prince<Dynamic_model_t,Torque_maximum_accel,Dynamic_model_t::NSTATE> integrator(options);
+
+    scalar t = 0.0;
+    scalar dt = 1.0;
+    bool t_end_reached = false;
+
+    while (!t_end_reached)
+        integrator.take_step(_car, control, q, t, dt, 10.0, t_end_reached);
+
+    EXPECT_DOUBLE_EQ(t, 10.0);
+
+    // Same as the RK4 solution with dt = 0.005
+    const std::vector<scalar> q_saved = { 332.90195128105444, 281.20101145486979, 0.0, 0.0, 42.805806972214526};
+
+    for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
+        EXPECT_NEAR(Value(q[i]), Value(q_saved[i]), 1.0e-6);
+
+    // The first stage is reused from the previous step
+    const auto& statistics = integrator.get_statistics();
+    EXPECT_EQ(statistics.n_function_evaluations, 6*(statistics.n_steps + statistics.n_rejected_steps) + 1);
+}
+
+
+TEST_F(Dynamic_model_powered_axle_test, track_run_batch)
+{
+    std::array<scalar,5> q0 = {5.0/0.139,0.0,0.0,0.0,5.0};
+
+    Track_run<Dynamic_model_t> run(_car, q0, 1);
+    run.set_number_of_blocks(Axle_type::ITORQUE, 2);
+    run.set_polynomial_order(10);
+
+    auto options = run.get_integrator_options();
+    options.max_h = 0.02;
+    run.set_integrator_options(options);
+
+    // Construct the control vectors
+    const size_t n_runs = 16;
+    std::vector<std::vector<scalar>> x(n_runs, std::vector<scalar>(run.number_total_variables()));
+
+    for (size_t i = 0; i < n_runs; ++i)
+        for (size_t j = 0; j < x[i].size(); ++j)
+            x[i][j] = 100.0 + 40.0*sin(0.3*i + 0.5*j);
+
+    // Run in parallel, and compare with sequential runs
+    const auto objective = run.run_batch(x, 0.0, 2.0, 0.01);
+
+    ASSERT_EQ(objective.size(), n_runs);
+
+    for (size_t i = 0; i < n_runs; ++i)
+        EXPECT_DOUBLE_EQ(objective[i], run(x[i], 0.0, 2.0, 0.01)) << "with i = " << i;
+
+    // Decimated outputs contain one of every n steps, and the final point
+    Track_run<Dynamic_model_t>::Output output;
+    Track_run<Dynamic_model_t>::Output output_decimated;
+    run.simulate_and_return(x.front(), 0.0, 2.0, 0.01, output);
+    run.simulate_and_return(x.front(), 0.0, 2.0, 0.01, output_decimated, 5);
+
+    const size_t n_steps = output.t.size() - 1;
+    EXPECT_EQ(output_decimated.t.size(), n_steps/5 + 1 + (n_steps % 5 == 0 ? 0 : 1));
+    EXPECT_DOUBLE_EQ(output.t.back(), 2.0);
+    EXPECT_DOUBLE_EQ(output_decimated.t.back(), 2.0);
+
+    for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
+        EXPECT_DOUBLE_EQ(output_decimated.q.back()[i], output.q.back()[i]);
+
+    for (size_t k = 1; k < output_decimated.t.size() - 1; ++k)
+        EXPECT_DOUBLE_EQ(output_decimated.t[k], output.t[5*k]);
+}
+
+
+TEST_F(Dynamic_model_powered_axle_test, track_run_sinks)
+{
+    std::array<scalar,5> q0 = {5.0/0.139,0.0,0.0,0.0,5.0};
+
+    Track_run<Dynamic_model_t> run(_car, q0, 1);
+    run.set_number_of_blocks(Axle_type::ITORQUE, 2);
+    run.set_polynomial_order(10);
+
+    std::vector<scalar> x(run.number_total_variables());
+    for (size_t j = 0; j < x.size(); ++j)
+        x[j] = 100.0 + 40.0*sin(0.5*j);
+
+    const scalar objective = run(x, 0.0, 2.0, 0.01);
+
+    // Reference trajectory with all the steps
+    Track_run<Dynamic_model_t>::Output output;
+    run.simulate_and_return(x, 0.0, 2.0, 0.01, output);
+
+    // (1) Dense output every 0.05s to a ring buffer that keeps the last 10 points
+    Trajectory_ring_buffer<Dynamic_model_t::NSTATE> buffer(10);
+    EXPECT_DOUBLE_EQ(run.simulate_to_sink(x, 0.0, 2.0, 0.01, buffer, {0.05, 1}), objective);
+
+    EXPECT_EQ(buffer.n_received(), 41u);
+    ASSERT_EQ(buffer.size(), 10u);
+
+    for (size_t i = 0; i < buffer.size(); ++i)
+        EXPECT_NEAR(buffer.get_t(i), 1.55 + 0.05*i, 1.0e-12);
+
+    for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
+        EXPECT_DOUBLE_EQ(buffer.get_q(9)[i], output.q.back()[i]);
+
+    // The interpolated points shall be close to the linear interpolation between the steps
+    size_t k = 0;
+    while ( output.t[k+1] < 1.75 ) ++k;
+
+    const scalar xi = (1.75 - output.t[k])/(output.t[k+1] - output.t[k]);
+    for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
+    {
+        const scalar q_linear = (1.0-xi)*output.q[k][i] + xi*output.q[k+1][i];
+        EXPECT_NEAR(buffer.get_q(4)[i], q_linear, 1.0e-3*std::max(1.0,std::abs(q_linear)));
+    }
+
+    // (2) Decimated steps to a binary file
+    {
+        Trajectory_file_writer<Dynamic_model_t::NSTATE> file("track_run_sinks.bin", Trajectory_file_writer<Dynamic_model_t::NSTATE>::BINARY, {}, 7, 2);
+        run.simulate_to_sink(x, 0.0, 2.0, 0.01, file, {0.0, 3});
+    }
+
+    std::ifstream binary("track_run_sinks.bin", std::ios::binary);
+    char magic[8];
+    uint64_t n_columns;
+    binary.read(magic, 8);
+    binary.read(reinterpret_cast<char*>(&n_columns), sizeof(uint64_t));
+
+    EXPECT_EQ(std::string(magic,8), "FLTRAJ01");
+    EXPECT_EQ(n_columns, Dynamic_model_t::NSTATE + 1);
+
+    std::vector<scalar> rows;
+    scalar value;
+    while (binary.read(reinterpret_cast<char*>(&value), sizeof(scalar)))
+        rows.push_back(value);
+
+    const size_t n_steps = output.t.size() - 1;
+    const size_t n_rows = n_steps/3 + 1 + (n_steps % 3 == 0 ? 0 : 1);
+    ASSERT_EQ(rows.size(), n_rows*n_columns);
+
+    for (size_t k = 0; k < n_rows - 1; ++k)
+    {
+        EXPECT_DOUBLE_EQ(rows[k*n_columns], output.t[3*k]);
+
+        for (size_t i = 0; i < Dynamic_model_t::NSTATE; ++i)
+            EXPECT_DOUBLE_EQ(rows[k*n_columns + 1 + i], output.q[3*k][i]);
+    }
+
+    EXPECT_DOUBLE_EQ(rows[(n_rows-1)*n_columns], 2.0);
+
+    // (3) All the steps to a CSV file through operator()
+    run.set_output_file("track_run_sinks.csv");
+    EXPECT_DOUBLE_EQ(run(x, 0.0, 2.0, 0.01, true), objective);
+
+    std::ifstream csv("track_run_sinks.csv");
+    std::string line;
+    std::getline(csv, line);
+    EXPECT_EQ(line, "t,q[0],q[1],q[2],q[3],q[4]");
+
+    size_t n_lines = 0;
+    while (std::getline(csv, line))
+        ++n_lines;
+
+    EXPECT_EQ(n_lines, output.t.size());
+}
+
+
+TEST_F(Dynamic_model_powered_axle_test, track_run_gradient)
+{
+    std::array<scalar,5> q0 = {5.0/0.139,0.0,0.0,0.0,5.0};
+
+    Track_run<Dynamic_model_t> run(_car, q0, 1);
+    run.set_number_of_blocks(Axle_type::ITORQUE, 2);
+    run.set_polynomial_order(10);
+
+    std::vector<scalar> x(run.number_total_variables());
+    for (size_t j = 0; j < x.size(); ++j)
+        x[j] = 100.0 + 40.0*sin(0.5*j);
+
+    const scalar objective = run(x, 0.0, 2.0, 0.01);
+
+    // (1) Adjoint, with several checkpoint intervals, and forward gradients
+    std::vector<scalar> gradient_adjoint, gradient_adjoint_checkpoints, gradient_forward;
+    EXPECT_NEAR(run(x, 0.0, 2.0, 0.01, gradient_adjoint), objective, 1.0e-10*std::abs(objective));
+
+    run.set_checkpoint_interval(7);
+    run(x, 0.0, 2.0, 0.01, gradient_adjoint_checkpoints);
+
+    EXPECT_NEAR(run(x, 0.0, 2.0, 0.01, gradient_forward, Track_run<Dynamic_model_t>::FORWARD), objective, 1.0e-10*std::abs(objective));
+
+    ASSERT_EQ(gradient_adjoint.size(), x.size());
+    ASSERT_EQ(gradient_adjoint_checkpoints.size(), x.size());
+    ASSERT_EQ(gradient_forward.size(), x.size());
+
+    for (size_t j = 0; j < x.size(); ++j)
+    {
+        EXPECT_NEAR(gradient_adjoint_checkpoints[j], gradient_adjoint[j], 1.0e-12*std::max(1.0,std::abs(gradient_adjoint[j])));
+        EXPECT_NEAR(gradient_forward[j], gradient_adjoint[j], 1.0e-10*std::max(1.0,std::abs(gradient_adjoint[j])));
+    }
+
+    // (2) Compare against central differences of the objective. The steps of the integrator change with x, while the
+    //     gradients keep them fixed: the difference is of the order of the integrator tolerance
+    const scalar h = 1.0e-2;
+    for (size_t j = 0; j < x.size(); ++j)
+    {
+        auto x_plus = x, x_minus = x;
+        x_plus[j] += h;
+        x_minus[j] -= h;
+
+        const scalar gradient_fd = (run(x_plus, 0.0, 2.0, 0.01) - run(x_minus, 0.0, 2.0, 0.01))/(2.0*h);
+
+        EXPECT_NEAR(gradient_adjoint[j], gradient_fd, 1.0e-3*std::max(1.0,std::abs(gradient_fd))) << "with j = " << j;
+    }
+
+    // (3) Sensitivities of the final states: the row of x is the gradient without the explicit terms
+    std::vector<scalar> dqdx;
+    const auto q_final = run.final_state_sensitivities(x, 0.0, 2.0, 0.01, dqdx);
+
+    ASSERT_EQ(dqdx.size(), Dynamic_model_t::NSTATE*x.size());
+    EXPECT_NEAR(q_final[Dynamic_model_t::Road_type::IX] - std::pow(x[10]-x[11],2)/1.0e1, objective, 1.0e-10*std::abs(objective));
+
+    for (size_t j = 0; j < x.size(); ++j)
+    {
+        const scalar explicit_term = (j == 10 ? -2.0*(x[10]-x[11])/1.0e1 : (j == 11 ? 2.0*(x[10]-x[11])/1.0e1 : 0.0));
+        EXPECT_NEAR(dqdx[Dynamic_model_t::Road_type::IX*x.size() + j] + explicit_term, gradient_forward[j], 1.0e-12*std::max(1.0,std::abs(gradient_forward[j])));
+    }
+}
+
+
+TEST_F(Dynamic_model_powered_axle_test, track_run_gradient_fixed_steps)
+{
+    // With fixed steps (tolerances never reached), central differences of the objective approximate the derivatives 
+    // of the computed solution, and check the gradients tightly
+    Dynamic_model_ad_t car_ad(Fz, *database);
+
+    const std::array<scalar,5> q0 = {5.0/0.139,0.0,0.0,0.0,5.0};
+    std::array<CppAD::AD<scalar>,5> q0_ad;
+    std::copy(q0.cbegin(), q0.cend(), q0_ad.begin());
+
+    Track_run<Dynamic_model_t> run(_car, q0, 1);
+    Track_run<Dynamic_model_ad_t> run_ad(car_ad, q0_ad, 1);
+
+    const std::vector<std::pair<std::string,scalar>> parameters = { {"vehicle/chassis/mass", 165.0}, 
+                                                                    {"vehicle/rear-tire/longitudinal/pure/pDx1", 0.9} };
+
+    auto options = run.get_integrator_options();
+    options.relative_error = 1.0e3;
+    options.absolute_error = 1.0e3;
+
+    auto set_up = [&](auto& track_run)
+    {
+        track_run.set_number_of_blocks(Axle_type::ITORQUE, 2);
+        track_run.set_polynomial_order(10);
+        track_run.set_integrator_options(options);
+
+        for (const auto& [name, value] : parameters)
+            track_run.add_gradient_parameter(name, value);
+    };
+
+    set_up(run);
+    set_up(run_ad);
+
+    std::vector<scalar> x(run.number_total_variables());
+    for (size_t j = 0; j < x.size(); ++j)
+        x[j] = 100.0 + 40.0*sin(0.5*j);
+
+    const std::vector<CppAD::AD<scalar>> x_ad(x.cbegin(), x.cend());
+
+    // (1) Gradients of the AD vehicle (CppAD Jacobians), and of the scalar vehicle (central differences Jacobians)
+    std::vector<scalar> gradient_ad, gradient_ad_forward, gradient_scalar;
+    const scalar objective = Value(run_ad(x_ad, 0.0, 2.0, 0.01, gradient_ad));
+    run_ad(x_ad, 0.0, 2.0, 0.01, gradient_ad_forward, Track_run<Dynamic_model_ad_t>::FORWARD);
+
+    EXPECT_NEAR(run(x, 0.0, 2.0, 0.01, gradient_scalar), objective, 1.0e-10*std::abs(objective));
+
+    const size_t n_derivatives = x.size() + parameters.size();
+    ASSERT_EQ(gradient_ad.size(), n_derivatives);
+    ASSERT_EQ(gradient_ad_forward.size(), n_derivatives);
+    ASSERT_EQ(gradient_scalar.size(), n_derivatives);
+
+    // (2) Central differences of the objective, w.r.t. x and the vehicle parameters
+    std::vector<scalar> gradient_reference(n_derivatives);
+
+    const scalar h = 1.0e-3;
+    for (size_t j = 0; j < x.size(); ++j)
+    {
+        auto x_plus = x, x_minus = x;
+        x_plus[j] += h;
+        x_minus[j] -= h;
+
+        gradient_reference[j] = (run(x_plus, 0.0, 2.0, 0.01) - run(x_minus, 0.0, 2.0, 0.01))/(2.0*h);
+    }
+
+    for (size_t v = 0; v < parameters.size(); ++v)
+    {
+        const auto& [name, value] = parameters[v];
+        const scalar h_parameter = 1.0e-5*value;
+
+        run.get_vehicle().set_parameter(name, value + h_parameter);
+        const scalar objective_plus = run(x, 0.0, 2.0, 0.01);
+
+        run.get_vehicle().set_parameter(name, value - h_parameter);
+        const scalar objective_minus = run(x, 0.0, 2.0, 0.01);
+
+        run.get_vehicle().set_parameter(name, value);
+
+        gradient_reference[x.size() + v] = (objective_plus - objective_minus)/(2.0*h_parameter);
+    }
+
+    // (3) The AD gradients are exact w.r.t. x. The Jacobians w.r.t. the vehicle parameters, and all the Jacobians of
+    //     the scalar vehicle, are computed by central differences, and are less accurate
+    for (size_t j = 0; j < n_derivatives; ++j)
+    {
+        const scalar tolerance = std::max(1.0,std::abs(gradient_reference[j]));
+        const scalar tolerance_ad = (j < x.size() ? 1.0e-7 : 1.0e-4)*tolerance;
+
+        EXPECT_NEAR(gradient_ad_forward[j], gradient_ad[j], 1.0e-10*tolerance) << "with j = " << j;
+        EXPECT_NEAR(gradient_ad[j], gradient_reference[j], tolerance_ad) << "with j = " << j;
+        EXPECT_NEAR(gradient_scalar[j], gradient_reference[j], 1.0e-4*tolerance) << "with j = " << j;
+    }
+}
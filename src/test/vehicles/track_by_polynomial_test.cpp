@@ -1,5 +1,9 @@
 #include "gtest/gtest.h"
 #include "src/core/vehicles/track_by_polynomial.h"
+#include "src/core/vehicles/track_cache.h"
+#include "src/core/vehicles/track_projection.h"
+#include <chrono>
+#include "lion/thirdparty/include/logger.hpp"
 
 TEST(Track_by_polynomial_test, evaluation_at_nodes)
 {
@@ -27,3 +31,291 @@ TEST(Track_by_polynomial_test, evaluation_at_nodes)
         EXPECT_NEAR(d2r.y(), -circuit.kappa[i]*cos(-circuit.theta[i]), 1.0e-15);
     }
 }
+
+
+TEST(Track_by_polynomial_test, shared_data)
+{
+    Xml_document catalunya = {"./database/catalunya_discrete.xml", true};
+
+    const Circuit_preprocessor circuit(catalunya);
+
+    Track_by_polynomial track(circuit);
+
+    EXPECT_TRUE(track.has_preprocessor());
+    EXPECT_EQ(track.get_preprocessor().n_points, circuit.n_points);
+
+    // Copies share the data with the original track
+    Track_by_polynomial track_copy(track);
+
+    EXPECT_TRUE(track_copy.is_same_track(track));
+    EXPECT_EQ(&track_copy.get_preprocessor(), &track.get_preprocessor());
+    EXPECT_EQ(&track_copy.get_total_length(), &track.get_total_length());
+
+    // The runtime track can drop the preprocessor
+    const auto runtime_track = track.without_preprocessor();
+
+    EXPECT_TRUE(runtime_track.is_same_track(track));
+    EXPECT_FALSE(runtime_track.has_preprocessor());
+    EXPECT_THROW(runtime_track.get_preprocessor(), std::runtime_error);
+
+    const auto [r, dr, d2r] = runtime_track(0.5*track.get_total_length());
+    const auto [r_ref, dr_ref, d2r_ref] = track(0.5*track.get_total_length());
+
+    EXPECT_DOUBLE_EQ(r.x(), r_ref.x());
+    EXPECT_DOUBLE_EQ(r.y(), r_ref.y());
+
+    // Tracks constructed independently do not share the data
+    Track_by_polynomial track_without_preprocessor(circuit, false);
+
+    EXPECT_FALSE(track_without_preprocessor.is_same_track(track));
+    EXPECT_FALSE(track_without_preprocessor.has_preprocessor());
+    EXPECT_DOUBLE_EQ(track_without_preprocessor.get_total_length(), track.get_total_length());
+}
+
+
+TEST(Track_by_polynomial_test, cache)
+{
+    const std::string directory = (std::filesystem::temp_directory_path() / "fastest-lap-track-cache-test").string();
+    std::filesystem::remove_all(directory);
+
+    Track_cache cache(directory);
+
+    // (1) The first call reads the xml and stores the track, the second loads it
+    const auto track_stored = cache.get_track("./database/catalunya_discrete.xml");
+    const auto track_loaded = cache.get_track("./database/catalunya_discrete.xml");
+
+    const uint64_t key = Track_cache::Content_hash().add(std::string("discrete")).add_file("./database/catalunya_discrete.xml").get();
+    EXPECT_TRUE(std::filesystem::exists(cache.get_path(key)));
+
+    // (2) The loaded preprocessor is identical
+    Xml_document catalunya = {"./database/catalunya_discrete.xml", true};
+    const Circuit_preprocessor circuit(catalunya);
+    const auto& circuit_loaded = track_loaded.get_preprocessor();
+
+    EXPECT_EQ(circuit_loaded.is_closed, circuit.is_closed);
+    EXPECT_EQ(circuit_loaded.n_points, circuit.n_points);
+    EXPECT_EQ(circuit_loaded.n_elements, circuit.n_elements);
+    EXPECT_EQ(circuit_loaded.track_length, circuit.track_length);
+    EXPECT_EQ(circuit_loaded.left_boundary_L2_error, circuit.left_boundary_L2_error);
+    EXPECT_EQ(circuit_loaded.options.eps_k, circuit.options.eps_k);
+    EXPECT_EQ(circuit_loaded.r_left_measured.size(), circuit.r_left_measured.size());
+    EXPECT_EQ(circuit_loaded.r_right_measured.size(), circuit.r_right_measured.size());
+
+    for (size_t i = 0; i < circuit.n_points; ++i)
+    {
+        EXPECT_EQ(circuit_loaded.s[i], circuit.s[i]);
+        EXPECT_EQ(circuit_loaded.r_centerline[i].x(), circuit.r_centerline[i].x());
+        EXPECT_EQ(circuit_loaded.r_centerline[i].y(), circuit.r_centerline[i].y());
+        EXPECT_EQ(circuit_loaded.r_left[i].x(), circuit.r_left[i].x());
+        EXPECT_EQ(circuit_loaded.r_right[i].y(), circuit.r_right[i].y());
+        EXPECT_EQ(circuit_loaded.theta[i], circuit.theta[i]);
+        EXPECT_EQ(circuit_loaded.kappa[i], circuit.kappa[i]);
+        EXPECT_EQ(circuit_loaded.nl[i], circuit.nl[i]);
+        EXPECT_EQ(circuit_loaded.nr[i], circuit.nr[i]);
+        EXPECT_EQ(circuit_loaded.dkappa[i], circuit.dkappa[i]);
+        EXPECT_EQ(circuit_loaded.dnl[i], circuit.dnl[i]);
+        EXPECT_EQ(circuit_loaded.dnr[i], circuit.dnr[i]);
+    }
+
+    // (3) And so is the track
+    EXPECT_EQ(track_loaded.get_total_length(), track_stored.get_total_length());
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        const scalar s = track_stored.get_total_length()*i/100.0;
+        const auto [r, dr, d2r] = track_loaded(s);
+        const auto [r_ref, dr_ref, d2r_ref] = track_stored(s);
+
+        EXPECT_EQ(r.x(), r_ref.x());
+        EXPECT_EQ(r.y(), r_ref.y());
+        EXPECT_EQ(dr.x(), dr_ref.x());
+        EXPECT_EQ(d2r.y(), d2r_ref.y());
+        EXPECT_EQ(track_loaded.get_left_track_limit(s), track_stored.get_left_track_limit(s));
+        EXPECT_EQ(track_loaded.get_right_track_limit(s), track_stored.get_right_track_limit(s));
+    }
+
+    // (4) Invalid data is rejected: other keys, and corrupted or truncated payloads
+    auto data = Track_cache::serialize(key, circuit);
+    Circuit_preprocessor circuit_read;
+
+    EXPECT_TRUE(Track_cache::deserialize(data.data(), data.size(), key, circuit_read));
+    EXPECT_FALSE(Track_cache::deserialize(data.data(), data.size(), key + 1, circuit_read));
+    EXPECT_FALSE(Track_cache::deserialize(data.data(), data.size() - 8, key, circuit_read));
+
+    data[data.size()/2] ^= 0x01;
+    EXPECT_FALSE(Track_cache::deserialize(data.data(), data.size(), key, circuit_read));
+
+    // (5) A corrupted file is ignored, and rewritten
+    {
+        std::ofstream file(cache.get_path(key), std::ios::binary);
+        file.write(data.data(), data.size());
+    }
+
+    EXPECT_FALSE(cache.load(key, circuit_read));
+
+    const auto track_rewritten = cache.get_track("./database/catalunya_discrete.xml");
+    EXPECT_EQ(track_rewritten.get_total_length(), track_stored.get_total_length());
+    EXPECT_TRUE(cache.load(key, circuit_read));
+
+    std::filesystem::remove_all(directory);
+}
+
+
+TEST(Track_by_polynomial_test, projection)
+{
+    Xml_document catalunya = {"./database/catalunya_discrete.xml", true};
+    const Track_by_polynomial track(catalunya);
+    const scalar L = track.get_total_length();
+
+    const Track_projection projection(track);
+    EXPECT_TRUE(projection.is_closed());
+
+    // (1) Points along a lap, offset from the centerline
+    const size_t n_points = 20000;
+    std::vector<scalar> s(n_points), n(n_points);
+    std::vector<sVector3d> points(n_points);
+
+    for (size_t i = 0; i < n_points; ++i)
+    {
+        s[i] = L*(i + 0.5)/n_points;
+        n[i] = 5.0*sin(2.0*pi*7.0*i/n_points);
+        points[i] = track.position_at(s[i], n[i]);
+    }
+
+    auto periodic_distance = [&](const scalar s1, const scalar s2) { const scalar d = std::abs(s1 - s2); return std::min(d, L - d); };
+
+    // (2) One by one, with the spatial index
+    for (size_t i = 0; i < n_points; i += 100)
+    {
+        const auto result = projection.project(points[i]);
+        EXPECT_LT(periodic_distance(result.s, s[i]), 1.0e-6) << "with i = " << i;
+        EXPECT_NEAR(result.n, n[i], 1.0e-6) << "with i = " << i;
+    }
+
+    // (3) Sequential and parallel batches
+    for (const bool parallel : {false, true})
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto result = projection.project(points, parallel);
+        const std::chrono::duration<scalar> elapsed = std::chrono::steady_clock::now() - start;
+
+        out(2) << "[projection] " << (parallel ? "parallel" : "sequential") << ": " << n_points/elapsed.count() << " points/s" << std::endl;
+
+        ASSERT_EQ(result.size(), n_points);
+
+        for (size_t i = 0; i < n_points; ++i)
+        {
+            EXPECT_LT(periodic_distance(result[i].s, s[i]), 1.0e-6) << "with i = " << i;
+            EXPECT_NEAR(result[i].n, n[i], 1.0e-6) << "with i = " << i;
+        }
+    }
+
+    // (4) A wrong hint falls back to the spatial index
+    const auto result = projection.project(points[n_points/2], 0.0);
+    EXPECT_LT(periodic_distance(result.s, s[n_points/2]), 1.0e-6);
+    EXPECT_NEAR(result.n, n[n_points/2], 1.0e-6);
+}
+
+
+TEST(Track_by_polynomial_test, fused_evaluation)
+{
+    Xml_document catalunya = {"./database/catalunya_discrete.xml", true};
+    const Circuit_preprocessor circuit(catalunya);
+    const Track_by_polynomial track(circuit);
+
+    ASSERT_TRUE(track.has_nodes());
+
+    // (1) Reference: the polynomials of the same nodes, as in the constructor from a preprocessor
+    auto s = circuit.s;
+    auto r = circuit.r_centerline;
+    auto theta = circuit.theta;
+    auto kappa = circuit.kappa;
+    auto nl = circuit.nl;
+    auto nr = circuit.nr;
+
+    s.push_back(circuit.track_length);
+    r.push_back(r.front());
+    theta.push_back(theta.front());
+    kappa.push_back(kappa.front());
+    nl.push_back(nl.front());
+    nr.push_back(nr.front());
+
+    std::vector<sVector3d> dr(s.size()), d2r(s.size());
+
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        r[i].y() *= -1.0;
+        dr[i] = sVector3d(cos(-theta[i]), sin(-theta[i]), 0.0);
+        d2r[i] = -kappa[i]*sVector3d(-sin(-theta[i]), cos(-theta[i]), 0.0);
+    }
+
+    const Track_by_polynomial track_reference(vPolynomial(s,r,1,false), vPolynomial(s,dr,1,false), vPolynomial(s,d2r,1,false), 
+                                              sPolynomial(s,nl,1,false), sPolynomial(s,nr,1,false));
+
+    ASSERT_FALSE(track_reference.has_nodes());
+
+    // (2) Monotone queries with a cursor, and random queries
+    const scalar L = track.get_total_length();
+    const size_t n = 20000;
+    Track_by_polynomial::Cursor cursor(track);
+    Track_by_polynomial::Cursor cursor_random(track);
+
+    for (size_t i = 0; i <= n; ++i)
+    {
+        const scalar s_monotone = L*i/n;
+        const scalar s_random = L*std::fmod(0.618033988749895*i, 1.0);
+
+        for (const scalar s_i : {s_monotone, s_random})
+        {
+            const auto geometry = track.evaluate(s_i);
+            const auto geometry_cursor = (s_i == s_monotone ? cursor(s_i) : cursor_random(s_i));
+            const auto [r_ref, dr_ref, d2r_ref] = track_reference(s_i);
+            const auto [r_i, dr_i, d2r_i] = track(s_i);
+
+            EXPECT_NEAR(geometry.r.x()  , r_ref.x()  , 1.0e-9) << "with s = " << s_i;
+            EXPECT_NEAR(geometry.r.y()  , r_ref.y()  , 1.0e-9) << "with s = " << s_i;
+            EXPECT_NEAR(geometry.dr.x() , dr_ref.x() , 1.0e-12) << "with s = " << s_i;
+            EXPECT_NEAR(geometry.dr.y() , dr_ref.y() , 1.0e-12) << "with s = " << s_i;
+            EXPECT_NEAR(geometry.d2r.x(), d2r_ref.x(), 1.0e-12) << "with s = " << s_i;
+            EXPECT_NEAR(geometry.d2r.y(), d2r_ref.y(), 1.0e-12) << "with s = " << s_i;
+            EXPECT_NEAR(geometry.wl     , track_reference.get_left_track_limit(s_i) , 1.0e-12) << "with s = " << s_i;
+            EXPECT_NEAR(geometry.wr     , track_reference.get_right_track_limit(s_i), 1.0e-12) << "with s = " << s_i;
+
+            // The cursor, the fused evaluation, and the separate calls are identical
+            EXPECT_EQ(geometry_cursor.r.x(), geometry.r.x());
+            EXPECT_EQ(geometry_cursor.dr.y(), geometry.dr.y());
+            EXPECT_EQ(geometry_cursor.d2r.x(), geometry.d2r.x());
+            EXPECT_EQ(geometry_cursor.wl, geometry.wl);
+            EXPECT_EQ(geometry_cursor.wr, geometry.wr);
+            EXPECT_EQ(r_i.y(), geometry.r.y());
+            EXPECT_EQ(dr_i.x(), geometry.dr.x());
+            EXPECT_EQ(d2r_i.y(), geometry.d2r.y());
+            EXPECT_EQ(track.get_left_track_limit(s_i), geometry.wl);
+            EXPECT_EQ(track.get_right_track_limit(s_i), geometry.wr);
+        }
+    }
+
+    // (3) Timings of the monotone sampling
+    auto start = std::chrono::steady_clock::now();
+    scalar checksum_reference = 0.0;
+    for (size_t i = 0; i <= n; ++i)
+    {
+        const scalar s_i = L*i/n;
+        const auto [r_ref, dr_ref, d2r_ref] = track_reference(s_i);
+        checksum_reference += r_ref.x() + dr_ref.y() + d2r_ref.x() + track_reference.get_left_track_limit(s_i) + track_reference.get_right_track_limit(s_i);
+    }
+    const std::chrono::duration<scalar> elapsed_reference = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    Track_by_polynomial::Cursor cursor_timing(track);
+    scalar checksum = 0.0;
+    for (size_t i = 0; i <= n; ++i)
+    {
+        const auto geometry = cursor_timing(L*i/n);
+        checksum += geometry.r.x() + geometry.dr.y() + geometry.d2r.x() + geometry.wl + geometry.wr;
+    }
+    const std::chrono::duration<scalar> elapsed = std::chrono::steady_clock::now() - start;
+
+    out(2) << "[fused_evaluation] polynomials: " << elapsed_reference.count() << "s, cursor: " << elapsed.count() << "s" << std::endl;
+    EXPECT_NEAR(checksum, checksum_reference, 1.0e-6*std::abs(checksum_reference));
+}